@@ -0,0 +1,149 @@
+#include "animation.h"
+
+AnimationPlayer::AnimationPlayer()
+    : frame(nullptr), maxPixels(0), pixelCount(0), frameInterval(0), frameCount(0),
+      frameIndex(0), lastFrameMs(0), decodeErrors(0), looping(false), playing(false),
+      chunkPos(0), chunkLen(0) {
+}
+
+AnimationPlayer::~AnimationPlayer() {
+    delete[] frame;
+}
+
+// Буфер кадра выделяется один раз под максимальную длину ленты.
+// LittleFS к этому моменту уже смонтирована в setup()
+void AnimationPlayer::begin(uint16_t pixels) {
+    maxPixels = pixels;
+    frame = new uint8_t[maxPixels * 3];
+    memset(frame, 0, maxPixels * 3);
+}
+
+bool AnimationPlayer::play(const char* path) {
+    stop();
+
+    file = LittleFS.open(path, "r");
+    if (!file) return false;
+
+    uint8_t header[ANIM_HEADER_SIZE];
+    if (file.read(header, ANIM_HEADER_SIZE) != ANIM_HEADER_SIZE || memcmp(header, "LCA1", 4) != 0) {
+        file.close();
+        return false;
+    }
+
+    pixelCount = header[4] | (header[5] << 8);
+    uint8_t channels = header[6];
+    looping = header[7] & ANIM_FLAG_LOOP;
+    frameInterval = header[8] | (header[9] << 8);
+    frameCount = header[10] | (header[11] << 8) | ((uint32_t)header[12] << 16) | ((uint32_t)header[13] << 24);
+
+    if (pixelCount == 0 || pixelCount > maxPixels || channels != 3 || frameCount == 0 || frameInterval == 0) {
+        file.close();
+        return false;
+    }
+
+    if (!rewind() || !decodeFrame()) {
+        file.close();
+        return false;
+    }
+
+    playing = true;
+    lastFrameMs = millis();
+    return true;
+}
+
+void AnimationPlayer::stop() {
+    playing = false;
+    if (file) {
+        file.close();
+    }
+}
+
+bool AnimationPlayer::rewind() {
+    chunkPos = 0;
+    chunkLen = 0;
+    frameIndex = 0;
+    return file.seek(ANIM_HEADER_SIZE);
+}
+
+bool AnimationPlayer::readByte(uint8_t& value) {
+    if (chunkPos >= chunkLen) {
+        int got = file.read(chunk, ANIM_CHUNK_SIZE);
+        if (got <= 0) return false;
+        chunkLen = got;
+        chunkPos = 0;
+    }
+    value = chunk[chunkPos++];
+    return true;
+}
+
+// Распаковка следующего кадра прямо в буфер кадра
+bool AnimationPlayer::decodeFrame() {
+    uint8_t type, lengthLow, lengthHigh;
+    if (!readByte(type) || !readByte(lengthLow) || !readByte(lengthHigh)) return false;
+
+    // Первый кадр должен быть ключевым, иначе XOR не с чем делать
+    if (type > ANIM_FRAME_DELTA || (frameIndex == 0 && type != ANIM_FRAME_KEY)) return false;
+
+    bool delta = type == ANIM_FRAME_DELTA;
+    uint16_t encodedLength = lengthLow | (lengthHigh << 8);
+    uint16_t frameBytes = pixelCount * 3;
+    uint16_t consumed = 0;
+    uint16_t out = 0;
+
+    while (out < frameBytes) {
+        uint8_t control, value;
+        if (!readByte(control)) return false;
+        consumed++;
+
+        uint8_t count = (control & 0x7F) + 1;
+        if (out + count > frameBytes) return false;
+
+        if (control & 0x80) {
+            if (!readByte(value)) return false;
+            consumed++;
+            for(uint8_t i = 0; i < count; i++, out++) {
+                frame[out] = delta ? frame[out] ^ value : value;
+            }
+        } else {
+            for(uint8_t i = 0; i < count; i++, out++) {
+                if (!readByte(value)) return false;
+                frame[out] = delta ? frame[out] ^ value : value;
+            }
+            consumed += count;
+        }
+    }
+
+    frameIndex++;
+    return consumed == encodedLength;
+}
+
+void AnimationPlayer::update(uint32_t nowMs) {
+    if (!playing) return;
+
+    for(uint8_t i = 0; i < ANIM_MAX_FRAMES_PER_UPDATE; i++) {
+        if (nowMs - lastFrameMs < frameInterval) return;
+        lastFrameMs += frameInterval;
+
+        if (frameIndex >= frameCount) {
+            if (!looping) {
+                // Анимация закончилась, под цифрами снова темный фон
+                stop();
+                return;
+            }
+            if (!rewind()) {
+                decodeErrors++;
+                stop();
+                return;
+            }
+        }
+
+        if (!decodeFrame()) {
+            decodeErrors++;
+            stop();
+            return;
+        }
+    }
+
+    // Сильно отстали - не пытаемся догнать, продолжаем с текущего момента
+    lastFrameMs = nowMs;
+}
@@ -0,0 +1,61 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Формат файла анимации (little-endian):
+//   заголовок 16 байт: "LCA1", pixelCount u16, channels u8, flags u8,
+//                      frameInterval u16 (мс), frameCount u32, reserved u16
+//   кадр: type u8, encodedLength u16, данные RLE
+// Данные кадра - поток байтов RGB длиной pixelCount * 3. Управляющий байт RLE:
+//   0x80 | (n - 1) - повтор следующего байта n раз,
+//   n - 1          - n байтов как есть.
+// Ключевой кадр пишет байты в кадр, разностный - применяет XOR к предыдущему кадру.
+const uint8_t ANIM_HEADER_SIZE = 16;
+const uint8_t ANIM_FRAME_KEY = 0;
+const uint8_t ANIM_FRAME_DELTA = 1;
+const uint8_t ANIM_FLAG_LOOP = 0x01;
+const uint8_t ANIM_CHUNK_SIZE = 64;           // порция чтения из flash
+const uint8_t ANIM_MAX_FRAMES_PER_UPDATE = 4; // догоняем не больше кадров за вызов
+const char* const ANIM_PATH = "/anim.lca";
+
+// Проигрывание анимации потоком из LittleFS.
+// В памяти только текущий кадр и небольшой буфер чтения.
+class AnimationPlayer {
+public:
+    AnimationPlayer();
+    ~AnimationPlayer();
+    void begin(uint16_t maxPixels);
+    bool play(const char* path);
+    void stop();
+    void update(uint32_t nowMs);
+    bool isPlaying() const { return playing; }
+    const uint8_t* getFrame() const { return frame; }
+    uint16_t getPixelCount() const { return pixelCount; }
+    uint32_t getFrameIndex() const { return frameIndex; }
+    uint32_t getDecodeErrors() const { return decodeErrors; }
+
+private:
+    File file;
+    uint8_t* frame;
+    uint16_t maxPixels;
+    uint16_t pixelCount;
+    uint16_t frameInterval;
+    uint32_t frameCount;
+    uint32_t frameIndex;
+    uint32_t lastFrameMs;
+    uint32_t decodeErrors;
+    bool looping;
+    bool playing;
+
+    uint8_t chunk[ANIM_CHUNK_SIZE];
+    uint8_t chunkPos;
+    uint8_t chunkLen;
+
+    bool readByte(uint8_t& value);
+    bool rewind();
+    bool decodeFrame();
+};
+
+#endif
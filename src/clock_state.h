@@ -0,0 +1,34 @@
+#ifndef CLOCK_STATE_H
+#define CLOCK_STATE_H
+
+#include <Arduino.h>
+#include "effects.h"
+
+// Изменение состояния, накопленное между кадрами.
+// Поля применяются все вместе в начале следующего кадра,
+// при повторной записи поля остается только последнее значение.
+const uint8_t UPDATE_COLOR = 0x01;
+const uint8_t UPDATE_BRIGHTNESS = 0x02;
+const uint8_t UPDATE_EFFECT = 0x04;
+const uint8_t UPDATE_TRANSITION = 0x08;
+const uint8_t UPDATE_WHITE = 0x10;
+
+struct StateUpdate {
+    uint8_t fields;
+    uint8_t red, green, blue;
+    uint8_t brightness;
+    Effect effect;
+    Transition transition;
+    uint8_t whiteRatio;
+};
+
+// Сохраняемые настройки пользователя. Правило расписания перекрывает яркость и эффект,
+// но не меняет их: после правила возвращаются эти значения
+struct ClockSettings {
+    uint8_t red, green, blue;
+    uint8_t brightness;
+    Effect effect;
+    uint8_t whiteRatio;     // доля общей части RGB, которую берет на себя белый канал
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "content.h"
+#include "font7seg.h"
+
+static const char* const CONTENT_NAMES[CONTENT_COUNT] = {
+    "time", "date", "seconds", "countdown", "number", "text"
+};
+
+const char* contentName(ContentType type) {
+    return type < CONTENT_COUNT ? CONTENT_NAMES[type] : "unknown";
+}
+
+ContentScheduler::ContentScheduler()
+    : rotationLength(1), rotationIndex(0), slotStartMillis(0), epoch(0), countdownTarget(0),
+      number(0), numberVersion(0), textVersion(0), countdownVersion(0) {
+    memset(providers, 0, sizeof(providers));
+    memset(&local, 0, sizeof(local));
+    memset(text, 0, sizeof(text));
+    rotation[0].type = CONTENT_TIME;
+    rotation[0].seconds = 0;
+}
+
+void ContentScheduler::setTime(const struct tm& localTime, time_t now) {
+    local = localTime;
+    epoch = now;
+}
+
+void ContentScheduler::setNumber(int32_t value) {
+    number = value;
+    numberVersion++;
+}
+
+bool ContentScheduler::setText(const char* value) {
+    if (strlen(value) >= CONTENT_TEXT_SIZE) return false;
+    strcpy(text, value);
+    textVersion++;
+    return true;
+}
+
+void ContentScheduler::setCountdown(time_t target) {
+    countdownTarget = target;
+    countdownVersion++;
+}
+
+bool ContentScheduler::setRotation(const char* spec) {
+    RotationSlot parsed[CONTENT_ROTATION_SIZE];
+    uint8_t count = 0;
+
+    const char* p = spec;
+    while (*p != '\0') {
+        if (count == CONTENT_ROTATION_SIZE) return false;
+
+        // Имя источника до ':' или ','
+        const char* end = p;
+        while (*end != '\0' && *end != ':' && *end != ',') end++;
+        int8_t type = -1;
+        for(uint8_t i = 0; i < CONTENT_COUNT; i++) {
+            if (strlen(CONTENT_NAMES[i]) == (size_t)(end - p) && strncmp(CONTENT_NAMES[i], p, end - p) == 0) {
+                type = i;
+            }
+        }
+        if (type < 0) return false;
+
+        uint32_t seconds = 10;
+        p = end;
+        if (*p == ':') {
+            p++;
+            if (*p < '0' || *p > '9') return false;
+            seconds = 0;
+            while (*p >= '0' && *p <= '9') {
+                seconds = seconds * 10 + (*p - '0');
+                if (seconds > 3600) return false;
+                p++;
+            }
+            if (seconds == 0) return false;
+        }
+        if (*p == ',') {
+            p++;
+            if (*p == '\0') return false;
+        } else if (*p != '\0') {
+            return false;
+        }
+
+        parsed[count].type = (ContentType)type;
+        parsed[count].seconds = seconds;
+        count++;
+    }
+    if (count == 0) return false;
+
+    memcpy(rotation, parsed, sizeof(parsed[0]) * count);
+    rotationLength = count;
+    rotationIndex = 0;
+    slotStartMillis = millis();
+    return true;
+}
+
+void ContentScheduler::update(uint32_t nowMs) {
+    if (rotationLength < 2) return;
+    if (nowMs - slotStartMillis < rotation[rotationIndex].seconds * 1000UL) return;
+    slotStartMillis = nowMs;
+    rotationIndex = (rotationIndex + 1) % rotationLength;
+}
+
+// Ключ меняется ровно тогда, когда меняется то, что видно на цифрах
+int32_t ContentScheduler::currentKey(ContentType type) {
+    switch (type) {
+        case CONTENT_TIME:
+            return local.tm_hour * 60 + local.tm_min;
+        case CONTENT_DATE:
+            return local.tm_mon * 32 + local.tm_mday;
+        case CONTENT_SECONDS:
+            return local.tm_min * 60 + local.tm_sec;
+        case CONTENT_COUNTDOWN: {
+            int32_t remaining = countdownTarget - epoch;
+            if (remaining <= 0) return -countdownVersion;
+            // Больше часа показываются минуты, секунды не меняют картинку
+            return remaining < 3600 ? remaining : 3600 + remaining / 60;
+        }
+        case CONTENT_NUMBER:
+            return numberVersion;
+        default:
+            return textVersion;
+    }
+}
+
+void ContentScheduler::setChars(ContentProvider& provider, const char* chars) {
+    uint8_t position = 0;
+    memset(provider.masks, 0, sizeof(provider.masks));
+    for(const char* c = chars; *c != '\0' && position < DIGIT_COUNT; c++) {
+        // Двоеточие между второй и третьей цифрой не занимает позицию
+        if (*c == ':' && position == 2) {
+            provider.colon = COLON_ON;
+            continue;
+        }
+        provider.masks[position++] = glyphMask(*c);
+    }
+}
+
+// Две пары цифр из полей даты и времени. Поля struct tm - int, остаток от 100 показывает
+// компилятору, что каждая пара занимает ровно два символа
+static void formatPairs(char* chars, size_t size, int first, int second) {
+    snprintf(chars, size, "%02u%02u", (unsigned)first % 100, (unsigned)second % 100);
+}
+
+void ContentScheduler::render(ContentType type, ContentProvider& provider) {
+    char chars[CONTENT_TEXT_SIZE];
+    provider.colon = COLON_OFF;
+
+    switch (type) {
+        case CONTENT_TIME:
+            formatPairs(chars, sizeof(chars), local.tm_hour, local.tm_min);
+            provider.colon = COLON_BLINK;
+            break;
+        case CONTENT_DATE:
+            formatPairs(chars, sizeof(chars), local.tm_mday, local.tm_mon + 1);
+            break;
+        case CONTENT_SECONDS:
+            formatPairs(chars, sizeof(chars), local.tm_min, local.tm_sec);
+            provider.colon = COLON_ON;
+            break;
+        case CONTENT_COUNTDOWN: {
+            int32_t remaining = countdownTarget - epoch;
+            if (remaining < 0) remaining = 0;
+            if (remaining < 3600) {
+                snprintf(chars, sizeof(chars), "%02ld%02ld", (long)(remaining / 60), (long)(remaining % 60));
+                provider.colon = COLON_ON;
+            } else if (remaining < 100L * 3600) {
+                snprintf(chars, sizeof(chars), "%02ld%02ld", (long)(remaining / 3600), (long)(remaining / 60 % 60));
+                provider.colon = COLON_BLINK;
+            } else {
+                int32_t days = remaining / 86400;
+                snprintf(chars, sizeof(chars), "%3ldd", (long)(days > 999 ? 999 : days));
+            }
+            break;
+        }
+        case CONTENT_NUMBER:
+            snprintf(chars, sizeof(chars), "%4ld", (long)constrain(number, (int32_t)-999, (int32_t)9999));
+            break;
+        default:
+            strcpy(chars, text);
+            break;
+    }
+    setChars(provider, chars);
+}
+
+const uint8_t* ContentScheduler::getMasks() {
+    ContentType type = rotation[rotationIndex].type;
+    ContentProvider& provider = providers[type];
+    int32_t key = currentKey(type);
+    if (!provider.valid || provider.key != key) {
+        render(type, provider);
+        provider.key = key;
+        provider.valid = true;
+    }
+    return provider.masks;
+}
+
+// Вызывается после getMasks(): режим разделителя задается при пересчете масок
+bool ContentScheduler::getColon(bool blinkPhase) {
+    const ContentProvider& provider = providers[rotation[rotationIndex].type];
+    return provider.colon == COLON_ON || (provider.colon == COLON_BLINK && blinkPhase);
+}
@@ -0,0 +1,80 @@
+#ifndef CONTENT_H
+#define CONTENT_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "effects.h"
+
+// Что показывают цифры, когда нет бегущей строки
+enum ContentType {
+    CONTENT_TIME,       // ЧЧ:ММ, разделитель мигает
+    CONTENT_DATE,       // ДДММ
+    CONTENT_SECONDS,    // ММ:СС
+    CONTENT_COUNTDOWN,  // до заданного момента: ММ:СС, ЧЧ:ММ или дни
+    CONTENT_NUMBER,     // число -999..9999 из HTTP
+    CONTENT_TEXT,       // до 4 символов из HTTP, например "23*C"
+    CONTENT_COUNT
+};
+
+const uint8_t CONTENT_ROTATION_SIZE = 8;
+const uint8_t CONTENT_TEXT_SIZE = 8;  // 4 символа и двоеточие с запасом
+
+enum ColonMode {
+    COLON_OFF,
+    COLON_ON,
+    COLON_BLINK
+};
+
+// Маски источника пересчитываются, только когда меняется его ключ
+struct ContentProvider {
+    int32_t key;
+    bool valid;
+    uint8_t masks[DIGIT_COUNT];
+    ColonMode colon;
+};
+
+struct RotationSlot {
+    ContentType type;
+    uint16_t seconds;
+};
+
+class ContentScheduler {
+public:
+    ContentScheduler();
+    void setTime(const struct tm& local, time_t epoch);
+    void setNumber(int32_t value);
+    bool setText(const char* text);
+    void setCountdown(time_t target);
+    // "time:20,date:5" - источники и секунды показа, один источник показывается постоянно
+    bool setRotation(const char* spec);
+    void update(uint32_t nowMs);
+    const uint8_t* getMasks();
+    bool getColon(bool blinkPhase);
+    ContentType getCurrent() const { return rotation[rotationIndex].type; }
+
+private:
+    ContentProvider providers[CONTENT_COUNT];
+    RotationSlot rotation[CONTENT_ROTATION_SIZE];
+    uint8_t rotationLength;
+    uint8_t rotationIndex;
+    uint32_t slotStartMillis;
+
+    struct tm local;
+    time_t epoch;
+    time_t countdownTarget;
+    int32_t number;
+    char text[CONTENT_TEXT_SIZE];
+    // Версии значений из HTTP: у каждого источника своя, чтобы новое число
+    // не перерисовывало текст и наоборот
+    int32_t numberVersion;
+    int32_t textVersion;
+    int32_t countdownVersion;
+
+    int32_t currentKey(ContentType type);
+    void render(ContentType type, ContentProvider& provider);
+    void setChars(ContentProvider& provider, const char* chars);
+};
+
+const char* contentName(ContentType type);
+
+#endif
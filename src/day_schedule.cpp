@@ -0,0 +1,307 @@
+#include "day_schedule.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <math.h>
+#include "http_args.h"
+
+const int16_t MINUTES_PER_DAY = 1440;
+const long SECONDS_PER_DAY = 86400;
+
+DaySchedule::DaySchedule()
+    : ruleCount(0), latitude(0), longitude(0), error("empty"), zone(), presets(nullptr),
+      pointCount(0), current(0), dayStart(0), dayEnd(0), nextAt(0), lastNow(0), valid(false),
+      activeRule(-1), firedPreset(SCHEDULE_NO_PRESET), sunrise(-1), sunset(-1) {
+    memset(rules, 0, sizeof(rules));
+    memset(points, 0, sizeof(points));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void DaySchedule::begin(const TimeZone& timeZone, const PresetBank* bank) {
+    zone = timeZone;
+    presets = bank;
+    valid = false;
+}
+
+// "ЧЧ:ММ", "sunrise", "sunset-30", "sunrise+15"
+static bool parseScheduleTime(const char* text, ScheduleTime& time) {
+    if (text == nullptr) return false;
+    const char* offset = nullptr;
+    if (strncmp(text, "sunrise", 7) == 0) {
+        time.anchor = ANCHOR_SUNRISE;
+        offset = text + 7;
+    } else if (strncmp(text, "sunset", 6) == 0) {
+        time.anchor = ANCHOR_SUNSET;
+        offset = text + 6;
+    }
+    if (offset != nullptr) {
+        long minutes = 0;
+        if (*offset != '\0' &&
+            ((*offset != '+' && *offset != '-') || !parseBoundedInt(offset, -720, 720, minutes))) {
+            return false;
+        }
+        time.minutes = minutes;
+        return true;
+    }
+
+    if (strlen(text) != 5 || text[2] != ':') return false;
+    char hours[3] = {text[0], text[1], '\0'};
+    long h, m;
+    if (!parseBoundedInt(hours, 0, 23, h) || !parseBoundedInt(text + 3, 0, 59, m)) return false;
+    time.anchor = ANCHOR_TIME;
+    time.minutes = h * 60 + m;
+    return true;
+}
+
+bool DaySchedule::parse(const char* json, size_t length) {
+    DynamicJsonDocument doc(SCHEDULE_DOCUMENT_SIZE);
+    if (deserializeJson(doc, json, length) != DeserializationError::Ok) {
+        error = "invalid JSON";
+        return false;
+    }
+    JsonArrayConst list = doc["rules"];
+    if (list.isNull() || list.size() > SCHEDULE_RULES) {
+        error = "rules must be a list of 0-8 entries";
+        return false;
+    }
+
+    ScheduleRule parsed[SCHEDULE_RULES];
+    uint8_t parsedCount = 0;
+    bool usesSun = false;
+
+    for(JsonObjectConst item : list) {
+        ScheduleRule& rule = parsed[parsedCount];
+        if (!parseScheduleTime(item["from"], rule.from) || !parseScheduleTime(item["to"], rule.to)) {
+            error = "invalid time";
+            return false;
+        }
+        if (rule.from.anchor == rule.to.anchor && rule.from.minutes == rule.to.minutes) {
+            error = "empty range";
+            return false;
+        }
+        usesSun = usesSun || rule.from.anchor != ANCHOR_TIME || rule.to.anchor != ANCHOR_TIME;
+
+        JsonVariantConst brightness = item["brightness"];
+        rule.brightness = -1;
+        if (!brightness.isNull()) {
+            if (!brightness.is<int>() || brightness.as<int>() < 0 || brightness.as<int>() > 255) {
+                error = "invalid brightness";
+                return false;
+            }
+            rule.brightness = brightness.as<int>();
+        }
+
+        const char* effect = item["effect"];
+        rule.effect = -1;
+        if (effect != nullptr) {
+            for(uint8_t i = 0; i < EFFECT_COUNT; i++) {
+                if (strcmp(effect, effectName((Effect)i)) == 0) rule.effect = i;
+            }
+            if (rule.effect < 0) {
+                error = "invalid effect";
+                return false;
+            }
+        }
+        if (rule.brightness < 0 && rule.effect < 0) {
+            error = "rule changes nothing";
+            return false;
+        }
+        parsedCount++;
+    }
+
+    // Координаты нужны только правилам от восхода и заката
+    JsonVariantConst lat = doc["lat"];
+    JsonVariantConst lon = doc["lon"];
+    bool hasLocation = lat.is<float>() && lon.is<float>();
+    if (usesSun && (!hasLocation || fabsf(lat.as<float>()) > 90 || fabsf(lon.as<float>()) > 180)) {
+        error = "invalid location";
+        return false;
+    }
+
+    memcpy(rules, parsed, sizeof(ScheduleRule) * parsedCount);
+    ruleCount = parsedCount;
+    latitude = hasLocation ? lat.as<float>() : 0;
+    longitude = hasLocation ? lon.as<float>() : 0;
+    error = nullptr;
+    valid = false;
+    return true;
+}
+
+bool DaySchedule::load(const char* path) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        error = "no file";
+        return false;
+    }
+    size_t size = file.size();
+    if (size == 0 || size > SCHEDULE_FILE_MAX) {
+        file.close();
+        error = "invalid file size";
+        return false;
+    }
+    char* json = new char[size];
+    bool ok = false;
+    if ((size_t)file.read((uint8_t*)json, size) == size) {
+        ok = parse(json, size);
+    } else {
+        error = "read error";
+    }
+    delete[] json;
+    file.close();
+    return ok;
+}
+
+// Восход и закат по приближенным формулам NOAA, минуты UTC от полуночи.
+// Точности в пару минут достаточно, считается раз в сутки.
+static bool sunTimes(int dayOfYear, float latitude, float longitude, float& rise, float& set) {
+    float gamma = 2 * PI / 365 * (dayOfYear - 1);
+    float equation = 229.18f * (0.000075f + 0.001868f * cosf(gamma) - 0.032077f * sinf(gamma)
+                                - 0.014615f * cosf(2 * gamma) - 0.040849f * sinf(2 * gamma));
+    float declination = 0.006918f - 0.399912f * cosf(gamma) + 0.070257f * sinf(gamma)
+                        - 0.006758f * cosf(2 * gamma) + 0.000907f * sinf(2 * gamma)
+                        - 0.002697f * cosf(3 * gamma) + 0.00148f * sinf(3 * gamma);
+    float lat = latitude * DEG_TO_RAD;
+    float cosAngle = cosf(90.833f * DEG_TO_RAD) / (cosf(lat) * cosf(declination)) - tanf(lat) * tanf(declination);
+    // Полярный день или ночь
+    if (cosAngle < -1 || cosAngle > 1) return false;
+    float angle = acosf(cosAngle) * RAD_TO_DEG;
+    rise = 720 - 4 * (longitude + angle) - equation;
+    set = 720 - 4 * (longitude - angle) - equation;
+    return true;
+}
+
+static int16_t wrapMinute(long minute) {
+    minute %= MINUTES_PER_DAY;
+    return minute < 0 ? minute + MINUTES_PER_DAY : minute;
+}
+
+int16_t DaySchedule::resolve(const ScheduleTime& time) const {
+    switch (time.anchor) {
+        case ANCHOR_SUNRISE:
+            return sunrise < 0 ? -1 : wrapMinute(sunrise + time.minutes);
+        case ANCHOR_SUNSET:
+            return sunset < 0 ? -1 : wrapMinute(sunset + time.minutes);
+        default:
+            return time.minutes;
+    }
+}
+
+// Последнее из правил, в интервал которых попадает минута
+int8_t DaySchedule::ruleAt(int16_t minute, const int16_t* from, const int16_t* to) const {
+    for(int8_t i = ruleCount - 1; i >= 0; i--) {
+        if (from[i] < 0 || to[i] < 0 || from[i] == to[i]) continue;
+        bool inside = from[i] < to[i] ? (minute >= from[i] && minute < to[i])
+                                      : (minute >= from[i] || minute < to[i]);
+        if (inside) return i;
+    }
+    return -1;
+}
+
+// Таблица на местные сутки, в которые попадает now. Минуты суток переводятся в UTC
+// по отдельности, поэтому в дни перехода точки после него сдвигаются на час
+void DaySchedule::compile(time_t now) {
+    time_t local = zone.toLocal(now);
+    long secondOfDay = local % SECONDS_PER_DAY;
+    if (secondOfDay < 0) secondOfDay += SECONDS_PER_DAY;
+    time_t midnight = local - secondOfDay;
+    dayStart = zone.toUtc(midnight);
+    // Полночь в повторяющемся часе переводится во второй раз, а now может быть в первом
+    if (dayStart > now) dayStart = now;
+    dayEnd = zone.toUtc(midnight + SECONDS_PER_DAY);
+
+    struct tm date;
+    gmtime_r(&local, &date);
+    float rise, set;
+    sunrise = sunset = -1;
+    if ((latitude != 0 || longitude != 0) && sunTimes(date.tm_yday + 1, latitude, longitude, rise, set)) {
+        // Переходы ночью, днем действует смещение полудня
+        long offset = zone.offsetAt(zone.toUtc(midnight + SECONDS_PER_DAY / 2));
+        sunrise = wrapMinute(lroundf(rise) + offset / 60);
+        sunset = wrapMinute(lroundf(set) + offset / 60);
+    }
+
+    // Границы интервалов и времена наборов - кандидаты в точки смены состояния
+    int16_t from[SCHEDULE_RULES], to[SCHEDULE_RULES];
+    int16_t minutes[SCHEDULE_POINTS];
+    uint8_t count = 0;
+    minutes[count++] = 0;
+    for(uint8_t i = 0; i < ruleCount; i++) {
+        from[i] = resolve(rules[i].from);
+        to[i] = resolve(rules[i].to);
+        if (from[i] >= 0) minutes[count++] = from[i];
+        if (to[i] >= 0) minutes[count++] = to[i];
+    }
+    uint8_t presetCount = presets != nullptr ? presets->getCount() : 0;
+    for(uint8_t i = 0; i < presetCount; i++) {
+        if (presets->get(i).startMinute != PRESET_NO_TIME) minutes[count++] = presets->get(i).startMinute;
+    }
+
+    // Кандидатов не больше пары десятков, сортировки вставками достаточно
+    for(uint8_t i = 1; i < count; i++) {
+        int16_t value = minutes[i];
+        uint8_t j = i;
+        for(; j > 0 && minutes[j - 1] > value; j--) minutes[j] = minutes[j - 1];
+        minutes[j] = value;
+    }
+
+    pointCount = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        if (i > 0 && minutes[i] == minutes[i - 1]) continue;
+        int8_t rule = ruleAt(minutes[i], from, to);
+        uint8_t preset = SCHEDULE_NO_PRESET;
+        for(uint8_t p = 0; p < presetCount && preset == SCHEDULE_NO_PRESET; p++) {
+            if (presets->get(p).startMinute == minutes[i]) preset = p;
+        }
+        // Точка без смены правила и без набора ничего не меняет
+        if (pointCount > 0 && rule == points[pointCount - 1].rule && preset == SCHEDULE_NO_PRESET) continue;
+        points[pointCount].at = zone.toUtc(midnight + (time_t)minutes[i] * 60);
+        points[pointCount].rule = rule;
+        points[pointCount].preset = preset;
+        pointCount++;
+    }
+    valid = true;
+    stats.compiles++;
+}
+
+bool DaySchedule::update(time_t now) {
+    // Обычный кадр: часы идут вперед и следующая точка еще не наступила
+    if (valid && now >= lastNow && now < nextAt) {
+        lastNow = now;
+        return false;
+    }
+
+    // Наборы включаются только при обычном ходе часов. После скачка или перезагрузки
+    // их настройки уже сохранены, восстанавливается только действующее правило
+    bool stepped = valid && now >= lastNow && now - lastNow <= (time_t)SCHEDULE_MAX_STEP;
+    if (valid && !stepped) stats.jumps++;
+    int8_t previousRule = valid ? activeRule : -2;
+    time_t previous = lastNow;
+
+    if (!valid || now < dayStart || now >= dayEnd) {
+        compile(now);
+    }
+
+    current = 0;
+    while (current + 1 < pointCount && points[current + 1].at <= now) current++;
+    for(uint8_t i = 0; stepped && i <= current; i++) {
+        if (points[i].at > previous && points[i].preset != SCHEDULE_NO_PRESET) {
+            firedPreset = points[i].preset;
+        }
+    }
+    activeRule = points[current].rule;
+    nextAt = current + 1 < pointCount ? points[current + 1].at : dayEnd;
+    lastNow = now;
+
+    if (activeRule != previousRule) stats.transitions++;
+    return activeRule != previousRule || firedPreset != SCHEDULE_NO_PRESET;
+}
+
+const ScheduleRule* DaySchedule::getActiveRule() const {
+    return activeRule >= 0 ? &rules[activeRule] : nullptr;
+}
+
+// Набор, время которого наступило, выдается один раз
+uint8_t DaySchedule::takePreset() {
+    uint8_t preset = firedPreset;
+    firedPreset = SCHEDULE_NO_PRESET;
+    return preset;
+}
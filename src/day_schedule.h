@@ -0,0 +1,106 @@
+#ifndef DAY_SCHEDULE_H
+#define DAY_SCHEDULE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "presets.h"
+#include "time_zone.h"
+
+// Расписание яркости и эффекта по времени суток в LittleFS:
+// {"lat": 55.75, "lon": 37.62,
+//  "rules": [{"from": "22:00", "to": "07:00", "brightness": 15, "effect": "static"},
+//            {"from": "sunset-30", "to": "sunset", "brightness": 80}]}
+// Время - "ЧЧ:ММ" или восход/закат со смещением в минутах. Из пересекающихся правил действует последнее.
+// Время правил местное: в день перехода на летнее время точка из пропущенного часа
+// наступает сразу после перехода, точка из повторяющегося осенью часа - во второй раз.
+const uint8_t SCHEDULE_RULES = 8;
+const uint8_t SCHEDULE_POINTS = SCHEDULE_RULES * 2 + PRESET_COUNT + 1;
+const uint32_t SCHEDULE_MAX_STEP = 120;       // больший шаг часов считается скачком, с
+const size_t SCHEDULE_FILE_MAX = 1024;
+const size_t SCHEDULE_DOCUMENT_SIZE = 1536;
+const char* const SCHEDULE_PATH = "/schedule.json";
+const uint8_t SCHEDULE_NO_PRESET = 0xFF;
+
+enum ScheduleAnchor : uint8_t {
+    ANCHOR_TIME,                 // минута суток
+    ANCHOR_SUNRISE,              // смещение от восхода
+    ANCHOR_SUNSET                // смещение от заката
+};
+
+struct ScheduleTime {
+    ScheduleAnchor anchor;
+    int16_t minutes;
+};
+
+struct ScheduleRule {
+    ScheduleTime from, to;
+    int16_t brightness;          // -1 - не менять
+    int8_t effect;               // -1 - не менять
+};
+
+// Точка таблицы дня: с этого момента действует правило rule (-1 - ни одно)
+struct SchedulePoint {
+    time_t at;
+    int8_t rule;
+    uint8_t preset;              // набор, включаемый в этот момент, или SCHEDULE_NO_PRESET
+};
+
+struct ScheduleStats {
+    uint32_t compiles;
+    uint32_t jumps;              // скачки часов, после которых состояние найдено заново
+    uint32_t transitions;
+};
+
+// Правила разбираются при загрузке и раз в сутки переводятся в отсортированную таблицу
+// моментов смены состояния. В кадре проверяется только наступление следующего момента.
+class DaySchedule {
+public:
+    DaySchedule();
+    // Часовой пояс правил и банк наборов с временем включения
+    void begin(const TimeZone& zone, const PresetBank* presets);
+    bool parse(const char* json, size_t length);
+    bool load(const char* path);
+    const char* getError() const { return error; }
+    // Таблица пересобирается при следующем update(), например после замены наборов
+    void invalidate() { valid = false; }
+
+    // true, если сменилось действующее правило или наступило время набора
+    bool update(time_t now);
+    const ScheduleRule* getActiveRule() const;
+    int8_t getActiveIndex() const { return activeRule; }
+    uint8_t takePreset();
+
+    uint8_t getRuleCount() const { return ruleCount; }
+    uint8_t getPointCount() const { return pointCount; }
+    time_t getNextTransition() const { return nextAt; }
+    int16_t getSunrise() const { return sunrise; }
+    int16_t getSunset() const { return sunset; }
+    const ScheduleStats& getStats() const { return stats; }
+
+private:
+    ScheduleRule rules[SCHEDULE_RULES];
+    uint8_t ruleCount;
+    float latitude, longitude;
+    const char* error;
+    TimeZone zone;
+    const PresetBank* presets;
+
+    // Таблица текущих суток и последний полученный момент
+    SchedulePoint points[SCHEDULE_POINTS];
+    uint8_t pointCount;
+    uint8_t current;
+    time_t dayStart, dayEnd;     // UTC границы местных суток, в дни перехода 23 или 25 часов
+    time_t nextAt;
+    time_t lastNow;
+    bool valid;
+    int8_t activeRule;
+    uint8_t firedPreset;
+    int16_t sunrise, sunset;     // местная минута суток, -1 - солнце не восходит или не заходит
+    ScheduleStats stats;
+
+    void compile(time_t now);
+    int16_t resolve(const ScheduleTime& time) const;
+    int8_t ruleAt(int16_t minute, const int16_t* from, const int16_t* to) const;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "diag_log.h"
+#include <stddef.h>
+#include <user_interface.h>
+
+const uint32_t DIAG_MAGIC = 0x4C474C44;      // "DLGL"
+
+DiagLog diag;
+
+static const char* const DIAG_EVENT_NAMES[DIAG_EVENT_COUNT] = {
+    "boot", "exception", "reset_stage", "stall", "watchdog", "slow_commit", "slow_show", "low_heap"
+};
+
+const char* diagEventName(uint8_t type) {
+    return type < DIAG_EVENT_COUNT ? DIAG_EVENT_NAMES[type] : "unknown";
+}
+
+DiagLog::DiagLog() : loggedHeap(0xFFFFFFFF), watchdogFired(false) {
+    memset(&header, 0, sizeof(header));
+    memset(&previous, 0, sizeof(previous));
+}
+
+void DiagLog::writeHeader(size_t offset, size_t size) {
+    ESP.rtcUserMemoryWrite(DIAG_RTC_OFFSET + offset / 4, (uint32_t*)((uint8_t*)&header + offset), size);
+}
+
+void DiagLog::begin() {
+    ESP.rtcUserMemoryRead(DIAG_RTC_OFFSET, (uint32_t*)&header, sizeof(header));
+    // После включения питания память RTC содержит мусор
+    if (header.magic != DIAG_MAGIC || header.head >= DIAG_ENTRIES || header.count > DIAG_ENTRIES) {
+        memset(&header, 0, sizeof(header));
+        header.magic = DIAG_MAGIC;
+        header.stage = DIAG_STAGE_IDLE;
+    }
+    header.route[DIAG_ROUTE_SIZE - 1] = '\0';
+
+    previous.stage = header.stage;
+    previous.stageStartMs = header.stageStartMs;
+    memcpy(previous.route, header.route, DIAG_ROUTE_SIZE);
+    previous.routeMs = header.routeMs;
+
+    header.bootCount++;
+    header.stage = DIAG_STAGE_SETUP;
+    header.stageStartMs = millis();
+    header.lowHeap = ESP.getFreeHeap();
+    header.route[0] = '\0';
+    header.routeMs = 0;
+    writeHeader(0, sizeof(header));
+
+    const rst_info* info = ESP.getResetInfoPtr();
+    record(DIAG_BOOT, info->reason, header.bootCount);
+    if (info->reason == REASON_EXCEPTION_RST) {
+        record(DIAG_EXCEPTION, info->exccause, info->epc1);
+    }
+    // Сброс не из простоя: этап, который выполнялся в этот момент
+    if (info->reason != REASON_DEFAULT_RST && info->reason != REASON_EXT_SYS_RST &&
+        previous.stage != DIAG_STAGE_IDLE) {
+        append(DIAG_RESET_STAGE, previous.stage, 0, previous.stageStartMs);
+    }
+}
+
+void DiagLog::record(DiagEvent type, uint16_t arg, uint32_t value) {
+    append(type, header.stage, arg, value);
+}
+
+// Запись в кольцо: сначала событие, затем заголовок, чтобы сброс между ними не испортил журнал
+void DiagLog::append(uint8_t type, uint8_t stage, uint16_t arg, uint32_t value) {
+    DiagEntry entry;
+    entry.millis = millis();
+    entry.type = type;
+    entry.stage = stage;
+    entry.arg = arg;
+    entry.value = value;
+    ESP.rtcUserMemoryWrite(entryBlock(header.head), (uint32_t*)&entry, sizeof(entry));
+
+    header.head = (header.head + 1) % DIAG_ENTRIES;
+    if (header.count < DIAG_ENTRIES) header.count++;
+    writeHeader(offsetof(Header, head), 4);
+}
+
+DiagEntry DiagLog::getEntry(uint8_t index) const {
+    uint8_t slot = (header.head + DIAG_ENTRIES - header.count + index) % DIAG_ENTRIES;
+    DiagEntry entry;
+    ESP.rtcUserMemoryRead(entryBlock(slot), (uint32_t*)&entry, sizeof(entry));
+    return entry;
+}
+
+void DiagLog::enterStage(uint8_t stage) {
+    header.stage = stage;
+    header.stageStartMs = millis();
+    watchdogFired = false;
+    writeHeader(offsetof(Header, stage), 8);
+}
+
+void DiagLog::leaveStage(uint32_t durationUs) {
+    if (durationUs > DIAG_STALL_US) {
+        record(DIAG_STALL, 0, durationUs);
+    }
+    header.stage = DIAG_STAGE_IDLE;
+    writeHeader(offsetof(Header, stage), 4);
+}
+
+// Маршрут пишется до обработчика: если обработчик не вернется, он останется в RTC
+void DiagLog::setRoute(const char* uri) {
+    strncpy(header.route, uri, DIAG_ROUTE_SIZE - 1);
+    header.route[DIAG_ROUTE_SIZE - 1] = '\0';
+    header.routeMs = millis();
+    writeHeader(offsetof(Header, routeMs), 4 + DIAG_ROUTE_SIZE);
+}
+
+void DiagLog::checkHeap() {
+    uint32_t free = ESP.getFreeHeap();
+    if (free >= header.lowHeap) return;
+    header.lowHeap = free;
+    writeHeader(offsetof(Header, lowHeap), 4);
+    if (free + DIAG_HEAP_STEP <= loggedHeap) {
+        loggedHeap = free;
+        record(DIAG_LOW_HEAP, ESP.getMaxFreeBlockSize() / 16, free);
+    }
+}
+
+// Таймер срабатывает, только когда цикл отдает управление системе. Задача, которая
+// не отдает его, будет сброшена аппаратным сторожем, и ее этап останется в заголовке
+void DiagLog::watchdog() {
+    if (header.stage == DIAG_STAGE_IDLE || watchdogFired) return;
+    uint32_t elapsed = millis() - header.stageStartMs;
+    if (elapsed >= DIAG_WATCHDOG_MS) {
+        watchdogFired = true;
+        record(DIAG_WATCHDOG, 0, elapsed);
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef DIAG_LOG_H
+#define DIAG_LOG_H
+
+#include <Arduino.h>
+
+// Журнал событий в пользовательской памяти RTC: переживает программный сброс и сброс сторожевым таймером.
+// Первые 128 байт пользовательской памяти занимает загрузчик OTA, журнал лежит за ними.
+const uint8_t DIAG_RTC_OFFSET = 32;           // в 4-байтовых блоках
+const uint8_t DIAG_ENTRIES = 28;
+const uint8_t DIAG_ROUTE_SIZE = 16;
+const uint32_t DIAG_STALL_US = 200000;        // задача дольше - событие STALL
+const uint32_t DIAG_SLOW_CALL_US = 50000;     // EEPROM.commit() или вывод кадра дольше - событие
+const uint32_t DIAG_WATCHDOG_MS = 1000;       // задача не вернулась за это время - событие WATCHDOG
+const uint32_t DIAG_WATCHDOG_PERIOD_MS = 250;
+const uint32_t DIAG_HEAP_STEP = 1024;         // новый минимум кучи записывается с таким шагом
+
+// Этапы кроме задач планировщика
+const uint8_t DIAG_STAGE_IDLE = 0xFF;
+const uint8_t DIAG_STAGE_SETUP = 0xFE;
+
+enum DiagEvent : uint8_t {
+    DIAG_BOOT,           // arg - причина сброса, value - номер загрузки
+    DIAG_EXCEPTION,      // arg - код исключения, value - адрес (epc1)
+    DIAG_RESET_STAGE,    // stage - этап, прерванный сбросом, value - время его начала, мс
+    DIAG_STALL,          // value - длительность задачи, мкс
+    DIAG_WATCHDOG,       // задача все еще выполняется, value - мс с ее начала
+    DIAG_SLOW_COMMIT,    // value - длительность EEPROM.commit(), мкс
+    DIAG_SLOW_SHOW,      // value - длительность вывода кадра, мкс
+    DIAG_LOW_HEAP,       // arg - наибольший свободный блок / 16, value - свободно байт
+    DIAG_EVENT_COUNT
+};
+
+struct DiagEntry {
+    uint32_t millis;
+    uint8_t type;
+    uint8_t stage;
+    uint16_t arg;
+    uint32_t value;
+};
+
+// Этап и маршрут предыдущей загрузки, прочитанные до их перезаписи
+struct DiagPrevious {
+    uint8_t stage;
+    uint32_t stageStartMs;
+    char route[DIAG_ROUTE_SIZE];
+    uint32_t routeMs;
+};
+
+class DiagLog {
+public:
+    DiagLog();
+    // Чтение журнала прошлой загрузки и запись причины сброса
+    void begin();
+    void record(DiagEvent type, uint16_t arg, uint32_t value);
+
+    // Начало и конец задачи планировщика: этап пишется в RTC, чтобы сброс внутри него был виден
+    void enterStage(uint8_t stage);
+    void leaveStage(uint32_t durationUs);
+    void setRoute(const char* uri);
+    void checkHeap();
+    // Вызывается таймером, пока цикл стоит внутри задачи, но отдает управление системе
+    void watchdog();
+
+    uint8_t getCount() const { return header.count; }
+    // 0 - самое старое событие
+    DiagEntry getEntry(uint8_t index) const;
+    uint32_t getBootCount() const { return header.bootCount; }
+    uint32_t getLowHeap() const { return header.lowHeap; }
+    const char* getRoute() const { return header.route; }
+    uint32_t getRouteMs() const { return header.routeMs; }
+    const DiagPrevious& getPrevious() const { return previous; }
+
+private:
+    // Заголовок в RTC, поля этапа идут подряд и пишутся одной операцией
+    struct Header {
+        uint32_t magic;
+        uint16_t head;
+        uint16_t count;
+        uint32_t bootCount;
+        uint32_t stage;
+        uint32_t stageStartMs;
+        uint32_t lowHeap;
+        uint32_t routeMs;
+        char route[DIAG_ROUTE_SIZE];
+    };
+
+    Header header;
+    DiagPrevious previous;
+    uint32_t loggedHeap;         // минимум кучи, уже попавший в журнал
+    bool watchdogFired;          // событие для текущего запуска задачи уже записано
+
+    void writeHeader(size_t offset, size_t size);
+    uint32_t entryBlock(uint8_t slot) const { return DIAG_RTC_OFFSET + sizeof(Header) / 4 + slot * sizeof(DiagEntry) / 4; }
+    void append(uint8_t type, uint8_t stage, uint16_t arg, uint32_t value);
+};
+
+const char* diagEventName(uint8_t type);
+
+// Журнал сбросов и зависаний в памяти RTC
+extern DiagLog diag;
+
+#endif
@@ -0,0 +1,268 @@
+#include "effect_vm.h"
+#include <LittleFS.h>
+
+// Для каждой инструкции: снимает со стека, кладет на стек, байтов операнда
+struct VmOpInfo {
+    uint8_t pops;
+    uint8_t pushes;
+    uint8_t immediate;
+};
+
+static const VmOpInfo OP_INFO[VM_OPCODE_COUNT] = {
+    {3, 0, 0},  // END
+    {0, 1, 1},  // PUSH8
+    {0, 1, 2},  // PUSH16
+    {0, 1, 1},  // LOAD
+    {1, 0, 1},  // STORE
+    {1, 2, 0},  // DUP
+    {1, 0, 0},  // DROP
+    {2, 2, 0},  // SWAP
+    {2, 1, 0},  // ADD
+    {2, 1, 0},  // SUB
+    {2, 1, 0},  // MUL
+    {2, 1, 0},  // DIV
+    {2, 1, 0},  // MOD
+    {2, 1, 0},  // AND
+    {2, 1, 0},  // OR
+    {2, 1, 0},  // XOR
+    {2, 1, 0},  // SHL
+    {2, 1, 0},  // SHR
+    {1, 1, 0},  // NEG
+    {2, 1, 0},  // LT
+    {2, 1, 0},  // GT
+    {2, 1, 0},  // EQ
+    {2, 1, 0},  // MIN
+    {2, 1, 0},  // MAX
+    {3, 1, 0},  // SELECT
+    {1, 1, 0},  // SIN8
+    {1, 1, 0},  // PAL_R
+    {1, 1, 0},  // PAL_G
+    {1, 1, 0},  // PAL_B
+    {0, 1, 0},  // PIXEL
+    {0, 1, 0},  // SEGMENT
+    {0, 1, 0},  // DIGIT
+    {0, 1, 0},  // LIT
+    {0, 1, 0},  // TIME
+    {0, 1, 0},  // FRAME
+    {0, 1, 0},  // RED
+    {0, 1, 0},  // GREEN
+    {0, 1, 0},  // BLUE
+};
+
+// Четверть периода синуса, амплитуда 127
+static const uint8_t SINE_QUARTER[65] PROGMEM = {
+    0, 3, 6, 9, 12, 16, 19, 22, 25, 28, 31, 34, 37, 40, 43, 46,
+    49, 51, 54, 57, 60, 63, 65, 68, 71, 73, 76, 78, 81, 83, 85, 88,
+    90, 92, 94, 96, 98, 100, 102, 104, 106, 107, 109, 111, 112, 113, 115, 116,
+    117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127,
+    127
+};
+
+static int32_t sin8(int32_t x) {
+    uint8_t angle = x & 0xFF;
+    uint8_t index = angle & 0x3F;
+    uint8_t value;
+    switch (angle >> 6) {
+        case 0: value = pgm_read_byte(&SINE_QUARTER[index]); return 128 + value;
+        case 1: value = pgm_read_byte(&SINE_QUARTER[64 - index]); return 128 + value;
+        case 2: value = pgm_read_byte(&SINE_QUARTER[index]); return 128 - value;
+        default: value = pgm_read_byte(&SINE_QUARTER[64 - index]); return 128 - value;
+    }
+}
+
+// Цветовой круг: красный -> зеленый -> синий -> красный
+static int32_t palette(int32_t x, uint8_t component) {
+    uint8_t position = x & 0xFF;
+    uint8_t sector = position < 85 ? 0 : (position < 170 ? 1 : 2);
+    uint8_t offset = (position - sector * 85) * 3;
+    // В каждом секторе одна компонента растет, одна гаснет, третья выключена
+    uint8_t rising = (sector + 1) % 3;
+    if (component == sector) return 255 - offset;
+    if (component == rising) return offset;
+    return 0;
+}
+
+static uint8_t clampColor(int32_t value) {
+    if (value < 0) return 0;
+    if (value > 255) return 255;
+    return value;
+}
+
+EffectVM::EffectVM()
+    : codeLength(0), instructionCount(0), loaded(false), timeMs(0), frame(0),
+      colorRed(0), colorGreen(0), colorBlue(0), budget(VM_FRAME_BUDGET),
+      lastFrameInstructions(0), overruns(0), budgetExceeded(false) {
+}
+
+// Полная проверка программы до запуска: после нее интерпретатор
+// не проверяет ни коды инструкций, ни границы стека
+VmError EffectVM::validate(const uint8_t* program, uint16_t length) {
+    uint16_t pc = 0;
+    uint8_t depth = 0;
+    uint16_t count = 0;
+
+    while (pc < length) {
+        uint8_t op = program[pc];
+        if (op >= VM_OPCODE_COUNT) return VM_ERROR_OPCODE;
+
+        const VmOpInfo& info = OP_INFO[op];
+        if (pc + 1 + info.immediate > length) return VM_ERROR_TRUNCATED;
+        if ((op == VM_LOAD || op == VM_STORE) && program[pc + 1] >= VM_LOCALS) return VM_ERROR_LOCAL;
+        if (depth < info.pops) return VM_ERROR_STACK_UNDERFLOW;
+
+        depth = depth - info.pops + info.pushes;
+        if (depth > VM_STACK_SIZE) return VM_ERROR_STACK_OVERFLOW;
+
+        count++;
+        pc += 1 + info.immediate;
+
+        if (op == VM_END) {
+            // END снимает r, g, b - стек должен остаться пустым, код - закончиться
+            if (depth != 0 || pc != length) return VM_ERROR_RESULT;
+            instructionCount = count;
+            return VM_OK;
+        }
+    }
+    return VM_ERROR_RESULT;
+}
+
+VmError EffectVM::load(const uint8_t* data, size_t length) {
+    if (length < VM_HEADER_SIZE || memcmp(data, "LCV1", 4) != 0) return VM_ERROR_HEADER;
+
+    uint16_t programLength = data[4] | (data[5] << 8);
+    if (programLength == 0 || programLength > VM_MAX_CODE || programLength != length - VM_HEADER_SIZE) {
+        return VM_ERROR_HEADER;
+    }
+
+    VmError error = validate(data + VM_HEADER_SIZE, programLength);
+    if (error != VM_OK) return error;
+
+    memcpy(code, data + VM_HEADER_SIZE, programLength);
+    codeLength = programLength;
+    loaded = true;
+    return VM_OK;
+}
+
+// Программа читается целиком в буфер на стеке и заменяет текущую только после проверки
+VmError EffectVM::loadFile(const char* path) {
+    File file = LittleFS.open(path, "r");
+    if (!file) return VM_ERROR_HEADER;
+
+    uint8_t data[VM_HEADER_SIZE + VM_MAX_CODE];
+    size_t length = file.size();
+    if (length > sizeof(data)) {
+        file.close();
+        return VM_ERROR_HEADER;
+    }
+    size_t got = file.read(data, length);
+    file.close();
+    if (got != length) return VM_ERROR_TRUNCATED;
+
+    return load(data, length);
+}
+
+void EffectVM::beginFrame(uint32_t nowMs, uint8_t red, uint8_t green, uint8_t blue) {
+    timeMs = nowMs;
+    colorRed = red;
+    colorGreen = green;
+    colorBlue = blue;
+    budget = VM_FRAME_BUDGET;
+    budgetExceeded = false;
+}
+
+void EffectVM::endFrame() {
+    lastFrameInstructions = VM_FRAME_BUDGET - budget;
+    if (budgetExceeded) overruns++;
+    frame++;
+}
+
+// Выполнение программы для одного пикселя.
+// Переходов нет, поэтому пиксель стоит ровно instructionCount инструкций
+// и бюджет проверяется один раз до запуска, а не на каждой инструкции.
+bool EffectVM::run(const VmPixel& input, uint8_t& red, uint8_t& green, uint8_t& blue) {
+    if (!loaded || budget < instructionCount) {
+        budgetExceeded = true;
+        return false;
+    }
+    budget -= instructionCount;
+
+    int32_t stack[VM_STACK_SIZE];
+    int32_t locals[VM_LOCALS] = {0};
+    int32_t* sp = stack;            // следующий свободный элемент
+    const uint8_t* ip = code;
+    int32_t a, b;
+
+    // Переполнение целых заворачивается, деление на 0 дает 0.
+    // Переход сразу на обработчик следующей инструкции, без общего switch
+    static const void* const dispatch[VM_OPCODE_COUNT] = {
+        &&op_end, &&op_push8, &&op_push16, &&op_load, &&op_store, &&op_dup, &&op_drop, &&op_swap,
+        &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_mod, &&op_and, &&op_or, &&op_xor,
+        &&op_shl, &&op_shr, &&op_neg, &&op_lt, &&op_gt, &&op_eq, &&op_min, &&op_max,
+        &&op_select, &&op_sin8, &&op_pal_r, &&op_pal_g, &&op_pal_b, &&op_pixel, &&op_segment, &&op_digit,
+        &&op_lit, &&op_time, &&op_frame, &&op_red, &&op_green, &&op_blue
+    };
+    #define VM_NEXT() goto *dispatch[*ip++]
+    #define VM_BINARY(expr) b = *--sp; a = sp[-1]; sp[-1] = (expr); VM_NEXT()
+
+    VM_NEXT();
+
+op_push8:   *sp++ = *ip++; VM_NEXT();
+op_push16:  *sp++ = (int16_t)(ip[0] | (ip[1] << 8)); ip += 2; VM_NEXT();
+op_load:    *sp++ = locals[*ip++]; VM_NEXT();
+op_store:   locals[*ip++] = *--sp; VM_NEXT();
+op_dup:     *sp = sp[-1]; sp++; VM_NEXT();
+op_drop:    sp--; VM_NEXT();
+op_swap:    a = sp[-1]; sp[-1] = sp[-2]; sp[-2] = a; VM_NEXT();
+op_add:     VM_BINARY((int32_t)((uint32_t)a + (uint32_t)b));
+op_sub:     VM_BINARY((int32_t)((uint32_t)a - (uint32_t)b));
+op_mul:     VM_BINARY((int32_t)((uint32_t)a * (uint32_t)b));
+op_div:     VM_BINARY(b == 0 ? 0 : (b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b));
+op_mod:     VM_BINARY(b == 0 || b == -1 ? 0 : a % b);
+op_and:     VM_BINARY(a & b);
+op_or:      VM_BINARY(a | b);
+op_xor:     VM_BINARY(a ^ b);
+op_shl:     VM_BINARY((int32_t)((uint32_t)a << (b & 31)));
+op_shr:     VM_BINARY(a >> (b & 31));
+op_neg:     sp[-1] = (int32_t)(0u - (uint32_t)sp[-1]); VM_NEXT();
+op_lt:      VM_BINARY(a < b);
+op_gt:      VM_BINARY(a > b);
+op_eq:      VM_BINARY(a == b);
+op_min:     VM_BINARY(a < b ? a : b);
+op_max:     VM_BINARY(a > b ? a : b);
+op_select:  b = *--sp; a = *--sp; sp[-1] = sp[-1] ? a : b; VM_NEXT();
+op_sin8:    sp[-1] = sin8(sp[-1]); VM_NEXT();
+op_pal_r:   sp[-1] = palette(sp[-1], 0); VM_NEXT();
+op_pal_g:   sp[-1] = palette(sp[-1], 1); VM_NEXT();
+op_pal_b:   sp[-1] = palette(sp[-1], 2); VM_NEXT();
+op_pixel:   *sp++ = input.pixel; VM_NEXT();
+op_segment: *sp++ = input.segment; VM_NEXT();
+op_digit:   *sp++ = input.digit; VM_NEXT();
+op_lit:     *sp++ = input.lit; VM_NEXT();
+op_time:    *sp++ = timeMs; VM_NEXT();
+op_frame:   *sp++ = frame; VM_NEXT();
+op_red:     *sp++ = colorRed; VM_NEXT();
+op_green:   *sp++ = colorGreen; VM_NEXT();
+op_blue:    *sp++ = colorBlue; VM_NEXT();
+
+op_end:
+    #undef VM_BINARY
+    #undef VM_NEXT
+    red = clampColor(stack[0]);
+    green = clampColor(stack[1]);
+    blue = clampColor(stack[2]);
+    return true;
+}
+
+const char* vmErrorName(VmError error) {
+    switch (error) {
+        case VM_OK: return "OK";
+        case VM_ERROR_HEADER: return "Invalid header";
+        case VM_ERROR_OPCODE: return "Invalid opcode";
+        case VM_ERROR_TRUNCATED: return "Truncated program";
+        case VM_ERROR_STACK_UNDERFLOW: return "Stack underflow";
+        case VM_ERROR_STACK_OVERFLOW: return "Stack overflow";
+        case VM_ERROR_LOCAL: return "Invalid local variable";
+        case VM_ERROR_RESULT: return "Program must end with r, g, b on the stack";
+    }
+    return "Unknown error";
+}
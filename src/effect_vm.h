@@ -0,0 +1,113 @@
+#ifndef EFFECT_VM_H
+#define EFFECT_VM_H
+
+#include <Arduino.h>
+
+// Байткод пользовательских эффектов.
+// Программа выполняется для каждого пикселя и оставляет на стеке r, g, b.
+// Переходов нет, поэтому глубина стека известна заранее и проверяется один раз при загрузке.
+//
+// Файл программы: "LCV1", codeLength u16 (little-endian), код.
+enum VmOpcode {
+    VM_END,       // завершение: на стеке ровно r, g, b
+    VM_PUSH8,     // imm8 без знака
+    VM_PUSH16,    // imm16 со знаком, little-endian
+    VM_LOAD,      // imm8: номер локальной переменной
+    VM_STORE,     // imm8: номер локальной переменной
+    VM_DUP,
+    VM_DROP,
+    VM_SWAP,
+    VM_ADD,
+    VM_SUB,
+    VM_MUL,
+    VM_DIV,       // деление на 0 дает 0
+    VM_MOD,
+    VM_AND,
+    VM_OR,
+    VM_XOR,
+    VM_SHL,
+    VM_SHR,
+    VM_NEG,
+    VM_LT,
+    VM_GT,
+    VM_EQ,
+    VM_MIN,
+    VM_MAX,
+    VM_SELECT,    // c ? a : b, на стеке c, a, b
+    VM_SIN8,      // синус: 0..255 -> 0..255
+    VM_PAL_R,     // радужная палитра: 0..255 -> компонента
+    VM_PAL_G,
+    VM_PAL_B,
+    VM_PIXEL,     // номер пикселя
+    VM_SEGMENT,   // сегмент 0-6 или 255 вне цифр
+    VM_DIGIT,     // цифра 0-3 или 255 вне цифр
+    VM_LIT,       // 1, если пиксель горит в текущем времени
+    VM_TIME,      // миллисекунды
+    VM_FRAME,     // номер кадра
+    VM_RED,       // выбранный пользователем цвет
+    VM_GREEN,
+    VM_BLUE,
+    VM_OPCODE_COUNT
+};
+
+const uint8_t VM_HEADER_SIZE = 6;
+const uint16_t VM_MAX_CODE = 512;          // максимальная длина кода, байт
+const uint8_t VM_STACK_SIZE = 16;
+const uint8_t VM_LOCALS = 8;
+const uint32_t VM_FRAME_BUDGET = 30000;    // инструкций на кадр
+const char* const VM_PATH = "/effect.lcv";
+
+// Входные данные одного пикселя
+struct VmPixel {
+    uint16_t pixel;
+    uint8_t segment;
+    uint8_t digit;
+    uint8_t lit;
+};
+
+// Ошибки проверки программы
+enum VmError {
+    VM_OK,
+    VM_ERROR_HEADER,
+    VM_ERROR_OPCODE,
+    VM_ERROR_TRUNCATED,
+    VM_ERROR_STACK_UNDERFLOW,
+    VM_ERROR_STACK_OVERFLOW,
+    VM_ERROR_LOCAL,
+    VM_ERROR_RESULT
+};
+
+class EffectVM {
+public:
+    EffectVM();
+    VmError load(const uint8_t* data, size_t length);
+    VmError loadFile(const char* path);
+    bool isLoaded() const { return loaded; }
+    void beginFrame(uint32_t timeMs, uint8_t red, uint8_t green, uint8_t blue);
+    bool run(const VmPixel& input, uint8_t& red, uint8_t& green, uint8_t& blue);
+    void endFrame();
+
+    uint16_t getInstructionCount() const { return instructionCount; }
+    uint32_t getLastFrameInstructions() const { return lastFrameInstructions; }
+    uint32_t getOverruns() const { return overruns; }
+
+private:
+    uint8_t code[VM_MAX_CODE];
+    uint16_t codeLength;
+    uint16_t instructionCount;  // инструкций на пиксель, известно после проверки
+    bool loaded;
+
+    uint32_t timeMs;
+    uint32_t frame;
+    uint8_t colorRed, colorGreen, colorBlue;
+    uint32_t budget;
+    uint32_t lastFrameInstructions;
+    uint32_t overruns;
+    bool budgetExceeded;
+
+    VmError validate(const uint8_t* program, uint16_t length);
+};
+
+const char* vmErrorName(VmError error);
+
+#endif
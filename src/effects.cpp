@@ -1,29 +1,142 @@
 #include "effects.h"
 #include <math.h>
 
-// Массив для маппинга цифр
-const uint8_t DIGITS[10][7] = {
-    {0,1,1,1,1,1,1}, // 0
-    {0,1,0,0,0,0,1}, // 1
-    {1,1,1,0,1,1,0}, // 2
-    {1,1,1,0,0,1,1}, // 3
-    {1,1,0,1,0,0,1}, // 4
-    {1,0,1,1,0,1,1}, // 5
-    {1,0,1,1,1,1,1}, // 6
-    {0,1,1,0,0,0,1}, // 7
-    {1,1,1,1,1,1,1}, // 8
-    {1,1,1,1,0,1,1}  // 9
+// Маски цифр: бит N - сегмент с номером N (SEG_G = бит 0 ... SEG_C = бит 6)
+const uint8_t DIGIT_MASKS[10] = {
+    0b1111110, // 0
+    0b1000010, // 1
+    0b0110111, // 2
+    0b1100111, // 3
+    0b1001011, // 4
+    0b1101101, // 5
+    0b1111101, // 6
+    0b1000110, // 7
+    0b1111111, // 8
+    0b1101111  // 9
 };
 
-Effects::Effects(NeoPixelBus<NeoRgbwFeature, NeoEsp8266Uart1Ws2813Method>* strip) 
-    : strip(strip), currentEffect(STATIC), effectStep(0), runningPhase(0),
-      lastUpdate(0), lastSparkleUpdate(0), maxBrightness(255),
-      currentRed(255), currentGreen(0), currentBlue(0) {
+static const char* const EFFECT_NAMES[EFFECT_COUNT] = {
+    "static", "rainbow", "breathing", "running", "sparkle", "custom"
+};
+
+const char* effectName(Effect effect) {
+    return effect < EFFECT_COUNT ? EFFECT_NAMES[effect] : "unknown";
+}
+
+// Положение светодиодов внутри цифры: x 0-4 слева направо, y 0-8 сверху вниз.
+// Светодиоды сегмента считаются идущими сверху вниз или слева направо.
+struct LedPosition {
+    uint8_t x, y;
+};
+
+constexpr LedPosition LED_POSITIONS[SEGMENTS_PER_DIGIT][LEDS_PER_SEGMENT] = {
+    {{1, 4}, {2, 4}, {3, 4}},  // G
+    {{4, 1}, {4, 2}, {4, 3}},  // B
+    {{1, 0}, {2, 0}, {3, 0}},  // A
+    {{0, 1}, {0, 2}, {0, 3}},  // F
+    {{0, 5}, {0, 6}, {0, 7}},  // E
+    {{1, 8}, {2, 8}, {3, 8}},  // D
+    {{4, 5}, {4, 6}, {4, 7}}   // C
+};
+
+// Для каждого светодиода - момент начала смены (доля 0-255 от длительности перехода),
+// смена занимает width долей
+struct TransitionTiming {
+    uint8_t width;
+    uint8_t start[SEGMENTS_PER_DIGIT][LEDS_PER_SEGMENT];
+};
+
+constexpr uint8_t transitionStart(Transition style, LedPosition led, uint8_t width) {
+    return style == TRANSITION_SLIDE ? led.y * (256 - width) / 8 :
+           style == TRANSITION_WIPE ? led.x * (256 - width) / 4 :
+           style == TRANSITION_FLIP ? (led.y > 4 ? led.y - 4 : 4 - led.y) * (256 - width) / 4 :
+           0;
+}
+
+constexpr TransitionTiming makeTiming(Transition style, uint8_t width) {
+    TransitionTiming timing = {};
+    timing.width = width;
+    for(uint8_t segment = 0; segment < SEGMENTS_PER_DIGIT; segment++) {
+        for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
+            timing.start[segment][i] = transitionStart(style, LED_POSITIONS[segment][i], width);
+        }
+    }
+    return timing;
 }
 
-float Effects::limitBrightness(float brightness) {
-    float maxValue = (float)maxBrightness / 255.0f;
-    return brightness < maxValue ? brightness : maxValue;
+// Таблицы считает компилятор, в прошивку попадают готовые числа
+constexpr TransitionTiming TRANSITION_TIMINGS[TRANSITION_COUNT] = {
+    makeTiming(TRANSITION_NONE, 255),
+    makeTiming(TRANSITION_SLIDE, 64),
+    makeTiming(TRANSITION_WIPE, 64),
+    makeTiming(TRANSITION_FADE, 255),
+    makeTiming(TRANSITION_FLIP, 96)
+};
+
+Effects::Effects(PixelOutput* output, PixelArena* arena) 
+    : output(output), arena(arena), currentEffect(STATIC), currentRed(255), currentGreen(0), currentBlue(0),
+      maxBrightness(255), phaseTime(0), phaseStart(0), effectStep(0), runningPhase(0), lastSparkleUpdate(0),
+      background(nullptr), backgroundPixels(0), program(nullptr), transition(TRANSITION_NONE), digits(), frameMasks(), frameColon(false), morphEnabled(true),
+      whiteRatio(0), frameDirty(true), frameLoad(0), powerScale(POWER_SCALE_FULL), limitedFrames(0),
+      ditherActive(false), ditherFrames(0), fadeFrom(nullptr), fadeMix(nullptr), fadeLoad(0),
+      fadeStartMillis(0), fadeMs(0) {
+    resize();
+}
+
+void Effects::resize() {
+    pixelCount = output->getPixelCount();
+
+    // Эффекты рисуют в кадр линейного RGB, в порядок каналов ленты его переводит present()
+    arena->reset();
+    frame = (uint16_t*)arena->take(pixelCount * 3 * sizeof(uint16_t));
+    fadeFrom = (uint16_t*)arena->take(pixelCount * 3 * sizeof(uint16_t));
+    fadeMix = (uint16_t*)arena->take(pixelCount * 3 * sizeof(uint16_t));
+    ditherError = (uint8_t*)arena->take(pixelCount * StripOrder::SIZE);
+    memset(frame, 0, pixelCount * 3 * sizeof(uint16_t));
+    memset(ditherError, 0, pixelCount * StripOrder::SIZE);
+    frameLoad = 0;
+    ditherActive = false;
+    fadeMs = 0;
+
+    // Ток покоя не зависит от кадра, остаток бюджета переводим в ступени каналов
+    uint32_t idle = POWER_BOARD_MA + (uint32_t)POWER_PIXEL_IDLE_MA * pixelCount;
+    loadBudget = idle < POWER_BUDGET_MA ? (POWER_BUDGET_MA - idle) * CHANNEL_FULL / POWER_CHANNEL_MA : 0;
+    invalidate();
+}
+
+// Нагрузка пикселей зависит от доли белого, поэтому сумма пересчитывается целиком
+void Effects::setWhiteRatio(uint8_t ratio) {
+    whiteRatio = ratio;
+    frameLoad = 0;
+    for(uint16_t i = 0; i < pixelCount; i++) {
+        const uint16_t* rgb = frame + i * 3;
+        frameLoad += OutputStage<StripOrder>::load(rgb[0], rgb[1], rgb[2], whiteRatio);
+    }
+    frameDirty = true;
+}
+
+uint32_t Effects::getRequestedCurrent() const {
+    return POWER_BOARD_MA + (uint32_t)POWER_PIXEL_IDLE_MA * pixelCount + (uint64_t)frameLoad * POWER_CHANNEL_MA / CHANNEL_FULL;
+}
+
+uint32_t Effects::getOutputCurrent() const {
+    uint64_t load = (uint64_t)frameLoad * powerScale / POWER_SCALE_FULL;
+    return POWER_BOARD_MA + (uint32_t)POWER_PIXEL_IDLE_MA * pixelCount + load * POWER_CHANNEL_MA / CHANNEL_FULL;
+}
+
+void Effects::invalidate() {
+    for(uint8_t i = 0; i < DIGIT_COUNT; i++) {
+        digits[i].clean = 0;
+    }
+    frameDirty = true;
+}
+
+// Новый эффект начинается с первого шага, как раньше при /effect.
+// Начало отсчитывается по общей шкале, поэтому часы, переключенные одновременно, остаются в фазе
+void Effects::setEffect(Effect effect) {
+    if (effect == currentEffect) return;
+    currentEffect = effect;
+    phaseStart = phaseTime;
 }
 
 uint16_t Effects::getSegmentStart(uint8_t digit, uint8_t segment) {
@@ -34,205 +147,406 @@ uint16_t Effects::getSegmentStart(uint8_t digit, uint8_t segment) {
     }
 }
 
-void Effects::setSegmentColor(uint8_t digit, uint8_t segment, RgbwColor color) {
+void Effects::setSegmentColor(uint8_t digit, uint8_t segment, Rgb48Color color) {
+    uint16_t start = getSegmentStart(digit, segment);
+    for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
+        setPixel(start + i, color);
+    }
+}
+
+// Запись только изменившихся пикселей: если ничего не изменилось, кадр не отправляется
+void Effects::setPixel(uint16_t index, Rgb48Color color) {
+    uint16_t* rgb = frame + index * 3;
+    if (rgb[0] != color.R || rgb[1] != color.G || rgb[2] != color.B) {
+        frameLoad -= OutputStage<StripOrder>::load(rgb[0], rgb[1], rgb[2], whiteRatio);
+        frameLoad += OutputStage<StripOrder>::load(color.R, color.G, color.B, whiteRatio);
+        rgb[0] = color.R;
+        rgb[1] = color.G;
+        rgb[2] = color.B;
+        frameDirty = true;
+    }
+}
+
+// Белый канал отправителя складывается с цветными: белый светодиод светит как равные R, G, B,
+// а какую часть общей доли снова отдать белому, решает whiteRatio
+void Effects::setExternalPixel(uint16_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t white) {
+    fadeMs = 0;
+    int32_t w = (int32_t)white << 8;
+    setPixel(index, Rgb48Color(minBranchless(((int32_t)red << 8) + w, CHANNEL_FULL),
+                               minBranchless(((int32_t)green << 8) + w, CHANNEL_FULL),
+                               minBranchless(((int32_t)blue << 8) + w, CHANNEL_FULL)));
+}
+
+// Выходной каскад: порядок каналов ленты, белый канал и ограничение тока.
+// При превышении бюджета весь кадр равномерно затемняется, соотношение цветов сохраняется.
+void Effects::present() {
+    if (!frameDirty && !ditherActive && fadeMs == 0) return;
+
+    const uint16_t* source = frame;
+    uint32_t load = frameLoad;
+    if (fadeMs != 0) {
+        uint32_t elapsed = millis() - fadeStartMillis;
+        if (elapsed >= fadeMs) {
+            fadeMs = 0;
+            frameDirty = true;
+        } else {
+            // Линейное смешивание снимка и нового кадра, доля нового кадра в 1/256
+            int32_t progress = elapsed * 256 / fadeMs;
+            for(uint16_t i = 0; i < pixelCount * 3; i++) {
+                int32_t from = fadeFrom[i];
+                fadeMix[i] = from + (((int32_t)frame[i] - from) * progress >> 8);
+            }
+            source = fadeMix;
+            if (fadeLoad > load) load = fadeLoad;
+        }
+    }
+
+    if (frameDirty || source == fadeMix) {
+        if (load > loadBudget) {
+            powerScale = (uint64_t)loadBudget * POWER_SCALE_FULL / load;
+            limitedFrames++;
+        } else {
+            powerScale = POWER_SCALE_FULL;
+        }
+    }
+    ditherActive = OutputStage<StripOrder>::convert(source, output->getPixels(), ditherError, pixelCount, whiteRatio, powerScale);
+    if (ditherActive) ditherFrames++;
+    output->show();
+    frameDirty = false;
+}
+
+// Снимок берется из кадра, уже выведенного на ленту
+void Effects::startCrossfade(uint16_t durationMs) {
+    if (durationMs == 0) return;
+    // Переход, начатый во время другого перехода, стартует с уже смешанного кадра
+    memcpy(fadeFrom, fadeMs != 0 ? fadeMix : frame, pixelCount * 3 * sizeof(uint16_t));
+    fadeLoad = 0;
+    for(uint16_t i = 0; i < pixelCount; i++) {
+        fadeLoad += OutputStage<StripOrder>::load(fadeFrom[i * 3], fadeFrom[i * 3 + 1], fadeFrom[i * 3 + 2], whiteRatio);
+    }
+    fadeStartMillis = millis();
+    fadeMs = durationMs;
+}
+
+// Промежуточный кадр для дизеринга и перехода: тот же кадр с накопленной ошибкой квантования
+// или следующая ступень смешивания
+void Effects::refresh() {
+    if (ditherActive || fadeMs != 0) present();
+}
+
+// Погашенный сегмент показывает фон
+void Effects::setSegment(uint8_t digit, uint8_t segment, bool on, Rgb48Color color) {
+    if (on) {
+        setSegmentColor(digit, segment, color);
+        return;
+    }
     uint16_t start = getSegmentStart(digit, segment);
     for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
-        strip->SetPixelColor(start + i, color);
+        clearPixel(start + i);
     }
 }
 
-void Effects::showDigit(uint8_t digit, uint8_t number, RgbwColor color) {
+// Пиксель фона: кадр анимации с учетом яркости или черный
+Rgb48Color Effects::backgroundColor(uint16_t index) {
+    if (background == nullptr || index >= backgroundPixels) {
+        return Rgb48Color(0);
+    }
+    const uint8_t* rgb = background + index * 3;
+    return Rgb48Color(
+        (rgb[0] * maxBrightness * 256) / 255,
+        (rgb[1] * maxBrightness * 256) / 255,
+        (rgb[2] * maxBrightness * 256) / 255
+    );
+}
+
+// Цвет пользователя с учетом яркости, level: CHANNEL_FULL - полный
+Rgb48Color Effects::userColor(uint32_t level) {
+    // currentRed * maxBrightness * level < 2^32
+    return Rgb48Color(
+        currentRed * maxBrightness * level / 65025,
+        currentGreen * maxBrightness * level / 65025,
+        currentBlue * maxBrightness * level / 65025
+    );
+}
+
+void Effects::clearPixel(uint16_t index) {
+    setPixel(index, backgroundColor(index));
+}
+
+void Effects::showDigit(uint8_t digit, uint8_t number, Rgb48Color color) {
     if(number > 9) return;
+    showMask(digit, DIGIT_MASKS[number], color);
+}
+
+// Рисуются только сегменты, которые меняются или еще не нарисованы этим цветом
+void Effects::showMask(uint8_t digit, uint8_t mask, Rgb48Color color) {
+    DigitState& state = digits[digit];
+    uint32_t now = millis();
+
+    // Новая цифра во время перехода: прерванный переход сразу считается завершенным
+    if (mask != state.to) {
+        state.from = state.to;
+        state.to = mask;
+        state.startMillis = now;
+        state.morphing = transition != TRANSITION_NONE && morphEnabled;
+    }
+
+    uint8_t changed = 0;
+    uint8_t progress = 0;
+    if (state.morphing) {
+        uint32_t elapsed = now - state.startMillis;
+        if (elapsed < TRANSITION_MS) {
+            changed = state.from ^ state.to;
+            progress = (elapsed * 256) / TRANSITION_MS;
+        } else {
+            state.morphing = false;
+        }
+    }
+
+    // Другой цвет или фон под цифрой: все сегменты надо перерисовать
+    if (color != state.color || background != nullptr) {
+        state.clean = 0;
+        state.color = color;
+    }
+
+    for(uint8_t segment = 0; segment < SEGMENTS_PER_DIGIT; segment++) {
+        uint8_t bit = 1 << segment;
+        if (changed & bit) {
+            morphSegment(digit, segment, mask & bit, color, progress);
+            state.clean &= ~bit;
+            continue;
+        }
+        if ((state.clean & bit) && ((state.drawn ^ mask) & bit) == 0) continue;
+
+        setSegment(digit, segment, mask & bit, color);
+        state.clean |= bit;
+        state.drawn = (state.drawn & ~bit) | (mask & bit);
+    }
+}
+
+// Светодиод меняется в свое время из таблицы перехода, остальное время показывает старое или новое
+void Effects::morphSegment(uint8_t digit, uint8_t segment, bool on, Rgb48Color color, uint8_t progress) {
+    const TransitionTiming& timing = TRANSITION_TIMINGS[transition];
+    uint16_t start = getSegmentStart(digit, segment);
+    for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
+        uint8_t ledStart = timing.start[segment][i];
+        uint8_t level = 0;
+        if (progress >= ledStart + timing.width) {
+            level = 255;
+        } else if (progress > ledStart) {
+            level = ((progress - ledStart) * 255) / timing.width;
+        }
+        if (!on) level = 255 - level;
+        setPixel(start + i, Rgb48Color::LinearBlend(backgroundColor(start + i), color, level));
+    }
+}
+
+void Effects::showAllDigits(Rgb48Color color) {
+    showMask(0, frameMasks[0], color);
+    showMask(1, frameMasks[1], color);
     
-    setSegmentColor(digit, SEG_G, DIGITS[number][0] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_B, DIGITS[number][1] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_A, DIGITS[number][2] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_F, DIGITS[number][3] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_E, DIGITS[number][4] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_D, DIGITS[number][5] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_C, DIGITS[number][6] ? color : RgbwColor(0));
-}
-
-void Effects::showAllDigits(RgbwColor color, uint8_t hours, uint8_t minutes, bool colonVisible) {
-    showDigit(0, hours / 10, color);
-    showDigit(1, hours % 10, color);
-    
-    if (colonVisible) {
+    if (frameColon) {
         for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, color);
+            setPixel(DISPLAY3_START + i, color);
         }
     } else {
         for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
+            clearPixel(DISPLAY3_START + i);
         }
     }
     
-    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
+    clearPixel(DISPLAY4_START);
     
-    showDigit(2, minutes / 10, color);
-    showDigit(3, minutes % 10, color);
+    showMask(2, frameMasks[2], color);
+    showMask(3, frameMasks[3], color);
     
-    strip->Show();
+    present();
 }
 
-void Effects::update(uint8_t currentHours, uint8_t currentMinutes, bool colonVisible) {
-    unsigned long currentMillis = millis();
-    
-    if (currentMillis - lastUpdate >= 50) {
-        lastUpdate = currentMillis;
-        
-        switch (currentEffect) {
-            case STATIC:
-                staticEffect(currentHours, currentMinutes, colonVisible);
-                break;
-            case RAINBOW:
-                rainbowEffect(currentHours, currentMinutes, colonVisible);
-                break;
-            case BREATHING:
-                breathingEffect(currentHours, currentMinutes, colonVisible);
-                break;
-            case RUNNING:
-                runningEffect(currentHours, currentMinutes, colonVisible);
-                break;
-            case SPARKLE:
-                sparkleEffect(currentHours, currentMinutes, colonVisible);
-                break;
-            default:
-                staticEffect(currentHours, currentMinutes, colonVisible);
-                break;
-        }
+// Кадр с произвольными масками цифр. animate - анимировать смену цифр стилем transition
+void Effects::showMasks(const uint8_t* masks, bool colonVisible, bool animate) {
+    memcpy(frameMasks, masks, DIGIT_COUNT);
+    frameColon = colonVisible;
+    morphEnabled = animate;
+
+    // Пиксели за последней цифрой не заняты сегментами и показывают только фон
+    uint16_t digitsEnd = getSegmentStart(DIGIT_COUNT - 1, SEGMENTS_PER_DIGIT - 1) + LEDS_PER_SEGMENT;
+    for(uint16_t i = digitsEnd; i < pixelCount; i++) {
+        clearPixel(i);
+    }
+
+    switch (currentEffect) {
+        case STATIC:
+            staticEffect();
+            break;
+        case RAINBOW:
+            rainbowEffect();
+            break;
+        case BREATHING:
+            breathingEffect();
+            break;
+        case RUNNING:
+            runningEffect();
+            break;
+        case SPARKLE:
+            sparkleEffect();
+            break;
+        case CUSTOM:
+            customEffect();
+            break;
+        default:
+            staticEffect();
+            break;
     }
 }
 
-void Effects::staticEffect(uint8_t hours, uint8_t minutes, bool colonVisible) {
-    RgbwColor color(
-        (currentGreen * maxBrightness) / 255,
-        (currentRed * maxBrightness) / 255,
-        (currentBlue * maxBrightness) / 255,
-        0
-    );
-    showAllDigits(color, hours, minutes, colonVisible);
+void Effects::staticEffect() {
+    Rgb48Color color = userColor(CHANNEL_FULL);
+    showAllDigits(color);
 }
 
-void Effects::rainbowEffect(uint8_t hours, uint8_t minutes, bool colonVisible) {
+void Effects::rainbowEffect() {
     // Обновляем фазу эффекта
-    effectStep = (effectStep + 1) % 256;
+    effectStep = getPhase();
 
-    // Вычисляем цвет на основе текущей фазы
-    uint8_t red = (sin((effectStep * 0.02) + 0) * 127 + 128) * maxBrightness / 255;
-    uint8_t green = (sin((effectStep * 0.02) + 2) * 127 + 128) * maxBrightness / 255;
-    uint8_t blue = (sin((effectStep * 0.02) + 4) * 127 + 128) * maxBrightness / 255;
-
-    RgbwColor color(red, green, blue, 0); // Устанавливаем цвет без белого канала
+    // Цветовой круг из трех линейных участков: зеленый -> красный -> синий -> зеленый.
+    // Период ровно 256 шагов, поэтому переход фазы через 0 не дает скачка цвета
+    uint32_t rising, falling;
+    Rgb48Color color;
+    if (effectStep < 85) {
+        rising = effectStep * 3;
+        falling = 255 - rising;
+        color = Rgb48Color(rising * maxBrightness * 256 / 255, falling * maxBrightness * 256 / 255, 0);
+    } else if (effectStep < 170) {
+        rising = (effectStep - 85) * 3;
+        falling = 255 - rising;
+        color = Rgb48Color(falling * maxBrightness * 256 / 255, 0, rising * maxBrightness * 256 / 255);
+    } else {
+        rising = (effectStep - 170) * 3;
+        falling = 255 - rising;
+        color = Rgb48Color(0, rising * maxBrightness * 256 / 255, falling * maxBrightness * 256 / 255);
+    }
 
     // Отображаем все цифры с цветом радуги
-    showAllDigits(color, hours, minutes, colonVisible);
+    showAllDigits(color);
 }
 
-void Effects::breathingEffect(uint8_t hours, uint8_t minutes, bool colonVisible) {
-    effectStep = (effectStep + 2) % 256;
+void Effects::breathingEffect() {
+    effectStep = getPhase() * 2;
+    // Яркость пользователя уже входит в userColor, дыхание только модулирует ее
     float brightness = sin(effectStep * PI / 128) * 0.4 + 0.6;
-    brightness = limitBrightness(brightness);
     
-    RgbwColor color(
-        (currentGreen * maxBrightness * brightness) / 255,
-        (currentRed * maxBrightness * brightness) / 255,
-        (currentBlue * maxBrightness * brightness) / 255,
-        0
-    );
-    showAllDigits(color, hours, minutes, colonVisible);
+    Rgb48Color color = userColor(brightness * CHANNEL_FULL);
+    showAllDigits(color);
 }
 
-void Effects::runningEffect(uint8_t hours, uint8_t minutes, bool colonVisible) {
-    runningPhase = (runningPhase + 2) % 256;
+void Effects::runningEffect() {
+    runningPhase = getPhase() * 2;
     
     const float baseBrightness = 0.3f;
     uint8_t activeDisplay = (runningPhase / 64) % 4;
     uint8_t transitionPhase = runningPhase % 64;
     
-    RgbwColor baseColor(
-        (currentGreen * maxBrightness * baseBrightness) / 255,
-        (currentRed * maxBrightness * baseBrightness) / 255,
-        (currentBlue * maxBrightness * baseBrightness) / 255,
-        0
-    );
+    Rgb48Color baseColor = userColor(baseBrightness * CHANNEL_FULL);
     
     for(uint8_t i = 0; i < 4; i++) {
-        showDigit(i, i < 2 ? 
-            (i == 0 ? hours / 10 : hours % 10) :
-            (i == 2 ? minutes / 10 : minutes % 10),
-            baseColor);
+        showMask(i, frameMasks[i], baseColor);
     }
     
     float activePhase = (float)transitionPhase / 63.0f;
     float activeBrightness = baseBrightness + (1.0f - baseBrightness) * sin(activePhase * PI);
-    activeBrightness = limitBrightness(activeBrightness);
     
-    RgbwColor activeColor(
-        (currentGreen * maxBrightness * activeBrightness) / 255,
-        (currentRed * maxBrightness * activeBrightness) / 255,
-        (currentBlue * maxBrightness * activeBrightness) / 255,
-        0
-    );
+    Rgb48Color activeColor = userColor(activeBrightness * CHANNEL_FULL);
     
-    showDigit(activeDisplay, activeDisplay < 2 ? 
-        (activeDisplay == 0 ? hours / 10 : hours % 10) :
-        (activeDisplay == 2 ? minutes / 10 : minutes % 10),
-        activeColor);
+    showMask(activeDisplay, frameMasks[activeDisplay], activeColor);
     
-    if (colonVisible) {
+    if (frameColon) {
         for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, baseColor);
+            setPixel(DISPLAY3_START + i, baseColor);
         }
     } else {
         for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
+            clearPixel(DISPLAY3_START + i);
         }
     }
     
-    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
-    strip->Show();
+    clearPixel(DISPLAY4_START);
+    present();
 }
 
-void Effects::sparkleEffect(uint8_t hours, uint8_t minutes, bool colonVisible) {
+void Effects::sparkleEffect() {
     unsigned long currentMillis = millis();
     if (currentMillis - lastSparkleUpdate >= 200) {
         lastSparkleUpdate = currentMillis;
         
         for(uint8_t digit = 0; digit < 4; digit++) {
             float brightness = random(100) < 30 ? 0.8f : 1.0f;
-            brightness = limitBrightness(brightness);
             
-            RgbwColor color(
-                (currentGreen * maxBrightness * brightness) / 255,
-                (currentRed * maxBrightness * brightness) / 255,
-                (currentBlue * maxBrightness * brightness) / 255,
-                0
-            );
+            Rgb48Color color = userColor(brightness * CHANNEL_FULL);
             
-            showDigit(digit, digit < 2 ? 
-                (digit == 0 ? hours / 10 : hours % 10) :
-                (digit == 2 ? minutes / 10 : minutes % 10),
-                color);
+            showMask(digit, frameMasks[digit], color);
         }
         
-        if (colonVisible) {
-            RgbwColor color(
-                (currentGreen * maxBrightness) / 255,
-                (currentRed * maxBrightness) / 255,
-                (currentBlue * maxBrightness) / 255,
-                0
-            );
+        if (frameColon) {
+            Rgb48Color color = userColor(CHANNEL_FULL);
             for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                strip->SetPixelColor(DISPLAY3_START + i, color);
+                setPixel(DISPLAY3_START + i, color);
             }
         } else {
             for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
+                clearPixel(DISPLAY3_START + i);
             }
         }
         
-        strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
-        strip->Show();
+        clearPixel(DISPLAY4_START);
+        present();
+    }
+}
+
+// Пользовательский эффект: программа считает цвет каждого пикселя ленты
+void Effects::customEffect() {
+    if (program == nullptr || !program->isLoaded()) {
+        staticEffect();
+        return;
+    }
+
+    program->beginFrame(millis(), currentRed, currentGreen, currentBlue);
+
+    for(uint8_t digit = 0; digit < DIGIT_COUNT; digit++) {
+        for(uint8_t segment = 0; segment < SEGMENTS_PER_DIGIT; segment++) {
+            uint16_t start = getSegmentStart(digit, segment);
+            for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
+                runProgram(start + i, segment, digit, (frameMasks[digit] >> segment) & 1);
+            }
+        }
+    }
+
+    for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
+        runProgram(DISPLAY3_START + i, 255, 255, frameColon);
+    }
+    runProgram(DISPLAY4_START, 255, 255, false);
+
+    uint16_t digitsEnd = getSegmentStart(DIGIT_COUNT - 1, SEGMENTS_PER_DIGIT - 1) + LEDS_PER_SEGMENT;
+    for(uint16_t i = digitsEnd; i < pixelCount; i++) {
+        runProgram(i, 255, 255, false);
+    }
+
+    program->endFrame();
+    invalidate();
+    present();
+}
+
+// Если бюджет кадра исчерпан, оставшиеся пиксели показывают фон
+void Effects::runProgram(uint16_t pixel, uint8_t segment, uint8_t digit, bool lit) {
+    VmPixel input = {pixel, segment, digit, lit};
+    uint8_t red, green, blue;
+    if (!program->run(input, red, green, blue)) {
+        clearPixel(pixel);
+        return;
     }
+    setPixel(pixel, Rgb48Color(
+        (red * maxBrightness * 256) / 255,
+        (green * maxBrightness * 256) / 255,
+        (blue * maxBrightness * 256) / 255
+    ));
 }
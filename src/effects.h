@@ -2,6 +2,10 @@
 #define EFFECTS_H
 
 #include <NeoPixelBus.h>
+#include "effect_vm.h"
+#include "output.h"
+#include "pixel_output.h"
+#include "pixel_arena.h"
 
 // Константы для 7-сегментного дисплея
 const uint8_t LEDS_PER_SEGMENT = 3;    // количество светодиодов в одном сегменте
@@ -23,6 +27,30 @@ const uint8_t SEG_E = 4;
 const uint8_t SEG_D = 5;
 const uint8_t SEG_C = 6;
 
+// Буферы эффектов на пиксель в арене: кадр, снимок и смесь перехода, ошибка дизеринга
+const uint8_t EFFECTS_BYTES_PER_PIXEL = 3 * 3 * sizeof(uint16_t) + StripOrder::SIZE;
+
+// Маски цифр: бит N - сегмент с номером N
+extern const uint8_t DIGIT_MASKS[10];
+
+// Смена цифры: меняются только сегменты из XOR старой и новой маски
+enum Transition {
+    TRANSITION_NONE,
+    TRANSITION_SLIDE,   // сверху вниз
+    TRANSITION_WIPE,    // слева направо
+    TRANSITION_FADE,    // плавная смена яркости
+    TRANSITION_FLIP,    // от средней линии к краям
+    TRANSITION_COUNT
+};
+const uint16_t TRANSITION_MS = 400;
+
+// Эффекты считают цвет в 16 битах на канал (см. CHANNEL_FULL), до 8 бит кадр доводит дизеринг
+const uint32_t DITHER_INTERVAL = 10;   // период промежуточных кадров, мс
+
+// Фаза эффектов растет на 1 за это время общей шкалы, а не за кадр,
+// поэтому часы с синхронизированной шкалой показывают одну фазу
+const uint32_t EFFECT_STEP_MS = 50;
+
 // Перечисление для эффектов
 enum Effect {
     STATIC,
@@ -30,43 +58,142 @@ enum Effect {
     BREATHING,
     RUNNING,
     SPARKLE,
+    CUSTOM,       // загруженная программа для EffectVM
     EFFECT_COUNT
 };
 
+// Имя эффекта для внешних систем (MQTT, Home Assistant)
+const char* effectName(Effect effect);
+
 class Effects {
 public:
-    Effects(NeoPixelBus<NeoRgbwFeature, NeoEsp8266Uart1Ws2813Method>* strip);
-    void update(uint8_t currentHours, uint8_t currentMinutes, bool colonVisible);
-    void setEffect(Effect effect) { currentEffect = effect; }
+    Effects(PixelOutput* output, PixelArena* arena);
+    // Лента перенастроена: буферы кадра размечаются в арене заново, настройки сохраняются
+    void resize();
+    void showMasks(const uint8_t* masks, bool colonVisible, bool animate);
+    void setEffect(Effect effect);
     void setColor(uint8_t r, uint8_t g, uint8_t b) { 
         currentRed = r; 
         currentGreen = g; 
         currentBlue = b; 
     }
     void setBrightness(uint8_t brightness) { maxBrightness = brightness; }
+    uint8_t getBrightness() { return maxBrightness; }
     Effect getCurrentEffect() { return currentEffect; }
+    void setBackground(const uint8_t* rgb, uint16_t pixels) {
+        background = rgb;
+        backgroundPixels = pixels;
+    }
+    void setProgram(EffectVM* vm) { program = vm; }
+    void setTransition(Transition style) { transition = style; }
+    void setPhaseTime(uint32_t ms) { phaseTime = ms; }
+    uint8_t getPhase() const { return (phaseTime - phaseStart) / EFFECT_STEP_MS; }
+    uint32_t getPhaseStart() const { return phaseStart; }
+    // Начало эффекта подводится к началу у ведущих часов, см. PhaseSync
+    void shiftPhase(int32_t ms) { phaseStart += ms; }
+    void setWhiteRatio(uint8_t ratio);
+    uint8_t getWhiteRatio() { return whiteRatio; }
+
+    // Оценка тока ленты: запрошенный кадром и после ограничения, мА
+    uint32_t getRequestedCurrent() const;
+    uint32_t getOutputCurrent() const;
+    uint16_t getPowerScale() const { return powerScale; }
+    uint32_t getLimitedFrames() const { return limitedFrames; }
+
+    // Повторный вывод кадра, пока у пикселей есть дробная часть яркости
+    void refresh();
+    bool isDithering() const { return ditherActive; }
+    uint32_t getDitherFrames() const { return ditherFrames; }
+    // Плавный переход от текущего содержимого ленты к кадрам, нарисованным после вызова
+    void startCrossfade(uint16_t durationMs);
+    bool isFading() const { return fadeMs != 0; }
+    Transition getTransition() { return transition; }
+    // Содержимое ленты изменено в обход эффектов, следующий кадр рисуется целиком
+    void invalidate();
+    uint16_t getPixelCount() const { return pixelCount; }
+
+    // Кадр внешнего источника (DDP, E1.31) проходит тот же выходной каскад:
+    // белый канал, ограничение тока и дизеринг. Эффекты после него вызывают invalidate()
+    void setExternalPixel(uint16_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t white);
+    void showExternal() { present(); }
 
 private:
-    NeoPixelBus<NeoRgbwFeature, NeoEsp8266Uart1Ws2813Method>* strip;
+    PixelOutput* output;
+    PixelArena* arena;
     Effect currentEffect;
     uint8_t currentRed, currentGreen, currentBlue;
     uint8_t maxBrightness;
+    uint32_t phaseTime;          // общая шкала времени для фаз эффектов, мс
+    uint32_t phaseStart;         // момент включения текущего эффекта по общей шкале
     uint8_t effectStep;
     uint8_t runningPhase;
-    unsigned long lastUpdate;
     unsigned long lastSparkleUpdate;
+    const uint8_t* background;   // кадр RGB под цифрами или nullptr
+    uint16_t backgroundPixels;
+    EffectVM* program;           // программа эффекта CUSTOM или nullptr
+    Transition transition;
+
+    // Что сейчас показывает цифра, чтобы не перерисовывать неизменившиеся сегменты
+    struct DigitState {
+        uint8_t from;            // маска до смены цифры
+        uint8_t to;              // маска после смены цифры
+        uint8_t drawn;           // сегменты, нарисованные включенными
+        uint8_t clean;           // сегменты, пиксели которых соответствуют drawn и color
+        Rgb48Color color;
+        uint32_t startMillis;
+        bool morphing;
+    };
+    DigitState digits[DIGIT_COUNT];
+
+    // Маски цифр и разделитель текущего кадра
+    uint8_t frameMasks[DIGIT_COUNT];
+    bool frameColon;
+    bool morphEnabled;
+
+    // Кадр в линейном RGB, 16 бит на канал. Все буферы кадра лежат в арене
+    uint16_t* frame;
+    uint16_t pixelCount;
+    uint8_t whiteRatio;          // доля общей части RGB, уходящая в белый канал
+    bool frameDirty;
 
-    void setSegmentColor(uint8_t digit, uint8_t segment, RgbwColor color);
+    // Нагрузка кадра в ступенях канала, обновляется в setPixel только для изменившихся пикселей
+    uint32_t frameLoad;
+    uint32_t loadBudget;         // нагрузка, укладывающаяся в POWER_BUDGET_MA
+    uint16_t powerScale;
+    uint32_t limitedFrames;
+
+    // Ошибка квантования каждого канала ленты, переносится в следующий кадр
+    uint8_t* ditherError;
+    bool ditherActive;           // в кадре есть каналы с дробной частью
+    uint32_t ditherFrames;
+
+    // Переход между наборами настроек: снимок прежнего кадра и буфер смешанного кадра
+    uint16_t* fadeFrom;
+    uint16_t* fadeMix;
+    uint32_t fadeLoad;           // нагрузка снимка, ограничение тока считается по большей из двух
+    uint32_t fadeStartMillis;
+    uint16_t fadeMs;             // 0 - перехода нет
+
+    void setSegmentColor(uint8_t digit, uint8_t segment, Rgb48Color color);
+    void setSegment(uint8_t digit, uint8_t segment, bool on, Rgb48Color color);
+    void clearPixel(uint16_t index);
+    void present();
+    void setPixel(uint16_t index, Rgb48Color color);
+    Rgb48Color backgroundColor(uint16_t index);
+    Rgb48Color userColor(uint32_t level);
+    void morphSegment(uint8_t digit, uint8_t segment, bool on, Rgb48Color color, uint8_t progress);
     uint16_t getSegmentStart(uint8_t digit, uint8_t segment);
-    void showDigit(uint8_t digit, uint8_t number, RgbwColor color);
-    void showAllDigits(RgbwColor color, uint8_t hours, uint8_t minutes, bool colonVisible);
-    float limitBrightness(float brightness);
-
-    void staticEffect(uint8_t hours, uint8_t minutes, bool colonVisible);
-    void rainbowEffect(uint8_t hours, uint8_t minutes, bool colonVisible);
-    void breathingEffect(uint8_t hours, uint8_t minutes, bool colonVisible);
-    void runningEffect(uint8_t hours, uint8_t minutes, bool colonVisible);
-    void sparkleEffect(uint8_t hours, uint8_t minutes, bool colonVisible);
+    void showDigit(uint8_t digit, uint8_t number, Rgb48Color color);
+    void showAllDigits(Rgb48Color color);
+    void showMask(uint8_t digit, uint8_t mask, Rgb48Color color);
+
+    void staticEffect();
+    void rainbowEffect();
+    void breathingEffect();
+    void runningEffect();
+    void sparkleEffect();
+    void customEffect();
+    void runProgram(uint16_t pixel, uint8_t segment, uint8_t digit, bool lit);
 };
 
 #endif
@@ -0,0 +1,159 @@
+#include "event_stream.h"
+
+static const char EVENT_HEADERS[] PROGMEM =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "\r\n"
+    "retry: 3000\n\n";
+
+EventStream::EventStream() : valid(false) {
+    for(uint8_t i = 0; i < EVENT_SLOTS; i++) {
+        slots[i].active = false;
+        slots[i].pending = 0;
+        slots[i].lastSendMillis = 0;
+        slots[i].blockedSinceMillis = 0;
+    }
+    memset(&current, 0, sizeof(current));
+    memset(&stats, 0, sizeof(stats));
+}
+
+// Соединение остается открытым после обработчика HTTP: слот хранит свою копию клиента
+bool EventStream::accept(WiFiClient& client) {
+    for(uint8_t i = 0; i < EVENT_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (slot.active && !slot.client.connected()) {
+            drop(slot);
+        }
+        if (slot.active) continue;
+
+        slot.client = client;
+        slot.client.setNoDelay(true);
+        char headers[sizeof(EVENT_HEADERS)];
+        memcpy_P(headers, EVENT_HEADERS, sizeof(EVENT_HEADERS));
+        slot.client.write((const uint8_t*)headers, sizeof(EVENT_HEADERS) - 1);
+
+        // Новый подписчик сначала получает все поля
+        slot.active = true;
+        slot.pending = valid ? EVENT_ALL : 0;
+        slot.lastSendMillis = millis();
+        slot.blockedSinceMillis = 0;
+        stats.connects++;
+        return true;
+    }
+    stats.rejected++;
+    return false;
+}
+
+void EventStream::update(const EventSnapshot& snapshot) {
+    uint8_t changed = EVENT_ALL;
+    if (valid) {
+        changed = 0;
+        if (snapshot.red != current.red || snapshot.green != current.green || snapshot.blue != current.blue) {
+            changed |= EVENT_COLOR;
+        }
+        if (snapshot.brightness != current.brightness) changed |= EVENT_BRIGHTNESS;
+        if (snapshot.effect != current.effect) changed |= EVENT_EFFECT;
+        if (snapshot.hours != current.hours || snapshot.minutes != current.minutes ||
+            snapshot.timeSynced != current.timeSynced) {
+            changed |= EVENT_TIME;
+        }
+        if (snapshot.syncRole != current.syncRole || snapshot.phaseLocked != current.phaseLocked) {
+            changed |= EVENT_SYNC;
+        }
+    }
+    if (changed == 0) return;
+
+    current = snapshot;
+    valid = true;
+    for(uint8_t i = 0; i < EVENT_SLOTS; i++) {
+        if (slots[i].active) {
+            slots[i].pending |= changed;
+        }
+    }
+}
+
+void EventStream::loop() {
+    for(uint8_t i = 0; i < EVENT_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (!slot.active) continue;
+        if (!slot.client.connected()) {
+            drop(slot);
+            continue;
+        }
+        send(slot);
+    }
+}
+
+// Событие пишется, только если целиком помещается в окно TCP, поэтому запись не блокируется
+void EventStream::send(Slot& slot) {
+    uint32_t now = millis();
+    if (slot.pending == 0 && now - slot.lastSendMillis >= EVENT_KEEPALIVE) {
+        if (slot.client.availableForWrite() >= 2) {
+            slot.client.write((const uint8_t*)":\n", 2);
+            slot.lastSendMillis = now;
+        }
+    }
+
+    while (slot.pending != 0) {
+        uint8_t field = slot.pending & -slot.pending;  // младший взведенный бит
+        char message[EVENT_MESSAGE_SIZE];
+        size_t length = format(field, message, sizeof(message));
+        if (slot.client.availableForWrite() < length) {
+            if (slot.blockedSinceMillis == 0) {
+                slot.blockedSinceMillis = now | 1;
+            } else if (now - slot.blockedSinceMillis >= EVENT_STALL_TIMEOUT) {
+                stats.stalled++;
+                drop(slot);
+            }
+            return;
+        }
+        slot.client.write((const uint8_t*)message, length);
+        slot.pending &= ~field;
+        slot.lastSendMillis = now;
+        slot.blockedSinceMillis = 0;
+        stats.events++;
+    }
+}
+
+// Компактные события: имя поля и значение без JSON
+size_t EventStream::format(uint8_t field, char* buffer, size_t size) const {
+    int length = 0;
+    switch (field) {
+        case EVENT_COLOR:
+            length = snprintf(buffer, size, "event: color\ndata: %02x%02x%02x\n\n",
+                              current.red, current.green, current.blue);
+            break;
+        case EVENT_BRIGHTNESS:
+            length = snprintf(buffer, size, "event: brightness\ndata: %u\n\n", current.brightness);
+            break;
+        case EVENT_EFFECT:
+            length = snprintf(buffer, size, "event: effect\ndata: %u\n\n", current.effect);
+            break;
+        case EVENT_TIME:
+            length = snprintf(buffer, size, "event: time\ndata: %02u:%02u %u\n\n",
+                              current.hours, current.minutes, current.timeSynced ? 1 : 0);
+            break;
+        case EVENT_SYNC:
+            length = snprintf(buffer, size, "event: sync\ndata: %u %u\n\n",
+                              current.syncRole, current.phaseLocked ? 1 : 0);
+            break;
+    }
+    return length > 0 ? length : 0;
+}
+
+uint8_t EventStream::getClientCount() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < EVENT_SLOTS; i++) {
+        if (slots[i].active) count++;
+    }
+    return count;
+}
+
+void EventStream::drop(Slot& slot) {
+    slot.client.stop();
+    slot.active = false;
+    slot.pending = 0;
+}
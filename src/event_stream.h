@@ -0,0 +1,71 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Параметры потока событий (Server-Sent Events)
+const uint8_t EVENT_SLOTS = 4;                 // одновременных подписчиков
+const uint32_t EVENT_KEEPALIVE = 15000;        // комментарий при отсутствии событий, мс
+const uint32_t EVENT_STALL_TIMEOUT = 10000;    // подписчик, не принимающий данные, отключается, мс
+const uint8_t EVENT_MESSAGE_SIZE = 64;         // самое длинное событие
+
+// Поля состояния, изменения которых рассылаются отдельными событиями
+const uint8_t EVENT_COLOR = 0x01;
+const uint8_t EVENT_BRIGHTNESS = 0x02;
+const uint8_t EVENT_EFFECT = 0x04;
+const uint8_t EVENT_TIME = 0x08;
+const uint8_t EVENT_SYNC = 0x10;
+const uint8_t EVENT_ALL = 0x1F;
+
+// Состояние часов, видимое подписчикам
+struct EventSnapshot {
+    uint8_t red, green, blue;
+    uint8_t brightness;
+    uint8_t effect;
+    uint8_t hours, minutes;
+    bool timeSynced;         // время получено по SNTP
+    uint8_t syncRole;        // роль в синхронизации фаз с соседними часами
+    bool phaseLocked;
+};
+
+// Статистика потока
+struct EventStats {
+    uint32_t connects;
+    uint32_t rejected;       // все слоты заняты
+    uint32_t events;         // отправленные события
+    uint32_t stalled;        // отключенные из-за переполнения окна TCP
+};
+
+// Подписчики держат открытое HTTP соединение и получают только изменившиеся поля.
+// Изменения копятся битовой маской в слоте подписчика, поэтому медленный клиент
+// получает последнее значение поля, а не очередь промежуточных.
+class EventStream {
+public:
+    EventStream();
+    bool accept(WiFiClient& client);
+    void update(const EventSnapshot& snapshot);
+    void loop();
+    uint8_t getClientCount() const;
+    const EventStats& getStats() const { return stats; }
+
+private:
+    struct Slot {
+        WiFiClient client;
+        bool active;
+        uint8_t pending;             // поля, еще не отправленные этому подписчику
+        uint32_t lastSendMillis;
+        uint32_t blockedSinceMillis; // окно TCP заполнено с этого момента
+    };
+
+    Slot slots[EVENT_SLOTS];
+    EventSnapshot current;
+    bool valid;
+    EventStats stats;
+
+    void send(Slot& slot);
+    size_t format(uint8_t field, char* buffer, size_t size) const;
+    void drop(Slot& slot);
+};
+
+#endif
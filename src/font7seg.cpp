@@ -0,0 +1,23 @@
+#include "font7seg.h"
+
+// Строчные и прописные буквы различаются там, где это можно нарисовать (b/B, c/C, h/H ...)
+static const uint8_t FONT[FONT_CHAR_COUNT] PROGMEM = {
+    0x00, 0x42, 0x0A, 0x5B, 0x6D, 0x0F, 0x77, 0x02, // ' ' '!' '"' '#' '$' '%' '&' "'"
+    0x3C, 0x66, 0x0F, 0x19, 0x40, 0x01, 0x20, 0x13, // '(' ')' '*' '+' ',' '-' '.' '/'
+    0x7E, 0x42, 0x37, 0x67, 0x4B, 0x6D, 0x7D, 0x46, // '0' '1' '2' '3' '4' '5' '6' '7'
+    0x7F, 0x6F, 0x00, 0x00, 0x31, 0x21, 0x61, 0x17, // '8' '9' ':' ';' '<' '=' '>' '?'
+    0x3F, 0x5F, 0x79, 0x3C, 0x73, 0x3D, 0x1D, 0x7C, // '@' 'A' 'B' 'C' 'D' 'E' 'F' 'G'
+    0x5B, 0x18, 0x72, 0x5D, 0x38, 0x54, 0x5E, 0x7E, // 'H' 'I' 'J' 'K' 'L' 'M' 'N' 'O'
+    0x1F, 0x4F, 0x11, 0x6D, 0x39, 0x7A, 0x78, 0x2A, // 'P' 'Q' 'R' 'S' 'T' 'U' 'V' 'W'
+    0x5B, 0x6B, 0x37, 0x3C, 0x49, 0x66, 0x0E, 0x20, // 'X' 'Y' 'Z' '[' '\\' ']' '^' '_'
+    0x08, 0x5F, 0x79, 0x31, 0x73, 0x3D, 0x1D, 0x7C, // '`' 'a' 'b' 'c' 'd' 'e' 'f' 'g'
+    0x59, 0x10, 0x72, 0x5D, 0x38, 0x54, 0x51, 0x71, // 'h' 'i' 'j' 'k' 'l' 'm' 'n' 'o'
+    0x1F, 0x4F, 0x11, 0x6D, 0x39, 0x70, 0x70, 0x2A, // 'p' 'q' 'r' 's' 't' 'u' 'v' 'w'
+    0x5B, 0x6B, 0x37, 0x3C, 0x18, 0x66, 0x04, 0x00  // 'x' 'y' 'z' '{' '|' '}' '~' DEL
+};
+
+uint8_t glyphMask(char c) {
+    uint8_t index = (uint8_t)c - FONT_FIRST_CHAR;
+    if (index >= FONT_CHAR_COUNT) return 0;
+    return pgm_read_byte(&FONT[index]);
+}
@@ -0,0 +1,14 @@
+#ifndef FONT7SEG_H
+#define FONT7SEG_H
+
+#include <Arduino.h>
+
+// Шрифт для 7-сегментных цифр: символы ASCII 0x20-0x7F.
+// Бит N маски - сегмент с номером N, как в DIGIT_MASKS (SEG_G = бит 0 ... SEG_C = бит 6).
+// Символы, которые нельзя показать на 7 сегментах, пустые.
+const char FONT_FIRST_CHAR = 0x20;
+const uint8_t FONT_CHAR_COUNT = 96;
+
+uint8_t glyphMask(char c);
+
+#endif
@@ -0,0 +1,139 @@
+#include "frame_renderer.h"
+
+FrameRenderer::FrameRenderer()
+    : sources(), settings(nullptr), pending(nullptr), changed(nullptr), pendingPreset(nullptr), activePreset(nullptr) {
+}
+
+void FrameRenderer::begin(const FrameSources& frameSources, ClockSettings* clockSettings, StateUpdate* pendingUpdate,
+                          void (*settingsChanged)()) {
+    sources = frameSources;
+    settings = clockSettings;
+    pending = pendingUpdate;
+    changed = settingsChanged;
+}
+
+void FrameRenderer::forgetPresets() {
+    pendingPreset = nullptr;
+    activePreset = nullptr;
+}
+
+// Правило расписания меняет яркость и эффект поверх сохраненных настроек.
+// Команда пользователя действует до следующей точки расписания
+void FrameRenderer::applySchedule() {
+    const ScheduleRule* rule = sources.schedule->getActiveRule();
+    sources.effects->setBrightness(rule != nullptr && rule->brightness >= 0 ? rule->brightness : settings->brightness);
+    sources.effects->setEffect(rule != nullptr && rule->effect >= 0 ? (Effect)rule->effect : settings->effect);
+    uint8_t preset = sources.schedule->takePreset();
+    if (preset != SCHEDULE_NO_PRESET) {
+        pendingPreset = &sources.presets->get(preset);
+    }
+}
+
+// Применение накопленных изменений на границе кадра
+void FrameRenderer::applyPendingUpdate() {
+    if (pendingPreset != nullptr) {
+        applyPreset(*pendingPreset);
+    }
+    if (pending->fields == 0) return;
+
+    Effects* effects = sources.effects;
+    if (pending->fields & UPDATE_COLOR) {
+        settings->red = pending->red;
+        settings->green = pending->green;
+        settings->blue = pending->blue;
+        effects->setColor(settings->red, settings->green, settings->blue);
+    }
+    if (pending->fields & UPDATE_BRIGHTNESS) {
+        settings->brightness = pending->brightness;
+        effects->setBrightness(settings->brightness);
+    }
+    if (pending->fields & UPDATE_EFFECT) {
+        settings->effect = pending->effect;
+        effects->setEffect(settings->effect);
+    }
+    if (pending->fields & UPDATE_TRANSITION) {
+        effects->setTransition(pending->transition);
+    }
+    if (pending->fields & UPDATE_WHITE) {
+        settings->whiteRatio = pending->whiteRatio;
+        effects->setWhiteRatio(settings->whiteRatio);
+    }
+    pending->fields = 0;
+
+    // Серия изменений сохраняется одной записью после паузы
+    changed();
+}
+
+// Набор применяется целиком в одном кадре и сохраняется одной записью
+void FrameRenderer::applyPreset(const Preset& preset) {
+    Effects* effects = sources.effects;
+    // Снимок прежнего кадра берется до смены настроек
+    if (preset.fadeMs > 0) {
+        effects->startCrossfade(preset.fadeMs);
+    }
+    settings->red = preset.red;
+    settings->green = preset.green;
+    settings->blue = preset.blue;
+    settings->brightness = preset.brightness;
+    settings->effect = preset.effect;
+    effects->setColor(settings->red, settings->green, settings->blue);
+    effects->setBrightness(settings->brightness);
+    effects->setEffect(settings->effect);
+    if (preset.transition >= 0) {
+        effects->setTransition((Transition)preset.transition);
+    }
+    if (preset.whiteRatio >= 0) {
+        settings->whiteRatio = preset.whiteRatio;
+        effects->setWhiteRatio(settings->whiteRatio);
+    }
+    if (preset.rotation[0] != '\0') {
+        sources.content->setRotation(preset.rotation);
+    }
+    activePreset = &preset;
+    pendingPreset = nullptr;
+
+    changed();
+}
+
+StateUpdate FrameRenderer::getState() const {
+    StateUpdate state = {0, settings->red, settings->green, settings->blue, sources.effects->getBrightness(),
+                         sources.effects->getCurrentEffect(), sources.effects->getTransition(), settings->whiteRatio};
+    return state;
+}
+
+void FrameRenderer::render(time_t epoch) {
+    Effects* effects = sources.effects;
+    // В кадре только сравнение с моментом следующей точки расписания
+    if (epoch != 0 && sources.schedule->update(epoch)) {
+        applySchedule();
+    }
+    applyPendingUpdate();
+    if (sources.realtime->isActive()) {
+        effects->invalidate();
+        sources.live->publishState(getState());
+        return;
+    }
+    // Фазы эффектов и разделителя считаются от общей шкалы, а не от числа кадров
+    uint32_t phaseTime = sources.phaseSync->now();
+    bool colonVisible = (phaseTime / COLON_INTERVAL) % 2 == 0;
+    effects->setPhaseTime(phaseTime);
+    sources.phaseSync->setEffect(effects->getCurrentEffect());
+    effects->shiftPhase(sources.phaseSync->takePhaseShift());
+    sources.phaseSync->setPhaseStart(effects->getPhaseStart());
+
+    AnimationPlayer* animation = sources.animation;
+    animation->update(millis());
+    effects->setBackground(animation->isPlaying() ? animation->getFrame() : nullptr, animation->getPixelCount());
+    Marquee* marquee = sources.marquee;
+    marquee->update(millis());
+    if (marquee->isActive()) {
+        effects->showMasks(marquee->getMasks(), marquee->getColon(), false);
+    } else {
+        // Маски пересчитываются, только когда меняется показываемое значение
+        sources.content->update(millis());
+        const uint8_t* masks = sources.content->getMasks();
+        effects->showMasks(masks, sources.content->getColon(colonVisible), true);
+    }
+    sources.live->frameRendered();
+    sources.live->publishState(getState());
+}
@@ -0,0 +1,67 @@
+#ifndef FRAME_RENDERER_H
+#define FRAME_RENDERER_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "clock_state.h"
+#include "effects.h"
+#include "content.h"
+#include "marquee.h"
+#include "animation.h"
+#include "phase_sync.h"
+#include "live_control.h"
+#include "realtime.h"
+#include "presets.h"
+#include "day_schedule.h"
+
+const uint32_t COLON_INTERVAL = 500;   // мс, полупериод мигания разделителя
+
+// Модули, из которых собирается кадр часов
+struct FrameSources {
+    Effects* effects;
+    ContentScheduler* content;
+    Marquee* marquee;
+    AnimationPlayer* animation;
+    PhaseSync* phaseSync;
+    LiveControl* live;
+    RealtimeReceiver* realtime;
+    DaySchedule* schedule;
+    PresetBank* presets;
+};
+
+// Кадр часов: на его границе применяются точка расписания, включенный набор и изменения
+// из HTTP API, WebSocket и MQTT, затем рисуются фон, эффект и цифры или бегущая строка.
+// Задача кадра прошивки и проверка выделений на хосте вызывают один и тот же render()
+class FrameRenderer {
+public:
+    FrameRenderer();
+    // Настройки и ожидающее изменение принадлежат прошивке.
+    // settingsChanged вызывается, когда настройки пора сохранить
+    void begin(const FrameSources& frameSources, ClockSettings* clockSettings, StateUpdate* pendingUpdate,
+               void (*settingsChanged)());
+    // epoch - время UTC, 0 - часы еще не синхронизированы и расписание не проверяется
+    void render(time_t epoch);
+
+    // Набор включается в начале следующего кадра
+    void selectPreset(const Preset* preset) { pendingPreset = preset; }
+    // Банк наборов заменен: указатели на прежние наборы больше недействительны
+    void forgetPresets();
+    const Preset* getActivePreset() const { return activePreset; }
+
+    // Показываемое состояние: яркость и эффект с учетом правила расписания
+    StateUpdate getState() const;
+
+private:
+    void applySchedule();
+    void applyPendingUpdate();
+    void applyPreset(const Preset& preset);
+
+    FrameSources sources;
+    ClockSettings* settings;
+    StateUpdate* pending;
+    void (*changed)();
+    const Preset* pendingPreset;
+    const Preset* activePreset;
+};
+
+#endif
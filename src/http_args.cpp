@@ -0,0 +1,75 @@
+#include "http_args.h"
+#include <limits.h>
+
+// Значение шестнадцатеричной цифры или -1
+static int8_t hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+const char* findArg(ESP8266WebServer& server, const char* name) {
+    // arg(i) и argName(i) возвращают ссылки на строки сервера, копий не создается
+    int count = server.args();
+    for(int i = 0; i < count; i++) {
+        if (strcmp(server.argName(i).c_str(), name) == 0) {
+            return server.arg(i).c_str();
+        }
+    }
+    return nullptr;
+}
+
+bool parseHexColor(const char* text, uint8_t& red, uint8_t& green, uint8_t& blue) {
+    if (text == nullptr) return false;
+    if (*text == '#') text++;
+
+    uint32_t number = 0;
+    for(uint8_t i = 0; i < 6; i++) {
+        int8_t digit = hexDigit(text[i]);
+        if (digit < 0) return false;
+        number = (number << 4) | digit;
+    }
+    if (text[6] != '\0') return false;
+
+    red = number >> 16;
+    green = (number >> 8) & 0xFF;
+    blue = number & 0xFF;
+    return true;
+}
+
+bool parseBoundedInt(const char* text, long minValue, long maxValue, long& value) {
+    if (text == nullptr) return false;
+
+    bool negative = false;
+    if (*text == '-') {
+        negative = true;
+        text++;
+    }
+    if (*text == '\0') return false;
+
+    // Считаем в отрицательной области, чтобы LONG_MIN тоже помещался
+    long result = 0;
+    for(; *text; text++) {
+        if (*text < '0' || *text > '9') return false;
+        int digit = *text - '0';
+        if (result < (LONG_MIN + digit) / 10) return false;
+        result = result * 10 - digit;
+    }
+    if (!negative) {
+        if (result == LONG_MIN) return false;
+        result = -result;
+    }
+
+    if (result < minValue || result > maxValue) return false;
+    value = result;
+    return true;
+}
+
+bool argHexColor(ESP8266WebServer& server, const char* name, uint8_t& red, uint8_t& green, uint8_t& blue) {
+    return parseHexColor(findArg(server, name), red, green, blue);
+}
+
+bool argInt(ESP8266WebServer& server, const char* name, long minValue, long maxValue, long& value) {
+    return parseBoundedInt(findArg(server, name), minValue, maxValue, value);
+}
@@ -0,0 +1,24 @@
+#ifndef HTTP_ARGS_H
+#define HTTP_ARGS_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+// Разбор аргументов запроса без выделения памяти.
+// Значения читаются прямо из строк, которые сервер уже разобрал,
+// без копий String, toInt() и substring().
+
+// Значение аргумента или nullptr, если его нет в запросе
+const char* findArg(ESP8266WebServer& server, const char* name);
+
+// Цвет в формате "rrggbb" или "#rrggbb"
+bool parseHexColor(const char* text, uint8_t& red, uint8_t& green, uint8_t& blue);
+
+// Десятичное целое в диапазоне [minValue, maxValue], без лишних символов
+bool parseBoundedInt(const char* text, long minValue, long maxValue, long& value);
+
+// То же для аргументов запроса: false, если аргумента нет или он некорректен
+bool argHexColor(ESP8266WebServer& server, const char* name, uint8_t& red, uint8_t& green, uint8_t& blue);
+bool argInt(ESP8266WebServer& server, const char* name, long minValue, long maxValue, long& value);
+
+#endif
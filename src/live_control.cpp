@@ -0,0 +1,143 @@
+#include "live_control.h"
+
+LiveControl::LiveControl(uint16_t port)
+    : socket(port), pending(nullptr), statePublished(false), firstInputUs(0), inputWaiting(false),
+      inputClients(0) {
+    memset(lastState, 0, sizeof(lastState));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void LiveControl::begin(StateUpdate* pendingUpdate) {
+    pending = pendingUpdate;
+    socket.onEvent([this](uint8_t client, WStype_t type, uint8_t* payload, size_t length) {
+        handleEvent(client, type, payload, length);
+    });
+    socket.begin();
+}
+
+void LiveControl::loop() {
+    socket.loop();
+}
+
+void LiveControl::handleEvent(uint8_t client, WStype_t type, uint8_t* payload, size_t length) {
+    switch (type) {
+        case WStype_CONNECTED:
+            // Новый клиент сразу получает текущее состояние
+            if (statePublished) {
+                socket.sendBIN(client, lastState, sizeof(lastState));
+            }
+            break;
+        case WStype_BIN:
+            handleMessage(client, payload, length);
+            break;
+        default:
+            break;
+    }
+}
+
+void LiveControl::markField(uint8_t client, uint8_t field) {
+    if (pending->fields & field) {
+        stats.coalesced++;
+    }
+    pending->fields |= field;
+    inputClients |= 1UL << client;
+
+    if (!inputWaiting) {
+        inputWaiting = true;
+        firstInputUs = micros();
+    }
+}
+
+void LiveControl::handleMessage(uint8_t client, const uint8_t* payload, size_t length) {
+    if (length == 0) {
+        stats.invalid++;
+        return;
+    }
+
+    switch (payload[0]) {
+        case LIVE_OP_COLOR:
+            if (length != 4) break;
+            pending->red = payload[1];
+            pending->green = payload[2];
+            pending->blue = payload[3];
+            markField(client, UPDATE_COLOR);
+            stats.messages++;
+            return;
+
+        case LIVE_OP_BRIGHTNESS:
+            if (length != 2) break;
+            pending->brightness = payload[1];
+            markField(client, UPDATE_BRIGHTNESS);
+            stats.messages++;
+            return;
+
+        case LIVE_OP_EFFECT:
+            if (length != 2 || payload[1] >= EFFECT_COUNT) break;
+            pending->effect = (Effect)payload[1];
+            markField(client, UPDATE_EFFECT);
+            stats.messages++;
+            return;
+
+        case LIVE_OP_TRANSITION:
+            if (length != 2 || payload[1] >= TRANSITION_COUNT) break;
+            pending->transition = (Transition)payload[1];
+            markField(client, UPDATE_TRANSITION);
+            stats.messages++;
+            return;
+
+        case LIVE_OP_WHITE:
+            if (length != 2 || payload[1] > 254) break;
+            pending->whiteRatio = payload[1];
+            markField(client, UPDATE_WHITE);
+            stats.messages++;
+            return;
+
+        case LIVE_OP_GET_STATE:
+            if (statePublished) {
+                socket.sendBIN(client, lastState, sizeof(lastState));
+            }
+            stats.messages++;
+            return;
+
+        default:
+            break;
+    }
+    stats.invalid++;
+}
+
+// Вызывается после вывода кадра, в котором применены накопленные команды
+void LiveControl::frameRendered() {
+    if (!inputWaiting || pending->fields != 0) return;
+
+    inputWaiting = false;
+    stats.lastLatencyUs = micros() - firstInputUs;
+    if (stats.lastLatencyUs > stats.maxLatencyUs) {
+        stats.maxLatencyUs = stats.lastLatencyUs;
+    }
+}
+
+// Рассылает состояние клиентам, если оно изменилось. Клиент, чья команда его изменила,
+// рассылку не получает: иначе эхо сдвигает ползунок, который пользователь еще тянет
+void LiveControl::publishState(const StateUpdate& state) {
+    uint8_t message[LIVE_STATE_SIZE] = {
+        LIVE_OP_STATE, state.red, state.green, state.blue, state.brightness, (uint8_t)state.effect,
+        (uint8_t)state.transition, state.whiteRatio
+    };
+    uint32_t skipClients = inputClients;
+    // Команды уже применены кадром, дальше рассылки снова идут всем
+    if (pending->fields == 0) inputClients = 0;
+    if (statePublished && memcmp(message, lastState, sizeof(message)) == 0) return;
+
+    memcpy(lastState, message, sizeof(message));
+    statePublished = true;
+    if (skipClients == 0) {
+        socket.broadcastBIN(lastState, sizeof(lastState));
+    } else {
+        for(uint8_t client = 0; client < WEBSOCKETS_SERVER_CLIENT_MAX; client++) {
+            if (!(skipClients & (1UL << client))) {
+                socket.sendBIN(client, lastState, sizeof(lastState));
+            }
+        }
+    }
+    stats.broadcasts++;
+}
@@ -0,0 +1,57 @@
+#ifndef LIVE_CONTROL_H
+#define LIVE_CONTROL_H
+
+#include <Arduino.h>
+#include <WebSocketsServer.h>
+#include "clock_state.h"
+
+// Двоичный протокол канала управления: [код][данные]
+const uint8_t LIVE_OP_COLOR = 0x01;       // r, g, b
+const uint8_t LIVE_OP_BRIGHTNESS = 0x02;  // яркость
+const uint8_t LIVE_OP_EFFECT = 0x03;      // номер эффекта
+const uint8_t LIVE_OP_TRANSITION = 0x04;  // стиль перехода
+const uint8_t LIVE_OP_WHITE = 0x05;       // доля белого, 0-254
+const uint8_t LIVE_OP_GET_STATE = 0x10;   // запрос текущего состояния
+const uint8_t LIVE_OP_STATE = 0x80;       // r, g, b, яркость, эффект, переход, белый (от устройства)
+const uint8_t LIVE_STATE_SIZE = 8;
+
+const uint16_t LIVE_CONTROL_PORT = 81;
+
+// Статистика канала
+struct LiveControlStats {
+    uint32_t messages;        // принятые команды
+    uint32_t coalesced;       // команды, перекрытые более новыми до кадра
+    uint32_t invalid;         // некорректные сообщения
+    uint32_t broadcasts;      // рассылки состояния
+    uint32_t lastLatencyUs;   // от приема команды до вывода кадра
+    uint32_t maxLatencyUs;
+};
+
+// Постоянное WebSocket соединение для плавного управления ползунками.
+// Команды только накапливаются в ожидающем изменении, применяет их кадр.
+class LiveControl {
+public:
+    LiveControl(uint16_t port = LIVE_CONTROL_PORT);
+    void begin(StateUpdate* pending);
+    void loop();
+    void frameRendered();
+    void publishState(const StateUpdate& state);
+    uint8_t getClientCount() { return socket.connectedClients(); }
+    const LiveControlStats& getStats() const { return stats; }
+
+private:
+    WebSocketsServer socket;
+    StateUpdate* pending;
+    uint8_t lastState[LIVE_STATE_SIZE];
+    bool statePublished;
+    uint32_t firstInputUs;   // момент первой команды, еще не выведенной на ленту
+    bool inputWaiting;
+    uint32_t inputClients;   // клиенты, чьи команды войдут в следующую рассылку, бит на клиента
+    LiveControlStats stats;
+
+    void handleEvent(uint8_t client, WStype_t type, uint8_t* payload, size_t length);
+    void handleMessage(uint8_t client, const uint8_t* payload, size_t length);
+    void markField(uint8_t client, uint8_t field);
+};
+
+#endif
@@ -6,118 +6,51 @@
 #include <NeoPixelBus.h>
 #include <EEPROM.h>
 #include <time.h>
-
-// Создаем объект ленты в зависимости от типа
-NeoPixelBus<NeoRgbwFeature, NeoEsp8266Uart1Ws2813Method>* strip = nullptr;
-
-// Изменим константы для 7-сегментного дисплея
-const uint8_t LEDS_PER_SEGMENT = 3;    // количество светодиодов в одном сегменте
-const uint8_t SEGMENTS_PER_DIGIT = 7;   // количество сегментов в одной цифре
-const uint8_t DIGIT_COUNT = 4;          // количество цифр
-const uint16_t TOTAL_SEGMENT_LEDS = DIGIT_COUNT * SEGMENTS_PER_DIGIT * LEDS_PER_SEGMENT;  // 84 светодиода для цифр
-
-// Порядок сегментов в ленте (g,b,a,f,e,d,c)
-const uint8_t SEG_G = 0;
-const uint8_t SEG_B = 1;
-const uint8_t SEG_A = 2;
-const uint8_t SEG_F = 3;
-const uint8_t SEG_E = 4;
-const uint8_t SEG_D = 5;
-const uint8_t SEG_C = 6;
-
-// Массив для маппинга цветов на сегменты (0-9)
-const uint8_t DIGITS[10][7] = {
-    {0,1,1,1,1,1,1}, // 0
-    {0,1,0,0,0,0,1}, // 1
-    {1,1,1,0,1,1,0}, // 2
-    {1,1,1,0,0,1,1}, // 3
-    {1,1,0,1,0,0,1}, // 4
-    {1,0,1,1,0,1,1}, // 5
-    {1,0,1,1,1,1,1}, // 6
-    {0,1,1,0,0,0,1}, // 7
-    {1,1,1,1,1,1,1}, // 8
-    {1,1,1,1,0,1,1}  // 9
-};
-
-// Функция для получения индекса начала сегмента
-uint16_t getSegmentStart(uint8_t digit, uint8_t segment) {
-    if (digit < 2) {
-        // Первые два дисплея остаются как есть (0-41)
-        return (digit * SEGMENTS_PER_DIGIT + segment) * LEDS_PER_SEGMENT;
-    } else {
-        // Для третьего и четвертого дисплея добавляем смещение в 3 светодиода
-        // После индексов 42,43,44 идут следующие дисплеи
-        return ((digit * SEGMENTS_PER_DIGIT + segment) * LEDS_PER_SEGMENT) + 3;
-    }
-}
-
-// Функция для установки цвета сегмента
-void setSegmentColor(uint8_t digit, uint8_t segment, RgbwColor color) {
-    uint16_t start = getSegmentStart(digit, segment);
-    for(uint8_t i = 0; i < LEDS_PER_SEGMENT; i++) {
-        strip->SetPixelColor(start + i, color);
-    }
-}
-
-// Функция для отображения одной цифры
-void showDigit(uint8_t digit, uint8_t number, RgbwColor color) {
-    if(number > 9) return;
-    
-    // Устанавливаем цвет для каждого сегмента согласно маппингу
-    setSegmentColor(digit, SEG_G, DIGITS[number][0] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_B, DIGITS[number][1] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_A, DIGITS[number][2] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_F, DIGITS[number][3] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_E, DIGITS[number][4] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_D, DIGITS[number][5] ? color : RgbwColor(0));
-    setSegmentColor(digit, SEG_C, DIGITS[number][6] ? color : RgbwColor(0));
-}
-
-// Константы для дополнительных дисплеев
-const uint16_t DISPLAY3_START = 42;     // Начальный индекс для доп. дисплея (2 диода)
-const uint16_t DISPLAY3_LEDS = 2;       // Количество диодов
-const uint16_t DISPLAY4_START = 44;     // Начальный индекс для доп. дисплея (1 диод)
-const uint16_t DISPLAY4_LEDS = 1;       // Количество диодов
+#include "sntp_client.h"
+#include "wifi_manager.h"
+#include "scheduler.h"
+#include "effects.h"
+#include "http_args.h"
+#include <ArduinoJson.h>
+#include "clock_state.h"
+#include "live_control.h"
+#include "realtime.h"
+#include "animation.h"
+#include "effect_vm.h"
+#include "ota_verify.h"
+#include "marquee.h"
+#include "content.h"
+#include "phase_sync.h"
+#include "mqtt_control.h"
+#include "event_stream.h"
+#include "presets.h"
+#include "day_schedule.h"
+#include "time_zone.h"
+#include "pixel_arena.h"
+#include "pixel_output.h"
+#include "diag_log.h"
+#include "memory_monitor.h"
+#include "settings.h"
+#include "frame_renderer.h"
+#include <Ticker.h>
+
+// Сторож задач, работающий, пока задача отдает управление
+Ticker diagWatchdog;
+
+// Логический кадр ленты, разложенный по одной или двум физическим цепочкам
+PixelOutput output;
+Effects* effects = nullptr;
 
 // Изменим объявление PixelCount, учитывая сдвиг
 const uint16_t PixelCount = 90;         // 21 + 21 + 2 + 1 + 21 + 21 + 3 = 90 светодиодов всего
+const uint16_t PixelCountMax = 300;     // пиксели за часами показывают фон, арена кадра на эту длину
+uint16_t stripPixelCount = PixelCount;
+uint16_t stripSplit = 0;                 // пикселей на цепочке UART1, остальные на DMA; 0 - одна цепочка
 
-// Функция для установки цвета дополнительных дисплеев
-void setExtraDisplays(RgbwColor color) {
-    // Дополнительный дисплей 1 (2 диода)
-    for(uint16_t i = 0; i < DISPLAY3_LEDS; i++) {
-        strip->SetPixelColor(DISPLAY3_START + i, color);
-    }
-    
-    // Дополнительный дисплей 2 (1 диод)
-    strip->SetPixelColor(DISPLAY4_START, color);
-}
-
-// Функция для отображения числа
-void showNumber(int number, RgbwColor color) {
-    // Ограничиваем число четырьмя разрядами
-    number = constrain(number, 0, 9999);
-    
-    // Разбиваем число на цифры
-    uint8_t digits[4];
-    digits[0] = number / 1000;          // Тысячи
-    digits[1] = (number / 100) % 10;    // Сотни
-    digits[2] = (number / 10) % 10;     // Десятки
-    digits[3] = number % 10;            // Единицы
-    
-    // Первые две цифры на первый и второй дисплей (индексы 0-41)
-    showDigit(0, digits[0], color);  // Первая цифра (тысячи)
-    showDigit(1, digits[1], color);  // Вторая цифра (сотни)
-    
-    // Показываем дополнительные дисплеи (индексы 42-44)
-    setExtraDisplays(color);
-    
-    // Последние две цифры на пятый и шестой дисплей (индексы 45-86)
-    showDigit(2, digits[2], color);  // Третья цифра (десятки)
-    showDigit(3, digits[3], color);  // Четвертая цифра (единицы)
-    
-    strip->Show();
-}
+// Буферы кадра для самой длинной ленты, перенастройка не выделяет память под кадр
+PixelArena pixelArena;
+uint32_t stripReconfigures = 0;
+uint32_t stripReconfigureUs = 0;         // длительность последней перенастройки
 
 // В начале файла добавим определения типов лент
 enum StripType {
@@ -126,18 +59,7 @@ enum StripType {
     WS2812B_RGB
 };
 
-// Добавим перечисление для эффектов
-enum Effect {
-    STATIC,
-    RAINBOW,
-    BREATHING,
-    RUNNING,
-    SPARKLE,
-    EFFECT_COUNT  // Используем для проверки границ
-};
-
 // Глобальные переменные
-const uint8_t PixelPin = 2;  // Фиксированный пин GPIO2 (D4)
 StripType currentStripType = SK6812_RGBW;
 
 // Адреса в EEPROM
@@ -147,89 +69,129 @@ const int RED_ADDRESS = 3;
 const int GREEN_ADDRESS = 4;
 const int BLUE_ADDRESS = 5;
 const int EFFECT_ADDRESS = 6;
-
-// Добавим глобальные переменные для анимации
-Effect currentEffect = STATIC;  // Начальный эффект не важен, т.к. время всегда отображается
-unsigned long lastUpdate = 0;
-uint8_t effectStep = 0;
+const int TRANSITION_ADDRESS = 7;
+const int WHITE_RATIO_ADDRESS = 8;
+const int PIXEL_COUNT_ADDRESS = 9;  // 2 байта
+const int STRIP_SPLIT_ADDRESS = 11; // 2 байта
+const int WIFI_CACHE_ADDRESS = 16;  // 8 байт: метка, канал и BSSID точки доступа
 
 // Добавим глобальные переменные для хранения времени
 uint8_t currentHours = 0;
 uint8_t currentMinutes = 0;
-bool colonVisible = true;  // Для мигания разделителя
-
-// Добавим глобальную переменную для отслеживания времени мигания
-unsigned long lastColonUpdate = 0;
-
-// Добавим глобальную переменную для отслеживания времени бегущего огня
-unsigned long lastRunningUpdate = 0;
 
-// Добавим глобальную переменную для отслеживания времени мерцания
-unsigned long lastSparkleUpdate = 0;
+// Периоды задач планировщика, мс
+const uint32_t FRAME_INTERVAL = 50;
+const uint32_t CLOCK_INTERVAL = 1000;
 
-// Добавим глобальную переменную для фазы бегущего огня
-uint8_t runningPhase = 0;
-
-// Добавим прототип функции перед updateEffect
-void showAllDigits(RgbwColor color);
-
-// Функция для отображения времени
-void showTime(RgbwColor color) {
-    // Отображаем часы на первых двух дисплеях
-    showDigit(0, currentHours / 10, color);  // Десятки часов
-    showDigit(1, currentHours % 10, color);  // Единицы часов
-    
-    // Мигающий разделитель только на третьем дисплее (2 диода)
-    if (colonVisible) {
-        // Третий дисплей мигает
-        for(uint16_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, color);
-        }
-    } else {
-        // Выключаем третий дисплей
-        for(uint16_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
-        }
-    }
-    
-    // Чтвертый дисплей всегда выключен
-    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
-    
-    // Отображаем минуты на последних двух дисплеях
-    showDigit(2, currentMinutes / 10, color);  // Десятки минут
-    showDigit(3, currentMinutes % 10, color);  // Единицы минут
-    
-    strip->Show();
-}
+Scheduler scheduler;
 
 // Функции для работы с EEPROM
-void saveStripConfig(StripType type, uint8_t brightness, uint8_t red, uint8_t green, uint8_t blue, Effect effect) {
+
+void saveStripConfig(StripType type, uint16_t count, uint16_t split, uint8_t brightness, uint8_t red, uint8_t green, uint8_t blue, Effect effect) {
     EEPROM.begin(512);
     EEPROM.write(TYPE_ADDRESS, (uint8_t)type);
+    EEPROM.write(PIXEL_COUNT_ADDRESS, count & 0xFF);
+    EEPROM.write(PIXEL_COUNT_ADDRESS + 1, count >> 8);
+    EEPROM.write(STRIP_SPLIT_ADDRESS, split & 0xFF);
+    EEPROM.write(STRIP_SPLIT_ADDRESS + 1, split >> 8);
     EEPROM.write(BRIGHTNESS_LIMIT_ADDRESS, brightness);
     EEPROM.write(RED_ADDRESS, red);
     EEPROM.write(GREEN_ADDRESS, green);
     EEPROM.write(BLUE_ADDRESS, blue);
     EEPROM.write(EFFECT_ADDRESS, (uint8_t)effect);
-    EEPROM.commit();
+    commitSettings();
 }
 
 // Настройки WiFi
 const char* ssid = "q7c";
 const char* password = "11111111";
 
+// Резервная точка доступа для настройки при длительном отсутствии сети
+const char* fallbackApSsid = "LED-Clock";
+const char* fallbackApPassword = "clocksetup";
+const uint32_t FALLBACK_AP_DELAY = 120000;  // мс без связи до запуска точки доступа
+
+// Брокер MQTT для домашней автоматизации, пустая строка - MQTT выключен
+const char* mqttHost = "";
+const uint32_t MQTT_METRICS_INTERVAL = 30000;  // мс
+
+WifiManager wifi;
+bool otaStarted = false;
+
 ESP8266WebServer server(80);
 
+// Настройки времени
+// GMT+3, без летнего времени. Для Центральной Европы: {3600, 3600, 3, 10, 1}
+const TimeZone TIMEZONE = {3 * 3600, 0, 0, 0, 0};
+const char* const ntpServers[] = {"ru.pool.ntp.org", "europe.pool.ntp.org", "ntp1.stratum2.ru"};
+SntpClient sntp;
+
+// Локальное время по собственной шкале SNTP клиента
+void getLocalTime(struct tm* timeinfo) {
+    time_t now = TIMEZONE.toLocal(sntp.now());
+    gmtime_r(&now, timeinfo);
+}
+
 // Сначала объявим все глобальные переменные
-uint8_t currentRed = 0;
-uint8_t currentGreen = 0;
-uint8_t currentBlue = 0;
-uint8_t currentWhite = 0;
+// Цвет, яркость и эффект пользователя; начальный эффект не важен, т.к. время всегда отображается
+ClockSettings settings = {0, 0, 0, 255, STATIC, 0};
 uint8_t currentBrightness = 255;
-uint8_t maxBrightness = 255;  // Объявляем перед использованием в HTML
 
-// HTML шаблон без значения яркости
-const char* serverIndex = R"(
+// Изменения из HTTP API и WebSocket, применяются в начале кадра
+StateUpdate pendingUpdate = {0, 0, 0, 0, 0, STATIC, TRANSITION_NONE, 0};
+LiveControl live;
+
+// Прием кадров от внешнего контроллера по DDP и E1.31
+RealtimeReceiver realtime;
+
+// Анимация из LittleFS под цифрами
+AnimationPlayer animation;
+File animationUpload;
+bool animationUploadOk = false;   // все порции записаны и файл заменен
+
+// Пользовательский эффект в байткоде
+EffectVM effectVm;
+File programUpload;
+bool programUploadOk = false;
+
+// Сообщения бегущей строкой поверх часов
+Marquee marquee;
+
+// Источники содержимого цифр и их чередование
+ContentScheduler content;
+
+// Общая с соседними часами шкала для фаз эффектов и мигания разделителя
+PhaseSync phaseSync;
+
+// Постоянное соединение с брокером MQTT и описание для Home Assistant
+MqttControl mqtt;
+
+// Подписчики /events получают изменения состояния без опроса
+EventStream events;
+
+// Наборы настроек разобраны при загрузке, включение - замена указателя перед кадром
+PresetBank presets;
+
+// Расписание по времени суток: таблица моментов смены состояния на текущие сутки
+DaySchedule schedule;
+
+// Отложенное сохранение в EEPROM: одна запись после серии изменений
+const uint32_t SAVE_DELAY = 2000;  // мс
+int8_t saveTaskId = -1;
+
+// Кадр часов: изменения, наборы и расписание применяются на его границе
+FrameRenderer frame;
+
+// Какие файлы предлагает форма обновления: сборка с OTA_REQUIRE_HASH примет только
+// образ из tools/ota_pack.py, обычная - и простой firmware.bin
+#ifdef OTA_REQUIRE_HASH
+#define OTA_UPLOAD_ACCEPT ".gz"
+#else
+#define OTA_UPLOAD_ACCEPT ".bin,.gz"
+#endif
+
+// Страница во флеше, разрезанная на месте значения яркости: отдается частями без копии в куче
+static const char serverIndexHead[] PROGMEM = R"(
 <!DOCTYPE html>
 <html lang="ru">
 <head>
@@ -399,7 +361,78 @@ const char* serverIndex = R"(
         }
     </style>
     <script>
+    // Постоянный канал для плавного управления: [код][данные]
+    let socket = null;
+
+    // Элемент, который пользователь только что двигал, не обновляется извне,
+    // иначе состояние из сети сдвигает ползунок у него под рукой
+    const touched = {};
+
+    function setControl(id, value) {
+        if (performance.now() - (touched[id] || 0) < 1000) return;
+        document.getElementById(id).value = value;
+    }
+
+    function connectLive() {
+        socket = new WebSocket('ws://' + location.hostname + ':81/');
+        socket.binaryType = 'arraybuffer';
+        socket.onmessage = (event) => {
+            const data = new Uint8Array(event.data);
+            if (data.length !== 8 || data[0] !== 0x80) return;
+            const hex = '#' + [data[1], data[2], data[3]].map(v => v.toString(16).padStart(2, '0')).join('');
+            setControl('colorPicker', hex);
+            setControl('brightnessSlider', data[4]);
+            setControl('effectSelect', data[5]);
+            setControl('transitionSelect', data[6]);
+        };
+        socket.onclose = () => setTimeout(connectLive, 2000);
+    }
+
+    function sendLive(bytes) {
+        if (!socket || socket.readyState !== WebSocket.OPEN) return false;
+        socket.send(new Uint8Array(bytes));
+        return true;
+    }
+
+    function liveColor() {
+        touched.colorPicker = performance.now();
+        const color = document.getElementById('colorPicker').value;
+        const number = parseInt(color.substring(1), 16);
+        sendLive([0x01, (number >> 16) & 0xFF, (number >> 8) & 0xFF, number & 0xFF]);
+    }
+
+    function liveBrightness() {
+        touched.brightnessSlider = performance.now();
+        sendLive([0x02, parseInt(document.getElementById('brightnessSlider').value)]);
+    }
+
+    // Изменения состояния приходят потоком событий, страницу не нужно перезагружать
+    function connectEvents() {
+        const source = new EventSource('/events');
+        source.addEventListener('color', (event) => {
+            setControl('colorPicker', '#' + event.data);
+        });
+        source.addEventListener('brightness', (event) => {
+            setControl('brightnessSlider', event.data);
+        });
+        source.addEventListener('effect', (event) => {
+            setControl('effectSelect', event.data);
+        });
+        source.addEventListener('time', (event) => {
+            const [time, synced] = event.data.split(' ');
+            document.getElementById('clockTime').textContent = time + (synced === '1' ? '' : ' (не синхронизировано)');
+        });
+    }
+
+    window.addEventListener('load', () => {
+        connectLive();
+        connectEvents();
+        document.getElementById('colorPicker').addEventListener('input', liveColor);
+        document.getElementById('brightnessSlider').addEventListener('input', liveBrightness);
+    });
+
     function applyEffect() {
+        touched.effectSelect = performance.now();
         const effect = document.getElementById('effectSelect').value;
         fetch('/effect?value=' + effect)
             .then(response => {
@@ -412,6 +445,19 @@ const char* serverIndex = R"(
         return false;
     }
 
+    function applyTransition() {
+        const transition = document.getElementById('transitionSelect').value;
+        fetch('/transition?value=' + transition)
+            .then(response => {
+                if (!response.ok) throw new Error('Network response was not ok');
+                console.log('Transition changed to:', transition);
+            })
+            .catch(error => {
+                console.error('Error:', error);
+            });
+        return false;
+    }
+
     function applyColor() {
         const color = document.getElementById('colorPicker').value;
         fetch('/update-strip?color=' + encodeURIComponent(color))
@@ -444,6 +490,7 @@ const char* serverIndex = R"(
         <div class="header">
             <h1>LED Clock Control</h1>
             <p>Управление LED часами</p>
+            <p id="clockTime"></p>
         </div>
 
         <div class="panel">
@@ -462,7 +509,8 @@ const char* serverIndex = R"(
             <form onsubmit='return applyBrightness()'>
                 <div class="control-group">
                     <label>Уровень яркости:</label>
-                    <input type="range" id="brightnessSlider" name="value" min="0" max="255" value="255" class="slider">
+                    <input type="range" id="brightnessSlider" name="value" min="0" max="255" value=")";
+static const char serverIndexTail[] PROGMEM = R"(" class="slider">
                 </div>
                 <button type="submit" class="btn">Установить яркость</button>
             </form>
@@ -479,10 +527,24 @@ const char* serverIndex = R"(
                         <option value="2">Дыхание</option>
                         <option value="3">Бегущий огонь</option>
                         <option value="4">Мерцание</option>
+                        <option value="5">Пользовательский</option>
                     </select>
                 </div>
                 <button type="submit" class="btn">Применить эффект</button>
             </form>
+            <form onsubmit='return applyTransition()'>
+                <div class="control-group">
+                    <label>Смена цифр:</label>
+                    <select id="transitionSelect" name="value" class="select">
+                        <option value="0">Без анимации</option>
+                        <option value="1">Сдвиг сверху вниз</option>
+                        <option value="2">Шторка слева направо</option>
+                        <option value="3">Плавная смена</option>
+                        <option value="4">Переворот</option>
+                    </select>
+                </div>
+                <button type="submit" class="btn">Применить</button>
+            </form>
         </div>
 
         <div class="panel">
@@ -490,7 +552,7 @@ const char* serverIndex = R"(
             <form method="POST" action="/update" enctype="multipart/form-data">
                 <div class="control-group">
                     <label>Выберите файл прошивки:</label>
-                    <input type="file" name="update" accept=".bin" class="file-input">
+                    <input type="file" name="update" accept=")" OTA_UPLOAD_ACCEPT R"(" class="file-input">
                 </div>
                 <button type="submit" class="btn">Обновить прошивку</button>
             </form>
@@ -500,45 +562,63 @@ const char* serverIndex = R"(
 </html>
 )";
 
-// Объявим функцию updateEffect перед setup()
-void updateEffect();
-
-// Изменим функцию limitBrightness
-float limitBrightness(float brightness) {
-    float maxValue = (float)maxBrightness / 255.0f;
-    return brightness < maxValue ? brightness : maxValue;
-}
+// Задачи планировщика
+void renderTask();
+void ditherTask();
+void renderDuringTransfer();
+void saveTask();
+void stateToJson(char* buffer, size_t size);
+void reconfigureStrip(uint16_t count, uint16_t split);
+const char* stageName(uint8_t stage);
+void clockTask();
 
 void setup() {
   Serial.begin(115200);
+  // Журнал прошлой загрузки читается до того, как этап setup его перезапишет
+  diag.begin();
   Serial.println("Запуск");
   
   // Чтние конфигурации из EEPROM
   EEPROM.begin(512);
+
+  // Файловая система монтируется один раз: из нее читают анимация, программа эффекта,
+  // наборы настроек и расписание
+  if (!LittleFS.begin()) {
+      Serial.println("LittleFS не смонтирована");
+  }
   StripType savedType = (StripType)EEPROM.read(TYPE_ADDRESS);
   
   if (savedType <= WS2812B_RGB) {
       currentStripType = savedType;
   }
+  // 0xFFFF - стертая EEPROM, лента только под часы
+  uint16_t savedCount = EEPROM.read(PIXEL_COUNT_ADDRESS) | (EEPROM.read(PIXEL_COUNT_ADDRESS + 1) << 8);
+  if (savedCount >= PixelCount && savedCount <= PixelCountMax) {
+      stripPixelCount = savedCount;
+  }
+  uint16_t savedSplit = EEPROM.read(STRIP_SPLIT_ADDRESS) | (EEPROM.read(STRIP_SPLIT_ADDRESS + 1) << 8);
+  if (savedSplit < stripPixelCount) {
+      stripSplit = savedSplit;
+  }
   
   // Инциализация ленты
-  if (strip != nullptr) {
-    delete strip;
-  }
-  strip = new NeoPixelBus<NeoRgbwFeature, NeoEsp8266Uart1Ws2813Method>(PixelCount, PixelPin);
-  strip->Begin();
+  pixelArena.begin((size_t)PixelCountMax * EFFECTS_BYTES_PER_PIXEL);
+  output.begin(PixelCountMax);
+  output.configure(stripPixelCount, stripSplit);
+  effects = new Effects(&output, &pixelArena);
+  memoryMonitor.addBuffer("pixel_arena", pixelArena.getSize());
+  memoryMonitor.addBuffer("output_frame", (size_t)PixelCountMax * StripOrder::SIZE);
   
   // Устанавливаем начальный расный цвет
-  currentRed = 255;
-  currentGreen = 0;
-  currentBlue = 0;
-  currentWhite = 0;
+  settings.red = 255;
+  settings.green = 0;
+  settings.blue = 0;
   currentBrightness = 255;
   
   // После чтения других параметров из EEPROM
   uint8_t savedBrightness = EEPROM.read(BRIGHTNESS_LIMIT_ADDRESS);
   if (savedBrightness > 0 && savedBrightness <= 255) {
-      maxBrightness = savedBrightness;
+      settings.brightness = savedBrightness;
   }
 
   // Читаем сохраненный цвет
@@ -548,41 +628,46 @@ void setup() {
   
   // Прменяем сохраненный цвет, если он валиден
   if (savedRed != 255 || savedGreen != 255 || savedBlue != 255) {
-      currentRed = savedRed;
-      currentGreen = savedGreen;
-      currentBlue = savedBlue;
+      settings.red = savedRed;
+      settings.green = savedGreen;
+      settings.blue = savedBlue;
   } else {
       // Наче используем красный по умолчанию
-      currentRed = 255;
-      currentGreen = 0;
-      currentBlue = 0;
+      settings.red = 255;
+      settings.green = 0;
+      settings.blue = 0;
   }
 
-  // Обновляем цвет ленты с учетом всех параметров
-  RgbwColor color(
-      (currentGreen * maxBrightness) / 255,
-      (currentRed * maxBrightness) / 255,
-      (currentBlue * maxBrightness) / 255,
-      currentWhite
-  );
-  
-  for(uint16_t i = 0; i < PixelCount; i++) {
-      strip->SetPixelColor(i, color);
+  // 255 - стертая EEPROM, белый канал выключен
+  uint8_t savedWhite = EEPROM.read(WHITE_RATIO_ADDRESS);
+  if (savedWhite != 255) {
+      settings.whiteRatio = savedWhite;
   }
-  strip->Show();
 
-  // Подключение к WiFi
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  
-  while (WiFi.waitForConnectResult() != WL_CONNECTED) {
-    Serial.println("Ошибка подключения! Перезагрузка...");
-    delay(5000);
-    ESP.restart();
-  }
+  effects->setColor(settings.red, settings.green, settings.blue);
+  effects->setBrightness(settings.brightness);
+  effects->setWhiteRatio(settings.whiteRatio);
+
+  // Подключение к WiFi идет в фоне, часы работают и без сети
+  wifi.enableFallbackAP(fallbackApSsid, fallbackApPassword, FALLBACK_AP_DELAY);
+  wifi.onConnect([]() {
+    Serial.print("IP адрес: ");
+    Serial.println(WiFi.localIP());
+    if (!otaStarted) {
+      ArduinoOTA.begin();
+      otaStarted = true;
+    }
+  });
+  wifi.begin(ssid, password, WIFI_CACHE_ADDRESS);
 
   // Настройка OTA
   ArduinoOTA.setHostname("esp8266-ota"); // Задайте своё имя устройства
+
+  // Сжатый образ (.bin.gz) распаковывает загрузчик. Сборка с OTA_REQUIRE_HASH принимает
+  // только образы с верным SHA-256 из tools/ota_pack.py, обычная - и простой .bin
+#ifdef OTA_REQUIRE_HASH
+  otaVerifyBegin();
+#endif
   
   ArduinoOTA.onStart([]() {
     Serial.println("Начало OTA обновления");
@@ -594,6 +679,7 @@ void setup() {
   
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
     Serial.printf("Прогресс: %u%%\r", (progress / (total / 100)));
+    renderDuringTransfer();
   });
   
   ArduinoOTA.onError([](ota_error_t error) {
@@ -605,19 +691,25 @@ void setup() {
     else if (error == OTA_END_ERROR) Serial.println("Ошибка завершения");
   });
 
-  ArduinoOTA.begin();
-
   // Настройка веб-сервера
   server.on("/", HTTP_GET, []() {
-    String html = String(serverIndex);
-    html.replace("value='255'", "value='" + String(maxBrightness) + "'");
+    char value[4];
+    size_t valueLength = snprintf(value, sizeof(value), "%u", effects->getBrightness());
     server.sendHeader("Connection", "close");
-    server.send(200, "text/html", html);
+    server.setContentLength(strlen_P(serverIndexHead) + valueLength + strlen_P(serverIndexTail));
+    server.send(200, "text/html", "");
+    server.sendContent_P(serverIndexHead);
+    server.sendContent(value, valueLength);
+    server.sendContent_P(serverIndexTail);
   });
   
   server.on("/update", HTTP_POST, []() {
     server.sendHeader("Connection", "close");
-    server.send(200, "text/plain", (Update.hasError()) ? "Ошибка" : "OK");
+    if (Update.hasError()) {
+      server.send(500, "text/plain", Update.getErrorString());
+      return;
+    }
+    server.send(200, "text/plain", "OK");
     ESP.restart();
   }, []() {
     HTTPUpload& upload = server.upload();
@@ -631,6 +723,7 @@ void setup() {
       if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
         Update.printError(Serial);
       }
+      renderDuringTransfer();
     } else if (upload.status == UPLOAD_FILE_END) {
       if (Update.end(true)) {
         Serial.printf("Обновление успешно: %u\nПерезагрузка...\n", upload.totalSize);
@@ -643,88 +736,66 @@ void setup() {
 
   // Обновляем обработчики с захватом переменных
   server.on("/color", HTTP_GET, [&]() {
-    String hexColor = server.arg("hex");
-    long number = strtol(hexColor.c_str(), NULL, 16);
-    currentRed = number >> 16;
-    currentGreen = (number >> 8) & 0xFF;
-    currentBlue = number & 0xFF;
-    
-    RgbwColor color(
-      currentRed,
-      currentGreen,
-      currentBlue,
-      currentWhite
-    );
-    
-    for(uint16_t i = 0; i < PixelCount; i++) {
-      strip->SetPixelColor(i, color);
+    if (!argHexColor(server, "hex", settings.red, settings.green, settings.blue)) {
+      server.send(400, "text/plain", "Invalid color");
+      return;
     }
-    strip->Show();
+    effects->setColor(settings.red, settings.green, settings.blue);
     server.send(200, "text/plain", "OK");
   });
 
   server.on("/brightness", HTTP_GET, [&]() {
-    String value = server.arg("value");
-    maxBrightness = value.toInt();
+    long value;
+    if (!argInt(server, "value", 0, 255, value)) {
+      server.send(400, "text/plain", "Invalid brightness");
+      return;
+    }
+    settings.brightness = value;
+    effects->setBrightness(settings.brightness);
     
     // Сохраняем яркость в EEPROM
     EEPROM.begin(512);
-    EEPROM.write(BRIGHTNESS_LIMIT_ADDRESS, maxBrightness);
-    EEPROM.commit();
+    EEPROM.write(BRIGHTNESS_LIMIT_ADDRESS, settings.brightness);
+    commitSettings();
     
     // Перенаправляем обратно на главную страницу
     server.sendHeader("Location", "/");
     server.send(302, "text/plain", "");
   });
 
+  // Доля белого: 0 - только RGB, 254 - вся общая часть RGB уходит в белый светодиод
   server.on("/white", HTTP_GET, [&]() {
-    currentWhite = server.arg("value").toInt();
-    RgbwColor color(
-      currentRed,
-      currentGreen,
-      currentBlue,
-      currentWhite
-    );
-    
-    for(uint16_t i = 0; i < PixelCount; i++) {
-      strip->SetPixelColor(i, color);
+    long value;
+    if (!argInt(server, "value", 0, 254, value)) {
+      server.send(400, "text/plain", "Invalid white");
+      return;
     }
-    strip->Show();
+    settings.whiteRatio = value;
+    effects->setWhiteRatio(settings.whiteRatio);
+
+    EEPROM.begin(512);
+    EEPROM.write(WHITE_RATIO_ADDRESS, settings.whiteRatio);
+    commitSettings();
+
     server.send(200, "text/plain", "OK");
   });
 
   // Добавляем новый обработчик для одновременного обновления всех параметров
   server.on("/update-strip", HTTP_GET, [&]() {
-    String color = server.arg("color");
-    // Убираем символ # из начала строки, если он есть
-    if (color.startsWith("#")) {
-        color = color.substring(1);
+    // Преобразуем HEX в RGB, символ # допускается
+    if (!argHexColor(server, "color", settings.red, settings.green, settings.blue)) {
+        server.send(400, "text/plain", "Invalid color");
+        return;
     }
-    
-    // Преобразуем HEX в RGB
-    long number = strtol(color.c_str(), NULL, 16);
-    currentRed = (number >> 16) & 0xFF;
-    currentGreen = (number >> 8) & 0xFF;
-    currentBlue = number & 0xFF;
-    currentWhite = 0;
-    
     // Сохраняем в EEPROM
     EEPROM.begin(512);
-    EEPROM.write(RED_ADDRESS, currentRed);
-    EEPROM.write(GREEN_ADDRESS, currentGreen);
-    EEPROM.write(BLUE_ADDRESS, currentBlue);
-    EEPROM.commit();
+    EEPROM.write(RED_ADDRESS, settings.red);
+    EEPROM.write(GREEN_ADDRESS, settings.green);
+    EEPROM.write(BLUE_ADDRESS, settings.blue);
+    commitSettings();
     
-    // Применяем цвет
-    RgbwColor rgbw(
-        (currentGreen * maxBrightness) / 255,
-        (currentRed * maxBrightness) / 255,
-        (currentBlue * maxBrightness) / 255,
-        0
-    );
-    
-    // Обновляем дисплеи
-    showAllDigits(rgbw);
+    // Применяем цвет, дисплеи обновятся в следующем кадре
+    effects->setColor(settings.red, settings.green, settings.blue);
     
     // Перенаправляем обратно на главную страницу
     server.sendHeader("Location", "/");
@@ -732,18 +803,36 @@ void setup() {
   });
 
   // Добавляем новый обработчик для конфигурации ленты
+  // Лента перестраивается между кадрами без перезагрузки, WiFi и время сохраняются
   server.on("/strip-config", HTTP_GET, [&]() {
-    uint16_t newCount = server.arg("count").toInt();
-    StripType newType = (StripType)server.arg("type").toInt();
-    uint8_t newBrightness = server.arg("brightness").toInt();
+    long newCount, newBrightness;
+    long newType = SK6812_RGBW;
+    long newSplit = 0;
     
-    if (newCount > 0 && newCount <= 1000 &&
-        newType <= WS2812B_RGB &&
-        newBrightness > 0 && newBrightness <= 255) {
+    // split - длина первой цепочки на UART1, остаток ленты идет на вторую цепочку через DMA
+    if (argInt(server, "count", PixelCount, PixelCountMax, newCount) &&
+        (findArg(server, "type") == nullptr || argInt(server, "type", SK6812_RGBW, WS2812B_RGB, newType)) &&
+        argInt(server, "brightness", 1, 255, newBrightness) &&
+        (findArg(server, "split") == nullptr || argInt(server, "split", 0, newCount - 1, newSplit))) {
+        // Цепочки собраны под NeoRgbwFeature: ленты RGB требуют другой сборки прошивки
+        if (newType != SK6812_RGBW) {
+            server.send(400, "text/plain", "Strip type not supported by this build");
+            return;
+        }
         
-        saveStripConfig(newType, newBrightness, currentRed, currentGreen, currentBlue, currentEffect);
+        saveStripConfig((StripType)newType, newCount, newSplit, newBrightness, settings.red, settings.green, settings.blue, settings.effect);
+        currentStripType = (StripType)newType;
+        settings.brightness = newBrightness;
+        effects->setBrightness(settings.brightness);
+        if (newCount != stripPixelCount || newSplit != stripSplit) {
+            reconfigureStrip(newCount, newSplit);
+        }
+        // Длительность перестройки видна в инструментах разработчика браузера
+        char timing[40];
+        snprintf(timing, sizeof(timing), "reconfigure;dur=%lu.%03lu",
+                 (unsigned long)(stripReconfigureUs / 1000), (unsigned long)(stripReconfigureUs % 1000));
+        server.sendHeader("Server-Timing", timing);
         server.send(200, "text/plain", "OK");
-        ESP.restart();
     } else {
         server.send(400, "text/plain", "Invalid parameters");
     }
@@ -752,20 +841,21 @@ void setup() {
   // В setup() после чтения других параметров
   uint8_t savedEffect = EEPROM.read(EFFECT_ADDRESS);
   if(savedEffect < EFFECT_COUNT) {
-      currentEffect = (Effect)savedEffect;
+      settings.effect = (Effect)savedEffect;
+      effects->setEffect(settings.effect);
   }
 
   // Добавим обработчик изменения эффекта (перед server.begin())
   server.on("/effect", HTTP_GET, [&]() {
-      int effect = server.arg("value").toInt();
-      if(effect >= 0 && effect < EFFECT_COUNT) {
-          currentEffect = (Effect)effect;
-          effectStep = 0;
+      long effect;
+      if(argInt(server, "value", 0, EFFECT_COUNT - 1, effect)) {
+          settings.effect = (Effect)effect;
+          effects->setEffect(settings.effect);
           
           // Схраняем эффект в EEPROM
           EEPROM.begin(512);
-          EEPROM.write(EFFECT_ADDRESS, (uint8_t)currentEffect);
-          EEPROM.commit();
+          EEPROM.write(EFFECT_ADDRESS, (uint8_t)settings.effect);
+          commitSettings();
           
           server.send(200, "text/plain", "OK");
       } else {
@@ -773,47 +863,401 @@ void setup() {
       }
   });
 
-  // Настройка времени
-  configTime(3 * 3600, 0, "ru.pool.ntp.org", "europe.pool.ntp.org", "ntp1.stratum2.ru"); // GMT+3, без летнего времени
-  Serial.println("Ожидание синхронизации времени...");
-  while (time(nullptr) < 10000) {
-      delay(100);
+  uint8_t savedTransition = EEPROM.read(TRANSITION_ADDRESS);
+  if(savedTransition < TRANSITION_COUNT) {
+      effects->setTransition((Transition)savedTransition);
   }
 
-  Serial.println("Подключение к NTP...");
-  time_t now = time(nullptr);
-  while (now < 24 * 3600) {
-      Serial.print(".");
-      delay(100);
-      now = time(nullptr);
+  // Стиль смены цифр
+  server.on("/transition", HTTP_GET, [&]() {
+      long transition;
+      if(argInt(server, "value", 0, TRANSITION_COUNT - 1, transition)) {
+          effects->setTransition((Transition)transition);
+
+          EEPROM.begin(512);
+          EEPROM.write(TRANSITION_ADDRESS, (uint8_t)transition);
+          commitSettings();
+
+          server.send(200, "text/plain", "OK");
+      } else {
+          server.send(400, "text/plain", "Invalid transition");
+      }
+  });
+
+  // Сообщение бегущей строкой: /message?text=...&priority=0-9&timeout=секунды, /message?clear=1
+  server.on("/message", HTTP_GET, [&]() {
+      if (findArg(server, "clear") != nullptr) {
+          marquee.clear();
+          server.send(200, "text/plain", "OK");
+          return;
+      }
+      const char* text = findArg(server, "text");
+      long priority = 0;
+      long timeout = 60;
+      if (text == nullptr || *text == '\0' || strlen(text) > MARQUEE_MAX_TEXT ||
+          (findArg(server, "priority") != nullptr && !argInt(server, "priority", 0, MARQUEE_MAX_PRIORITY, priority)) ||
+          (findArg(server, "timeout") != nullptr && !argInt(server, "timeout", 1, 3600, timeout))) {
+          server.send(400, "text/plain", "Invalid message");
+          return;
+      }
+      if (!marquee.enqueue(text, priority, timeout * 1000)) {
+          server.send(503, "text/plain", "Queue full");
+          return;
+      }
+      server.send(200, "text/plain", "OK");
+  });
+
+  // Содержимое цифр: /content?rotation=time:20,date:5 и значения для источников
+  server.on("/content", HTTP_GET, [&]() {
+      const char* rotation = findArg(server, "rotation");
+      const char* text = findArg(server, "text");
+      long number, countdown;
+      bool hasNumber = findArg(server, "number") != nullptr;
+      bool hasCountdown = findArg(server, "countdown") != nullptr;
+
+      // Сначала проверяем все аргументы, чтобы не применить запрос наполовину
+      if ((hasNumber && !argInt(server, "number", -999, 9999, number)) ||
+          (hasCountdown && !argInt(server, "countdown", 0, 0x7FFFFFFF, countdown)) ||
+          (text != nullptr && strlen(text) >= CONTENT_TEXT_SIZE) ||
+          (rotation == nullptr && text == nullptr && !hasNumber && !hasCountdown)) {
+          server.send(400, "text/plain", "Invalid content");
+          return;
+      }
+      if (rotation != nullptr && !content.setRotation(rotation)) {
+          server.send(400, "text/plain", "Invalid rotation");
+          return;
+      }
+      if (text != nullptr) content.setText(text);
+      if (hasNumber) content.setNumber(number);
+      if (hasCountdown) content.setCountdown(countdown);
+      server.send(200, "text/plain", "OK");
+  });
+
+  // Канал плавного управления по WebSocket
+  live.begin(&pendingUpdate);
+
+  // Команды MQTT попадают в то же ожидающее изменение
+  char deviceId[16];
+  snprintf(deviceId, sizeof(deviceId), "%06x", ESP.getChipId());
+  mqtt.begin(mqttHost, MQTT_PORT, deviceId, &pendingUpdate);
+
+  // Пока идут кадры по UDP, эффекты часов не отрисовываются
+  realtime.begin(effects);
+
+  // Загруженная ранее анимация продолжает играть после перезагрузки
+  memoryMonitor.addBuffer("animation_frame", (size_t)PixelCountMax * 3);
+  animation.begin(PixelCountMax);
+  if (LittleFS.exists(ANIM_PATH)) {
+    animation.play(ANIM_PATH);
   }
-  Serial.println();
-  Serial.println("Время синхронизировано");
+
+  // Кадр собирается из модулей выше; примененные изменения сохраняются одной записью после паузы
+  FrameSources sources = {effects, &content, &marquee, &animation, &phaseSync, &live, &realtime, &schedule, &presets};
+  frame.begin(sources, &settings, &pendingUpdate, []() { scheduler.schedule(saveTaskId, SAVE_DELAY); });
+
+  // Загрузка анимации: файл пишется во временный и заменяет старый, только если
+  // записана каждая порция. При ошибке продолжает играть прежняя анимация
+  server.on("/animation", HTTP_POST, [&]() {
+    if (!animationUploadOk) {
+      animation.play(ANIM_PATH);
+      server.send(500, "text/plain", "Write failed");
+    } else if (animation.play(ANIM_PATH)) {
+      server.send(200, "text/plain", "OK");
+    } else {
+      server.send(400, "text/plain", "Invalid animation");
+    }
+  }, [&]() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+      animation.stop();
+      animationUpload = LittleFS.open("/anim.tmp", "w");
+      animationUploadOk = (bool)animationUpload;
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+      if (animationUploadOk && animationUpload.write(upload.buf, upload.currentSize) != upload.currentSize) {
+        animationUploadOk = false;
+      }
+    } else if (upload.status == UPLOAD_FILE_END) {
+      if (animationUpload) {
+        animationUpload.close();
+      }
+      if (animationUploadOk) {
+        LittleFS.remove(ANIM_PATH);
+        animationUploadOk = LittleFS.rename("/anim.tmp", ANIM_PATH);
+      } else {
+        LittleFS.remove("/anim.tmp");
+      }
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+      if (animationUpload) {
+        animationUpload.close();
+      }
+      animationUploadOk = false;
+      LittleFS.remove("/anim.tmp");
+    }
+  });
+
+  server.on("/animation", HTTP_GET, [&]() {
+    const char* action = findArg(server, "action");
+    if (action == nullptr) {
+      server.send(400, "text/plain", "Invalid action");
+    } else if (strcmp(action, "play") == 0) {
+      if (animation.play(ANIM_PATH)) {
+        server.send(200, "text/plain", "OK");
+      } else {
+        server.send(404, "text/plain", "No animation");
+      }
+    } else if (strcmp(action, "stop") == 0) {
+      animation.stop();
+      server.send(200, "text/plain", "OK");
+    } else if (strcmp(action, "delete") == 0) {
+      animation.stop();
+      LittleFS.remove(ANIM_PATH);
+      server.send(200, "text/plain", "OK");
+    } else {
+      server.send(400, "text/plain", "Invalid action");
+    }
+  });
+
+  // Программа пользовательского эффекта проверяется при загрузке, в кадре только выполняется
+  effects->setProgram(&effectVm);
+  if (LittleFS.exists(VM_PATH)) {
+    effectVm.loadFile(VM_PATH);
+  }
+
+  // Загрузка программы: старая заменяется, только если новая прошла проверку
+  server.on("/program", HTTP_POST, [&]() {
+    if (!programUploadOk) {
+      LittleFS.remove("/effect.tmp");
+      server.send(500, "text/plain", "Write failed");
+      return;
+    }
+    VmError error = effectVm.loadFile("/effect.tmp");
+    if (error != VM_OK) {
+      LittleFS.remove("/effect.tmp");
+      server.send(400, "text/plain", vmErrorName(error));
+      return;
+    }
+    LittleFS.remove(VM_PATH);
+    LittleFS.rename("/effect.tmp", VM_PATH);
+    pendingUpdate.effect = CUSTOM;
+    pendingUpdate.fields |= UPDATE_EFFECT;
+    server.send(200, "text/plain", "OK");
+  }, [&]() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+      programUpload = LittleFS.open("/effect.tmp", "w");
+      programUploadOk = (bool)programUpload;
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+      if (programUploadOk && programUpload.write(upload.buf, upload.currentSize) != upload.currentSize) {
+        programUploadOk = false;
+      }
+    } else if (upload.status == UPLOAD_FILE_END) {
+      if (programUpload) {
+        programUpload.close();
+      }
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+      if (programUpload) {
+        programUpload.close();
+      }
+      programUploadOk = false;
+      LittleFS.remove("/effect.tmp");
+    }
+  });
+
+  // Настройка времени: синхронизация идет в фоне из loop()
+  sntp.begin(ntpServers, sizeof(ntpServers) / sizeof(ntpServers[0]));
+
+  // Последний запрошенный маршрут сохраняется в RTC до вызова обработчика
+  server.addHook([](const String& method, const String& url, WiFiClient* client,
+                    ESP8266WebServer::ContentTypeFunction contentType) {
+      diag.setRoute(url.c_str());
+      return ESP8266WebServer::CLIENT_REQUEST_CAN_CONTINUE;
+  });
 
   server.begin();
   
-  Serial.println("OTA и веб-сервер готовы");
-  Serial.print("IP адрес: ");
-  Serial.println(WiFi.localIP());
+  Serial.println("Веб-сервер готов");
+
+  // Наборы настроек из LittleFS проверяются и разбираются один раз
+  if (LittleFS.exists(PRESET_PATH)) {
+    presets.load(PRESET_PATH);
+  }
+  schedule.begin(TIMEZONE, &presets);
+  if (LittleFS.exists(SCHEDULE_PATH)) {
+    schedule.load(SCHEDULE_PATH);
+  }
+
+  // Включение набора по имени, применяется в начале следующего кадра
+  server.on("/preset", HTTP_GET, [&]() {
+      const char* name = findArg(server, "name");
+      const Preset* preset = name != nullptr ? presets.find(name) : nullptr;
+      if (preset == nullptr) {
+          server.send(404, "text/plain", "Unknown preset");
+          return;
+      }
+      frame.selectPreset(preset);
+      server.send(200, "text/plain", "OK");
+  });
+
+  server.on("/presets", HTTP_GET, [&]() {
+      File file = LittleFS.open(PRESET_PATH, "r");
+      if (!file) {
+          server.send(404, "text/plain", "No presets");
+          return;
+      }
+      server.streamFile(file, "application/json");
+      file.close();
+  });
+
+  // Новый банк заменяет старый, только если все наборы прошли проверку
+  server.on("/presets", HTTP_POST, [&]() {
+      const char* body = findArg(server, "plain");
+      size_t length = body != nullptr ? strlen(body) : 0;
+      if (length == 0 || length > PRESET_FILE_MAX) {
+          server.send(400, "text/plain", "Invalid size");
+          return;
+      }
+      // Сначала файл: если запись не удалась, действующие наборы не меняются
+      File file = LittleFS.open("/presets.tmp", "w");
+      if (!file || file.write((const uint8_t*)body, length) != length) {
+          if (file) file.close();
+          LittleFS.remove("/presets.tmp");
+          server.send(500, "text/plain", "Write failed");
+          return;
+      }
+      file.close();
+      // Банк заменяется, только если документ корректен; неверный документ не попадает на место файла
+      if (!presets.parse(body, length)) {
+          LittleFS.remove("/presets.tmp");
+          server.send(400, "text/plain", presets.getError());
+          return;
+      }
+      // Указатели на старые наборы теперь указывают на чужие данные
+      frame.forgetPresets();
+      schedule.invalidate();
+      // rename заменяет прежний файл целиком; если не удалось, банк возвращается к нему
+      if (!LittleFS.rename("/presets.tmp", PRESET_PATH)) {
+          LittleFS.remove("/presets.tmp");
+          presets.load(PRESET_PATH);
+          server.send(500, "text/plain", "Write failed");
+          return;
+      }
+      server.send(200, "text/plain", "OK");
+  });
+
+  server.on("/schedule", HTTP_GET, [&]() {
+      File file = LittleFS.open(SCHEDULE_PATH, "r");
+      if (!file) {
+          server.send(404, "text/plain", "No schedule");
+          return;
+      }
+      server.streamFile(file, "application/json");
+      file.close();
+  });
+
+  // Расписание заменяется целиком, таблица суток пересобирается в следующем кадре
+  server.on("/schedule", HTTP_POST, [&]() {
+      const char* body = findArg(server, "plain");
+      size_t length = body != nullptr ? strlen(body) : 0;
+      if (length == 0 || length > SCHEDULE_FILE_MAX) {
+          server.send(400, "text/plain", "Invalid size");
+          return;
+      }
+      if (!schedule.parse(body, length)) {
+          server.send(400, "text/plain", schedule.getError());
+          return;
+      }
+      File file = LittleFS.open("/schedule.tmp", "w");
+      if (!file || file.write((const uint8_t*)body, length) != length) {
+          if (file) file.close();
+          LittleFS.remove("/schedule.tmp");
+          server.send(500, "text/plain", "Write failed");
+          return;
+      }
+      file.close();
+      LittleFS.remove(SCHEDULE_PATH);
+      LittleFS.rename("/schedule.tmp", SCHEDULE_PATH);
+      server.send(200, "text/plain", "OK");
+  });
+
+  // Поток изменений состояния для страницы и панелей с несколькими часами
+  server.on("/events", HTTP_GET, [&]() {
+      WiFiClient client = server.client();
+      if (!events.accept(client)) {
+          server.send(503, "text/plain", "Too many subscribers");
+      }
+  });
+
+  // Состояние часов одним JSON документом
+  server.on("/api/state", HTTP_GET, [&]() {
+      char json[160];
+      stateToJson(json, sizeof(json));
+      server.send(200, "application/json", json);
+  });
+
+  server.on("/api/state", HTTP_POST, [&]() {
+      // Документ разбирается в статический буфер на стеке, без кучи
+      StaticJsonDocument<192> doc;
+      const char* body = findArg(server, "plain");
+      if (body == nullptr || deserializeJson(doc, body) != DeserializationError::Ok ||
+          !doc.is<JsonObject>()) {
+          server.send(400, "text/plain", "Invalid JSON");
+          return;
+      }
+
+      // Сначала проверяем все поля: документ применяется целиком или не применяется
+      JsonObjectConst fields = doc.as<JsonObjectConst>();
+      StateUpdate update = pendingUpdate;
+      JsonVariantConst color = fields["color"];
+      if (!color.isNull()) {
+          if (!parseHexColor(color.as<const char*>(), update.red, update.green, update.blue)) {
+              server.send(400, "text/plain", "Invalid color");
+              return;
+          }
+          update.fields |= UPDATE_COLOR;
+      }
+      JsonVariantConst brightness = fields["brightness"];
+      if (!brightness.isNull()) {
+          if (!brightness.is<int>() || brightness.as<int>() < 0 || brightness.as<int>() > 255) {
+              server.send(400, "text/plain", "Invalid brightness");
+              return;
+          }
+          update.brightness = brightness.as<int>();
+          update.fields |= UPDATE_BRIGHTNESS;
+      }
+      JsonVariantConst effect = fields["effect"];
+      if (!effect.isNull()) {
+          if (!effect.is<int>() || effect.as<int>() < 0 || effect.as<int>() >= EFFECT_COUNT) {
+              server.send(400, "text/plain", "Invalid effect");
+              return;
+          }
+          update.effect = (Effect)effect.as<int>();
+          update.fields |= UPDATE_EFFECT;
+      }
+
+      pendingUpdate = update;
+
+      char json[160];
+      stateToJson(json, sizeof(json));
+      server.send(200, "application/json", json);
+  });
 
   // Добавим обработчик установки времени
   server.on("/set-time", HTTP_GET, [&]() {
-      int hours = server.arg("hours").toInt();
-      int minutes = server.arg("minutes").toInt();
+      long hours, minutes;
       
-      if(hours >= 0 && hours <= 23 && minutes >= 0 && minutes <= 59) {
+      if(argInt(server, "hours", 0, 23, hours) && argInt(server, "minutes", 0, 59, minutes)) {
           // Устанавливаем время
           currentHours = hours;
           currentMinutes = minutes;
+
+          struct tm timeinfo;
+          getLocalTime(&timeinfo);
+          timeinfo.tm_hour = hours;
+          timeinfo.tm_min = minutes;
+          content.setTime(timeinfo, sntp.now());
           
           // Сразу отображаем новое время
-          RgbwColor color(
-              (currentGreen * maxBrightness) / 255,
-              (currentRed * maxBrightness) / 255,
-              (currentBlue * maxBrightness) / 255,
-              0
-          );
-          showTime(color);
+          renderTask();
           
           server.send(200, "text/plain", "OK");
       } else {
@@ -823,250 +1267,538 @@ void setup() {
 
   // Добавим обработчик для получения времени
   server.on("/get-time", HTTP_GET, [&]() {
-      time_t now = time(nullptr);
-      struct tm* timeinfo = localtime(&now);
+      struct tm timeinfo;
+      getLocalTime(&timeinfo);
       char timeString[6];
-      sprintf(timeString, "%02d:%02d", timeinfo->tm_hour, timeinfo->tm_min);
+      sprintf(timeString, "%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
       server.send(200, "text/plain", timeString);
   });
+
+  // Метрики в текстовом формате Prometheus
+  // Журнал сбросов и зависаний, в том числе записанный до последнего сброса
+  server.on("/diag", HTTP_GET, [&]() {
+      char line[128];
+      server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+      server.send(200, "text/plain", "");
+      const DiagPrevious& previous = diag.getPrevious();
+      snprintf(line, sizeof(line),
+          "boots %lu\n"
+          "uptime_ms %lu\n"
+          "low_heap %lu\n",
+          (unsigned long)diag.getBootCount(),
+          (unsigned long)millis(),
+          (unsigned long)diag.getLowHeap());
+      server.sendContent(line);
+      snprintf(line, sizeof(line),
+          "previous_stage %s\n"
+          "previous_stage_start_ms %lu\n"
+          "previous_route %s\n"
+          "previous_route_ms %lu\n",
+          stageName(previous.stage),
+          (unsigned long)previous.stageStartMs,
+          previous.route[0] != '\0' ? previous.route : "-",
+          (unsigned long)previous.routeMs);
+      server.sendContent(line);
+      for(uint8_t i = 0; i < diag.getCount(); i++) {
+          DiagEntry entry = diag.getEntry(i);
+          snprintf(line, sizeof(line), "%10lu %-12s %-12s arg=%u value=%lu\n",
+              (unsigned long)entry.millis,
+              diagEventName(entry.type),
+              stageName(entry.stage),
+              entry.arg,
+              (unsigned long)entry.value);
+          server.sendContent(line);
+      }
+      server.sendContent("");
+  });
+
+  server.on("/metrics", HTTP_GET, [&]() {
+      // Ответ уходит частями по мере заполнения буфера, размер ответа не ограничен буфером
+      static char metrics[1536];
+      size_t len = 0;
+      auto flush = [&](bool force) {
+          if (len > 0 && (force || len > sizeof(metrics) - 512)) {
+              server.sendContent(metrics, len);
+              len = 0;
+          }
+      };
+      server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+      server.send(200, "text/plain", "");
+      const SntpStats& ntp = sntp.getStats();
+      const WifiStats& net = wifi.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "ntp_synced %d\n"
+          "ntp_offset_ms %ld\n"
+          "ntp_delay_ms %lu\n"
+          "ntp_drift_ppm %.1f\n"
+          "ntp_pending_slew_ms %ld\n"
+          "ntp_sync_count %lu\n"
+          "ntp_fail_count %lu\n"
+          "ntp_sample_count %lu\n"
+          "ntp_last_sync_age_s %lu\n"
+          "ntp_last_server %u\n",
+          sntp.isSynced() ? 1 : 0,
+          (long)ntp.offsetMs,
+          (unsigned long)ntp.delayMs,
+          ntp.driftPpm,
+          (long)ntp.pendingSlewMs,
+          (unsigned long)ntp.syncCount,
+          (unsigned long)ntp.failCount,
+          (unsigned long)ntp.sampleCount,
+          (unsigned long)((millis() - ntp.lastSyncMillis) / 1000),
+          ntp.lastServer);
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "wifi_connected %d\n"
+          "wifi_fallback_ap %d\n"
+          "wifi_rssi_dbm %ld\n"
+          "wifi_outage_count %lu\n"
+          "wifi_connect_attempts %lu\n"
+          "wifi_failed_attempts %lu\n"
+          "wifi_fast_connects %lu\n"
+          "wifi_last_reconnect_ms %lu\n"
+          "wifi_max_reconnect_ms %lu\n"
+          "wifi_total_outage_ms %lu\n",
+          wifi.isConnected() ? 1 : 0,
+          wifi.isFallbackAPActive() ? 1 : 0,
+          wifi.isConnected() ? (long)WiFi.RSSI() : 0L,
+          (unsigned long)net.outageCount,
+          (unsigned long)net.connectAttempts,
+          (unsigned long)net.failedAttempts,
+          (unsigned long)net.fastConnects,
+          (unsigned long)net.lastReconnectMs,
+          (unsigned long)net.maxReconnectMs,
+          (unsigned long)net.totalOutageMs);
+      flush(false);
+      const LiveControlStats& ws = live.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "ws_clients %u\n"
+          "ws_messages %lu\n"
+          "ws_coalesced %lu\n"
+          "ws_invalid %lu\n"
+          "ws_broadcasts %lu\n"
+          "ws_last_latency_us %lu\n"
+          "ws_max_latency_us %lu\n",
+          live.getClientCount(),
+          (unsigned long)ws.messages,
+          (unsigned long)ws.coalesced,
+          (unsigned long)ws.invalid,
+          (unsigned long)ws.broadcasts,
+          (unsigned long)ws.lastLatencyUs,
+          (unsigned long)ws.maxLatencyUs);
+      flush(false);
+      const RealtimeStats& rt = realtime.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "realtime_active %d\n"
+          "realtime_packets %lu\n"
+          "realtime_frames %lu\n"
+          "realtime_dropped %lu\n"
+          "realtime_late %lu\n"
+          "realtime_invalid %lu\n"
+          "realtime_timeouts %lu\n",
+          realtime.isActive() ? 1 : 0,
+          (unsigned long)rt.packets,
+          (unsigned long)rt.frames,
+          (unsigned long)rt.dropped,
+          (unsigned long)rt.late,
+          (unsigned long)rt.invalid,
+          (unsigned long)rt.timeouts);
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "animation_playing %d\n"
+          "animation_frame %lu\n"
+          "animation_decode_errors %lu\n",
+          animation.isPlaying() ? 1 : 0,
+          (unsigned long)animation.getFrameIndex(),
+          (unsigned long)animation.getDecodeErrors());
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "vm_loaded %d\n"
+          "vm_instructions_per_pixel %u\n"
+          "vm_frame_instructions %lu\n"
+          "vm_budget_overruns %lu\n",
+          effectVm.isLoaded() ? 1 : 0,
+          effectVm.getInstructionCount(),
+          (unsigned long)effectVm.getLastFrameInstructions(),
+          (unsigned long)effectVm.getOverruns());
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "power_requested_ma %lu\n"
+          "power_estimated_ma %lu\n"
+          "power_budget_ma %u\n"
+          "power_scale %u\n"
+          "power_limited_frames %lu\n"
+          "dither_active %d\n"
+          "dither_frames %lu\n",
+          (unsigned long)effects->getRequestedCurrent(),
+          (unsigned long)effects->getOutputCurrent(),
+          POWER_BUDGET_MA,
+          effects->getPowerScale(),
+          (unsigned long)effects->getLimitedFrames(),
+          effects->isDithering() ? 1 : 0,
+          (unsigned long)effects->getDitherFrames());
+      flush(false);
+      const SyncStats& sync = phaseSync.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "sync_role %d\n"
+          "sync_locked %d\n"
+          "sync_leader %lu\n"
+          "sync_offset_ms %ld\n"
+          "sync_pending_ms %ld\n"
+          "sync_jitter_ms %lu\n"
+          "sync_phase_error %d\n"
+          "sync_phase_pending_ms %ld\n"
+          "sync_received %lu\n"
+          "sync_sent %lu\n"
+          "sync_steps %lu\n"
+          "sync_elections %lu\n",
+          (int)phaseSync.getRole(),
+          phaseSync.isLocked() ? 1 : 0,
+          (unsigned long)sync.leaderId,
+          (long)sync.offsetMs,
+          (long)sync.pendingMs,
+          (unsigned long)sync.jitterMs,
+          sync.phaseError,
+          (long)sync.phasePendingMs,
+          (unsigned long)sync.received,
+          (unsigned long)sync.sent,
+          (unsigned long)sync.steps,
+          (unsigned long)sync.elections);
+      flush(false);
+      const EventStats& stream = events.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "events_clients %u\n"
+          "events_connects %lu\n"
+          "events_rejected %lu\n"
+          "events_sent %lu\n"
+          "events_stalled %lu\n",
+          events.getClientCount(),
+          (unsigned long)stream.connects,
+          (unsigned long)stream.rejected,
+          (unsigned long)stream.events,
+          (unsigned long)stream.stalled);
+      flush(false);
+      const MqttStats& broker = mqtt.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "mqtt_connected %d\n"
+          "mqtt_queued %u\n"
+          "mqtt_connects %lu\n"
+          "mqtt_disconnects %lu\n"
+          "mqtt_commands %lu\n"
+          "mqtt_invalid %lu\n"
+          "mqtt_skipped %lu\n"
+          "mqtt_published %lu\n"
+          "mqtt_dropped %lu\n",
+          mqtt.isConnected() ? 1 : 0,
+          mqtt.getQueued(),
+          (unsigned long)broker.connects,
+          (unsigned long)broker.disconnects,
+          (unsigned long)broker.received,
+          (unsigned long)broker.invalid,
+          (unsigned long)broker.skipped,
+          (unsigned long)broker.published,
+          (unsigned long)broker.dropped);
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "presets_count %u\n"
+          "preset_fading %d\n",
+          presets.getCount(),
+          effects->isFading() ? 1 : 0);
+      if (frame.getActivePreset() != nullptr) {
+          len += snprintf(metrics + len, sizeof(metrics) - len,
+              "preset_active{preset=\"%s\"} 1\n", frame.getActivePreset()->name);
+      }
+      flush(false);
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "strip_pixels %u\n"
+          "strip_show_us %lu\n"
+          "strip_reconfigures %lu\n"
+          "strip_reconfigure_us %lu\n"
+          "pixel_arena_used_bytes %u\n"
+          "pixel_arena_size_bytes %u\n",
+          stripPixelCount,
+          (unsigned long)output.getLastShowUs(),
+          (unsigned long)stripReconfigures,
+          (unsigned long)stripReconfigureUs,
+          (unsigned)pixelArena.getUsed(),
+          (unsigned)pixelArena.getSize());
+      flush(false);
+      for(uint8_t i = 0; i < output.getSinkCount(); i++) {
+          const OutputSink& sink = output.getSink(i);
+          const SinkStats& timing = sink.getStats();
+          len += snprintf(metrics + len, sizeof(metrics) - len,
+              "sink_pixels{sink=\"%s\"} %u\n"
+              "sink_wire_us{sink=\"%s\"} %lu\n"
+              "sink_start_us{sink=\"%s\"} %lu\n"
+              "sink_max_start_us{sink=\"%s\"} %lu\n"
+              "sink_frames{sink=\"%s\"} %lu\n"
+              "sink_busy_frames{sink=\"%s\"} %lu\n",
+              sink.getName(), sink.getCount(),
+              sink.getName(), (unsigned long)sink.getWireUs(),
+              sink.getName(), (unsigned long)timing.startUs,
+              sink.getName(), (unsigned long)timing.maxStartUs,
+              sink.getName(), (unsigned long)timing.frames,
+              sink.getName(), (unsigned long)timing.busyFrames);
+          flush(false);
+      }
+      const ScheduleStats& day = schedule.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "schedule_rules %u\n"
+          "schedule_points %u\n"
+          "schedule_active_rule %d\n"
+          "schedule_next_transition %lld\n"
+          "schedule_sunrise_minute %d\n"
+          "schedule_sunset_minute %d\n"
+          "schedule_compiles %lu\n"
+          "schedule_jumps %lu\n"
+          "schedule_transitions %lu\n",
+          schedule.getRuleCount(),
+          schedule.getPointCount(),
+          schedule.getActiveIndex(),
+          (long long)schedule.getNextTransition(),
+          schedule.getSunrise(),
+          schedule.getSunset(),
+          (unsigned long)day.compiles,
+          (unsigned long)day.jumps,
+          (unsigned long)day.transitions);
+      flush(false);
+      const MarqueeStats& text = marquee.getStats();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "marquee_active %d\n"
+          "marquee_queued %u\n"
+          "marquee_messages %lu\n"
+          "marquee_shown %lu\n"
+          "marquee_preempted %lu\n"
+          "marquee_expired %lu\n"
+          "marquee_rejected %lu\n",
+          marquee.isActive() ? 1 : 0,
+          marquee.getQueued(),
+          (unsigned long)text.queued,
+          (unsigned long)text.shown,
+          (unsigned long)text.preempted,
+          (unsigned long)text.expired,
+          (unsigned long)text.rejected);
+      flush(false);
+      for(uint8_t i = 0; i < scheduler.getTaskCount(); i++) {
+          const Task& task = scheduler.getTask(i);
+          len += snprintf(metrics + len, sizeof(metrics) - len,
+              "task_runs{task=\"%s\"} %lu\n"
+              "task_overruns{task=\"%s\"} %lu\n"
+              "task_deferrals{task=\"%s\"} %lu\n"
+              "task_max_us{task=\"%s\"} %lu\n"
+              "task_max_late_us{task=\"%s\"} %lu\n",
+              task.name, (unsigned long)task.runs,
+              task.name, (unsigned long)task.overruns,
+              task.name, (unsigned long)task.deferrals,
+              task.name, (unsigned long)task.maxUs,
+              task.name, (unsigned long)task.maxLateUs);
+          flush(false);
+          const MemoryCounters& heap = memoryMonitor.getTask(i);
+          len += snprintf(metrics + len, sizeof(metrics) - len,
+              "heap_allocations{task=\"%s\"} %lu\n"
+              "heap_frees{task=\"%s\"} %lu\n"
+              "heap_alloc_bytes{task=\"%s\"} %lu\n"
+              "heap_allocating_runs{task=\"%s\"} %lu\n",
+              task.name, (unsigned long)heap.allocations,
+              task.name, (unsigned long)heap.frees,
+              task.name, (unsigned long)heap.bytes,
+              task.name, (unsigned long)heap.allocatingRuns);
+          flush(false);
+      }
+      const MemoryCounters& other = memoryMonitor.getOther();
+      len += snprintf(metrics + len, sizeof(metrics) - len,
+          "heap_tracking %d\n"
+          "heap_allocations{task=\"other\"} %lu\n"
+          "heap_frees{task=\"other\"} %lu\n"
+          "heap_alloc_bytes{task=\"other\"} %lu\n"
+          "heap_free_bytes %lu\n"
+          "heap_min_free_bytes %lu\n"
+          "heap_max_block_bytes %lu\n"
+          "heap_min_max_block_bytes %lu\n"
+          "heap_fragmentation %u\n"
+          "heap_max_fragmentation %u\n",
+          memoryMonitor.isTracking() ? 1 : 0,
+          (unsigned long)other.allocations,
+          (unsigned long)other.frees,
+          (unsigned long)other.bytes,
+          (unsigned long)ESP.getFreeHeap(),
+          (unsigned long)memoryMonitor.getMinFreeHeap(),
+          (unsigned long)ESP.getMaxFreeBlockSize(),
+          (unsigned long)memoryMonitor.getMinMaxBlock(),
+          ESP.getHeapFragmentation(),
+          memoryMonitor.getMaxFragmentation());
+      flush(false);
+      for(uint8_t i = 0; i < memoryMonitor.getBufferCount(); i++) {
+          const MemoryBuffer& buffer = memoryMonitor.getBuffer(i);
+          len += snprintf(metrics + len, sizeof(metrics) - len,
+              "memory_buffer_bytes{buffer=\"%s\"} %u\n", buffer.name, (unsigned)buffer.bytes);
+          flush(false);
+      }
+      flush(true);
+      server.sendContent("");
+  });
+
+  // Кадр важнее сетевого обслуживания: сеть не начинает работу, если не успеет до кадра
+  saveTaskId = scheduler.addOneShot("save", saveTask, SAVE_DELAY, PRIORITY_LOW, 20000);
+  scheduler.addPeriodic("frame", renderTask, FRAME_INTERVAL, PRIORITY_FRAME, 5000);
+  scheduler.addPeriodic("dither", ditherTask, DITHER_INTERVAL, PRIORITY_FRAME, 4000);
+  scheduler.addPeriodic("realtime", []() { realtime.loop(); }, 2, PRIORITY_FRAME, 4000);
+  scheduler.addPeriodic("clock", clockTask, CLOCK_INTERVAL, PRIORITY_HIGH, 500);
+  scheduler.addPeriodic("sync", []() {
+    if (!phaseSync.isStarted() && wifi.isConnected()) {
+      phaseSync.begin(ESP.getChipId(), WiFi.localIP());
+    }
+    phaseSync.loop();
+  }, 10, PRIORITY_HIGH, 1000);
+  scheduler.addPeriodic("wifi", []() { wifi.loop(); }, 100, PRIORITY_NORMAL, 2000);
+  scheduler.addPeriodic("http", []() { server.handleClient(); }, 2, PRIORITY_NORMAL, 10000);
+  scheduler.addPeriodic("ws", []() { live.loop(); }, 2, PRIORITY_NORMAL, 5000);
+  scheduler.addPeriodic("mqtt", []() {
+    if (wifi.isConnected()) {
+      mqtt.publishState(frame.getState());
+      mqtt.loop();
+    }
+  }, 10, PRIORITY_NORMAL, 5000);
+  scheduler.addPeriodic("events", []() {
+    StateUpdate state = frame.getState();
+    EventSnapshot snapshot = {
+      state.red, state.green, state.blue, state.brightness, (uint8_t)state.effect,
+      currentHours, currentMinutes, sntp.isSynced(),
+      (uint8_t)phaseSync.getRole(), phaseSync.isLocked()
+    };
+    events.update(snapshot);
+    events.loop();
+  }, 100, PRIORITY_NORMAL, 3000);
+  scheduler.addPeriodic("mqtt-metrics", []() {
+    if (!mqtt.isConnected()) return;
+    char json[160];
+    snprintf(json, sizeof(json),
+        "{\"current_ma\":%lu,\"rssi\":%ld,\"uptime\":%lu,\"heap\":%lu,\"synced\":%s}",
+        (unsigned long)effects->getOutputCurrent(),
+        (long)WiFi.RSSI(),
+        (unsigned long)(millis() / 1000),
+        (unsigned long)ESP.getFreeHeap(),
+        sntp.isSynced() ? "true" : "false");
+    mqtt.publishMetrics(json);
+  }, MQTT_METRICS_INTERVAL, PRIORITY_LOW, 2000);
+  scheduler.addPeriodic("ota", []() {
+    if (otaStarted) {
+      ArduinoOTA.handle();
+    }
+  }, 10, PRIORITY_NORMAL, 2000);
+  scheduler.addPeriodic("sntp", []() {
+    if (wifi.isConnected()) {
+      sntp.loop();
+    }
+  }, 20, PRIORITY_LOW, 2000);
+
+  // Номер задачи пишется в RTC на время ее выполнения, выделения в куче считаются по задачам
+  scheduler.setHooks([](uint8_t id, uint32_t) {
+    diag.enterStage(id);
+    memoryMonitor.enterStage(id);
+  }, [](uint8_t id, uint32_t durationUs) {
+    memoryMonitor.leaveStage();
+    uint32_t showUs = output.takeMaxShowUs();
+    if (showUs > DIAG_SLOW_CALL_US) {
+      diag.record(DIAG_SLOW_SHOW, 0, showUs);
+    }
+    diag.leaveStage(durationUs);
+    diag.checkHeap();
+  });
+  diagWatchdog.attach_ms(DIAG_WATCHDOG_PERIOD_MS, []() { diag.watchdog(); });
+  diag.leaveStage(0);
+}
+
+// Имя этапа журнала: задачи планировщика регистрируются в одном порядке при каждой загрузке
+const char* stageName(uint8_t stage) {
+    if (stage == DIAG_STAGE_IDLE) return "idle";
+    if (stage == DIAG_STAGE_SETUP) return "setup";
+    return stage < scheduler.getTaskCount() ? scheduler.getTask(stage).name : "unknown";
 }
 
 void loop() {
-  ArduinoOTA.handle();
-  server.handleClient();
-  updateEffect();
+  scheduler.run();
 }
 
-// В функции updateEffect изменим структуру:
-void updateEffect() {
-    static unsigned long lastTimeUpdate = 0;
-    static unsigned long lastEffectUpdate = 0;
-    unsigned long currentMillis = millis();
-
-    // Объявляем все переменные в начале функции
-    RgbwColor color;
-    float brightness = 0;
-    RgbwColor dimColor;
-    RgbwColor brightColor;
-    RgbwColor baseColor;
-
-    // Обновляем время каждую секунду
-    if (currentMillis - lastTimeUpdate >= 1000) {
-        lastTimeUpdate = currentMillis;
-        time_t now = time(nullptr);
-        struct tm* timeinfo = localtime(&now);
-        currentHours = timeinfo->tm_hour;
-        currentMinutes = timeinfo->tm_min;
-    }
+// Обработчики HTTP выполняются между кадрами, поэтому цепочки можно пересоздать сразу
+void reconfigureStrip(uint16_t count, uint16_t split) {
+    uint32_t start = micros();
+    output.configure(count, split);
+    effects->resize();
+    stripPixelCount = count;
+    stripSplit = split;
+
+    // Длительность видна в /metrics и в Server-Timing ответа /strip-config
+    stripReconfigureUs = micros() - start;
+    stripReconfigures++;
+}
 
-    // Обновляем состояние разделителя каждые 500мс
-    if(currentMillis - lastColonUpdate >= 500) {
-        lastColonUpdate = currentMillis;
-        colonVisible = !colonVisible;
+// Состояние с учетом еще не примененных изменений
+void stateToJson(char* buffer, size_t size) {
+    StateUpdate state = frame.getState();
+    if (pendingUpdate.fields & UPDATE_COLOR) {
+        state.red = pendingUpdate.red;
+        state.green = pendingUpdate.green;
+        state.blue = pendingUpdate.blue;
     }
-
-    // Обновляем эффекты каждые 50мс
-    if (currentMillis - lastEffectUpdate >= 50) {
-        lastEffectUpdate = currentMillis;
-
-        switch (currentEffect) {
-            case STATIC:
-            default:
-                color = RgbwColor(
-                    (currentGreen * maxBrightness) / 255,
-                    (currentRed * maxBrightness) / 255,
-                    (currentBlue * maxBrightness) / 255,
-                    0
-                );
-                break;
-
-            case RAINBOW:
-                effectStep = (effectStep + 1) % 256;
-                if(effectStep < 85) {
-                    color = RgbwColor(
-                        (255 - effectStep * 3) * maxBrightness / 255,
-                        (effectStep * 3) * maxBrightness / 255,
-                        0,
-                        0
-                    );
-                } else if(effectStep < 170) {
-                    uint8_t step = effectStep - 85;
-                    color = RgbwColor(
-                        0,
-                        (255 - step * 3) * maxBrightness / 255,
-                        (step * 3) * maxBrightness / 255,
-                        0
-                    );
-                } else {
-                    uint8_t step = effectStep - 170;
-                    color = RgbwColor(
-                        (step * 3) * maxBrightness / 255,
-                        0,
-                        (255 - step * 3) * maxBrightness / 255,
-                        0
-                    );
-                }
-                break;
-
-            case BREATHING:
-                effectStep = (effectStep + 2) % 256;
-                brightness = sin(effectStep * PI / 128) * 0.4 + 0.6;
-                color = RgbwColor(
-                    (currentGreen * maxBrightness * brightness) / 255,
-                    (currentRed * maxBrightness * brightness) / 255,
-                    (currentBlue * maxBrightness * brightness) / 255,
-                    0
-                );
-                break;
-
-            case RUNNING:
-                {
-                    // Обновляем фазу анимации (0-255)
-                    runningPhase = (runningPhase + 2) % 256;  // Увеличили шаг для более быстрой анимации
-                    
-                    // Базовая яркость 30%
-                    const float baseBrightness = 0.3f;
-                    
-                    // Вычисляем текущий активный дисплей (0-3)
-                    uint8_t activeDisplay = (runningPhase / 64) % 4;  // Делим на 64 для 4 фаз
-                    
-                    // Вычисляем фазу перехода (0-63)
-                    uint8_t transitionPhase = runningPhase % 64;
-                    
-                    // Создаем базовый цвет для неактивных дисплеев
-                    RgbwColor baseColor(
-                        (currentGreen * maxBrightness * baseBrightness) / 255,
-                        (currentRed * maxBrightness * baseBrightness) / 255,
-                        (currentBlue * maxBrightness * baseBrightness) / 255,
-                        0
-                    );
-                    
-                    // Отображаем все дисплеи с базовой яркостью
-                    for(uint8_t i = 0; i < 4; i++) {
-                        showDigit(i, i < 2 ? 
-                            (i == 0 ? currentHours / 10 : currentHours % 10) :
-                            (i == 2 ? currentMinutes / 10 : currentMinutes % 10),
-                            baseColor);
-                    }
-                    
-                    // Вычисляем яркость для активного дисплея (плавное нарастание и затухание)
-                    float activePhase = (float)transitionPhase / 63.0f;  // 0.0 - 1.0
-                    float activeBrightness = baseBrightness + (1.0f - baseBrightness) * sin(activePhase * PI);
-                    
-                    // Создаем цвет для активного дисплея
-                    RgbwColor activeColor(
-                        (currentGreen * maxBrightness * activeBrightness) / 255,
-                        (currentRed * maxBrightness * activeBrightness) / 255,
-                        (currentBlue * maxBrightness * activeBrightness) / 255,
-                        0
-                    );
-                    
-                    // Обновляем активный дисплей
-                    showDigit(activeDisplay, activeDisplay < 2 ? 
-                        (activeDisplay == 0 ? currentHours / 10 : currentHours % 10) :
-                        (activeDisplay == 2 ? currentMinutes / 10 : currentMinutes % 10),
-                        activeColor);
-                    
-                    // Разделитель мигает с базовой яркостью
-                    if (colonVisible) {
-                        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                            strip->SetPixelColor(DISPLAY3_START + i, baseColor);
-                        }
-                    } else {
-                        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
-                        }
-                    }
-                    
-                    // Четвертый дисплей всегда выключен
-                    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
-                    
-                    strip->Show();
-                    return;
-                }
-
-            case SPARKLE:
-                // Обновляем мерцание каждые 200мс
-                if (currentMillis - lastSparkleUpdate >= 200) {
-                    lastSparkleUpdate = currentMillis;
-                    
-                    for(uint8_t digit = 0; digit < 4; digit++) {
-                        if(random(100) < 30) { // 30% вероятность уменьшения яркости
-                            // Уменьшаем яркость на 20% от базовой
-                            color = RgbwColor(
-                                (currentGreen * maxBrightness * 0.8) / 255,  // -20% от яркости
-                                (currentRed * maxBrightness * 0.8) / 255,    // -20% от яркости
-                                (currentBlue * maxBrightness * 0.8) / 255,   // -20% от яркости
-                                0
-                            );
-                        } else {
-                            // Базовая яркость
-                            color = RgbwColor(
-                                (currentGreen * maxBrightness) / 255,
-                                (currentRed * maxBrightness) / 255,
-                                (currentBlue * maxBrightness) / 255,
-                                0
-                            );
-                        }
-                        showDigit(digit, digit < 2 ? 
-                            (digit == 0 ? currentHours / 10 : currentHours % 10) :
-                            (digit == 2 ? currentMinutes / 10 : currentMinutes % 10),
-                            color);
-                    }
-                    
-                    // Разделитель с базовой яркостью
-                    if (colonVisible) {
-                        color = RgbwColor(
-                            (currentGreen * maxBrightness) / 255,
-                            (currentRed * maxBrightness) / 255,
-                            (currentBlue * maxBrightness) / 255,
-                            0
-                        );
-                        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                            strip->SetPixelColor(DISPLAY3_START + i, color);
-                        }
-                    } else {
-                        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-                            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
-                        }
-                    }
-                    
-                    // Четвертый дисплей всегда выключен
-                    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
-                    
-                    strip->Show();
-                }
-                return; // Выходим, так как уже обновили дисплей
-        }
-
-        // Общий код для отображения
-        showAllDigits(color);
+    if (pendingUpdate.fields & UPDATE_BRIGHTNESS) {
+        state.brightness = pendingUpdate.brightness;
+    }
+    if (pendingUpdate.fields & UPDATE_EFFECT) {
+        state.effect = pendingUpdate.effect;
     }
+
+    char color[8];
+    char time[6];
+    snprintf(color, sizeof(color), "#%02x%02x%02x", state.red, state.green, state.blue);
+    snprintf(time, sizeof(time), "%02d:%02d", currentHours, currentMinutes);
+
+    StaticJsonDocument<128> doc;
+    doc["color"] = color;
+    doc["brightness"] = state.brightness;
+    doc["effect"] = (int)state.effect;
+    doc["time"] = time;
+    doc["synced"] = sntp.isSynced();
+    serializeJson(doc, buffer, size);
 }
 
-// Реализация showAllDigits после updateEffect
-void showAllDigits(RgbwColor color) {
-    // Отображаем время
-    showDigit(0, currentHours / 10, color);
-    showDigit(1, currentHours % 10, color);
+// Одна запись EEPROM после серии изменений состояния
+void saveTask() {
+    EEPROM.begin(512);
+    EEPROM.write(BRIGHTNESS_LIMIT_ADDRESS, settings.brightness);
+    EEPROM.write(RED_ADDRESS, settings.red);
+    EEPROM.write(GREEN_ADDRESS, settings.green);
+    EEPROM.write(BLUE_ADDRESS, settings.blue);
+    EEPROM.write(EFFECT_ADDRESS, (uint8_t)settings.effect);
+    EEPROM.write(TRANSITION_ADDRESS, (uint8_t)effects->getTransition());
+    EEPROM.write(WHITE_RATIO_ADDRESS, settings.whiteRatio);
+    commitSettings();
+}
 
-    // Мигающий разделитель
-    if (colonVisible) {
-        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, color);
-        }
-    } else {
-        for(uint8_t i = 0; i < DISPLAY3_LEDS; i++) {
-            strip->SetPixelColor(DISPLAY3_START + i, RgbwColor(0));
-        }
-    }
+// Отрисовка кадра - самая приоритетная задача
+void renderTask() {
+    frame.render(sntp.isSynced() ? sntp.now() : 0);
+}
 
-    // Четвертый дисплей всегда выключен
-    strip->SetPixelColor(DISPLAY4_START, RgbwColor(0));
+// Между кадрами эффектов и потока DDP тот же кадр выводится с дизерингом, пока он нужен
+void ditherTask() {
+    effects->refresh();
+}
 
-    // Отображаем минуты
-    showDigit(2, currentMinutes / 10, color);
-    showDigit(3, currentMinutes % 10, color);
+// Загрузка прошивки целиком идет внутри одного вызова http или ota,
+// поэтому кадры отрисовываются между порциями данных
+void renderDuringTransfer() {
+    static uint32_t lastFrameMillis = 0;
+    if (millis() - lastFrameMillis < FRAME_INTERVAL) return;
+    lastFrameMillis = millis();
+    renderTask();
+}
 
-    strip->Show();
-} 
+// Обновляем время каждую секунду
+void clockTask() {
+    struct tm timeinfo;
+    getLocalTime(&timeinfo);
+    currentHours = timeinfo.tm_hour;
+    currentMinutes = timeinfo.tm_min;
+    content.setTime(timeinfo, sntp.now());
+}
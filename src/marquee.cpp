@@ -0,0 +1,148 @@
+#include "marquee.h"
+#include "font7seg.h"
+
+Marquee::Marquee()
+    : streamLength(0), streamPos(0), window(0), colonWindow(0), currentPriority(0),
+      currentExpires(0), lastStepMillis(0), holdUntilMillis(0), active(false) {
+    memset(queue, 0, sizeof(queue));
+    memset(masks, 0, sizeof(masks));
+    memset(&stats, 0, sizeof(stats));
+}
+
+// Полная очередь вытесняет сообщение с меньшим приоритетом
+bool Marquee::enqueue(const char* text, uint8_t priority, uint32_t timeoutMs) {
+    int8_t slot = -1;
+    for(uint8_t i = 0; i < MARQUEE_QUEUE_SIZE; i++) {
+        if (!queue[i].used) {
+            slot = i;
+            break;
+        }
+        if (queue[i].priority < priority && (slot < 0 || queue[i].priority < queue[slot].priority)) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        stats.rejected++;
+        return false;
+    }
+
+    MarqueeMessage& message = queue[slot];
+    strncpy(message.text, text, MARQUEE_MAX_TEXT);
+    message.text[MARQUEE_MAX_TEXT] = '\0';
+    message.priority = priority;
+    message.expiresMillis = millis() + timeoutMs;
+    message.used = true;
+    stats.queued++;
+    return true;
+}
+
+void Marquee::clear() {
+    for(uint8_t i = 0; i < MARQUEE_QUEUE_SIZE; i++) {
+        queue[i].used = false;
+    }
+    active = false;
+}
+
+uint8_t Marquee::getQueued() const {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < MARQUEE_QUEUE_SIZE; i++) {
+        if (queue[i].used) count++;
+    }
+    return count;
+}
+
+// Сообщение с наибольшим приоритетом, при равных - то, что раньше истекает
+int8_t Marquee::nextMessage(uint32_t nowMs) {
+    int8_t best = -1;
+    for(uint8_t i = 0; i < MARQUEE_QUEUE_SIZE; i++) {
+        if (!queue[i].used) continue;
+        if ((int32_t)(nowMs - queue[i].expiresMillis) >= 0) {
+            queue[i].used = false;
+            stats.expired++;
+            continue;
+        }
+        if (best < 0 || queue[i].priority > queue[best].priority ||
+            (queue[i].priority == queue[best].priority &&
+             (int32_t)(queue[i].expiresMillis - queue[best].expiresMillis) < 0)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Текст переводится в маски один раз, за ним - пустые позиции, чтобы он ушел с экрана
+void Marquee::start(uint8_t slot, uint32_t nowMs) {
+    MarqueeMessage& message = queue[slot];
+    streamLength = 0;
+    for(const char* c = message.text; *c != '\0'; c++) {
+        if (*c == ':' && streamLength > 0) {
+            streamColon[streamLength - 1] = 1;
+            continue;
+        }
+        stream[streamLength] = glyphMask(*c);
+        streamColon[streamLength] = 0;
+        streamLength++;
+    }
+    for(uint8_t i = 0; i < DIGIT_COUNT; i++) {
+        stream[streamLength] = 0;
+        streamColon[streamLength] = 0;
+        streamLength++;
+    }
+
+    currentPriority = message.priority;
+    currentExpires = message.expiresMillis;
+    message.used = false;
+
+    streamPos = 0;
+    window = 0;
+    colonWindow = 0;
+    memset(masks, 0, sizeof(masks));
+    lastStepMillis = nowMs;
+    holdUntilMillis = nowMs;
+    active = true;
+    stats.shown++;
+}
+
+void Marquee::step() {
+    window = (window << 8) | stream[streamPos];
+    colonWindow = ((colonWindow << 1) | streamColon[streamPos]) & ((1 << DIGIT_COUNT) - 1);
+    streamPos++;
+    for(uint8_t i = 0; i < DIGIT_COUNT; i++) {
+        masks[i] = window >> (8 * (DIGIT_COUNT - 1 - i));
+    }
+}
+
+void Marquee::update(uint32_t nowMs) {
+    if (active) {
+        // Более важное сообщение прерывает текущее, текущее не возвращается в очередь
+        int8_t next = nextMessage(nowMs);
+        if (next >= 0 && queue[next].priority > currentPriority) {
+            stats.preempted++;
+            start(next, nowMs);
+        } else if ((int32_t)(nowMs - currentExpires) >= 0) {
+            stats.expired++;
+            active = false;
+        }
+    }
+
+    if (!active) {
+        int8_t next = nextMessage(nowMs);
+        if (next < 0) return;
+        start(next, nowMs);
+    }
+
+    if ((int32_t)(nowMs - holdUntilMillis) < 0) return;
+    if (nowMs - lastStepMillis < MARQUEE_STEP_MS) return;
+    lastStepMillis = nowMs;
+
+    if (streamPos >= streamLength) {
+        active = false;
+        return;
+    }
+    step();
+
+    // Начало текста дошло до первой цифры: короткий текст виден целиком, даем его прочитать
+    if (streamPos == DIGIT_COUNT) {
+        holdUntilMillis = nowMs + MARQUEE_HOLD_MS;
+    }
+}
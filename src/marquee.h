@@ -0,0 +1,69 @@
+#ifndef MARQUEE_H
+#define MARQUEE_H
+
+#include <Arduino.h>
+#include "effects.h"
+
+const uint8_t MARQUEE_QUEUE_SIZE = 4;
+const uint8_t MARQUEE_MAX_TEXT = 64;
+const uint16_t MARQUEE_STEP_MS = 300;   // сдвиг на одну позицию
+const uint16_t MARQUEE_HOLD_MS = 1500;  // пауза, когда начало текста дошло до первой цифры
+const uint8_t MARQUEE_MAX_PRIORITY = 9;
+
+struct MarqueeMessage {
+    char text[MARQUEE_MAX_TEXT + 1];
+    uint8_t priority;
+    uint32_t expiresMillis;
+    bool used;
+};
+
+struct MarqueeStats {
+    uint32_t queued;
+    uint32_t shown;
+    uint32_t preempted;
+    uint32_t expired;
+    uint32_t rejected;
+};
+
+// Бегущая строка поверх часов.
+// Текст один раз переводится в поток масок, шаг прокрутки - сдвиг 32-битного окна на байт.
+// Двоеточие в тексте не занимает позицию, а зажигает разделитель после предыдущего символа.
+class Marquee {
+public:
+    Marquee();
+    bool enqueue(const char* text, uint8_t priority, uint32_t timeoutMs);
+    void clear();
+    void update(uint32_t nowMs);
+    bool isActive() const { return active; }
+    const uint8_t* getMasks() const { return masks; }
+    bool getColon() const { return colonWindow & MARQUEE_COLON_BIT; }
+    uint8_t getQueued() const;
+    const MarqueeStats& getStats() const { return stats; }
+
+private:
+    // Разделитель стоит между второй и третьей цифрой
+    static const uint8_t MARQUEE_COLON_BIT = 1 << (DIGIT_COUNT - 2);
+
+    MarqueeMessage queue[MARQUEE_QUEUE_SIZE];
+
+    // Текущее сообщение: маски символов и признак двоеточия после символа
+    uint8_t stream[MARQUEE_MAX_TEXT + DIGIT_COUNT];
+    uint8_t streamColon[MARQUEE_MAX_TEXT + DIGIT_COUNT];
+    uint8_t streamLength;
+    uint8_t streamPos;
+    uint32_t window;        // маски на цифрах, первая цифра - старший байт
+    uint8_t colonWindow;    // признаки двоеточия на цифрах, первая цифра - старший бит
+    uint8_t masks[DIGIT_COUNT];
+    uint8_t currentPriority;
+    uint32_t currentExpires;
+    uint32_t lastStepMillis;
+    uint32_t holdUntilMillis;
+    bool active;
+    MarqueeStats stats;
+
+    int8_t nextMessage(uint32_t nowMs);
+    void start(uint8_t slot, uint32_t nowMs);
+    void step();
+};
+
+#endif
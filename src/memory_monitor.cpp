@@ -0,0 +1,79 @@
+#include "memory_monitor.h"
+
+MemoryMonitor memoryMonitor;
+
+// Счетчики и этап не инициализируются: глобальный объект обнулен до конструкторов,
+// а выделения из конструкторов других объектов уже учтены
+MemoryMonitor::MemoryMonitor()
+    : bufferCount(0), minFreeHeap(0xFFFFFFFF), minMaxBlock(0xFFFFFFFF), maxFragmentation(0) {
+}
+
+void MemoryMonitor::addBuffer(const char* name, size_t bytes) {
+    if (bufferCount >= MEMORY_MAX_BUFFERS) return;
+    buffers[bufferCount].name = name;
+    buffers[bufferCount].bytes = bytes;
+    bufferCount++;
+}
+
+void MemoryMonitor::enterStage(uint8_t id) {
+    stage = id < SCHEDULER_MAX_TASKS ? id + 1 : MEMORY_OTHER;
+    stageAllocations = counters[stage].allocations;
+}
+
+// Состояние кучи снимается после каждой задачи: минимум между задачами и есть пик занятости
+void MemoryMonitor::leaveStage() {
+    if (counters[stage].allocations != stageAllocations) {
+        counters[stage].allocatingRuns++;
+    }
+    stage = MEMORY_OTHER;
+
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t maxBlock = ESP.getMaxFreeBlockSize();
+    uint8_t fragmentation = ESP.getHeapFragmentation();
+    if (freeHeap < minFreeHeap) minFreeHeap = freeHeap;
+    if (maxBlock < minMaxBlock) minMaxBlock = maxBlock;
+    if (fragmentation > maxFragmentation) maxFragmentation = fragmentation;
+}
+
+void MemoryMonitor::allocated(size_t bytes) {
+    counters[stage].allocations++;
+    counters[stage].bytes += bytes;
+}
+
+void MemoryMonitor::freed() {
+    counters[stage].frees++;
+}
+
+#ifdef MEMORY_TRACKING
+bool MemoryMonitor::isTracking() const { return true; }
+
+// Компоновщик направляет сюда все вызовы malloc, calloc, realloc и free (-Wl,--wrap)
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void __real_free(void* pointer);
+
+void* __wrap_malloc(size_t size) {
+    memoryMonitor.allocated(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    memoryMonitor.allocated(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    memoryMonitor.allocated(size);
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void* pointer) {
+    if (pointer != nullptr) memoryMonitor.freed();
+    __real_free(pointer);
+}
+}
+#else
+bool MemoryMonitor::isTracking() const { return false; }
+#endif
@@ -0,0 +1,63 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <Arduino.h>
+#include "scheduler.h"
+
+// Учет памяти: выделения в куче по задачам планировщика, минимум свободной кучи,
+// наибольший свободный блок и размеры постоянных буферов подсистем.
+// Выделения считаются только в сборке, перехватывающей malloc: pio run -e esp8266-tracking.
+// Счетчики 0 - выделения вне задач (setup и система), 1..16 - задачи планировщика.
+// Перехватчик может сработать до конструктора, поэтому нулевой индекс должен быть корректным
+const uint8_t MEMORY_OTHER = 0;
+const uint8_t MEMORY_STAGES = SCHEDULER_MAX_TASKS + 1;
+const uint8_t MEMORY_MAX_BUFFERS = 8;
+
+struct MemoryCounters {
+    uint32_t allocations;        // malloc, calloc и realloc
+    uint32_t frees;
+    uint32_t bytes;              // запрошено всего
+    uint32_t allocatingRuns;     // запуски задачи, в которых была хоть одна выделенная область
+};
+
+struct MemoryBuffer {
+    const char* name;
+    size_t bytes;
+};
+
+class MemoryMonitor {
+public:
+    MemoryMonitor();
+    // Постоянный буфер подсистемы, выделенный при запуске
+    void addBuffer(const char* name, size_t bytes);
+    // Начало и конец задачи планировщика
+    void enterStage(uint8_t id);
+    void leaveStage();
+
+    // Вызываются перехватчиками malloc и free
+    void allocated(size_t bytes);
+    void freed();
+
+    bool isTracking() const;
+    const MemoryCounters& getOther() const { return counters[MEMORY_OTHER]; }
+    const MemoryCounters& getTask(uint8_t id) const { return counters[id + 1]; }
+    uint8_t getBufferCount() const { return bufferCount; }
+    const MemoryBuffer& getBuffer(uint8_t index) const { return buffers[index]; }
+    uint32_t getMinFreeHeap() const { return minFreeHeap; }
+    uint32_t getMinMaxBlock() const { return minMaxBlock; }
+    uint8_t getMaxFragmentation() const { return maxFragmentation; }
+
+private:
+    MemoryCounters counters[MEMORY_STAGES];
+    uint8_t stage;
+    uint32_t stageAllocations;   // счетчик выделений в начале задачи
+    MemoryBuffer buffers[MEMORY_MAX_BUFFERS];
+    uint8_t bufferCount;
+    uint32_t minFreeHeap;
+    uint32_t minMaxBlock;
+    uint8_t maxFragmentation;
+};
+
+extern MemoryMonitor memoryMonitor;
+
+#endif
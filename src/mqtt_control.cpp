@@ -0,0 +1,572 @@
+#include "mqtt_control.h"
+#include <ArduinoJson.h>
+#include <include/ClientContext.h>
+
+// Типы пакетов MQTT, старшие 4 бита первого байта
+const uint8_t MQTT_CONNECT = 0x10;
+const uint8_t MQTT_CONNACK = 0x20;
+const uint8_t MQTT_PUBLISH = 0x30;
+const uint8_t MQTT_SUBSCRIBE = 0x82;   // с обязательным флагом 0010
+const uint8_t MQTT_SUBACK = 0x90;
+const uint8_t MQTT_PINGREQ = 0xC0;
+const uint8_t MQTT_PINGRESP = 0xD0;
+const uint8_t MQTT_RETAIN = 0x01;
+
+// Заголовок: тип и до 4 байт длины
+const uint8_t MQTT_HEADER_MAX = 5;
+
+// Описания для Home Assistant, одно сообщение на шаг
+const uint8_t DISCOVERY_STEPS = 3;
+
+MqttControl::MqttControl()
+    : host(nullptr), port(MQTT_PORT), pending(nullptr), state(DISCONNECTED),
+      retryDelay(MQTT_RETRY_MIN), nextAttemptMillis(0), waitStartMillis(0), connecting(nullptr), lastSendMillis(0), lastReceiveMillis(0),
+      pingSent(false), head(0), queued(0), discoveryStep(DISCOVERY_STEPS), rxLength(0), rxSkip(0),
+      onBrightness(255), stateValid(false), statePublished(false) {
+    deviceId[0] = '\0';
+    baseTopic[0] = '\0';
+    memset(lastState, 0, sizeof(lastState));
+    memset(&stats, 0, sizeof(stats));
+}
+
+// host == nullptr или пустая строка - клиент выключен
+void MqttControl::begin(const char* brokerHost, uint16_t brokerPort, const char* id, StateUpdate* pendingUpdate) {
+    host = brokerHost;
+    port = brokerPort;
+    pending = pendingUpdate;
+    strlcpy(deviceId, id, sizeof(deviceId));
+    snprintf(baseTopic, sizeof(baseTopic), "ledclock/%s", deviceId);
+    nextAttemptMillis = millis();
+}
+
+void MqttControl::loop() {
+    if (host == nullptr || host[0] == '\0') return;
+
+    if (state == DISCONNECTED) {
+        if ((int32_t)(millis() - nextAttemptMillis) >= 0) {
+            connect();
+        }
+        return;
+    }
+
+    if (state == RESOLVING) {
+        if (hostIp.isSet()) {
+            state = DISCONNECTED;
+            connect();
+        } else if (millis() - waitStartMillis >= MQTT_RESOLVE_TIMEOUT) {
+            state = DISCONNECTED;
+            retryLater();
+        }
+        return;
+    }
+
+    if (state == CONNECTING) {
+        if (client.connected()) {
+            startSession();
+        } else if (connecting == nullptr || millis() - waitStartMillis >= MQTT_CONNECT_TIMEOUT) {
+            // Отказ или нет ответа: брокер мог сменить адрес, следующая попытка разрешит имя заново
+            abortConnect();
+            hostIp = IPAddress();
+            state = DISCONNECTED;
+            retryLater();
+        }
+        return;
+    }
+
+    if (!client.connected()) {
+        disconnect();
+        return;
+    }
+
+    receive();
+    if (state == DISCONNECTED) return;
+
+    uint32_t now = millis();
+    if (state == WAIT_CONNACK) {
+        if (now - lastReceiveMillis >= MQTT_RESPONSE_TIMEOUT) {
+            disconnect();
+            return;
+        }
+    } else {
+        // Описания и состояние дописываются по мере освобождения буферов
+        if (discoveryStep < DISCOVERY_STEPS) {
+            publishDiscovery();
+        }
+        if (stateValid && !statePublished && discoveryStep >= DISCOVERY_STEPS) {
+            statePublished = sendState();
+        }
+
+        if (pingSent && now - lastReceiveMillis >= MQTT_RESPONSE_TIMEOUT) {
+            disconnect();
+            return;
+        }
+        if (!pingSent && queued == 0 && now - lastSendMillis >= MQTT_KEEPALIVE * 1000UL / 2) {
+            Buffer* buffer = beginMessage();
+            if (buffer != nullptr) {
+                endMessage(buffer, MQTT_PINGREQ);
+                pingSent = true;
+                lastReceiveMillis = now;
+            }
+        }
+    }
+
+    flush();
+}
+
+// Имя брокера разрешается асинхронно и один раз: connect() по имени ждал бы ответа DNS
+// внутри вызова. WiFiClient::connect() по адресу так же ждал бы установки соединения,
+// поэтому его открывает lwIP, а готовность сообщает tcpConnected()
+void MqttControl::connect() {
+    if (!hostIp.isSet()) {
+        // Адрес записывает dnsFound(); для имени в кэше lwIP или IP в виде строки - сразу
+        ip_addr_t address;
+        err_t result = dns_gethostbyname(host, &address, dnsFound, this);
+        if (result == ERR_INPROGRESS) {
+            state = RESOLVING;
+            waitStartMillis = millis();
+            return;
+        }
+        if (result != ERR_OK) {
+            retryLater();
+            return;
+        }
+        hostIp = IPAddress(&address);
+    }
+
+    client.stop();
+    connecting = tcp_new();
+    if (connecting == nullptr) {
+        retryLater();
+        return;
+    }
+    tcp_arg(connecting, this);
+    tcp_err(connecting, tcpError);
+    ip_addr_t address = hostIp;
+    if (tcp_connect(connecting, &address, port, tcpConnected) != ERR_OK) {
+        abortConnect();
+        hostIp = IPAddress();
+        retryLater();
+        return;
+    }
+    state = CONNECTING;
+    waitStartMillis = millis();
+}
+
+// Конструктор WiFiClient из готового соединения ядро открывает только наследникам
+struct ConnectedClient : WiFiClient {
+    ConnectedClient(ClientContext* context) : WiFiClient(context) {}
+};
+
+// Вызывается lwIP между вызовами loop(): соединением дальше владеет WiFiClient
+err_t MqttControl::tcpConnected(void* arg, tcp_pcb* pcb, err_t err) {
+    MqttControl* mqtt = (MqttControl*)arg;
+    mqtt->connecting = nullptr;
+    mqtt->client = ConnectedClient(new ClientContext(pcb, nullptr, nullptr));
+    return ERR_OK;
+}
+
+// Отказ в соединении: lwIP уже освободил блок
+void MqttControl::tcpError(void* arg, err_t err) {
+    ((MqttControl*)arg)->connecting = nullptr;
+}
+
+void MqttControl::abortConnect() {
+    if (connecting == nullptr) return;
+    tcp_err(connecting, nullptr);
+    tcp_abort(connecting);
+    connecting = nullptr;
+}
+
+void MqttControl::startSession() {
+    client.setNoDelay(true);
+
+    head = 0;
+    queued = 0;
+    rxLength = 0;
+    rxSkip = 0;
+    pingSent = false;
+
+    // CONNECT: чистая сессия, завещание "offline" в /status с сохранением
+    char willTopic[MQTT_TOPIC_SIZE];
+    snprintf(willTopic, sizeof(willTopic), "%s/status", baseTopic);
+    Buffer* buffer = beginMessage();
+    static const uint8_t protocol[] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+    uint8_t flags = 0x02 | 0x04 | 0x20;    // clean session, will, will retain
+    uint8_t keepalive[2] = {(uint8_t)(MQTT_KEEPALIVE >> 8), (uint8_t)MQTT_KEEPALIVE};
+    writeBytes(buffer, protocol, sizeof(protocol));
+    writeBytes(buffer, &flags, 1);
+    writeBytes(buffer, keepalive, 2);
+    writeString(buffer, deviceId);
+    writeString(buffer, willTopic);
+    writeString(buffer, "offline");
+    endMessage(buffer, MQTT_CONNECT);
+
+    state = WAIT_CONNACK;
+    lastReceiveMillis = millis();
+    flush();
+}
+
+void MqttControl::dnsFound(const char* name, const ip_addr_t* address, void* arg) {
+    MqttControl* mqtt = (MqttControl*)arg;
+    if (address == nullptr || mqtt->host == nullptr || strcmp(mqtt->host, name) != 0) return;
+    mqtt->hostIp = IPAddress(address);
+}
+
+void MqttControl::disconnect() {
+    if (state != DISCONNECTED) {
+        stats.disconnects++;
+    }
+    client.stop();
+    state = DISCONNECTED;
+    head = 0;
+    queued = 0;
+    retryLater();
+}
+
+// Паузы между попытками растут вдвое до MQTT_RETRY_MAX
+void MqttControl::retryLater() {
+    nextAttemptMillis = millis() + retryDelay;
+    retryDelay = retryDelay * 2 < MQTT_RETRY_MAX ? retryDelay * 2 : MQTT_RETRY_MAX;
+}
+
+// Отправка очереди без ожидания: пишем столько, сколько помещается в окно TCP
+void MqttControl::flush() {
+    while (queued > 0) {
+        Buffer& buffer = pool[head];
+        size_t room = client.availableForWrite();
+        if (room == 0) return;
+        uint16_t left = buffer.end - buffer.start;
+        size_t written = client.write(buffer.data + buffer.start, left < room ? left : room);
+        if (written == 0) return;
+        buffer.start += written;
+        lastSendMillis = millis();
+        if (buffer.start < buffer.end) return;
+        head = (head + 1) % MQTT_POOL_SIZE;
+        queued--;
+    }
+}
+
+// Входящие пакеты собираются в rx; слишком длинные пропускаются без разбора
+void MqttControl::receive() {
+    while (client.available() > 0 && state != DISCONNECTED) {
+        if (rxSkip > 0) {
+            uint8_t scratch[32];
+            size_t chunk = rxSkip < sizeof(scratch) ? rxSkip : sizeof(scratch);
+            int got = client.read(scratch, chunk);
+            if (got <= 0) return;
+            rxSkip -= got;
+            continue;
+        }
+
+        int got = client.read(rx + rxLength, sizeof(rx) - rxLength);
+        if (got <= 0) return;
+        rxLength += got;
+
+        // Разбор всех полностью принятых пакетов
+        while (rxLength >= 2) {
+            uint32_t remaining = 0;
+            uint8_t lengthBytes = 0;
+            bool complete = false;
+            for(uint8_t i = 1; i < rxLength && i <= 4; i++) {
+                remaining |= (uint32_t)(rx[i] & 0x7F) << (7 * (i - 1));
+                lengthBytes = i;
+                if ((rx[i] & 0x80) == 0) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete) {
+                if (lengthBytes >= 4) {
+                    disconnect();
+                    return;
+                }
+                break;
+            }
+
+            uint16_t headerLength = 1 + lengthBytes;
+            if (headerLength + remaining > sizeof(rx)) {
+                // Пакет не помещается в буфер: отбрасываем его остаток
+                stats.skipped++;
+                rxSkip = headerLength + remaining - rxLength;
+                rxLength = 0;
+                break;
+            }
+            if (rxLength < headerLength + remaining) break;
+
+            lastReceiveMillis = millis();
+            handlePacket(rx[0], rx + headerLength, remaining);
+            if (state == DISCONNECTED) return;
+
+            uint16_t used = headerLength + remaining;
+            memmove(rx, rx + used, rxLength - used);
+            rxLength -= used;
+        }
+    }
+}
+
+void MqttControl::handlePacket(uint8_t type, const uint8_t* body, uint16_t length) {
+    switch (type & 0xF0) {
+        case MQTT_CONNACK: {
+            if (length != 2 || body[1] != 0) {
+                disconnect();
+                return;
+            }
+            state = CONNECTED;
+            retryDelay = MQTT_RETRY_MIN;
+            stats.connects++;
+
+            // Подписка на команды и объявление о готовности
+            char topic[MQTT_TOPIC_SIZE];
+            snprintf(topic, sizeof(topic), "%s/set", baseTopic);
+            Buffer* buffer = beginMessage();
+            if (buffer == nullptr) {
+                disconnect();
+                return;
+            }
+            static const uint8_t packetId[] = {0, 1};
+            static const uint8_t qos = 0;
+            writeBytes(buffer, packetId, sizeof(packetId));
+            writeString(buffer, topic);
+            writeBytes(buffer, &qos, 1);
+            endMessage(buffer, MQTT_SUBSCRIBE);
+
+            snprintf(topic, sizeof(topic), "%s/status", baseTopic);
+            publish(topic, "online", 6, true);
+
+            discoveryStep = 0;
+            statePublished = false;
+            return;
+        }
+        case MQTT_PUBLISH: {
+            if (length < 2) break;
+            uint16_t topicLength = ((uint16_t)body[0] << 8) | body[1];
+            uint16_t offset = 2 + topicLength;
+            if ((type & 0x06) != 0) offset += 2;   // идентификатор пакета для QoS 1 и 2
+            if (offset > length) break;
+            handleCommand((const char*)body + offset, length - offset);
+            return;
+        }
+        case MQTT_SUBACK:
+            return;
+        case MQTT_PINGRESP:
+            pingSent = false;
+            return;
+        default:
+            return;
+    }
+    stats.invalid++;
+}
+
+// Команда в формате JSON схемы света Home Assistant:
+// {"state": "ON", "brightness": 128, "color": {"r": 255, "g": 0, "b": 0}, "effect": "rainbow"}
+void MqttControl::handleCommand(const char* payload, uint16_t length) {
+    StaticJsonDocument<256> doc;
+    if (deserializeJson(doc, payload, length) != DeserializationError::Ok || !doc.is<JsonObject>()) {
+        stats.invalid++;
+        return;
+    }
+
+    // Команда применяется целиком или не применяется
+    StateUpdate update = *pending;
+    JsonVariantConst color = doc["color"];
+    if (!color.isNull()) {
+        int red = color["r"] | -1;
+        int green = color["g"] | -1;
+        int blue = color["b"] | -1;
+        if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 || blue > 255) {
+            stats.invalid++;
+            return;
+        }
+        update.red = red;
+        update.green = green;
+        update.blue = blue;
+        update.fields |= UPDATE_COLOR;
+    }
+
+    JsonVariantConst brightness = doc["brightness"];
+    if (!brightness.isNull()) {
+        if (!brightness.is<int>() || brightness.as<int>() < 0 || brightness.as<int>() > 255) {
+            stats.invalid++;
+            return;
+        }
+        update.brightness = brightness.as<int>();
+        update.fields |= UPDATE_BRIGHTNESS;
+    }
+
+    // Выключение - нулевая яркость, включение без яркости возвращает яркость до выключения
+    const char* power = doc["state"];
+    if (power != nullptr && brightness.isNull()) {
+        if (strcmp(power, "OFF") == 0) {
+            update.brightness = 0;
+            update.fields |= UPDATE_BRIGHTNESS;
+        } else if (strcmp(power, "ON") == 0 && stateValid && lastState[4] == 0) {
+            update.brightness = onBrightness;
+            update.fields |= UPDATE_BRIGHTNESS;
+        }
+    }
+
+    const char* effect = doc["effect"];
+    if (effect != nullptr) {
+        int found = -1;
+        for(uint8_t i = 0; i < EFFECT_COUNT; i++) {
+            if (strcmp(effect, effectName((Effect)i)) == 0) {
+                found = i;
+                break;
+            }
+        }
+        if (found < 0) {
+            stats.invalid++;
+            return;
+        }
+        update.effect = (Effect)found;
+        update.fields |= UPDATE_EFFECT;
+    }
+
+    *pending = update;
+    stats.received++;
+}
+
+void MqttControl::publishState(const StateUpdate& current) {
+    uint8_t snapshot[6] = {
+        1, current.red, current.green, current.blue, current.brightness, (uint8_t)current.effect
+    };
+    if (stateValid && memcmp(snapshot, lastState, sizeof(snapshot)) == 0) return;
+    memcpy(lastState, snapshot, sizeof(snapshot));
+    if (current.brightness > 0) {
+        onBrightness = current.brightness;
+    }
+    stateValid = true;
+    statePublished = false;
+    if (state == CONNECTED && discoveryStep >= DISCOVERY_STEPS) {
+        statePublished = sendState();
+    }
+}
+
+bool MqttControl::sendState() {
+    StaticJsonDocument<192> doc;
+    doc["state"] = lastState[4] > 0 ? "ON" : "OFF";
+    doc["brightness"] = lastState[4];
+    doc["color_mode"] = "rgb";
+    JsonObject color = doc.createNestedObject("color");
+    color["r"] = lastState[1];
+    color["g"] = lastState[2];
+    color["b"] = lastState[3];
+    doc["effect"] = effectName((Effect)lastState[5]);
+
+    char payload[160];
+    size_t length = serializeJson(doc, payload, sizeof(payload));
+    char topic[MQTT_TOPIC_SIZE];
+    snprintf(topic, sizeof(topic), "%s/state", baseTopic);
+    return publish(topic, payload, length, true);
+}
+
+bool MqttControl::publishMetrics(const char* json) {
+    if (state != CONNECTED) return false;
+    char topic[MQTT_TOPIC_SIZE];
+    snprintf(topic, sizeof(topic), "%s/metrics", baseTopic);
+    return publish(topic, json, strlen(json), true);
+}
+
+// Описания собираются один раз после подключения: свет и два датчика из метрик
+void MqttControl::publishDiscovery() {
+    while (discoveryStep < DISCOVERY_STEPS && queued < MQTT_POOL_SIZE) {
+        char topic[64];
+        char payload[MQTT_BUFFER_SIZE - 80];
+        int length = 0;
+        char deviceJson[128];
+        snprintf(deviceJson, sizeof(deviceJson),
+            "\"dev\":{\"ids\":[\"%s\"],\"name\":\"LED Clock %s\",\"mf\":\"q7c\",\"mdl\":\"ESP8266 LED clock\"}",
+            deviceId, deviceId);
+
+        switch (discoveryStep) {
+            case 0: {
+                char effects[96];
+                size_t used = 0;
+                for(uint8_t i = 0; i < EFFECT_COUNT; i++) {
+                    used += snprintf(effects + used, sizeof(effects) - used, "%s\"%s\"", i ? "," : "", effectName((Effect)i));
+                }
+                snprintf(topic, sizeof(topic), "homeassistant/light/%s/config", deviceId);
+                length = snprintf(payload, sizeof(payload),
+                    "{\"name\":\"LED Clock\",\"uniq_id\":\"%s_light\",\"schema\":\"json\","
+                    "\"cmd_t\":\"%s/set\",\"stat_t\":\"%s/state\",\"avty_t\":\"%s/status\","
+                    "\"brightness\":true,\"supported_color_modes\":[\"rgb\"],"
+                    "\"effect\":true,\"effect_list\":[%s],%s}",
+                    deviceId, baseTopic, baseTopic, baseTopic, effects, deviceJson);
+                break;
+            }
+            case 1:
+                snprintf(topic, sizeof(topic), "homeassistant/sensor/%s_current/config", deviceId);
+                length = snprintf(payload, sizeof(payload),
+                    "{\"name\":\"LED Clock current\",\"uniq_id\":\"%s_current\",\"stat_t\":\"%s/metrics\","
+                    "\"avty_t\":\"%s/status\",\"val_tpl\":\"{{ value_json.current_ma }}\","
+                    "\"unit_of_meas\":\"mA\",\"dev_cla\":\"current\",%s}",
+                    deviceId, baseTopic, baseTopic, deviceJson);
+                break;
+            default:
+                snprintf(topic, sizeof(topic), "homeassistant/sensor/%s_rssi/config", deviceId);
+                length = snprintf(payload, sizeof(payload),
+                    "{\"name\":\"LED Clock signal\",\"uniq_id\":\"%s_rssi\",\"stat_t\":\"%s/metrics\","
+                    "\"avty_t\":\"%s/status\",\"val_tpl\":\"{{ value_json.rssi }}\","
+                    "\"unit_of_meas\":\"dBm\",\"dev_cla\":\"signal_strength\",\"ent_cat\":\"diagnostic\",%s}",
+                    deviceId, baseTopic, baseTopic, deviceJson);
+                break;
+        }
+
+        if (length <= 0 || length >= (int)sizeof(payload) || !publish(topic, payload, length, true)) return;
+        discoveryStep++;
+    }
+}
+
+MqttControl::Buffer* MqttControl::beginMessage() {
+    if (queued >= MQTT_POOL_SIZE) {
+        stats.dropped++;
+        return nullptr;
+    }
+    Buffer* buffer = &pool[(head + queued) % MQTT_POOL_SIZE];
+    buffer->start = MQTT_HEADER_MAX;
+    buffer->end = MQTT_HEADER_MAX;
+    return buffer;
+}
+
+// Заголовок с длиной переменной длины пишется вплотную перед телом
+void MqttControl::endMessage(Buffer* buffer, uint8_t type) {
+    uint16_t remaining = buffer->end - MQTT_HEADER_MAX;
+    uint8_t lengthBytes[4];
+    uint8_t count = 0;
+    do {
+        uint8_t digit = remaining & 0x7F;
+        remaining >>= 7;
+        lengthBytes[count++] = digit | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+
+    buffer->start = MQTT_HEADER_MAX - 1 - count;
+    buffer->data[buffer->start] = type;
+    memcpy(buffer->data + buffer->start + 1, lengthBytes, count);
+    queued++;
+}
+
+bool MqttControl::writeBytes(Buffer* buffer, const void* data, uint16_t length) {
+    if (buffer->end + length > MQTT_BUFFER_SIZE) return false;
+    memcpy(buffer->data + buffer->end, data, length);
+    buffer->end += length;
+    return true;
+}
+
+// Строка MQTT: длина u16 и байты без завершающего нуля
+bool MqttControl::writeString(Buffer* buffer, const char* text) {
+    uint16_t length = strlen(text);
+    uint8_t prefix[2] = {(uint8_t)(length >> 8), (uint8_t)length};
+    return writeBytes(buffer, prefix, 2) && writeBytes(buffer, text, length);
+}
+
+bool MqttControl::publish(const char* topic, const char* payload, uint16_t length, bool retain) {
+    Buffer* buffer = beginMessage();
+    if (buffer == nullptr) return false;
+    if (!writeString(buffer, topic) || !writeBytes(buffer, payload, length)) {
+        stats.dropped++;
+        return false;
+    }
+    endMessage(buffer, MQTT_PUBLISH | (retain ? MQTT_RETAIN : 0));
+    stats.published++;
+    return true;
+}
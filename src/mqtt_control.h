@@ -0,0 +1,126 @@
+#ifndef MQTT_CONTROL_H
+#define MQTT_CONTROL_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+#include <lwip/tcp.h>
+#include "clock_state.h"
+
+// Параметры MQTT клиента (протокол 3.1.1, QoS 0)
+const uint16_t MQTT_PORT = 1883;
+const uint16_t MQTT_KEEPALIVE = 30;              // с
+const uint32_t MQTT_CONNECT_TIMEOUT = 3000;      // ожидание TCP соединения по адресу, мс
+const uint32_t MQTT_RESOLVE_TIMEOUT = 5000;      // ожидание ответа DNS на имя брокера, мс
+const uint32_t MQTT_RESPONSE_TIMEOUT = 5000;     // ожидание CONNACK и PINGRESP, мс
+const uint32_t MQTT_RETRY_MIN = 2000;            // первая пауза перед переподключением, мс
+const uint32_t MQTT_RETRY_MAX = 60000;
+const uint8_t MQTT_POOL_SIZE = 4;                // исходящих сообщений в очереди
+const uint16_t MQTT_BUFFER_SIZE = 640;           // самое длинное сообщение - описание для Home Assistant
+const uint16_t MQTT_RX_SIZE = 256;               // входящие сообщения длиннее пропускаются
+const uint8_t MQTT_ID_SIZE = 16;
+// Базовый топик ledclock/<id> и топик с самым длинным суффиксом, /metrics
+const uint8_t MQTT_BASE_TOPIC_SIZE = sizeof("ledclock/") - 1 + MQTT_ID_SIZE;
+const uint8_t MQTT_TOPIC_SIZE = MQTT_BASE_TOPIC_SIZE - 1 + sizeof("/metrics");
+
+// Статистика клиента
+struct MqttStats {
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t received;       // команды
+    uint32_t invalid;        // команды с ошибкой
+    uint32_t skipped;        // входящие пакеты длиннее буфера
+    uint32_t published;
+    uint32_t dropped;        // сообщения, не поместившиеся в очередь
+};
+
+// Постоянное соединение с брокером вместо отдельного HTTP запроса на каждую команду.
+// Команды, как и у LiveControl, только накапливаются в ожидающем изменении.
+// Исходящие сообщения собираются в буферы фиксированного пула и отправляются
+// порциями по мере освобождения окна TCP, без выделения памяти на сообщение.
+//
+// Топики: ledclock/<id>/set (команды), /state (состояние), /status (online/offline), /metrics
+class MqttControl {
+public:
+    MqttControl();
+    void begin(const char* host, uint16_t port, const char* deviceId, StateUpdate* pending);
+    void loop();
+    bool isConnected() const { return state == CONNECTED; }
+
+    // Сохраняемое брокером состояние, отправляется только при изменении
+    void publishState(const StateUpdate& state);
+    // Метрики JSON документом в топик /metrics
+    bool publishMetrics(const char* json);
+    uint8_t getQueued() const { return queued; }
+    const MqttStats& getStats() const { return stats; }
+
+private:
+    enum State {
+        DISCONNECTED,
+        RESOLVING,           // ждем ответа DNS, loop() не блокируется
+        CONNECTING,          // ждем установки TCP соединения, тоже без блокировки
+        WAIT_CONNACK,
+        CONNECTED
+    };
+
+    // Буфер исходящего сообщения: заголовок пишется перед телом, когда длина уже известна
+    struct Buffer {
+        uint8_t data[MQTT_BUFFER_SIZE];
+        uint16_t start;
+        uint16_t end;
+    };
+
+    WiFiClient client;
+    const char* host;
+    IPAddress hostIp;        // разрешается один раз, сбрасывается при неудачном соединении
+    uint16_t port;
+    char deviceId[MQTT_ID_SIZE];
+    char baseTopic[MQTT_BASE_TOPIC_SIZE];
+    StateUpdate* pending;
+    State state;
+    uint32_t retryDelay;
+    uint32_t nextAttemptMillis;
+    uint32_t waitStartMillis;     // начало ожидания DNS или TCP соединения
+    tcp_pcb* connecting;             // соединение, которое еще устанавливает lwIP
+    uint32_t lastSendMillis;
+    uint32_t lastReceiveMillis;
+    bool pingSent;
+
+    Buffer pool[MQTT_POOL_SIZE];
+    uint8_t head;            // первое неотправленное сообщение
+    uint8_t queued;
+    uint8_t discoveryStep;   // следующее описание для Home Assistant
+
+    uint8_t rx[MQTT_RX_SIZE];
+    uint16_t rxLength;
+    uint32_t rxSkip;         // оставшиеся байты пропускаемого пакета
+
+    uint8_t lastState[6];
+    uint8_t onBrightness;    // последняя ненулевая яркость, ее возвращает "state": "ON"
+    bool stateValid;
+    bool statePublished;
+    MqttStats stats;
+
+    void connect();
+    void disconnect();
+    void retryLater();
+    void startSession();
+    void abortConnect();
+    static void dnsFound(const char* name, const ip_addr_t* address, void* arg);
+    static err_t tcpConnected(void* arg, tcp_pcb* pcb, err_t err);
+    static void tcpError(void* arg, err_t err);
+    void flush();
+    void receive();
+    void handlePacket(uint8_t type, const uint8_t* body, uint16_t length);
+    void handleCommand(const char* payload, uint16_t length);
+    void publishDiscovery();
+    bool sendState();
+
+    Buffer* beginMessage();
+    void endMessage(Buffer* buffer, uint8_t type);
+    bool writeBytes(Buffer* buffer, const void* data, uint16_t length);
+    bool writeString(Buffer* buffer, const char* text);
+    bool publish(const char* topic, const char* payload, uint16_t length, bool retain);
+};
+
+#endif
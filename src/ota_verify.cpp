@@ -0,0 +1,13 @@
+#include "ota_verify.h"
+
+static BearSSL::HashSHA256 otaHash;
+static OtaVerifier otaVerifier;
+
+bool OtaVerifier::verify(UpdaterHashClass* hash, const void* signature, uint32_t signatureLength) {
+    if (signatureLength != OTA_HASH_SIZE || hash->len() != OTA_HASH_SIZE) return false;
+    return memcmp(hash->hash(), signature, OTA_HASH_SIZE) == 0;
+}
+
+void otaVerifyBegin() {
+    Update.installSignature(&otaHash, &otaVerifier);
+}
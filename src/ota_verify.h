@@ -0,0 +1,24 @@
+#ifndef OTA_VERIFY_H
+#define OTA_VERIFY_H
+
+#include <Arduino.h>
+#include <BearSSLHelpers.h>
+
+// Проверка образа прошивки перед переключением раздела.
+// В конец образа (обычно .bin.gz) дописаны SHA-256 всего, что до него, и длина хеша u32:
+//   [образ][SHA-256, 32 байта][32 u32 little-endian]
+// Updater сам читает хвост, считает хеш записанного во flash и вызывает verify().
+// Проверка общая для /update и ArduinoOTA и включается флагом сборки OTA_REQUIRE_HASH
+// (env:esp8266-signed): тогда образ без хеша не принимается, в том числе от espota и pio.
+const uint8_t OTA_HASH_SIZE = 32;
+
+class OtaVerifier : public UpdaterVerifyClass {
+public:
+    uint32_t length() override { return OTA_HASH_SIZE; }
+    bool verify(UpdaterHashClass* hash, const void* signature, uint32_t signatureLength) override;
+};
+
+// Подключение проверки к Update
+void otaVerifyBegin();
+
+#endif
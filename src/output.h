@@ -0,0 +1,93 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <Arduino.h>
+
+// Положение каналов пикселя в буфере ленты, WHITE < 0 - белого канала нет
+template<uint8_t R, uint8_t G, uint8_t B, int8_t W>
+struct ChannelOrder {
+    static const uint8_t RED = R;
+    static const uint8_t GREEN = G;
+    static const uint8_t BLUE = B;
+    static const int8_t WHITE = W;
+    static const uint8_t SIZE = W < 0 ? 3 : 4;
+};
+
+// Лента часов подключена через NeoRgbwFeature, но провода идут в порядке G, R, B, W
+typedef ChannelOrder<1, 0, 2, 3> GrbwOrder;
+typedef ChannelOrder<1, 0, 2, -1> GrbOrder;
+typedef GrbwOrder StripOrder;
+
+// Канал кадра в формате 8.8: старший байт - значение на проводе, младший - дробная часть.
+// 8-битный цвет переводится сдвигом без остатка, дизеринг нужен только для дробных яркостей.
+const uint32_t CHANNEL_FULL = 0xFF00;
+
+// Модель потребления ленты: ток канала линейно зависит от его значения
+const uint16_t POWER_CHANNEL_MA = 20;      // ток одного канала на полной яркости, мА
+const uint16_t POWER_PIXEL_IDLE_MA = 1;    // ток погашенного пикселя, мА
+const uint16_t POWER_BOARD_MA = 80;        // ESP8266 с WiFi, мА
+const uint16_t POWER_BUDGET_MA = 1800;     // запас под блок питания USB на 2 А
+const uint16_t POWER_SCALE_FULL = 256;     // множитель кадра без ограничения
+
+// Минимум без условного перехода
+inline int32_t minBranchless(int32_t a, int32_t b) {
+    int32_t d = a - b;
+    return b + (d & (d >> 31));
+}
+
+// Выходной каскад: кадр в линейном RGB -> буфер ленты в ее порядке каналов.
+// Порядок каналов известен при компиляции, ветка белого канала выбрасывается для RGB лент.
+template<class Order>
+struct OutputStage {
+    // Доля белого 0..254 -> множитель 0..256 из 256: при 0 белый не горит вовсе
+    // и дизеринга белого канала нет, при 254 в белый уходит вся общая часть
+    static int32_t whiteScale(uint8_t whiteRatio) {
+        return ((int32_t)whiteRatio * 1033) >> 10;
+    }
+
+    // Сумма 16-битных значений каналов пикселя на проводе - нагрузка в ступенях POWER_CHANNEL_MA / CHANNEL_FULL
+    static uint32_t load(uint16_t red, uint16_t green, uint16_t blue, uint8_t whiteRatio) {
+        uint32_t sum = (uint32_t)red + green + blue;
+        if constexpr (Order::WHITE >= 0) {
+            // Белый светодиод заменяет три цветных: минус 3 * white, плюс сам white
+            int32_t white = (minBranchless(minBranchless(red, green), blue) * whiteScale(whiteRatio)) >> 8;
+            sum -= 2 * white;
+        }
+        return sum;
+    }
+
+    // Квантование 8.8 -> 8 бит с переносом ошибки в следующий кадр.
+    // Младший байт значения копится в error, при переполнении канал горит на ступень ярче.
+    static uint8_t quantize(int32_t value, uint8_t& error, uint32_t& fraction) {
+        int32_t sum = (value & 0xFF) + error;
+        error = sum;
+        fraction |= value & 0xFF;
+        return minBranchless((value >> 8) + (sum >> 8), 255);
+    }
+
+    // whiteRatio: доля общей части R, G, B, которая переносится в белый светодиод (0 - не переносится, 254 - вся)
+    // scale: общий множитель кадра, POWER_SCALE_FULL - без изменений
+    // error: по байту ошибки на канал ленты. Возвращает true, если дизеринг нужен и в следующих кадрах.
+    static bool convert(const uint16_t* rgb, uint8_t* out, uint8_t* error, uint16_t count, uint8_t whiteRatio, uint16_t scale) {
+        int32_t ratio = whiteScale(whiteRatio);
+        uint32_t fraction = 0;
+        for(uint16_t i = 0; i < count; i++, rgb += 3, out += Order::SIZE, error += Order::SIZE) {
+            int32_t red = rgb[0];
+            int32_t green = rgb[1];
+            int32_t blue = rgb[2];
+            if constexpr (Order::WHITE >= 0) {
+                int32_t white = (minBranchless(minBranchless(red, green), blue) * ratio) >> 8;
+                red -= white;
+                green -= white;
+                blue -= white;
+                out[Order::WHITE] = quantize((white * scale) >> 8, error[Order::WHITE], fraction);
+            }
+            out[Order::RED] = quantize((red * scale) >> 8, error[Order::RED], fraction);
+            out[Order::GREEN] = quantize((green * scale) >> 8, error[Order::GREEN], fraction);
+            out[Order::BLUE] = quantize((blue * scale) >> 8, error[Order::BLUE], fraction);
+        }
+        return fraction != 0;
+    }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "phase_sync.h"
+#include <ESP8266WiFi.h>
+
+// Группа в диапазоне адресов локальной области, пакеты не выходят за маршрутизатор
+static const IPAddress SYNC_GROUP(239, 255, 76, 67);
+
+static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeLe32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+PhaseSync::PhaseSync(SyncClock clock)
+    : clock(clock), started(false), nodeId(0), role(SYNC_FOLLOWER), locked(false),
+      offset(0), pending(0), slewCredit(0), lastTickMillis(0), lastLeaderMillis(0), lastAnnounceMillis(0),
+      sequence(0), localEffect(0), phaseStart(0), phasePending(0), phaseShift(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+// nodeId - номер узла, при выборах побеждает меньший
+void PhaseSync::begin(uint32_t id, IPAddress localIp) {
+    nodeId = id;
+    role = SYNC_FOLLOWER;
+    lastTickMillis = clock();
+    lastLeaderMillis = lastTickMillis;
+    udp.beginMulticast(localIp, SYNC_GROUP, SYNC_PORT);
+    started = true;
+}
+
+uint32_t PhaseSync::now() const {
+    return clock() + offset;
+}
+
+// Подстройка относится к прежнему эффекту, у нового свое начало
+void PhaseSync::setEffect(uint8_t effect) {
+    if (effect == localEffect) return;
+    localEffect = effect;
+    phasePending = 0;
+    phaseShift = 0;
+    stats.phasePendingMs = 0;
+}
+
+int32_t PhaseSync::takePhaseShift() {
+    int32_t shift = phaseShift;
+    phaseShift = 0;
+    return shift;
+}
+
+void PhaseSync::loop() {
+    if (!started) return;
+
+    uint8_t packet[SYNC_PACKET_SIZE];
+    int size;
+    while ((size = udp.parsePacket()) > 0) {
+        if (size == SYNC_PACKET_SIZE && udp.read(packet, sizeof(packet)) == SYNC_PACKET_SIZE) {
+            receive(packet, size);
+        } else {
+            udp.flush();
+        }
+    }
+
+    tick();
+
+    if (announceDue()) {
+        size_t length = makeAnnounce(packet);
+        udp.beginPacketMulticast(SYNC_GROUP, SYNC_PORT, WiFi.localIP());
+        udp.write(packet, length);
+        udp.endPacket();
+    }
+}
+
+// Плавная подстройка и выборы ведущего
+void PhaseSync::tick() {
+    uint32_t current = clock();
+    uint32_t elapsed = current - lastTickMillis;
+    lastTickMillis = current;
+
+    // За elapsed мс шкала и начало эффекта сдвигаются не больше чем на 5% от elapsed,
+    // поэтому фазы не прыгают. Доли миллисекунды копятся до следующего вызова:
+    // округление вверх при частых вызовах разрешило бы сдвиг в 100%
+    slewCredit += elapsed * SYNC_SLEW_PERMILLE;
+    int32_t maxSlew = slewCredit / 1000;
+    slewCredit %= 1000;
+    if (pending == 0 && phasePending == 0) slewCredit = 0;
+    if (pending != 0) {
+        int32_t slew = pending;
+        if (slew > maxSlew) slew = maxSlew;
+        if (slew < -maxSlew) slew = -maxSlew;
+        offset += slew;
+        pending -= slew;
+    }
+    stats.pendingMs = pending;
+    if (phasePending != 0) {
+        int32_t slew = phasePending;
+        if (slew > maxSlew) slew = maxSlew;
+        if (slew < -maxSlew) slew = -maxSlew;
+        phaseShift += slew;
+        phasePending -= slew;
+    }
+    stats.phasePendingMs = phasePending;
+
+    // Ведущий пропал: ожидание растет вместе с номером (ESP.getChipId() - 24 бита),
+    // поэтому первым обычно просыпается меньший номер. Если раньше стал ведущим
+    // больший, меньший заберет роль по первому его пакету (см. receive)
+    if (role == SYNC_FOLLOWER) {
+        uint32_t wait = SYNC_LEADER_TIMEOUT + (uint32_t)(((uint64_t)(nodeId & 0xFFFFFF) * SYNC_ELECTION_SPREAD) >> 24);
+        if (current - lastLeaderMillis >= wait) {
+            becomeLeader();
+        }
+    }
+}
+
+bool PhaseSync::announceDue() const {
+    return role == SYNC_LEADER && clock() - lastAnnounceMillis >= SYNC_INTERVAL;
+}
+
+size_t PhaseSync::makeAnnounce(uint8_t* buffer) {
+    lastAnnounceMillis = clock();
+    memcpy(buffer, "LCS1", 4);
+    writeLe32(buffer + 4, nodeId);
+    buffer[8] = sequence;
+    buffer[9] = sequence >> 8;
+    writeLe32(buffer + 10, now());
+    buffer[14] = localEffect;
+    buffer[15] = (now() - phaseStart - phaseShift) / SYNC_PHASE_STEP;
+    sequence++;
+    stats.sent++;
+    return SYNC_PACKET_SIZE;
+}
+
+bool PhaseSync::receive(const uint8_t* packet, size_t length) {
+    if (length != SYNC_PACKET_SIZE || memcmp(packet, "LCS1", 4) != 0) return false;
+    uint32_t senderId = readLe32(packet + 4);
+    if (senderId == nodeId) return false;  // собственный пакет из группы
+    stats.received++;
+
+    uint32_t leaderTime = readLe32(packet + 10);
+    if (role == SYNC_LEADER) {
+        // Два ведущих после выборов: остается узел с меньшим номером
+        if (senderId > nodeId) return true;
+        role = SYNC_FOLLOWER;
+    } else if (stats.leaderId != 0 && senderId > stats.leaderId &&
+               clock() - lastLeaderMillis < SYNC_LEADER_TIMEOUT) {
+        // Пока живой ведущий с меньшим номером, второй ведущий игнорируется
+        return true;
+    }
+    follow(senderId, leaderTime, packet[14], packet[15]);
+
+    // Ведущий с большим номером: сначала перенимаем его шкалу, затем роль, так что
+    // смена ведущего никому не сдвигает фазу. Прежний ведущий уступит по нашему пакету
+    if (senderId > nodeId) {
+        becomeLeader();
+    }
+    return true;
+}
+
+void PhaseSync::becomeLeader() {
+    // Своя шкала продолжается без скачка, ведомые подстроятся к ней
+    role = SYNC_LEADER;
+    locked = true;
+    stats.leaderId = nodeId;
+    stats.elections++;
+    lastAnnounceMillis = clock() - SYNC_INTERVAL;
+}
+
+// Задержка доставки в локальной сети - единицы мс, поэтому смещение берется по одному пакету
+void PhaseSync::follow(uint32_t leaderId, uint32_t leaderTime, uint8_t effect, uint8_t phase) {
+    if (leaderId != stats.leaderId) {
+        stats.jitterMs = 0;
+    }
+    stats.leaderId = leaderId;
+    lastLeaderMillis = clock();
+
+    int32_t difference = leaderTime - now();
+    stats.offsetMs = difference;
+
+    if (!locked || difference > SYNC_STEP_THRESHOLD || difference < -SYNC_STEP_THRESHOLD) {
+        // Первая привязка или потеря синхронизации: одна перестановка вместо долгой подстройки
+        offset += difference;
+        pending = 0;
+        locked = true;
+        stats.steps++;
+    } else {
+        // Отклонение от ожидаемого: при ровных часах остаток подстройки совпадает с новым измерением
+        int32_t error = difference - pending;
+        uint32_t deviation = error < 0 ? -error : error;
+        stats.jitterMs = (stats.jitterMs * 15 + deviation) / 16;
+        pending = difference;
+    }
+
+    if (effect != localEffect) {
+        phasePending = 0;
+        return;
+    }
+    // Фаза в пакете округлена вниз до шага, начало эффекта у ведущего берется по середине шага.
+    // Обе величины - отметки общей шкалы, к которой уже подстраивается offset
+    uint32_t leaderStart = leaderTime - phase * SYNC_PHASE_STEP - SYNC_PHASE_STEP / 2;
+    int32_t error = leaderStart - (phaseStart + phaseShift);
+    // Фаза в пакете повторяется через 256 шагов, берется ближайшее из совпадающих начал
+    const int32_t period = 256 * SYNC_PHASE_STEP;
+    error %= period;
+    if (error >= period / 2) error -= period;
+    if (error < -period / 2) error += period;
+    stats.phaseError = error / (int32_t)SYNC_PHASE_STEP;
+    // Расхождение в пределах округления фазы не подстраивается
+    phasePending = error > (int32_t)SYNC_PHASE_STEP / 2 || error < -(int32_t)SYNC_PHASE_STEP / 2 ? error : 0;
+}
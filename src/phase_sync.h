@@ -0,0 +1,92 @@
+#ifndef PHASE_SYNC_H
+#define PHASE_SYNC_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+// Синхронизация фазы эффектов и мигания разделителя между часами в одной сети.
+// Ведущий рассылает свою шкалу времени, ведомые плавно подстраивают к ней свою.
+// При том же эффекте ведомый так же плавно сдвигает начало эффекта к началу у ведущего.
+//
+// Пакет (16 байт, little-endian): "LCS1", nodeId u32, sequence u16, time u32, effect u8, phase u8
+const uint16_t SYNC_PORT = 4210;
+const uint8_t SYNC_PACKET_SIZE = 16;
+const uint32_t SYNC_INTERVAL = 1000;          // рассылка ведущего, мс
+const uint32_t SYNC_LEADER_TIMEOUT = 3500;    // без пакетов ведущего начинаются выборы, мс
+const uint32_t SYNC_ELECTION_SPREAD = 1024;   // разброс ожидания по номеру узла от 0 до 2^24, мс
+const int32_t SYNC_STEP_THRESHOLD = 2000;     // при большем расхождении шкала переставляется скачком, мс
+const uint32_t SYNC_SLEW_PERMILLE = 50;       // скорость плавной подстройки (5%)
+const uint32_t SYNC_PHASE_STEP = 50;          // шаг фазы в пакете, мс (EFFECT_STEP_MS)
+
+typedef unsigned long (*SyncClock)();  // источник времени в миллисекундах
+
+enum SyncRole {
+    SYNC_FOLLOWER,
+    SYNC_LEADER
+};
+
+// Состояние синхронизации
+struct SyncStats {
+    uint32_t leaderId;       // текущий ведущий, 0 - нет
+    int32_t offsetMs;        // последнее измеренное расхождение с ведущим
+    int32_t pendingMs;       // остаток плавной подстройки
+    uint32_t jitterMs;       // среднее отклонение измерений
+    int16_t phaseError;      // расхождение фазы эффекта с ведущим, шагов
+    int32_t phasePendingMs;  // остаток подстройки начала эффекта
+    uint32_t received;
+    uint32_t sent;
+    uint32_t steps;          // перестановки шкалы скачком
+    uint32_t elections;      // сколько раз узел становился ведущим
+};
+
+class PhaseSync {
+public:
+    PhaseSync(SyncClock clock = millis);
+    void begin(uint32_t nodeId, IPAddress localIp);
+    void loop();
+
+    // Общая шкала времени для фаз эффектов, мс
+    uint32_t now() const;
+    void setEffect(uint8_t effect);
+    // Начало текущего эффекта по общей шкале, мс
+    void setPhaseStart(uint32_t start) { phaseStart = start; }
+    // Накопленный плавный сдвиг начала эффекта, который еще не применен
+    int32_t takePhaseShift();
+    bool isStarted() const { return started; }
+    SyncRole getRole() const { return role; }
+    bool isLocked() const { return locked; }
+    const SyncStats& getStats() const { return stats; }
+
+    // Протокол без сети, чтобы несколько узлов можно было прогнать на хосте
+    void tick();
+    bool announceDue() const;
+    size_t makeAnnounce(uint8_t* buffer);
+    bool receive(const uint8_t* packet, size_t length);
+
+private:
+    SyncClock clock;
+    WiFiUDP udp;
+    bool started;
+    uint32_t nodeId;
+    SyncRole role;
+    bool locked;                 // шкала уже привязана к ведущему
+
+    int32_t offset;              // общая шкала = clock() + offset
+    int32_t pending;             // еще не примененная подстройка
+    uint32_t slewCredit;         // доступный сдвиг, тысячные доли мс
+    uint32_t lastTickMillis;
+    uint32_t lastLeaderMillis;
+    uint32_t lastAnnounceMillis;
+    uint16_t sequence;
+    uint8_t localEffect;
+    uint32_t phaseStart;
+    int32_t phasePending;        // еще не примененная подстройка начала эффекта
+    int32_t phaseShift;          // подстройка, отданная плавно, но еще не забранная takePhaseShift
+
+    SyncStats stats;
+
+    void becomeLeader();
+    void follow(uint32_t leaderId, uint32_t leaderTime, uint8_t effect, uint8_t phase);
+};
+
+#endif
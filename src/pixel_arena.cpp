@@ -0,0 +1,19 @@
+#include "pixel_arena.h"
+
+PixelArena::PixelArena() : memory(nullptr), size(0), used(0) {
+}
+
+bool PixelArena::begin(size_t bytes) {
+    memory = new uint8_t[bytes];
+    size = bytes;
+    used = 0;
+    return memory != nullptr;
+}
+
+void* PixelArena::take(size_t bytes) {
+    size_t aligned = (bytes + 3) & ~(size_t)3;
+    if (memory == nullptr || aligned > size - used) return nullptr;
+    void* block = memory + used;
+    used += aligned;
+    return block;
+}
@@ -0,0 +1,25 @@
+#ifndef PIXEL_ARENA_H
+#define PIXEL_ARENA_H
+
+#include <Arduino.h>
+
+// Память под буферы кадра, выделяемая один раз при старте на самую длинную ленту.
+// При перенастройке ленты буферы размечаются заново в том же блоке, куча не дробится.
+class PixelArena {
+public:
+    PixelArena();
+    bool begin(size_t size);
+    // Все выданные ранее буферы становятся недействительными
+    void reset() { used = 0; }
+    // Блок с выравниванием по 4 байта или nullptr, если арена переполнена
+    void* take(size_t bytes);
+    size_t getUsed() const { return used; }
+    size_t getSize() const { return size; }
+
+private:
+    uint8_t* memory;
+    size_t size;
+    size_t used;
+};
+
+#endif
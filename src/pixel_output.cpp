@@ -0,0 +1,99 @@
+#include "pixel_output.h"
+#include <new>
+
+OutputSink::OutputSink(const char* name, uint16_t first, uint16_t count)
+    : name(name), first(first), count(count) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void OutputSink::show(const uint8_t* frame) {
+    if (isBusy()) stats.busyFrames++;
+    uint32_t start = micros();
+    transmit(frame + (size_t)first * StripOrder::SIZE, (size_t)count * StripOrder::SIZE);
+    stats.startUs = micros() - start;
+    if (stats.startUs > stats.maxStartUs) stats.maxStartUs = stats.startUs;
+    stats.frames++;
+}
+
+PixelOutput::PixelOutput()
+    : frame(nullptr), maxPixels(0), pixelCount(0), split(0), uart(nullptr), dma(nullptr), sinks(), sinkCount(0),
+      lastShowUs(0), maxShowUs(0) {
+}
+
+PixelOutput::~PixelOutput() {
+    release();
+    delete[] frame;
+}
+
+bool PixelOutput::begin(uint16_t pixels) {
+    maxPixels = pixels;
+    frame = new uint8_t[(size_t)maxPixels * StripOrder::SIZE];
+    if (frame == nullptr) return false;
+    memset(frame, 0, (size_t)maxPixels * StripOrder::SIZE);
+    return true;
+}
+
+void PixelOutput::release() {
+    if (uart != nullptr) uart->~UartSink();
+    if (dma != nullptr) dma->~DmaSink();
+    uart = nullptr;
+    dma = nullptr;
+    sinkCount = 0;
+}
+
+bool PixelOutput::configure(uint16_t count, uint16_t newSplit) {
+    if (frame == nullptr || count == 0 || count > maxPixels || newSplit >= count) return false;
+    if (sinkCount > 0 && count == pixelCount && newSplit == split) return true;
+
+    // Старые цепочки гасятся, чтобы за концом укороченной не остались светящиеся пиксели
+    if (sinkCount > 0) {
+        memset(frame, 0, getPixelsSize());
+        show();
+    }
+
+    // Буферы шин освобождаются и запрашиваются подряд, без других выделений между ними
+    uint16_t uartCount = newSplit == 0 ? count : newSplit;
+    uint16_t dmaCount = newSplit == 0 ? 0 : count - newSplit;
+    if (uart != nullptr && uart->getCount() != uartCount) {
+        uart->~UartSink();
+        uart = nullptr;
+    }
+    if (dma != nullptr && (dma->getFirst() != newSplit || dma->getCount() != dmaCount)) {
+        dma->~DmaSink();
+        dma = nullptr;
+    }
+    if (uart == nullptr) {
+        uart = new (uartMemory) UartSink("uart1", 0, uartCount, OUTPUT_UART_PIN);
+        uart->begin();
+    }
+    if (dma == nullptr && dmaCount > 0) {
+        dma = new (dmaMemory) DmaSink("dma", newSplit, dmaCount, OUTPUT_DMA_PIN);
+        dma->begin();
+    }
+
+    // Фоновая цепочка стоит первой: она передает, пока UART1 держит процессор
+    sinkCount = 0;
+    if (dma != nullptr) sinks[sinkCount++] = dma;
+    sinks[sinkCount++] = uart;
+
+    memset(frame, 0, (size_t)maxPixels * StripOrder::SIZE);
+    pixelCount = count;
+    split = newSplit;
+    return true;
+}
+
+// Цепочки запускаются подряд, их передачи по проводам идут одновременно
+void PixelOutput::show() {
+    uint32_t start = micros();
+    for(uint8_t i = 0; i < sinkCount; i++) {
+        sinks[i]->show(frame);
+    }
+    lastShowUs = micros() - start;
+    if (lastShowUs > maxShowUs) maxShowUs = lastShowUs;
+}
+
+uint32_t PixelOutput::takeMaxShowUs() {
+    uint32_t value = maxShowUs;
+    maxShowUs = 0;
+    return value;
+}
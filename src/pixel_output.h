@@ -0,0 +1,123 @@
+#ifndef PIXEL_OUTPUT_H
+#define PIXEL_OUTPUT_H
+
+#include <Arduino.h>
+#include <NeoPixelBus.h>
+#include "output.h"
+
+// Выводы цепочек фиксированы аппаратно
+const uint8_t OUTPUT_UART_PIN = 2;     // UART1, GPIO2 (D4)
+const uint8_t OUTPUT_DMA_PIN = 3;      // I2S DMA, GPIO3 (RX)
+const uint8_t OUTPUT_MAX_SINKS = 2;
+const uint32_t OUTPUT_BIT_NS = 1250;   // 800 кбит/с
+
+// Время одного кадра каждой цепочки
+struct SinkStats {
+    uint32_t frames;
+    uint32_t startUs;        // сколько занял запуск передачи в последнем кадре
+    uint32_t maxStartUs;
+    uint32_t busyFrames;     // кадр пришел, пока цепочка еще передавала предыдущий
+};
+
+// Физическая цепочка светодиодов со своим участком логического кадра
+class OutputSink {
+public:
+    OutputSink(const char* name, uint16_t first, uint16_t count);
+    virtual ~OutputSink() {}
+    virtual void begin() = 0;
+    // Передача идет в фоне, запуск возвращается сразу
+    virtual bool isAsync() const = 0;
+    virtual bool isBusy() = 0;
+
+    // Копия своего участка кадра и запуск передачи с замером времени
+    void show(const uint8_t* frame);
+
+    const char* getName() const { return name; }
+    uint16_t getFirst() const { return first; }
+    uint16_t getCount() const { return count; }
+    // Время передачи участка по проводу
+    uint32_t getWireUs() const { return (uint32_t)count * StripOrder::SIZE * 8 * OUTPUT_BIT_NS / 1000; }
+    const SinkStats& getStats() const { return stats; }
+
+protected:
+    virtual void transmit(const uint8_t* data, size_t length) = 0;
+
+private:
+    const char* name;
+    uint16_t first;
+    uint16_t count;
+    SinkStats stats;
+};
+
+// Цепочка на NeoPixelBus. Буфер шины хранит уже готовые байты в порядке проводов
+template<typename Method>
+class NeoBusSink : public OutputSink {
+public:
+    NeoBusSink(const char* name, uint16_t first, uint16_t count, uint8_t pin)
+        : OutputSink(name, first, count), bus(count, pin) {}
+    void begin() override { bus.Begin(); }
+    bool isAsync() const override;
+    bool isBusy() override { return !bus.CanShow(); }
+
+protected:
+    void transmit(const uint8_t* data, size_t length) override {
+        memcpy(bus.Pixels(), data, length);
+        bus.Dirty();
+        bus.Show();
+    }
+
+private:
+    NeoPixelBus<NeoRgbwFeature, Method> bus;
+};
+
+// UART1 ждет конца передачи в Show(), DMA только запускает ее
+typedef NeoBusSink<NeoEsp8266Uart1Ws2813Method> UartSink;
+typedef NeoBusSink<NeoEsp8266DmaWs2812xMethod> DmaSink;
+template<> inline bool UartSink::isAsync() const { return false; }
+template<> inline bool DmaSink::isAsync() const { return true; }
+
+// Один логический кадр на две цепочки: UART1 и I2S DMA. NeoPixelBus умеет вести и UART0
+// (GPIO1), но этот вывод - TX порта Serial, через который идут лог и консоль.
+// Эффекты и прием кадров по сети пишут в общий буфер, show() раздает участки цепочкам.
+class PixelOutput {
+public:
+    PixelOutput();
+    ~PixelOutput();
+    // Буфер кадра выделяется один раз на самую длинную ленту
+    bool begin(uint16_t maxPixels);
+    // split - пикселей на цепочке UART1, остальные идут на DMA. 0 - одна цепочка на UART1.
+    // Пересоздаются только цепочки, длина или начало которых изменились
+    bool configure(uint16_t pixelCount, uint16_t split);
+
+    uint8_t* getPixels() { return frame; }
+    size_t getPixelsSize() const { return (size_t)pixelCount * StripOrder::SIZE; }
+    uint16_t getPixelCount() const { return pixelCount; }
+    void show();
+
+    uint8_t getSinkCount() const { return sinkCount; }
+    const OutputSink& getSink(uint8_t index) const { return *sinks[index]; }
+    uint32_t getLastShowUs() const { return lastShowUs; }
+    // Самый долгий вывод с прошлого вызова
+    uint32_t takeMaxShowUs();
+
+private:
+    uint8_t* frame;
+    uint16_t maxPixels;
+    uint16_t pixelCount;
+    uint16_t split;
+    // Цепочки размещаются в самом объекте, в куче остаются только буферы шин:
+    // NeoPixelBus задает длину передачи при создании, шина на PixelCountMax
+    // передавала бы всю максимальную ленту в каждом кадре
+    alignas(UartSink) uint8_t uartMemory[sizeof(UartSink)];
+    alignas(DmaSink) uint8_t dmaMemory[sizeof(DmaSink)];
+    UartSink* uart;
+    DmaSink* dma;
+    OutputSink* sinks[OUTPUT_MAX_SINKS];
+    uint8_t sinkCount;
+    uint32_t lastShowUs;     // от запуска первой цепочки до возврата последней
+    uint32_t maxShowUs;
+
+    void release();
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "presets.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include "http_args.h"
+#include "content.h"
+
+PresetBank::PresetBank() : count(0), error("empty") {
+    memset(presets, 0, sizeof(presets));
+}
+
+// "ЧЧ:ММ" -> минута суток
+static bool parseMinute(const char* text, uint16_t& minute) {
+    if (text == nullptr || strlen(text) != 5 || text[2] != ':') return false;
+    char hours[3] = {text[0], text[1], '\0'};
+    long h, m;
+    if (!parseBoundedInt(hours, 0, 23, h) || !parseBoundedInt(text + 3, 0, 59, m)) return false;
+    minute = h * 60 + m;
+    return true;
+}
+
+bool PresetBank::parse(const char* json, size_t length) {
+    DynamicJsonDocument doc(PRESET_DOCUMENT_SIZE);
+    if (deserializeJson(doc, json, length) != DeserializationError::Ok) {
+        error = "invalid JSON";
+        return false;
+    }
+    JsonArrayConst list = doc["presets"];
+    if (list.isNull() || list.size() == 0 || list.size() > PRESET_COUNT) {
+        error = "presets must be a list of 1-8 entries";
+        return false;
+    }
+
+    // Разбор во временный банк: при ошибке действующие наборы не трогаются
+    Preset parsed[PRESET_COUNT];
+    memset(parsed, 0, sizeof(parsed));
+    uint8_t parsedCount = 0;
+    ContentScheduler rotationCheck;
+
+    for(JsonObjectConst item : list) {
+        Preset& preset = parsed[parsedCount];
+
+        const char* name = item["name"];
+        if (name == nullptr || name[0] == '\0' || strlen(name) >= PRESET_NAME_SIZE) {
+            error = "invalid name";
+            return false;
+        }
+        for(uint8_t i = 0; i < parsedCount; i++) {
+            if (strcmp(parsed[i].name, name) == 0) {
+                error = "duplicate name";
+                return false;
+            }
+        }
+        strcpy(preset.name, name);
+
+        const char* effect = item["effect"];
+        int effectIndex = -1;
+        for(uint8_t i = 0; effect != nullptr && i < EFFECT_COUNT; i++) {
+            if (strcmp(effect, effectName((Effect)i)) == 0) effectIndex = i;
+        }
+        if (effectIndex < 0) {
+            error = "invalid effect";
+            return false;
+        }
+        preset.effect = (Effect)effectIndex;
+
+        if (!parseHexColor(item["color"], preset.red, preset.green, preset.blue)) {
+            error = "invalid color";
+            return false;
+        }
+
+        JsonVariantConst brightness = item["brightness"];
+        if (!brightness.is<int>() || brightness.as<int>() < 0 || brightness.as<int>() > 255) {
+            error = "invalid brightness";
+            return false;
+        }
+        preset.brightness = brightness.as<int>();
+
+        JsonVariantConst transition = item["transition"];
+        preset.transition = -1;
+        if (!transition.isNull()) {
+            if (!transition.is<int>() || transition.as<int>() < 0 || transition.as<int>() >= TRANSITION_COUNT) {
+                error = "invalid transition";
+                return false;
+            }
+            preset.transition = transition.as<int>();
+        }
+
+        JsonVariantConst white = item["white"];
+        preset.whiteRatio = -1;
+        if (!white.isNull()) {
+            if (!white.is<int>() || white.as<int>() < 0 || white.as<int>() > 254) {
+                error = "invalid white";
+                return false;
+            }
+            preset.whiteRatio = white.as<int>();
+        }
+
+        const char* rotation = item["rotation"];
+        if (rotation != nullptr) {
+            if (strlen(rotation) >= PRESET_ROTATION_SIZE || !rotationCheck.setRotation(rotation)) {
+                error = "invalid rotation";
+                return false;
+            }
+            strcpy(preset.rotation, rotation);
+        }
+
+        JsonVariantConst fade = item["fade"];
+        if (!fade.isNull()) {
+            if (!fade.is<int>() || fade.as<int>() < 0 || fade.as<int>() > PRESET_MAX_FADE) {
+                error = "invalid fade";
+                return false;
+            }
+            preset.fadeMs = fade.as<int>();
+        }
+
+        preset.startMinute = PRESET_NO_TIME;
+        const char* at = item["at"];
+        if (at != nullptr && !parseMinute(at, preset.startMinute)) {
+            error = "invalid time";
+            return false;
+        }
+
+        parsedCount++;
+    }
+
+    memcpy(presets, parsed, sizeof(presets));
+    count = parsedCount;
+    error = nullptr;
+    return true;
+}
+
+bool PresetBank::load(const char* path) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        error = "no file";
+        return false;
+    }
+    // Файл читается в кучу один раз при загрузке, не на каждое включение набора
+    size_t size = file.size();
+    if (size == 0 || size > PRESET_FILE_MAX) {
+        file.close();
+        error = "invalid file size";
+        return false;
+    }
+    char* json = new char[size];
+    bool ok = false;
+    if ((size_t)file.read((uint8_t*)json, size) == size) {
+        ok = parse(json, size);
+    } else {
+        error = "read error";
+    }
+    delete[] json;
+    file.close();
+    return ok;
+}
+
+const Preset* PresetBank::find(const char* name) const {
+    for(uint8_t i = 0; i < count; i++) {
+        if (strcmp(presets[i].name, name) == 0) return &presets[i];
+    }
+    return nullptr;
+}
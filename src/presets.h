@@ -0,0 +1,51 @@
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <Arduino.h>
+#include "effects.h"
+
+// Банк именованных наборов настроек в LittleFS:
+// {"presets": [{"name": "night", "effect": "static", "color": "#ff2000", "brightness": 12,
+//               "transition": 3, "white": 0, "rotation": "time:0", "at": "22:30", "fade": 3000}, ...]}
+// Обязательны name, effect, color и brightness, остальные поля необязательны.
+const uint8_t PRESET_COUNT = 8;
+const uint8_t PRESET_NAME_SIZE = 16;
+const uint8_t PRESET_ROTATION_SIZE = 48;
+const uint16_t PRESET_MAX_FADE = 10000;     // мс
+const uint16_t PRESET_NO_TIME = 0xFFFF;
+const size_t PRESET_FILE_MAX = 2048;
+const size_t PRESET_DOCUMENT_SIZE = 3072;   // разбор JSON только при загрузке банка
+const char* const PRESET_PATH = "/presets.json";
+
+// Набор уже проверен и разобран: включение - только замена указателя
+struct Preset {
+    char name[PRESET_NAME_SIZE];
+    uint8_t red, green, blue;
+    uint8_t brightness;
+    Effect effect;
+    int8_t transition;                   // -1 - не менять
+    int16_t whiteRatio;                  // -1 - не менять
+    char rotation[PRESET_ROTATION_SIZE]; // пустая строка - не менять
+    uint16_t fadeMs;                     // плавная смена кадра, 0 - сразу
+    uint16_t startMinute;                // минута суток для расписания или PRESET_NO_TIME
+};
+
+class PresetBank {
+public:
+    PresetBank();
+    // Банк заменяется, только если все наборы документа корректны
+    bool parse(const char* json, size_t length);
+    bool load(const char* path);
+    const char* getError() const { return error; }
+
+    uint8_t getCount() const { return count; }
+    const Preset& get(uint8_t index) const { return presets[index]; }
+    const Preset* find(const char* name) const;
+
+private:
+    Preset presets[PRESET_COUNT];
+    uint8_t count;
+    const char* error;
+};
+
+#endif
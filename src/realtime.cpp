@@ -0,0 +1,171 @@
+#include "realtime.h"
+
+// Заголовок DDP
+const uint8_t DDP_HEADER_SIZE = 10;
+const uint8_t DDP_FLAG_VERSION = 0x40;
+const uint8_t DDP_FLAG_TIMECODE = 0x10;
+const uint8_t DDP_FLAG_QUERY = 0x02;
+const uint8_t DDP_FLAG_PUSH = 0x01;
+const uint8_t DDP_TYPE_RGBW = 0x03;  // поле TTT типа данных
+
+// Заголовок E1.31 до первого канала DMX
+const uint8_t E131_HEADER_SIZE = 126;
+
+static uint16_t readWord16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static uint32_t readWord32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+RealtimeReceiver::RealtimeReceiver()
+    : effects(nullptr), active(false), lastPacketMillis(0), ddpSequence(0) {
+    memset(e131Sequence, 0, sizeof(e131Sequence));
+    memset(e131SequenceValid, 0, sizeof(e131SequenceValid));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void RealtimeReceiver::begin(Effects* frameEffects) {
+    effects = frameEffects;
+    ddp.begin(DDP_PORT);
+    e131.begin(E131_PORT);
+}
+
+void RealtimeReceiver::loop() {
+    // Разбираем все накопившиеся пакеты, выводим только последний полный кадр
+    bool frameReady = false;
+    int size;
+
+    while ((size = ddp.parsePacket()) > 0) {
+        if (readDdp(size)) {
+            if (frameReady) stats.dropped++;
+            frameReady = true;
+        }
+    }
+    while ((size = e131.parsePacket()) > 0) {
+        if (readE131(size)) {
+            if (frameReady) stats.dropped++;
+            frameReady = true;
+        }
+    }
+
+    if (frameReady) {
+        effects->showExternal();
+        stats.frames++;
+    }
+
+    if (active && millis() - lastPacketMillis >= REALTIME_TIMEOUT) {
+        active = false;
+        stats.timeouts++;
+    }
+}
+
+// Копирование каналов из пакета в кадр небольшими порциями
+void RealtimeReceiver::copyPixels(WiFiUDP& udp, uint16_t firstPixel, size_t length, uint8_t channels) {
+    uint16_t pixelCount = effects->getPixelCount();
+    uint8_t chunk[60];  // кратно 3 и 4 каналам
+
+    uint16_t pixel = firstPixel;
+    while (length >= channels && pixel < pixelCount) {
+        size_t wanted = length < sizeof(chunk) ? length : sizeof(chunk);
+        wanted -= wanted % channels;
+        int got = udp.read(chunk, wanted);
+        if (got <= 0) break;
+        length -= got;
+
+        for(int i = 0; i + channels <= got && pixel < pixelCount; i += channels, pixel++) {
+            effects->setExternalPixel(pixel, chunk[i], chunk[i + 1], chunk[i + 2], channels == 4 ? chunk[i + 3] : 0);
+        }
+    }
+}
+
+bool RealtimeReceiver::readDdp(int size) {
+    stats.packets++;
+
+    uint8_t header[DDP_HEADER_SIZE + 4];
+    if (size < DDP_HEADER_SIZE || ddp.read(header, DDP_HEADER_SIZE) != DDP_HEADER_SIZE ||
+        (header[0] & 0xC0) != DDP_FLAG_VERSION) {
+        stats.invalid++;
+        return false;
+    }
+    if (header[0] & DDP_FLAG_QUERY) return false;
+
+    uint8_t headerSize = DDP_HEADER_SIZE;
+    if (header[0] & DDP_FLAG_TIMECODE) {
+        ddp.read(header + DDP_HEADER_SIZE, 4);
+        headerSize += 4;
+    }
+
+    // Номер 0 означает, что отправитель не нумерует пакеты
+    uint8_t sequence = header[1] & 0x0F;
+    if (sequence != 0 && ddpSequence != 0) {
+        uint8_t ahead = (sequence - ddpSequence) & 0x0F;
+        if (ahead == 0 || ahead > 8) {
+            stats.late++;
+            return false;
+        }
+    }
+    ddpSequence = sequence;
+
+    uint8_t channels = ((header[2] >> 3) & 0x07) == DDP_TYPE_RGBW ? 4 : 3;
+    uint32_t offset = readWord32(header + 4);
+    uint16_t length = readWord16(header + 8);
+    if (offset % channels != 0 || length > size - headerSize) {
+        stats.invalid++;
+        return false;
+    }
+
+    // Данные за концом ленты не выводим, но флаг вывода кадра в пакете учитываем
+    uint32_t firstPixel = offset / channels;
+    if (firstPixel < effects->getPixelCount()) {
+        copyPixels(ddp, firstPixel, length, channels);
+    }
+    active = true;
+    lastPacketMillis = millis();
+
+    return (header[0] & DDP_FLAG_PUSH) != 0;
+}
+
+bool RealtimeReceiver::readE131(int size) {
+    stats.packets++;
+
+    uint8_t header[E131_HEADER_SIZE];
+    if (size < E131_HEADER_SIZE || e131.read(header, E131_HEADER_SIZE) != E131_HEADER_SIZE ||
+        memcmp(header + 4, "ASC-E1.17", 9) != 0 ||
+        readWord32(header + 18) != 0x00000004 ||  // корневой уровень: данные E1.31
+        readWord32(header + 40) != 0x00000002 ||  // уровень кадра: данные DMP
+        header[125] != 0) {                        // стартовый код DMX
+        stats.invalid++;
+        return false;
+    }
+
+    uint16_t universe = readWord16(header + 113);
+    uint16_t channelCount = readWord16(header + 123) - 1;
+    uint16_t pixelCount = effects->getPixelCount();
+    uint8_t lastUniverse = (pixelCount + E131_PIXELS_PER_UNIVERSE - 1) / E131_PIXELS_PER_UNIVERSE;
+    if (universe < E131_START_UNIVERSE || universe - E131_START_UNIVERSE >= lastUniverse ||
+        universe - E131_START_UNIVERSE >= E131_MAX_UNIVERSES || channelCount > size - E131_HEADER_SIZE) {
+        return false;
+    }
+
+    // Номер последовательности свой для каждой вселенной, окно запаздывания по стандарту - 20
+    uint8_t index = universe - E131_START_UNIVERSE;
+    uint8_t sequence = header[111];
+    if (e131SequenceValid[index]) {
+        int8_t ahead = (int8_t)(sequence - e131Sequence[index]);
+        if (ahead <= 0 && ahead > -20) {
+            stats.late++;
+            return false;
+        }
+    }
+    e131Sequence[index] = sequence;
+    e131SequenceValid[index] = true;
+
+    copyPixels(e131, index * E131_PIXELS_PER_UNIVERSE, channelCount, 3);
+    active = true;
+    lastPacketMillis = millis();
+
+    // Кадр готов, когда пришла последняя нужная вселенная
+    return index == lastUniverse - 1;
+}
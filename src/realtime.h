@@ -0,0 +1,53 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "effects.h"
+
+// Параметры режима реального времени
+const uint16_t DDP_PORT = 4048;
+const uint16_t E131_PORT = 5568;
+const uint32_t REALTIME_TIMEOUT = 2500;     // без пакетов возвращаемся к часам, мс
+const uint16_t E131_START_UNIVERSE = 1;
+const uint16_t E131_PIXELS_PER_UNIVERSE = 170;
+const uint8_t E131_MAX_UNIVERSES = 8;
+
+// Счетчики кадров
+struct RealtimeStats {
+    uint32_t packets;    // принятые пакеты
+    uint32_t frames;     // выведенные кадры
+    uint32_t dropped;    // кадры, перезаписанные более новыми до вывода
+    uint32_t late;       // пакеты с устаревшим номером последовательности
+    uint32_t invalid;    // некорректные пакеты
+    uint32_t timeouts;   // возвраты к отображению часов
+};
+
+// Прием кадров DDP и E1.31 по UDP.
+// Данные пишутся в кадр эффектов, без промежуточных буферов пакета: ограничение тока,
+// белый канал и дизеринг у потока те же, что у часов.
+class RealtimeReceiver {
+public:
+    RealtimeReceiver();
+    void begin(Effects* effects);
+    void loop();
+    bool isActive() const { return active; }
+    const RealtimeStats& getStats() const { return stats; }
+
+private:
+    Effects* effects;
+    WiFiUDP ddp;
+    WiFiUDP e131;
+    bool active;
+    uint32_t lastPacketMillis;
+    uint8_t ddpSequence;
+    uint8_t e131Sequence[E131_MAX_UNIVERSES];
+    bool e131SequenceValid[E131_MAX_UNIVERSES];
+    RealtimeStats stats;
+
+    bool readDdp(int size);
+    bool readE131(int size);
+    void copyPixels(WiFiUDP& udp, uint16_t firstPixel, size_t length, uint8_t channels);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(SchedulerClock clock)
+    : clock(clock), taskCount(0), currentTask(-1), beforeTask(nullptr), afterTask(nullptr) {
+    memset(tasks, 0, sizeof(tasks));
+}
+
+int8_t Scheduler::addTask(const char* name, TaskCallback callback, uint32_t periodUs, uint32_t delayUs,
+                          uint8_t priority, uint32_t budgetUs) {
+    if (taskCount >= SCHEDULER_MAX_TASKS) return -1;
+
+    Task& task = tasks[taskCount];
+    task.name = name;
+    task.callback = callback;
+    task.periodUs = periodUs;
+    task.nextRunUs = clock() + delayUs;
+    task.budgetUs = budgetUs;
+    task.priority = priority;
+    task.active = true;
+    return taskCount++;
+}
+
+int8_t Scheduler::addPeriodic(const char* name, TaskCallback callback, uint32_t periodMs, uint8_t priority, uint32_t budgetUs) {
+    return addTask(name, callback, periodMs * 1000, 0, priority, budgetUs);
+}
+
+int8_t Scheduler::addOneShot(const char* name, TaskCallback callback, uint32_t delayMs, uint8_t priority, uint32_t budgetUs) {
+    int8_t id = addTask(name, callback, 0, delayMs * 1000, priority, budgetUs);
+    if (id >= 0) {
+        // Однократная задача ждет явного schedule()
+        tasks[id].active = false;
+    }
+    return id;
+}
+
+void Scheduler::schedule(int8_t id, uint32_t delayMs) {
+    if (id < 0 || id >= taskCount) return;
+    tasks[id].nextRunUs = clock() + delayMs * 1000;
+    tasks[id].active = true;
+}
+
+void Scheduler::setHooks(TaskHook before, TaskHook after) {
+    beforeTask = before;
+    afterTask = after;
+}
+
+void Scheduler::cancel(int8_t id) {
+    if (id < 0 || id >= taskCount) return;
+    tasks[id].active = false;
+}
+
+bool Scheduler::higherPriorityDueWithin(uint8_t priority, uint32_t now, uint32_t windowUs) const {
+    for(uint8_t i = 0; i < taskCount; i++) {
+        const Task& task = tasks[i];
+        if (!task.active || task.priority >= priority) continue;
+        // Опрос с периодом не длиннее окна наступает в любом окне: ожидание его
+        // ничего не защищает и держит задачу до SCHEDULER_MAX_DEFER. Он подождет одну задачу
+        if (task.periodUs != 0 && task.periodUs <= windowUs) continue;
+        if ((int32_t)(task.nextRunUs - now) < (int32_t)windowUs) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::execute(uint8_t id, uint32_t now) {
+    Task& task = tasks[id];
+
+    uint32_t late = now - task.nextRunUs;
+    if (late > task.maxLateUs) {
+        task.maxLateUs = late;
+    }
+
+    currentTask = id;
+    if (beforeTask != nullptr) beforeTask(id, 0);
+    uint32_t start = clock();
+    task.callback();
+    uint32_t duration = clock() - start;
+    if (afterTask != nullptr) afterTask(id, duration);
+    currentTask = -1;
+
+    task.runs++;
+    task.lastUs = duration;
+    if (duration > task.maxUs) {
+        task.maxUs = duration;
+    }
+    if (duration > task.budgetUs) {
+        task.overruns++;
+    }
+
+    if (task.periodUs == 0) {
+        task.active = false;
+        return;
+    }
+
+    // Фиксированная сетка запусков; при сильном отставании не навёрстываем пачкой
+    task.nextRunUs += task.periodUs;
+    uint32_t after = clock();
+    if ((int32_t)(after - task.nextRunUs) > (int32_t)task.periodUs) {
+        task.nextRunUs = after + task.periodUs;
+    }
+}
+
+void Scheduler::run() {
+    bool skipped[SCHEDULER_MAX_TASKS] = {false};
+
+    // За один проход каждая задача выполняется не более одного раза
+    for(uint8_t pass = 0; pass < taskCount; pass++) {
+        uint32_t now = clock();
+
+        // Среди готовых задач выбираем самую приоритетную, затем самую просроченную
+        int8_t best = -1;
+        for(uint8_t i = 0; i < taskCount; i++) {
+            const Task& task = tasks[i];
+            if (!task.active || skipped[i] || (int32_t)(now - task.nextRunUs) < 0) continue;
+            if (best < 0 || task.priority < tasks[best].priority ||
+                (task.priority == tasks[best].priority &&
+                 (int32_t)(task.nextRunUs - tasks[best].nextRunUs) < 0)) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+
+        skipped[best] = true;
+        Task& task = tasks[best];
+
+        // Не начинаем задачу, если за ее бюджет наступит срок более приоритетной
+        if (now - task.nextRunUs < SCHEDULER_MAX_DEFER &&
+            higherPriorityDueWithin(task.priority, now, task.budgetUs)) {
+            task.deferrals++;
+            continue;
+        }
+
+        execute(best, now);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+const uint8_t SCHEDULER_MAX_TASKS = 16;      // максимальное количество задач
+const uint32_t SCHEDULER_MAX_DEFER = 100000; // задача откладывается не дольше, мкс
+
+// Приоритеты задач: меньшее значение - выше приоритет
+const uint8_t PRIORITY_FRAME = 0;   // отрисовка кадра
+const uint8_t PRIORITY_HIGH = 1;    // отсчет времени
+const uint8_t PRIORITY_NORMAL = 2;  // сеть и HTTP
+const uint8_t PRIORITY_LOW = 3;     // фоновое обслуживание
+
+typedef void (*TaskCallback)();
+typedef unsigned long (*SchedulerClock)();  // источник времени в микросекундах
+typedef void (*TaskHook)(uint8_t id, uint32_t durationUs);  // перед задачей durationUs = 0
+
+// Задача и ее статистика
+struct Task {
+    const char* name;
+    TaskCallback callback;
+    uint32_t periodUs;     // 0 для однократной задачи
+    uint32_t nextRunUs;
+    uint32_t budgetUs;     // допустимое время выполнения
+    uint8_t priority;
+    bool active;
+
+    uint32_t runs;
+    uint32_t overruns;     // выполнение дольше бюджета
+    uint32_t deferrals;    // отложена ради более приоритетной задачи
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint32_t maxLateUs;    // максимальное опоздание запуска
+};
+
+// Кооперативный планировщик с учетом сроков.
+// Время берется из переданной функции, поэтому на хосте можно подставить виртуальные часы.
+class Scheduler {
+public:
+    Scheduler(SchedulerClock clock = micros);
+    int8_t addPeriodic(const char* name, TaskCallback callback, uint32_t periodMs, uint8_t priority, uint32_t budgetUs);
+    int8_t addOneShot(const char* name, TaskCallback callback, uint32_t delayMs, uint8_t priority, uint32_t budgetUs);
+    void schedule(int8_t id, uint32_t delayMs);
+    void cancel(int8_t id);
+    void run();
+    // Наблюдение за задачами снаружи, например для журнала зависаний
+    void setHooks(TaskHook before, TaskHook after);
+
+    uint8_t getTaskCount() const { return taskCount; }
+    const Task& getTask(uint8_t id) const { return tasks[id]; }
+    int8_t getCurrentTask() const { return currentTask; }
+
+private:
+    SchedulerClock clock;
+    Task tasks[SCHEDULER_MAX_TASKS];
+    uint8_t taskCount;
+    int8_t currentTask;
+    TaskHook beforeTask;
+    TaskHook afterTask;
+
+    int8_t addTask(const char* name, TaskCallback callback, uint32_t periodUs, uint32_t delayUs, uint8_t priority, uint32_t budgetUs);
+    bool higherPriorityDueWithin(uint8_t priority, uint32_t now, uint32_t windowUs) const;
+    void execute(uint8_t id, uint32_t now);
+};
+
+#endif
@@ -0,0 +1,12 @@
+#include "settings.h"
+#include <EEPROM.h>
+#include "diag_log.h"
+
+void commitSettings() {
+    uint32_t start = micros();
+    EEPROM.commit();
+    uint32_t duration = micros() - start;
+    if (duration > DIAG_SLOW_CALL_US) {
+        diag.record(DIAG_SLOW_COMMIT, 0, duration);
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+// Запись EEPROM стирает сектор flash, долгие записи попадают в журнал.
+// Все модули, сохраняющие настройки, фиксируют их через эту функцию.
+void commitSettings();
+
+#endif
@@ -0,0 +1,257 @@
+#include "sntp_client.h"
+
+// Разница между эпохами NTP (1900) и Unix (1970), секунды
+const uint32_t NTP_UNIX_OFFSET = 2208988800UL;
+const uint8_t NTP_PACKET_SIZE = 48;
+
+// Чтение 32-битного слова в сетевом порядке байт
+static uint32_t readWord(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void writeWord(uint8_t* p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+// Перевод метки NTP (секунды + доля 2^-32) в микросекунды Unix
+static int64_t ntpToUnixUs(const uint8_t* p) {
+    uint32_t seconds = readWord(p) - NTP_UNIX_OFFSET;
+    uint32_t fraction = readWord(p + 4);
+    return (int64_t)seconds * 1000000LL + (((uint64_t)fraction * 1000000ULL) >> 32);
+}
+
+SntpClient::SntpClient()
+    : serverCount(0), currentServer(0), state(IDLE), started(false), synced(false),
+      nextPollMillis(0), requestMillis(0), requestTimeUs(0),
+      refEpochUs(0), refLocalUs(0), pendingUs(0), driftPpm(0), lastSyncEpochUs(0) {
+    memset(&stats, 0, sizeof(stats));
+    requestTag[0] = requestTag[1] = 0;
+}
+
+void SntpClient::begin(const char* const* serverList, uint8_t count) {
+    serverCount = count < SNTP_MAX_SERVERS ? count : SNTP_MAX_SERVERS;
+    for(uint8_t i = 0; i < serverCount; i++) {
+        servers[i] = serverList[i];
+        serverIps[i] = IPAddress();
+    }
+    refLocalUs = micros64();
+    udp.begin(SNTP_LOCAL_PORT);
+    started = true;
+    state = IDLE;
+    nextPollMillis = millis();
+}
+
+int64_t SntpClient::slewApplied(uint64_t elapsedUs) {
+    int64_t maxSlew = (int64_t)(elapsedUs / 1000000ULL) * SNTP_SLEW_PPM +
+                      (int64_t)(elapsedUs % 1000000ULL) * SNTP_SLEW_PPM / 1000000LL;
+    if (pendingUs >= 0) {
+        return pendingUs < maxSlew ? pendingUs : maxSlew;
+    }
+    return -pendingUs < maxSlew ? pendingUs : -maxSlew;
+}
+
+int64_t SntpClient::localTimeUs(uint64_t localUs) {
+    uint64_t elapsed = localUs - refLocalUs;
+    int64_t driftUs = (int64_t)(elapsed / 1000000ULL) * driftPpm +
+                      (int64_t)(elapsed % 1000000ULL) * driftPpm / 1000000LL;
+    return refEpochUs + (int64_t)elapsed + driftUs + slewApplied(elapsed);
+}
+
+uint64_t SntpClient::nowMs() {
+    return localTimeUs(micros64()) / 1000;
+}
+
+const SntpStats& SntpClient::getStats() {
+    uint64_t elapsed = micros64() - refLocalUs;
+    stats.pendingSlewMs = (pendingUs - slewApplied(elapsed)) / 1000;
+    stats.driftPpm = driftPpm;
+    return stats;
+}
+
+void SntpClient::loop() {
+    if (!started) return;
+
+    uint32_t currentMillis = millis();
+    if (state == IDLE) {
+        if ((int32_t)(currentMillis - nextPollMillis) >= 0) {
+            startRound();
+        }
+        return;
+    }
+
+    // Ожидание адреса или ответа текущего сервера, без блокировки
+    bool answered = false;
+    if (state == RESOLVING) {
+        if (serverIps[currentServer].isSet()) {
+            transmit();
+            return;
+        }
+    } else {
+        answered = readResponse();
+    }
+    if (answered || currentMillis - requestMillis >= SNTP_RESPONSE_TIMEOUT) {
+        currentServer++;
+        if (currentServer < serverCount) {
+            sendRequest();
+        } else {
+            finishRound();
+        }
+    }
+}
+
+void SntpClient::startRound() {
+    for(uint8_t i = 0; i < SNTP_MAX_SERVERS; i++) {
+        samples[i].valid = false;
+    }
+    // Отбрасываем ответы, оставшиеся от прошлого раунда
+    while (udp.parsePacket() > 0) {
+    }
+    currentServer = 0;
+    sendRequest();
+}
+
+void SntpClient::sendRequest() {
+    requestMillis = millis();
+
+    if (!serverIps[currentServer].isSet()) {
+        // WiFi.hostByName() ждал бы ответа DNS внутри задачи. Запрос уходит асинхронно,
+        // адрес записывает dnsFound(); не пришел за таймаут - переходим к следующему серверу
+        ip_addr_t address;
+        err_t result = dns_gethostbyname(servers[currentServer], &address, dnsFound, this);
+        if (result != ERR_OK) {
+            state = RESOLVING;
+            return;
+        }
+        serverIps[currentServer] = IPAddress(&address);
+    }
+    transmit();
+}
+
+// Вызывается из lwIP между задачами. Ответ может прийти после таймаута -
+// тогда адрес просто останется для следующего раунда
+void SntpClient::dnsFound(const char* name, const ip_addr_t* address, void* arg) {
+    SntpClient* client = (SntpClient*)arg;
+    if (address == nullptr) return;
+    for(uint8_t i = 0; i < client->serverCount; i++) {
+        if (strcmp(client->servers[i], name) == 0) {
+            client->serverIps[i] = IPAddress(address);
+        }
+    }
+}
+
+void SntpClient::transmit() {
+    state = WAIT_RESPONSE;
+    requestMillis = millis();
+
+    uint8_t packet[NTP_PACKET_SIZE];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x23;  // LI = 0, версия 4, режим 3 (клиент)
+
+    // Случайная метка в поле transmit: сервер вернет ее в поле originate
+    requestTag[0] = (uint32_t)random(0x7FFFFFFF);
+    requestTag[1] = (uint32_t)random(0x7FFFFFFF);
+    writeWord(packet + 40, requestTag[0]);
+    writeWord(packet + 44, requestTag[1]);
+
+    udp.beginPacket(serverIps[currentServer], SNTP_PORT);
+    udp.write(packet, sizeof(packet));
+    requestTimeUs = localTimeUs(micros64());
+    udp.endPacket();
+}
+
+bool SntpClient::readResponse() {
+    int size = udp.parsePacket();
+    if (size <= 0) return false;
+
+    int64_t receiveTimeUs = localTimeUs(micros64());
+    if (size < NTP_PACKET_SIZE) return false;
+
+    uint8_t packet[NTP_PACKET_SIZE];
+    udp.read(packet, NTP_PACKET_SIZE);
+
+    // Ответ должен быть на наш последний запрос
+    if (readWord(packet + 24) != requestTag[0] || readWord(packet + 28) != requestTag[1]) {
+        return false;
+    }
+
+    stats.sampleCount++;
+
+    uint8_t leap = packet[0] >> 6;
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    if (leap == 3 || mode != 4 || stratum == 0 || stratum > 15) {
+        // Сервер не синхронизирован или прислал Kiss-o'-Death
+        return true;
+    }
+
+    int64_t serverReceiveUs = ntpToUnixUs(packet + 32);
+    int64_t serverTransmitUs = ntpToUnixUs(packet + 40);
+
+    Sample& sample = samples[currentServer];
+    sample.offsetUs = ((serverReceiveUs - requestTimeUs) + (serverTransmitUs - receiveTimeUs)) / 2;
+    sample.delayUs = (receiveTimeUs - requestTimeUs) - (serverTransmitUs - serverReceiveUs);
+    sample.valid = sample.delayUs >= 0;
+    return true;
+}
+
+void SntpClient::finishRound() {
+    // Берем образец с минимальной задержкой: у него наименьшая ошибка смещения
+    int8_t best = -1;
+    for(uint8_t i = 0; i < serverCount; i++) {
+        if (!samples[i].valid || samples[i].delayUs > (int64_t)SNTP_MAX_DELAY * 1000) continue;
+        if (best < 0 || samples[i].delayUs < samples[best].delayUs) {
+            best = i;
+        }
+    }
+
+    state = IDLE;
+    if (best < 0) {
+        stats.failCount++;
+        // Адреса могли смениться - разрешим имена заново
+        for(uint8_t i = 0; i < serverCount; i++) {
+            serverIps[i] = IPAddress();
+        }
+        nextPollMillis = millis() + SNTP_RETRY_INTERVAL;
+        return;
+    }
+
+    applyOffset(samples[best].offsetUs, samples[best].delayUs, best);
+    nextPollMillis = millis() + SNTP_POLL_INTERVAL;
+}
+
+void SntpClient::applyOffset(int64_t offsetUs, int64_t delayUs, uint8_t server) {
+    uint64_t localUs = micros64();
+    int64_t currentUs = localTimeUs(localUs);
+
+    if (!synced || offsetUs > SNTP_STEP_THRESHOLD || offsetUs < -SNTP_STEP_THRESHOLD) {
+        // Первая синхронизация или грубая ошибка - переставляем часы
+        refEpochUs = currentUs + offsetUs;
+        pendingUs = 0;
+    } else {
+        // Смещение, которое не объясняется незавершенной коррекцией, - это уход кварца
+        int64_t remainingUs = pendingUs - slewApplied(localUs - refLocalUs);
+        int64_t intervalUs = currentUs - lastSyncEpochUs;
+        if (intervalUs >= 60000000LL) {
+            int64_t errorPpm = (offsetUs - remainingUs) * 1000000LL / intervalUs;
+            // Половина ошибки за шаг сглаживает шум отдельных измерений
+            driftPpm = constrain((int32_t)(driftPpm + errorPpm / 2), -SNTP_MAX_DRIFT_PPM, SNTP_MAX_DRIFT_PPM);
+        }
+
+        // Часы не перескакивают: все смещение отрабатывается плавно
+        refEpochUs = currentUs;
+        pendingUs = offsetUs;
+    }
+
+    refLocalUs = localUs;
+    lastSyncEpochUs = refEpochUs;
+    synced = true;
+
+    stats.offsetMs = offsetUs / 1000;
+    stats.delayMs = delayUs / 1000;
+    stats.syncCount++;
+    stats.lastSyncMillis = millis();
+    stats.lastServer = server;
+}
@@ -0,0 +1,92 @@
+#ifndef SNTP_CLIENT_H
+#define SNTP_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+
+// Параметры SNTP клиента
+const uint8_t SNTP_MAX_SERVERS = 4;            // максимум опрашиваемых серверов
+const uint16_t SNTP_PORT = 123;                // порт NTP
+const uint16_t SNTP_LOCAL_PORT = 2390;         // локальный порт для ответов
+const uint32_t SNTP_RESPONSE_TIMEOUT = 1000;   // ожидание ответа одного сервера, мс
+const uint32_t SNTP_POLL_INTERVAL = 900000;    // интервал синхронизации, мс (15 минут)
+const uint32_t SNTP_RETRY_INTERVAL = 10000;    // повтор при неудаче, мс
+const uint32_t SNTP_MAX_DELAY = 500;           // отбрасываем образцы с большей задержкой, мс
+const int32_t SNTP_SLEW_PPM = 10000;           // скорость плавной коррекции (1%)
+const int32_t SNTP_MAX_DRIFT_PPM = 500;        // предел оценки ухода кварца
+const int64_t SNTP_STEP_THRESHOLD = 60000000;  // при большем смещении часы переставляются скачком, мкс
+
+// Статистика синхронизации
+struct SntpStats {
+    int32_t offsetMs;        // последнее измеренное смещение
+    uint32_t delayMs;        // задержка кругового пути лучшего образца
+    float driftPpm;          // оценка ухода кварца
+    int32_t pendingSlewMs;   // остаток плавной коррекции
+    uint32_t syncCount;      // успешные синхронизации
+    uint32_t failCount;      // раунды без пригодных ответов
+    uint32_t sampleCount;    // всего полученных ответов
+    uint32_t lastSyncMillis; // millis() последней синхронизации
+    uint8_t lastServer;      // сервер, давший лучший образец
+};
+
+class SntpClient {
+public:
+    SntpClient();
+    void begin(const char* const* servers, uint8_t serverCount);
+    void loop();
+    bool isSynced() const { return synced; }
+    uint64_t nowMs();                 // UTC в миллисекундах
+    time_t now() { return nowMs() / 1000; }
+    const SntpStats& getStats();
+
+private:
+    // Образец от одного сервера
+    struct Sample {
+        int64_t offsetUs;
+        int64_t delayUs;
+        bool valid;
+    };
+
+    enum State {
+        IDLE,
+        RESOLVING,               // ждем ответа DNS для текущего сервера
+        WAIT_RESPONSE
+    };
+
+    WiFiUDP udp;
+    const char* servers[SNTP_MAX_SERVERS];
+    IPAddress serverIps[SNTP_MAX_SERVERS];
+    Sample samples[SNTP_MAX_SERVERS];
+    uint8_t serverCount;
+    uint8_t currentServer;
+    State state;
+    bool started;
+    bool synced;
+    uint32_t nextPollMillis;
+    uint32_t requestMillis;
+    int64_t requestTimeUs;   // t1 по локальной шкале
+    uint32_t requestTag[2];  // поле transmit запроса для проверки ответа
+
+    // Модель локальных часов:
+    // t = refEpochUs + elapsed * (1 + drift) ± min(elapsed * SLEW, |pendingUs|)
+    int64_t refEpochUs;
+    uint64_t refLocalUs;
+    int64_t pendingUs;
+    int32_t driftPpm;
+    int64_t lastSyncEpochUs;
+
+    SntpStats stats;
+
+    int64_t localTimeUs(uint64_t localUs);
+    int64_t slewApplied(uint64_t elapsedUs);
+    void startRound();
+    void sendRequest();
+    void transmit();
+    bool readResponse();
+    void finishRound();
+    void applyOffset(int64_t offsetUs, int64_t delayUs, uint8_t server);
+    static void dnsFound(const char* name, const ip_addr_t* address, void* arg);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "time_zone.h"
+
+const long SECONDS_PER_DAY = 86400;
+
+// Дни от 1970-01-01 до даты по григорианскому календарю
+static long daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = year - era * 400;
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (long)dayOfEra - 719468;
+}
+
+// Момент перехода: последнее воскресенье месяца, switchHour UTC
+static time_t lastSunday(int year, uint8_t month, uint8_t hour) {
+    long nextMonth = month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1);
+    long last = nextMonth - 1;
+    // 1970-01-01 - четверг, воскресенье - 0
+    long weekday = ((last + 4) % 7 + 7) % 7;
+    return (time_t)(last - weekday) * SECONDS_PER_DAY + hour * 3600L;
+}
+
+long TimeZone::offsetAt(time_t utc) const {
+    if (dstOffset == 0) return standardOffset;
+    struct tm date;
+    gmtime_r(&utc, &date);
+    int year = date.tm_year + 1900;
+    time_t start = lastSunday(year, startMonth, switchHour);
+    time_t end = lastSunday(year, endMonth, switchHour);
+    bool summer = start < end ? (utc >= start && utc < end) : (utc >= start || utc < end);
+    return standardOffset + (summer ? dstOffset : 0);
+}
+
+// Местное время переводится по зимнему и по летнему смещению; подходит вариант,
+// при котором смещение в полученный момент совпадает с использованным
+time_t TimeZone::toUtc(time_t local) const {
+    time_t winter = local - standardOffset;
+    if (dstOffset == 0 || offsetAt(winter) == standardOffset) return winter;
+    time_t summer = winter - dstOffset;
+    if (offsetAt(summer) != standardOffset) return summer;
+    // Пропущенный при переходе на летнее время час: момент перехода
+    struct tm date;
+    gmtime_r(&winter, &date);
+    return lastSunday(date.tm_year + 1900, startMonth, switchHour);
+}
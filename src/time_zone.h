@@ -0,0 +1,24 @@
+#ifndef TIME_ZONE_H
+#define TIME_ZONE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// Часовой пояс: постоянное смещение и, если dstOffset не ноль, летнее время
+// по правилу "последнее воскресенье месяца" (Европа: март и октябрь, 01:00 UTC).
+// Начало после конца в году - пояс южного полушария.
+struct TimeZone {
+    long standardOffset;         // смещение зимнего времени от UTC, с
+    long dstOffset;              // добавка летнего времени, с; 0 - без перехода
+    uint8_t startMonth;          // 1-12, переход на летнее время
+    uint8_t endMonth;
+    uint8_t switchHour;          // час UTC обоих переходов
+
+    long offsetAt(time_t utc) const;
+    time_t toLocal(time_t utc) const { return utc + offsetAt(utc); }
+    // Для несуществующего местного времени весной - момент после перехода,
+    // для повторяющегося осенью - второе из двух
+    time_t toUtc(time_t local) const;
+};
+
+#endif
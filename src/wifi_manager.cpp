@@ -0,0 +1,192 @@
+#include "wifi_manager.h"
+#include <EEPROM.h>
+#include "settings.h"
+
+WifiManager::WifiManager()
+    : ssid(nullptr), password(nullptr), apSsid(nullptr), apPassword(nullptr), apAfterMs(0),
+      cacheAddress(-1), state(WIFI_STATE_IDLE), everConnected(false), apActive(false),
+      cacheValid(false), usingCache(false), cachedChannel(0), failures(0),
+      attemptStart(0), backoffStart(0), backoffDelay(0), outageStart(0) {
+    memset(cachedBssid, 0, sizeof(cachedBssid));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void WifiManager::begin(const char* newSsid, const char* newPassword, int newCacheAddress) {
+    ssid = newSsid;
+    password = newPassword;
+    cacheAddress = newCacheAddress;
+    loadCache();
+
+    // Переподключением управляем сами, SDK не должен писать настройки во flash
+    WiFi.persistent(false);
+    WiFi.setAutoReconnect(false);
+    WiFi.mode(WIFI_STA);
+
+    outageStart = millis();
+    startConnect();
+}
+
+void WifiManager::enableFallbackAP(const char* newApSsid, const char* newApPassword, uint32_t afterMs) {
+    apSsid = newApSsid;
+    apPassword = newApPassword;
+    apAfterMs = afterMs;
+}
+
+void WifiManager::loop() {
+    uint32_t currentMillis = millis();
+
+    switch (state) {
+        case WIFI_STATE_CONNECTING: {
+            wl_status_t status = WiFi.status();
+            uint32_t timeout = usingCache ? WIFI_FAST_CONNECT_TIMEOUT : WIFI_CONNECT_TIMEOUT;
+            if (status == WL_CONNECTED) {
+                handleConnected();
+            } else if (status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED ||
+                       status == WL_WRONG_PASSWORD || currentMillis - attemptStart >= timeout) {
+                handleFailure();
+            }
+            break;
+        }
+
+        case WIFI_STATE_BACKOFF:
+            if (currentMillis - backoffStart >= backoffDelay) {
+                startConnect();
+            }
+            break;
+
+        case WIFI_STATE_CONNECTED:
+            if (WiFi.status() != WL_CONNECTED) {
+                Serial.println("WiFi: связь потеряна");
+                stats.outageCount++;
+                outageStart = currentMillis;
+                startConnect();
+            }
+            break;
+
+        case WIFI_STATE_IDLE:
+        default:
+            break;
+    }
+
+    updateFallbackAP();
+}
+
+void WifiManager::startConnect() {
+    stats.connectAttempts++;
+    attemptStart = millis();
+    state = WIFI_STATE_CONNECTING;
+
+    WiFi.disconnect();
+    usingCache = cacheValid;
+    if (usingCache) {
+        // Быстрое подключение без сканирования эфира
+        WiFi.begin(ssid, password, cachedChannel, cachedBssid);
+    } else {
+        WiFi.begin(ssid, password);
+    }
+}
+
+void WifiManager::handleConnected() {
+    uint32_t reconnectMs = millis() - outageStart;
+    state = WIFI_STATE_CONNECTED;
+    failures = 0;
+
+    stats.lastReconnectMs = reconnectMs;
+    if (reconnectMs > stats.maxReconnectMs) {
+        stats.maxReconnectMs = reconnectMs;
+    }
+    if (everConnected) {
+        stats.totalOutageMs += reconnectMs;
+    }
+    if (usingCache) {
+        stats.fastConnects++;
+    }
+    everConnected = true;
+
+    Serial.printf("WiFi: подключено за %lu мс, канал %d\n", (unsigned long)reconnectMs, WiFi.channel());
+    saveCache();
+
+    if (apActive) {
+        WiFi.softAPdisconnect(true);
+        WiFi.mode(WIFI_STA);
+        apActive = false;
+    }
+
+    if (connectCallback) {
+        connectCallback();
+    }
+}
+
+void WifiManager::handleFailure() {
+    stats.failedAttempts++;
+
+    if (usingCache) {
+        // Точка доступа могла сменить канал - следующая попытка со сканированием
+        cacheValid = false;
+        startConnect();
+        return;
+    }
+
+    // Экспоненциальная пауза со случайной добавкой, чтобы часы не ломились к AP одновременно
+    if (failures < 16) {
+        failures++;
+    }
+    uint32_t delayMs = WIFI_BACKOFF_MIN << (failures - 1);
+    if (delayMs > WIFI_BACKOFF_MAX || failures > 9) {
+        delayMs = WIFI_BACKOFF_MAX;
+    }
+    backoffDelay = delayMs + random(delayMs / 4 + 1);
+    backoffStart = millis();
+    state = WIFI_STATE_BACKOFF;
+
+    WiFi.disconnect();
+    Serial.printf("WiFi: ошибка подключения, повтор через %lu мс\n", (unsigned long)backoffDelay);
+}
+
+void WifiManager::updateFallbackAP() {
+    if (apSsid == nullptr || apActive || state == WIFI_STATE_CONNECTED) return;
+
+    if (millis() - outageStart >= apAfterMs) {
+        // Точка доступа для настройки, станция продолжает попытки подключения
+        WiFi.mode(WIFI_AP_STA);
+        WiFi.softAP(apSsid, apPassword);
+        apActive = true;
+        Serial.print("WiFi: запущена точка доступа ");
+        Serial.println(apSsid);
+    }
+}
+
+void WifiManager::loadCache() {
+    if (cacheAddress < 0) return;
+
+    EEPROM.begin(512);
+    cacheValid = EEPROM.read(cacheAddress) == WIFI_CACHE_MAGIC;
+    cachedChannel = EEPROM.read(cacheAddress + 1);
+    for(uint8_t i = 0; i < 6; i++) {
+        cachedBssid[i] = EEPROM.read(cacheAddress + 2 + i);
+    }
+    if (cachedChannel < 1 || cachedChannel > 14) {
+        cacheValid = false;
+    }
+}
+
+void WifiManager::saveCache() {
+    uint8_t channel = WiFi.channel();
+    const uint8_t* bssid = WiFi.BSSID();
+    if (cacheAddress < 0 || bssid == nullptr) return;
+
+    // Пишем в EEPROM только при изменении, чтобы не изнашивать flash
+    if (cacheValid && channel == cachedChannel && memcmp(bssid, cachedBssid, 6) == 0) return;
+
+    cachedChannel = channel;
+    memcpy(cachedBssid, bssid, 6);
+    cacheValid = true;
+
+    EEPROM.begin(512);
+    EEPROM.write(cacheAddress, WIFI_CACHE_MAGIC);
+    EEPROM.write(cacheAddress + 1, cachedChannel);
+    for(uint8_t i = 0; i < 6; i++) {
+        EEPROM.write(cacheAddress + 2 + i, cachedBssid[i]);
+    }
+    commitSettings();
+}
@@ -0,0 +1,77 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Параметры переподключения
+const uint32_t WIFI_CONNECT_TIMEOUT = 15000;       // полное подключение со сканированием, мс
+const uint32_t WIFI_FAST_CONNECT_TIMEOUT = 5000;   // подключение по сохраненным BSSID и каналу, мс
+const uint32_t WIFI_BACKOFF_MIN = 1000;            // первая пауза после неудачи, мс
+const uint32_t WIFI_BACKOFF_MAX = 300000;          // максимальная пауза, мс (5 минут)
+const uint8_t WIFI_CACHE_SIZE = 8;                 // байт в EEPROM: метка, канал, BSSID
+const uint8_t WIFI_CACHE_MAGIC = 0xA5;
+
+enum WifiState {
+    WIFI_STATE_IDLE,
+    WIFI_STATE_CONNECTING,
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF
+};
+
+// Статистика соединения
+struct WifiStats {
+    uint32_t outageCount;      // потери связи после первого подключения
+    uint32_t connectAttempts;  // все попытки подключения
+    uint32_t failedAttempts;   // неудачные попытки
+    uint32_t lastReconnectMs;  // длительность последнего восстановления связи
+    uint32_t maxReconnectMs;   // максимальная длительность восстановления
+    uint32_t totalOutageMs;    // суммарное время без связи
+    uint32_t fastConnects;     // подключения по сохраненным BSSID и каналу
+};
+
+class WifiManager {
+public:
+    WifiManager();
+    void begin(const char* ssid, const char* password, int cacheAddress);
+    void enableFallbackAP(const char* apSsid, const char* apPassword, uint32_t afterMs);
+    void onConnect(std::function<void()> callback) { connectCallback = callback; }
+    void loop();
+    bool isConnected() const { return state == WIFI_STATE_CONNECTED; }
+    bool isFallbackAPActive() const { return apActive; }
+    WifiState getState() const { return state; }
+    const WifiStats& getStats() const { return stats; }
+
+private:
+    const char* ssid;
+    const char* password;
+    const char* apSsid;
+    const char* apPassword;
+    uint32_t apAfterMs;
+    int cacheAddress;
+
+    WifiState state;
+    bool everConnected;
+    bool apActive;
+    bool cacheValid;
+    bool usingCache;
+    uint8_t cachedChannel;
+    uint8_t cachedBssid[6];
+    uint8_t failures;
+    uint32_t attemptStart;
+    uint32_t backoffStart;
+    uint32_t backoffDelay;
+    uint32_t outageStart;
+
+    WifiStats stats;
+    std::function<void()> connectCallback;
+
+    void startConnect();
+    void handleConnected();
+    void handleFailure();
+    void updateFallbackAP();
+    void loadCache();
+    void saveCache();
+};
+
+#endif
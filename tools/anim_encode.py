@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Кодировщик анимаций для LED часов (формат LCA1, см. src/animation.h).
+
+Вход - сырые кадры RGB подряд, по pixels * 3 байта на кадр.
+Пример:
+    python3 tools/anim_encode.py frames.rgb anim.lca --pixels 90 --interval 40 --loop
+Загрузка на часы:
+    curl -F "file=@anim.lca" http://<ip>/animation
+"""
+
+import argparse
+import struct
+import sys
+
+FRAME_KEY = 0
+FRAME_DELTA = 1
+FLAG_LOOP = 0x01
+MAX_RUN = 128
+
+
+def rle_encode(data):
+    """RLE: 0x80 | (n - 1) + байт - повтор, n - 1 + n байтов - как есть."""
+    out = bytearray()
+    literal = bytearray()
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and run < MAX_RUN and data[i + run] == data[i]:
+            run += 1
+        if run >= 3:
+            if literal:
+                out.append(len(literal) - 1)
+                out += literal
+                literal.clear()
+            out.append(0x80 | (run - 1))
+            out.append(data[i])
+            i += run
+        else:
+            literal.append(data[i])
+            i += 1
+            if len(literal) == MAX_RUN:
+                out.append(len(literal) - 1)
+                out += literal
+                literal.clear()
+    if literal:
+        out.append(len(literal) - 1)
+        out += literal
+    return bytes(out)
+
+
+def encode(frames, pixels, interval, loop, keyframe_interval):
+    out = bytearray()
+    flags = FLAG_LOOP if loop else 0
+    out += b"LCA1"
+    out += struct.pack("<HBBHIH", pixels, 3, flags, interval, len(frames), 0)
+
+    previous = None
+    for index, frame in enumerate(frames):
+        key = rle_encode(frame)
+        frame_type, payload = FRAME_KEY, key
+        if previous is not None and (keyframe_interval == 0 or index % keyframe_interval != 0):
+            delta = rle_encode(bytes(a ^ b for a, b in zip(frame, previous)))
+            if len(delta) < len(key):
+                frame_type, payload = FRAME_DELTA, delta
+        out += struct.pack("<BH", frame_type, len(payload))
+        out += payload
+        previous = frame
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Кодирование анимации для LED часов")
+    parser.add_argument("input", help="файл с кадрами RGB подряд")
+    parser.add_argument("output", help="файл .lca для загрузки на часы")
+    parser.add_argument("--pixels", type=int, default=90, help="количество пикселей в кадре")
+    parser.add_argument("--interval", type=int, default=50, help="длительность кадра, мс")
+    parser.add_argument("--loop", action="store_true", help="проигрывать по кругу")
+    parser.add_argument("--keyframe-interval", type=int, default=0,
+                        help="ключевой кадр каждые N кадров (0 - только первый)")
+    args = parser.parse_args()
+
+    frame_size = args.pixels * 3
+    with open(args.input, "rb") as f:
+        raw = f.read()
+    if not raw or len(raw) % frame_size != 0:
+        sys.exit("размер входа не кратен размеру кадра (%d байт)" % frame_size)
+
+    frames = [raw[i:i + frame_size] for i in range(0, len(raw), frame_size)]
+    data = encode(frames, args.pixels, args.interval, args.loop, args.keyframe_interval)
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    print("%d кадров, %d -> %d байт (%.1f%%)" % (len(frames), len(raw), len(data),
+                                                  100.0 * len(data) / len(raw)))
+
+
+if __name__ == "__main__":
+    main()
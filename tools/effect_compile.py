@@ -0,0 +1,374 @@
+#!/usr/bin/env python3
+"""Компилятор пользовательских эффектов для LED часов (байткод LCV1, см. src/effect_vm.h).
+
+Программа выполняется для каждого пикселя и задает его цвет через r, g, b:
+
+    # радуга по ленте, погашенные сегменты темные
+    let x = t / 8 + i * 4
+    r = lit ? pal_r(x) : 0
+    g = lit ? pal_g(x) : 0
+    b = lit ? pal_b(x) : 0
+
+Входные значения: i (номер пикселя), seg (0-6, 255 вне цифр), digit (0-3, 255 вне цифр),
+lit (1, если пиксель горит), t (мс), frame, red, green, blue (выбранный цвет).
+Функции: sin8(x), pal_r(x), pal_g(x), pal_b(x), min(a, b), max(a, b).
+Операторы по убыванию приоритета: унарные - и !, * / %, + -, << >>, &, ^, |,
+< > <= >=, == !=, ?: . Все вычисления в 32-битных целых.
+
+Пример:
+    python3 tools/effect_compile.py rainbow.fx rainbow.lcv
+Загрузка на часы:
+    curl -F "file=@rainbow.lcv" http://<ip>/program
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+OPCODES = [
+    "END", "PUSH8", "PUSH16", "LOAD", "STORE", "DUP", "DROP", "SWAP",
+    "ADD", "SUB", "MUL", "DIV", "MOD", "AND", "OR", "XOR",
+    "SHL", "SHR", "NEG", "LT", "GT", "EQ", "MIN", "MAX",
+    "SELECT", "SIN8", "PAL_R", "PAL_G", "PAL_B", "PIXEL", "SEGMENT", "DIGIT",
+    "LIT", "TIME", "FRAME", "RED", "GREEN", "BLUE",
+]
+OP = {name: code for code, name in enumerate(OPCODES)}
+
+# Должно совпадать с effect_vm.h
+MAX_CODE = 512
+STACK_SIZE = 16
+LOCALS = 8
+
+INPUTS = {
+    "i": "PIXEL", "seg": "SEGMENT", "digit": "DIGIT", "lit": "LIT",
+    "t": "TIME", "frame": "FRAME", "red": "RED", "green": "GREEN", "blue": "BLUE",
+}
+FUNCTIONS = {
+    "sin8": ("SIN8", 1), "pal_r": ("PAL_R", 1), "pal_g": ("PAL_G", 1), "pal_b": ("PAL_B", 1),
+    "min": ("MIN", 2), "max": ("MAX", 2),
+}
+OUTPUTS = ("r", "g", "b")
+
+# Уровни приоритета бинарных операторов, от слабого к сильному
+BINARY_LEVELS = [
+    ["==", "!="],
+    ["<", ">", "<=", ">="],
+    ["|"],
+    ["^"],
+    ["&"],
+    ["<<", ">>"],
+    ["+", "-"],
+    ["*", "/", "%"],
+]
+BINARY_OPS = {
+    "+": ["ADD"], "-": ["SUB"], "*": ["MUL"], "/": ["DIV"], "%": ["MOD"],
+    "&": ["AND"], "|": ["OR"], "^": ["XOR"], "<<": ["SHL"], ">>": ["SHR"],
+    "<": ["LT"], ">": ["GT"], "==": ["EQ"],
+    "!=": ["EQ", ("PUSH8", 0), "EQ"],
+    "<=": ["GT", ("PUSH8", 0), "EQ"],
+    ">=": ["LT", ("PUSH8", 0), "EQ"],
+}
+
+TOKEN = re.compile(r"\s*(?:(\d+)|([A-Za-z_]\w*)|(<<|>>|<=|>=|==|!=|[-+*/%&|^<>!?:(),=]))")
+
+
+class CompileError(Exception):
+    pass
+
+
+def wrap32(value):
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def fold(op, a, b):
+    """Свертка констант с той же семантикой, что и в EffectVM."""
+    if op == "+": return wrap32(a + b)
+    if op == "-": return wrap32(a - b)
+    if op == "*": return wrap32(a * b)
+    if op == "/":
+        if b == 0: return 0
+        q = abs(a) // abs(b)
+        return wrap32(q if (a < 0) == (b < 0) else -q)
+    if op == "%":
+        if b == 0 or b == -1: return 0
+        return wrap32(a - fold("/", a, b) * b)
+    if op == "&": return wrap32(a & b)
+    if op == "|": return wrap32(a | b)
+    if op == "^": return wrap32(a ^ b)
+    if op == "<<": return wrap32(a << (b & 31))
+    if op == ">>": return wrap32(a >> (b & 31))
+    if op == "<": return int(a < b)
+    if op == ">": return int(a > b)
+    if op == "==": return int(a == b)
+    if op == "!=": return int(a != b)
+    if op == "<=": return int(a <= b)
+    if op == ">=": return int(a >= b)
+    raise CompileError("неизвестный оператор " + op)
+
+
+def tokenize(text, line):
+    tokens = []
+    pos = 0
+    text = text.rstrip()
+    while pos < len(text):
+        match = TOKEN.match(text, pos)
+        if not match:
+            raise CompileError("строка %d: непонятный символ '%s'" % (line, text[pos:].strip()[0]))
+        number, name, symbol = match.groups()
+        if number is not None:
+            tokens.append(("num", int(number)))
+        elif name is not None:
+            tokens.append(("name", name))
+        else:
+            tokens.append(("op", symbol))
+        pos = match.end()
+    return tokens
+
+
+class Parser:
+    """Разбор выражения в дерево: ("num", v), ("in", op), ("var", n), ("call", op, args),
+    ("neg", e), ("not", e), ("bin", op, a, b), ("select", c, a, b)."""
+
+    def __init__(self, tokens, line, variables):
+        self.tokens = tokens
+        self.pos = 0
+        self.line = line
+        self.variables = variables
+
+    def error(self, message):
+        raise CompileError("строка %d: %s" % (self.line, message))
+
+    def peek(self):
+        return self.tokens[self.pos] if self.pos < len(self.tokens) else (None, None)
+
+    def take(self, symbol=None):
+        token = self.peek()
+        if token[0] is None:
+            self.error("неожиданный конец строки")
+        if symbol is not None and token != ("op", symbol):
+            self.error("ожидалось '%s'" % symbol)
+        self.pos += 1
+        return token
+
+    def parse(self):
+        node = self.ternary()
+        if self.pos != len(self.tokens):
+            self.error("лишний текст после выражения")
+        return node
+
+    def ternary(self):
+        condition = self.binary(0)
+        if self.peek() == ("op", "?"):
+            self.take("?")
+            a = self.ternary()
+            self.take(":")
+            b = self.ternary()
+            if condition[0] == "num":
+                return a if condition[1] else b
+            return ("select", condition, a, b)
+        return condition
+
+    def binary(self, level):
+        if level == len(BINARY_LEVELS):
+            return self.unary()
+        node = self.binary(level + 1)
+        while self.peek()[0] == "op" and self.peek()[1] in BINARY_LEVELS[level]:
+            op = self.take()[1]
+            right = self.binary(level + 1)
+            if node[0] == "num" and right[0] == "num":
+                node = ("num", fold(op, node[1], right[1]))
+            else:
+                node = ("bin", op, node, right)
+        return node
+
+    def unary(self):
+        if self.peek() == ("op", "-"):
+            self.take()
+            node = self.unary()
+            return ("num", wrap32(-node[1])) if node[0] == "num" else ("neg", node)
+        if self.peek() == ("op", "!"):
+            self.take()
+            node = self.unary()
+            return ("num", int(node[1] == 0)) if node[0] == "num" else ("not", node)
+        return self.primary()
+
+    def primary(self):
+        kind, value = self.take()
+        if kind == "num":
+            return ("num", wrap32(value))
+        if kind == "op" and value == "(":
+            node = self.ternary()
+            self.take(")")
+            return node
+        if kind == "name":
+            if value in FUNCTIONS:
+                op, arity = FUNCTIONS[value]
+                self.take("(")
+                args = [self.ternary()]
+                while len(args) < arity:
+                    self.take(",")
+                    args.append(self.ternary())
+                self.take(")")
+                return ("call", op, args)
+            if value in INPUTS:
+                return ("in", INPUTS[value])
+            if value in self.variables:
+                return ("var", self.variables[value])
+            self.error("неизвестное имя '%s'" % value)
+        self.error("ожидалось выражение")
+
+
+def emit_push(code, value):
+    if 0 <= value <= 255:
+        code += bytes([OP["PUSH8"], value])
+    elif -32768 <= value <= 32767:
+        code += bytes([OP["PUSH16"]]) + struct.pack("<h", value)
+    else:
+        raise CompileError("константа %d не помещается в 16 бит" % value)
+
+
+def emit(code, node):
+    kind = node[0]
+    if kind == "num":
+        emit_push(code, node[1])
+    elif kind == "in":
+        code.append(OP[node[1]])
+    elif kind == "var":
+        code += bytes([OP["LOAD"], node[1]])
+    elif kind == "call":
+        for arg in node[2]:
+            emit(code, arg)
+        code.append(OP[node[1]])
+    elif kind == "neg":
+        emit(code, node[1])
+        code.append(OP["NEG"])
+    elif kind == "not":
+        emit(code, node[1])
+        code += bytes([OP["PUSH8"], 0, OP["EQ"]])
+    elif kind == "bin":
+        emit(code, node[2])
+        emit(code, node[3])
+        for op in BINARY_OPS[node[1]]:
+            if isinstance(op, tuple):
+                code += bytes([OP[op[0]], op[1]])
+            else:
+                code.append(OP[op])
+    elif kind == "select":
+        emit(code, node[1])
+        emit(code, node[2])
+        emit(code, node[3])
+        code.append(OP["SELECT"])
+
+
+def compile_source(source):
+    variables = {}
+    outputs = {}
+    statements = []
+
+    for line, text in enumerate(source.splitlines(), 1):
+        text = text.split("#", 1)[0]
+        if not text.strip():
+            continue
+        tokens = tokenize(text, line)
+        is_let = tokens[0] == ("name", "let")
+        if is_let:
+            tokens = tokens[1:]
+        if len(tokens) < 3 or tokens[0][0] != "name" or tokens[1] != ("op", "="):
+            raise CompileError("строка %d: ожидалось 'имя = выражение'" % line)
+        name = tokens[0][1]
+        if name in INPUTS or name in FUNCTIONS or name == "let":
+            raise CompileError("строка %d: имя '%s' зарезервировано" % (line, name))
+        if is_let and name in OUTPUTS:
+            raise CompileError("строка %d: r, g, b задаются без let" % line)
+        if not is_let and name not in OUTPUTS and name not in variables:
+            raise CompileError("строка %d: переменная '%s' не объявлена через let" % (line, name))
+
+        expression = Parser(tokens[2:], line, variables).parse()
+        if name not in variables:
+            if len(variables) == LOCALS:
+                raise CompileError("строка %d: больше %d переменных" % (line, LOCALS))
+            variables[name] = len(variables)
+        if name in OUTPUTS:
+            outputs[name] = True
+        statements.append((variables[name], expression))
+
+    code = bytearray()
+    for index, expression in statements:
+        emit(code, expression)
+        code += bytes([OP["STORE"], index])
+    for name in OUTPUTS:
+        if name in outputs:
+            code += bytes([OP["LOAD"], variables[name]])
+        else:
+            emit_push(code, 0)
+    code.append(OP["END"])
+
+    if len(code) > MAX_CODE:
+        raise CompileError("программа длиннее %d байт (%d)" % (MAX_CODE, len(code)))
+    check_stack(code)
+    return bytes(code)
+
+
+def instructions(code):
+    """Разбор байткода на инструкции: (смещение, имя, операнд)."""
+    pc = 0
+    while pc < len(code):
+        name = OPCODES[code[pc]]
+        if name in ("PUSH8", "LOAD", "STORE"):
+            yield pc, name, code[pc + 1]
+            pc += 2
+        elif name == "PUSH16":
+            yield pc, name, struct.unpack_from("<h", code, pc + 1)[0]
+            pc += 3
+        else:
+            yield pc, name, None
+            pc += 1
+
+
+def check_stack(code):
+    """Та же проверка глубины стека, что и EffectVM::validate."""
+    effects = {"END": (3, 0), "DUP": (1, 2), "DROP": (1, 0), "SWAP": (2, 2), "NEG": (1, 1),
+               "SELECT": (3, 1), "SIN8": (1, 1), "PAL_R": (1, 1), "PAL_G": (1, 1), "PAL_B": (1, 1),
+               "STORE": (1, 0)}
+    depth = 0
+    for _, name, _ in instructions(code):
+        if name in effects:
+            pops, pushes = effects[name]
+        elif name in ("PUSH8", "PUSH16", "LOAD") or name in INPUTS.values():
+            pops, pushes = 0, 1
+        else:
+            pops, pushes = 2, 1
+        depth += pushes - pops
+        if depth > STACK_SIZE:
+            raise CompileError("выражение слишком глубокое: стек больше %d" % STACK_SIZE)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Компиляция пользовательского эффекта для LED часов")
+    parser.add_argument("input", help="исходный текст эффекта")
+    parser.add_argument("output", help="файл .lcv для загрузки на часы")
+    parser.add_argument("--list", action="store_true", help="вывести получившийся байткод")
+    args = parser.parse_args()
+
+    with open(args.input, encoding="utf-8") as f:
+        source = f.read()
+    try:
+        code = compile_source(source)
+    except CompileError as error:
+        sys.exit("%s: %s" % (args.input, error))
+
+    with open(args.output, "wb") as f:
+        f.write(b"LCV1" + struct.pack("<H", len(code)) + code)
+
+    count = 0
+    for pc, name, operand in instructions(code):
+        count += 1
+        if args.list:
+            print("%4d  %-8s%s" % (pc, name, "" if operand is None else " %d" % operand))
+    print("%d байт, %d инструкций на пиксель" % (len(code), count))
+
+
+if __name__ == "__main__":
+    main()
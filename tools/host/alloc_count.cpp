@@ -0,0 +1,36 @@
+// Подсчет выделений памяти в проверках: malloc и free программы заменяются
+// обертками над распределителем glibc, поэтому учитываются и вызовы из libstdc++
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+}
+
+static uint32_t allocations = 0;
+
+uint32_t hostAllocations() { return allocations; }
+
+extern "C" {
+void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) {
+    __libc_free(pointer);
+}
+}
@@ -0,0 +1,92 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Минимальная замена ядра ESP8266 для проверок на хосте.
+// Время виртуальное: идет только через hostAdvance() и delay().
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <functional>
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define PROGMEM
+#define PSTR(x) (x)
+#define F(x) (x)
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+typedef const char* PGM_P;
+
+// В ядре ESP8266 есть всегда, в glibc - только с версии 2.38
+inline size_t hostStrlcpy(char* target, const char* source, size_t size) {
+    size_t length = strlen(source);
+    if (size > 0) {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(target, source, copied);
+        target[copied] = '\0';
+    }
+    return length;
+}
+#define strlcpy hostStrlcpy
+
+template<class T> T constrain(T x, T a, T b) { return x < a ? a : (x > b ? b : x); }
+
+unsigned long millis();
+unsigned long micros();
+uint64_t micros64();
+void delay(unsigned long ms);
+void yield();
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+// Виртуальные часы хоста
+void hostAdvance(uint64_t us);
+uint64_t hostMicros();
+
+class String {
+public:
+    String(const char* text = "") : value(text != nullptr ? text : "") {}
+    const char* c_str() const { return value.c_str(); }
+    unsigned length() const { return value.size(); }
+    bool operator==(const char* text) const { return value == text; }
+private:
+    std::string value;
+};
+
+class Print {
+public:
+    size_t print(const char* text) { return fputs(text, stdout) >= 0 ? strlen(text) : 0; }
+    size_t println(const char* text = "") { return print(text) + print("\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 40000; }
+    uint32_t getMaxFreeBlockSize() { return 30000; }
+    uint8_t getHeapFragmentation() { return 0; }
+    uint32_t getChipId() { return 0x123456; }
+    uint32_t getCycleCount() { return (uint32_t)(hostMicros() * 80); }
+};
+extern EspClass ESP;
+
+#endif
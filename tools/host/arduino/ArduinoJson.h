@@ -0,0 +1,250 @@
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+// Часть ArduinoJson 6, которой пользуются модули прошивки: разбор в дерево, чтение
+// через JsonVariantConst, запись полей документа и сериализация. Емкость документа
+// не ограничивается, числа с точкой и без различаются, как в библиотеке.
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct HostJsonValue {
+    enum Type { NUL, BOOLEAN, INTEGER, REAL, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    bool boolean = false;
+    long long integer = 0;
+    double real = 0;
+    std::string text;
+    std::vector<HostJsonValue> items;
+    std::vector<std::pair<std::string, HostJsonValue>> members;
+
+    const HostJsonValue* find(const char* key) const {
+        if (type != OBJECT) return nullptr;
+        for(auto& member : members) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+    HostJsonValue& member(const char* key) {
+        if (type != OBJECT) {
+            *this = HostJsonValue();
+            type = OBJECT;
+        }
+        for(auto& member : members) {
+            if (member.first == key) return member.second;
+        }
+        members.emplace_back(key, HostJsonValue());
+        return members.back().second;
+    }
+};
+
+class JsonObject;
+class JsonArray;
+
+class JsonVariantConst {
+public:
+    JsonVariantConst(const HostJsonValue* value = nullptr) : value(value) {}
+    bool isNull() const { return value == nullptr || value->type == HostJsonValue::NUL; }
+    size_t size() const {
+        if (value == nullptr) return 0;
+        return value->type == HostJsonValue::ARRAY ? value->items.size() :
+               value->type == HostJsonValue::OBJECT ? value->members.size() : 0;
+    }
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(value ? value->find(key) : nullptr); }
+    JsonVariantConst operator[](int index) const {
+        if (value == nullptr || value->type != HostJsonValue::ARRAY || index < 0 || (size_t)index >= value->items.size()) {
+            return JsonVariantConst();
+        }
+        return JsonVariantConst(&value->items[index]);
+    }
+
+    template<typename T> bool is() const;
+    template<typename T> T as() const;
+
+    operator const char*() const;
+    int operator|(int fallback) const;
+    const char* operator|(const char* fallback) const;
+
+    const HostJsonValue* raw() const { return value; }
+
+protected:
+    const HostJsonValue* value;
+};
+
+template<> inline bool JsonVariantConst::is<int>() const {
+    return value != nullptr && value->type == HostJsonValue::INTEGER && value->integer >= INT32_MIN && value->integer <= INT32_MAX;
+}
+template<> inline bool JsonVariantConst::is<long>() const { return is<int>(); }
+template<> inline bool JsonVariantConst::is<float>() const {
+    return value != nullptr && (value->type == HostJsonValue::INTEGER || value->type == HostJsonValue::REAL);
+}
+template<> inline bool JsonVariantConst::is<double>() const { return is<float>(); }
+template<> inline bool JsonVariantConst::is<bool>() const { return value != nullptr && value->type == HostJsonValue::BOOLEAN; }
+template<> inline bool JsonVariantConst::is<const char*>() const { return value != nullptr && value->type == HostJsonValue::STRING; }
+template<> inline bool JsonVariantConst::is<JsonObject>() const { return value != nullptr && value->type == HostJsonValue::OBJECT; }
+template<> inline bool JsonVariantConst::is<JsonArray>() const { return value != nullptr && value->type == HostJsonValue::ARRAY; }
+
+template<> inline long long JsonVariantConst::as<long long>() const {
+    if (value == nullptr) return 0;
+    if (value->type == HostJsonValue::INTEGER) return value->integer;
+    if (value->type == HostJsonValue::REAL) return (long long)value->real;
+    if (value->type == HostJsonValue::BOOLEAN) return value->boolean;
+    return 0;
+}
+template<> inline int JsonVariantConst::as<int>() const { return (int)as<long long>(); }
+template<> inline long JsonVariantConst::as<long>() const { return (long)as<long long>(); }
+template<> inline double JsonVariantConst::as<double>() const {
+    if (value == nullptr) return 0;
+    if (value->type == HostJsonValue::REAL) return value->real;
+    return (double)as<long long>();
+}
+template<> inline float JsonVariantConst::as<float>() const { return (float)as<double>(); }
+template<> inline bool JsonVariantConst::as<bool>() const { return value != nullptr && value->type == HostJsonValue::BOOLEAN && value->boolean; }
+template<> inline const char* JsonVariantConst::as<const char*>() const {
+    return value != nullptr && value->type == HostJsonValue::STRING ? value->text.c_str() : nullptr;
+}
+
+inline JsonVariantConst::operator const char*() const { return as<const char*>(); }
+inline int JsonVariantConst::operator|(int fallback) const { return is<int>() ? as<int>() : fallback; }
+inline const char* JsonVariantConst::operator|(const char* fallback) const {
+    return is<const char*>() ? as<const char*>() : fallback;
+}
+
+// Перебор массива: for(JsonObjectConst item : array)
+class JsonArrayConst : public JsonVariantConst {
+public:
+    JsonArrayConst(JsonVariantConst variant = JsonVariantConst())
+        : JsonVariantConst(variant.is<JsonArray>() ? variant.raw() : nullptr) {}
+
+    class iterator {
+    public:
+        explicit iterator(const HostJsonValue* item) : item(item) {}
+        JsonVariantConst operator*() const { return JsonVariantConst(item); }
+        iterator& operator++() { item++; return *this; }
+        bool operator!=(const iterator& other) const { return item != other.item; }
+    private:
+        const HostJsonValue* item;
+    };
+    iterator begin() const { return iterator(value ? value->items.data() : nullptr); }
+    iterator end() const { return iterator(value ? value->items.data() + value->items.size() : nullptr); }
+};
+
+class JsonObjectConst : public JsonVariantConst {
+public:
+    JsonObjectConst(JsonVariantConst variant = JsonVariantConst())
+        : JsonVariantConst(variant.is<JsonObject>() ? variant.raw() : nullptr) {}
+};
+
+// Поле документа для записи: создается только при присваивании
+class JsonMember {
+public:
+    JsonMember(HostJsonValue* object, const char* key) : object(object), key(key) {}
+
+    JsonMember& operator=(const char* text) {
+        HostJsonValue& target = object->member(key.c_str());
+        target = HostJsonValue();
+        if (text != nullptr) {
+            target.type = HostJsonValue::STRING;
+            target.text = text;
+        }
+        return *this;
+    }
+    JsonMember& operator=(bool flag) {
+        HostJsonValue& target = object->member(key.c_str());
+        target = HostJsonValue();
+        target.type = HostJsonValue::BOOLEAN;
+        target.boolean = flag;
+        return *this;
+    }
+    JsonMember& operator=(long long number) {
+        HostJsonValue& target = object->member(key.c_str());
+        target = HostJsonValue();
+        target.type = HostJsonValue::INTEGER;
+        target.integer = number;
+        return *this;
+    }
+    JsonMember& operator=(int number) { return *this = (long long)number; }
+    JsonMember& operator=(unsigned number) { return *this = (long long)number; }
+    JsonMember& operator=(long number) { return *this = (long long)number; }
+    JsonMember& operator=(unsigned long number) { return *this = (long long)number; }
+    JsonMember& operator=(uint8_t number) { return *this = (long long)number; }
+    JsonMember& operator=(double number) {
+        HostJsonValue& target = object->member(key.c_str());
+        target = HostJsonValue();
+        target.type = HostJsonValue::REAL;
+        target.real = number;
+        return *this;
+    }
+    JsonMember& operator=(float number) { return *this = (double)number; }
+
+    JsonVariantConst read() const { return JsonVariantConst(object->find(key.c_str())); }
+    operator JsonVariantConst() const { return read(); }
+    operator JsonArrayConst() const { return JsonArrayConst(read()); }
+    operator JsonObjectConst() const { return JsonObjectConst(read()); }
+    operator const char*() const { return read().as<const char*>(); }
+    JsonVariantConst operator[](const char* child) const { return read()[child]; }
+    template<typename T> bool is() const { return read().is<T>(); }
+    template<typename T> T as() const { return read().as<T>(); }
+    bool isNull() const { return read().isNull(); }
+    int operator|(int fallback) const { return read() | fallback; }
+
+private:
+    HostJsonValue* object;
+    std::string key;
+};
+
+class JsonObject {
+public:
+    explicit JsonObject(HostJsonValue* value = nullptr) : value(value) {}
+    JsonMember operator[](const char* key) { return JsonMember(value, key); }
+    JsonObject createNestedObject(const char* key) {
+        HostJsonValue& child = value->member(key);
+        child = HostJsonValue();
+        child.type = HostJsonValue::OBJECT;
+        return JsonObject(&child);
+    }
+    bool isNull() const { return value == nullptr; }
+private:
+    HostJsonValue* value;
+};
+
+class JsonArray {};
+
+class JsonDocument {
+public:
+    JsonMember operator[](const char* key) { return JsonMember(&root, key); }
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(root.find(key)); }
+    JsonObject createNestedObject(const char* key) { return JsonObject(&root).createNestedObject(key); }
+    template<typename T> bool is() const { return JsonVariantConst(&root).is<T>(); }
+    JsonVariantConst as() const { return JsonVariantConst(&root); }
+    void clear() { root = HostJsonValue(); }
+    HostJsonValue root;
+};
+
+template<size_t Capacity>
+class StaticJsonDocument : public JsonDocument {};
+
+class DynamicJsonDocument : public JsonDocument {
+public:
+    explicit DynamicJsonDocument(size_t capacity) { (void)capacity; }
+};
+
+class DeserializationError {
+public:
+    enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+    DeserializationError(Code code = Ok) : code(code) {}
+    friend bool operator==(const DeserializationError& error, Code code) { return error.code == code; }
+    friend bool operator!=(const DeserializationError& error, Code code) { return error.code != code; }
+    explicit operator bool() const { return code != Ok; }
+    Code code;
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t length);
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* input) {
+    return deserializeJson(doc, input, strlen(input));
+}
+size_t serializeJson(const JsonDocument& doc, char* output, size_t size);
+
+#endif
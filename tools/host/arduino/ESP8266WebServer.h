@@ -0,0 +1,26 @@
+#ifndef HOST_ESP8266WEBSERVER_H
+#define HOST_ESP8266WEBSERVER_H
+
+#include <ESP8266WiFi.h>
+#include <vector>
+
+// Сервер только с аргументами запроса: проверки задают их через hostSetArg()
+class ESP8266WebServer {
+public:
+    ESP8266WebServer(int = 80) {}
+    int args() const { return names.size(); }
+    const String& argName(int index) const { return names[index]; }
+    const String& arg(int index) const { return values[index]; }
+
+    void hostClearArgs() { names.clear(); values.clear(); }
+    void hostSetArg(const char* name, const char* value) {
+        names.push_back(String(name));
+        values.push_back(String(value));
+    }
+
+private:
+    std::vector<String> names;
+    std::vector<String> values;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiClient.h>
+
+// Блокирующего hostByName() здесь нет намеренно: модули должны разрешать имена асинхронно
+class WiFiClass {
+public:
+    IPAddress localIP() { return ip; }
+    bool isConnected() { return true; }
+    int32_t RSSI() { return -60; }
+    IPAddress ip = IPAddress(192, 168, 1, 10);
+};
+extern WiFiClass WiFi;
+
+#endif
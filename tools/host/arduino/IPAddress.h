@@ -0,0 +1,28 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <Arduino.h>
+
+struct ip_addr_t {
+    uint32_t addr;
+};
+
+// Адрес хранится в сетевом порядке байт, как в lwIP
+class IPAddress {
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t value) : address(value) {}
+    IPAddress(const ip_addr_t* lwip) : address(lwip->addr) {}
+    operator ip_addr_t() const { return ip_addr_t{address}; }
+    operator uint32_t() const { return address; }
+    bool isSet() const { return address != 0; }
+    uint8_t operator[](int index) const { return address >> (index * 8); }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+private:
+    uint32_t address;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+// Файловая система в памяти. Запись сверх hostFsSetCapacity() не проходит, как на полной flash
+struct HostFile;
+
+class File {
+public:
+    File() {}
+    explicit File(std::shared_ptr<HostFile> handle) : handle(handle) {}
+    explicit operator bool() const { return handle != nullptr; }
+    size_t read(uint8_t* buffer, size_t length);
+    int read();
+    size_t write(const uint8_t* data, size_t length);
+    size_t write(uint8_t value) { return write(&value, 1); }
+    bool seek(uint32_t position);
+    size_t position() const;
+    size_t size() const;
+    int available();
+    void close() { handle.reset(); }
+
+private:
+    std::shared_ptr<HostFile> handle;
+};
+
+class LittleFSClass {
+public:
+    bool begin();
+    File open(const char* path, const char* mode);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+};
+extern LittleFSClass LittleFS;
+
+void hostFsSetCapacity(size_t bytes);      // 0 - без ограничения
+void hostFsClear();
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef HOST_NEOPIXELBUS_H
+#define HOST_NEOPIXELBUS_H
+
+#include <Arduino.h>
+#include <vector>
+
+struct Rgb48Color {
+    uint16_t R, G, B;
+    Rgb48Color(uint16_t value = 0) : R(value), G(value), B(value) {}
+    Rgb48Color(uint16_t r, uint16_t g, uint16_t b) : R(r), G(g), B(b) {}
+    bool operator==(const Rgb48Color& other) const { return R == other.R && G == other.G && B == other.B; }
+    bool operator!=(const Rgb48Color& other) const { return !(*this == other); }
+    // Как в NeoPixelBus: progress 0 - left, 255 - почти right
+    static Rgb48Color LinearBlend(const Rgb48Color& left, const Rgb48Color& right, uint8_t progress) {
+        return Rgb48Color(left.R + ((((int32_t)right.R - left.R) * progress + 1) >> 8),
+                          left.G + ((((int32_t)right.G - left.G) * progress + 1) >> 8),
+                          left.B + ((((int32_t)right.B - left.B) * progress + 1) >> 8));
+    }
+};
+
+struct NeoRgbwFeature {
+    static const size_t PixelSize = 4;
+};
+
+// Методы вывода различаются только тем, ждет ли Show() конца передачи
+struct NeoEsp8266Uart1Ws2813Method {
+    static const bool Async = false;
+};
+struct NeoEsp8266DmaWs2812xMethod {
+    static const bool Async = true;
+};
+
+// Шина, которая записывает выведенные кадры вместо передачи по проводу
+struct HostBusLog {
+    uint8_t pin;
+    uint16_t count;
+    std::vector<std::vector<uint8_t>> frames;
+    uint32_t created;
+    bool recording = true;       // false - кадры не сохраняются и память не выделяется
+};
+HostBusLog& hostBusLog(uint8_t pin);
+
+template<typename Feature, typename Method>
+class NeoPixelBus {
+public:
+    NeoPixelBus(uint16_t count, uint8_t pin)
+        : count(count), pin(pin), pixels(count * Feature::PixelSize), busyUntilUs(0) {
+        hostBusLog(pin).count = count;
+        hostBusLog(pin).created++;
+    }
+    void Begin() {}
+    uint8_t* Pixels() { return pixels.data(); }
+    size_t PixelsSize() const { return pixels.size(); }
+    uint16_t PixelCount() const { return count; }
+    void Dirty() {}
+    bool CanShow() const { return hostMicros() >= busyUntilUs; }
+
+    // 30 мкс на пиксель RGBW по проводу; синхронный метод ждет конца передачи
+    void Show() {
+        if (hostBusLog(pin).recording) hostBusLog(pin).frames.push_back(pixels);
+        uint64_t wireUs = (uint64_t)count * Feature::PixelSize * 8 * 1250 / 1000;
+        if (Method::Async) {
+            busyUntilUs = hostMicros() + wireUs;
+        } else {
+            hostAdvance(wireUs);
+        }
+    }
+
+private:
+    uint16_t count;
+    uint8_t pin;
+    std::vector<uint8_t> pixels;
+    uint64_t busyUntilUs;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef HOST_WEBSOCKETSSERVER_H
+#define HOST_WEBSOCKETSSERVER_H
+
+#include <Arduino.h>
+#include <vector>
+#include <deque>
+#include <map>
+
+#define WEBSOCKETS_SERVER_CLIENT_MAX 5
+
+typedef enum { WStype_ERROR, WStype_DISCONNECTED, WStype_CONNECTED, WStype_TEXT, WStype_BIN } WStype_t;
+
+struct HostMessage {
+    uint64_t atUs;               // виртуальное время отправки
+    std::vector<uint8_t> data;
+};
+
+// Сервер без сети: входящие сообщения клиентов доставляются в loop(), исходящие копятся по клиентам
+class WebSocketsServer {
+public:
+    typedef std::function<void(uint8_t, WStype_t, uint8_t*, size_t)> WebSocketServerEvent;
+
+    WebSocketsServer(uint16_t port) : connected() { servers()[port] = this; }
+    // Сервер модуля по порту, чтобы проверка могла играть роль клиентов
+    static WebSocketsServer& hostFind(uint16_t port) { return *servers()[port]; }
+    void begin() {}
+    void onEvent(WebSocketServerEvent handler) { event = handler; }
+
+    void loop() {
+        while (!incoming.empty()) {
+            Incoming message = incoming.front();
+            incoming.pop_front();
+            if (message.connect) {
+                connected[message.client] = true;
+                event(message.client, WStype_CONNECTED, nullptr, 0);
+            } else {
+                event(message.client, WStype_BIN, message.data.data(), message.data.size());
+            }
+        }
+    }
+
+    bool sendBIN(uint8_t client, const uint8_t* data, size_t length) {
+        if (client >= WEBSOCKETS_SERVER_CLIENT_MAX || !connected[client]) return false;
+        outgoing[client].push_back(HostMessage{hostMicros(), std::vector<uint8_t>(data, data + length)});
+        return true;
+    }
+
+    bool broadcastBIN(const uint8_t* data, size_t length) {
+        for(uint8_t client = 0; client < WEBSOCKETS_SERVER_CLIENT_MAX; client++) {
+            sendBIN(client, data, length);
+        }
+        return true;
+    }
+
+    int connectedClients(bool = false) {
+        int count = 0;
+        for(bool client : connected) count += client;
+        return count;
+    }
+
+    void hostConnect(uint8_t client) { incoming.push_back(Incoming{client, true, {}}); }
+    void hostSend(uint8_t client, std::vector<uint8_t> data) { incoming.push_back(Incoming{client, false, data}); }
+    std::vector<HostMessage> hostTake(uint8_t client) {
+        std::vector<HostMessage> messages;
+        messages.swap(outgoing[client]);
+        return messages;
+    }
+
+private:
+    static std::map<uint16_t, WebSocketsServer*>& servers() {
+        static std::map<uint16_t, WebSocketsServer*> registry;
+        return registry;
+    }
+
+    struct Incoming {
+        uint8_t client;
+        bool connect;
+        std::vector<uint8_t> data;
+    };
+
+    WebSocketServerEvent event;
+    bool connected[WEBSOCKETS_SERVER_CLIENT_MAX];
+    std::deque<Incoming> incoming;
+    std::vector<HostMessage> outgoing[WEBSOCKETS_SERVER_CLIENT_MAX];
+};
+
+#endif
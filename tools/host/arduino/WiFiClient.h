@@ -0,0 +1,45 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Соединение TCP внутри процесса: две очереди байт и окно записи клиента
+struct HostConnection {
+    std::deque<uint8_t> toClient;
+    std::deque<uint8_t> toServer;
+    size_t window = 1460;
+    bool open = true;
+};
+
+// Сервер вне программы получает новое соединение и сам разбирает toServer
+typedef std::function<void(std::shared_ptr<HostConnection>)> HostAccept;
+void hostListen(IPAddress ip, uint16_t port, HostAccept accept);
+void hostStopListening(IPAddress ip, uint16_t port);
+uint32_t hostConnectAttempts();
+
+class ClientContext;
+
+// connect() нет намеренно: он блокировал бы на время ответа DNS и установки соединения.
+// Соединение открывает lwIP (lwip/tcp.h), клиент получает его через ClientContext
+class WiFiClient {
+protected:
+    // Как в ядре: открыт только WiFiServer и наследникам
+    WiFiClient(ClientContext* context);
+public:
+    WiFiClient() {}
+    uint8_t connected() { return connection != nullptr && connection->open; }
+    int available() { return connection != nullptr ? connection->toClient.size() : 0; }
+    int read(uint8_t* buffer, size_t size);
+    size_t write(const uint8_t* data, size_t size);
+    size_t availableForWrite() { return connected() ? connection->window : 0; }
+    void setNoDelay(bool) {}
+    void stop();
+private:
+    std::shared_ptr<HostConnection> connection;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include <ESP8266WiFi.h>
+#include <vector>
+#include <deque>
+
+struct HostDatagram {
+    IPAddress source;
+    uint16_t sourcePort;
+    IPAddress destination;
+    uint16_t destinationPort;
+    uint64_t deliverUs;          // виртуальное время доставки
+    std::vector<uint8_t> data;
+};
+
+// Сетевой узел вне программы: получает датаграммы на свой адрес и может ответить через hostSend()
+typedef std::function<void(const HostDatagram&)> HostPeer;
+void hostAddPeer(IPAddress ip, uint16_t port, HostPeer peer);
+void hostClearNetwork();
+// Доставка в сокеты программы: адресные по порту, групповые по группе и порту
+void hostSend(const HostDatagram& datagram);
+
+class WiFiUDP {
+public:
+    WiFiUDP();
+    ~WiFiUDP();
+    uint8_t begin(uint16_t port);
+    uint8_t beginMulticast(IPAddress local, IPAddress group, uint16_t port);
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacketMulticast(IPAddress group, uint16_t port, IPAddress local, int ttl = 1);
+    size_t write(const uint8_t* data, size_t length);
+    size_t write(uint8_t value) { return write(&value, 1); }
+    int endPacket();
+
+    int parsePacket();
+    int available();
+    int read();
+    int read(uint8_t* buffer, size_t length);
+    int read(char* buffer, size_t length) { return read((uint8_t*)buffer, length); }
+    void flush();
+    IPAddress remoteIP() { return current.source; }
+    uint16_t remotePort() { return current.sourcePort; }
+    IPAddress destinationIP() { return current.destination; }
+
+    // Для маршрутизации в hostSend()
+    bool accepts(const HostDatagram& datagram) const;
+    void receive(const HostDatagram& datagram) { queue.push_back(datagram); }
+
+private:
+    IPAddress localIp;
+    IPAddress group;
+    uint16_t port;
+    bool bound;
+    std::deque<HostDatagram> queue;
+    HostDatagram current;
+    size_t readPosition;
+    HostDatagram outgoing;
+};
+
+#endif
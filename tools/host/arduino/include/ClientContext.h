@@ -0,0 +1,17 @@
+#ifndef HOST_CLIENTCONTEXT_H
+#define HOST_CLIENTCONTEXT_H
+
+#include <WiFiClient.h>
+#include <lwip/tcp.h>
+
+class ClientContext;
+typedef void (*discard_cb_t)(void*, ClientContext*);
+
+// Как в ядре ESP8266: забирает установленное соединение lwIP, дальше им владеет WiFiClient
+class ClientContext {
+public:
+    ClientContext(tcp_pcb* pcb, discard_cb_t discard, void* arg);
+    std::shared_ptr<HostConnection> connection;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HOST_LWIP_DNS_H
+#define HOST_LWIP_DNS_H
+
+#include <IPAddress.h>
+#include <lwip/err.h>
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* address, void* arg);
+
+// Как в lwIP: ERR_OK и адрес из кэша или ERR_INPROGRESS и вызов callback позже
+err_t dns_gethostbyname(const char* name, ip_addr_t* address, dns_found_callback found, void* arg);
+
+// Имя разрешается через delayMs виртуального времени; не заданное имя не разрешается
+void hostAddHost(const char* name, IPAddress ip, uint32_t delayMs);
+uint32_t hostDnsQueries();
+
+#endif
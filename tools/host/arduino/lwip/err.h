@@ -0,0 +1,15 @@
+#ifndef HOST_LWIP_ERR_H
+#define HOST_LWIP_ERR_H
+
+#include <stdint.h>
+
+// Коды ошибок lwIP, которые встречаются в прошивке
+typedef int8_t err_t;
+const err_t ERR_OK = 0;
+const err_t ERR_MEM = -1;
+const err_t ERR_INPROGRESS = -5;
+const err_t ERR_ABRT = -13;
+const err_t ERR_RST = -14;
+const err_t ERR_ARG = -16;
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef HOST_LWIP_TCP_H
+#define HOST_LWIP_TCP_H
+
+#include <IPAddress.h>
+#include <lwip/err.h>
+
+// Управляющий блок соединения; на хосте держит адрес и обработчики до установки соединения
+struct tcp_pcb;
+
+typedef err_t (*tcp_connected_fn)(void* arg, tcp_pcb* pcb, err_t err);
+typedef void (*tcp_err_fn)(void* arg, err_t err);
+
+// Как в lwIP: tcp_connect() только отправляет SYN, о соединении сообщает connected
+// между вызовами модулей. Узел без слушателя не отвечает, пока соединение не прервут tcp_abort()
+tcp_pcb* tcp_new();
+void tcp_arg(tcp_pcb* pcb, void* arg);
+void tcp_err(tcp_pcb* pcb, tcp_err_fn err);
+err_t tcp_connect(tcp_pcb* pcb, const ip_addr_t* ip, uint16_t port, tcp_connected_fn connected);
+void tcp_abort(tcp_pcb* pcb);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+// Проверки без фреймворка: ошибка печатается, код возврата теста ненулевой
+static int checkFailures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        checkFailures++; \
+        printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+static int checkResult(const char* name) {
+    printf("%s: %s\n", name, checkFailures == 0 ? "ok" : "FAILED");
+    return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,629 @@
+// Реализация замены ядра для проверок на хосте: виртуальные часы,
+// UDP и TCP внутри процесса, асинхронный DNS с задержкой, файлы в памяти
+// и разбор JSON
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+#include <lwip/tcp.h>
+#include <include/ClientContext.h>
+#include <NeoPixelBus.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include <stdarg.h>
+#include <map>
+#include <string>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+
+static uint64_t virtualUs = 1000000;
+static uint32_t randomState = 1;
+
+struct HostLookup {
+    std::string name;
+    uint64_t readyUs;
+    dns_found_callback found;
+    void* arg;
+};
+
+struct HostName {
+    IPAddress ip;
+    uint32_t delayMs;
+    bool cached;
+};
+
+static std::map<std::string, HostName> hostNames;
+static std::vector<HostLookup> lookups;
+static uint32_t dnsQueries = 0;
+static std::vector<WiFiUDP*> sockets;
+static std::vector<std::pair<std::pair<uint32_t, uint16_t>, HostPeer>> peers;
+static std::vector<std::pair<std::pair<uint32_t, uint16_t>, HostAccept>> listeners;
+static uint32_t connectAttempts = 0;
+
+struct tcp_pcb {
+    void* arg = nullptr;
+    tcp_err_fn err = nullptr;
+    tcp_connected_fn connected = nullptr;
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    uint64_t readyUs = 0;    // 0 - SYN еще не отправлен или остался без ответа
+    std::shared_ptr<HostConnection> connection;
+};
+static std::vector<tcp_pcb*> handshakes;
+const uint64_t HOST_HANDSHAKE_US = 1000;
+
+size_t Print::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vprintf(format, args);
+    va_end(args);
+    return length > 0 ? length : 0;
+}
+
+uint64_t hostMicros() { return virtualUs; }
+uint64_t micros64() { return virtualUs; }
+unsigned long micros() { return (unsigned long)(uint32_t)virtualUs; }
+unsigned long millis() { return (unsigned long)(uint32_t)(virtualUs / 1000); }
+void yield() {}
+void delay(unsigned long ms) { hostAdvance((uint64_t)ms * 1000); }
+
+void hostAdvance(uint64_t us) {
+    virtualUs += us;
+    // Ответы DNS приходят между вызовами модулей, как из контекста lwIP
+    for(size_t i = 0; i < lookups.size();) {
+        if (lookups[i].readyUs > virtualUs) {
+            i++;
+            continue;
+        }
+        HostLookup lookup = lookups[i];
+        lookups.erase(lookups.begin() + i);
+        auto entry = hostNames.find(lookup.name);
+        if (entry == hostNames.end()) {
+            lookup.found(lookup.name.c_str(), nullptr, lookup.arg);
+        } else {
+            entry->second.cached = true;
+            ip_addr_t address = {(uint32_t)entry->second.ip};
+            lookup.found(lookup.name.c_str(), &address, lookup.arg);
+        }
+    }
+    // Ответ на SYN: слушатель получает соединение, модуль - вызов connected
+    for(size_t i = 0; i < handshakes.size();) {
+        tcp_pcb* pcb = handshakes[i];
+        if (pcb->readyUs == 0 || pcb->readyUs > virtualUs) {
+            i++;
+            continue;
+        }
+        handshakes.erase(handshakes.begin() + i);
+        pcb->readyUs = 0;
+        for(auto& listener : listeners) {
+            if (listener.first.first == pcb->ip && listener.first.second == pcb->port) {
+                pcb->connection = std::make_shared<HostConnection>();
+                listener.second(pcb->connection);
+                break;
+            }
+        }
+        if (pcb->connection == nullptr) {
+            // Слушатель пропал во время установки соединения: RST, блок освобождается
+            tcp_err_fn err = pcb->err;
+            void* arg = pcb->arg;
+            delete pcb;
+            if (err != nullptr) err(arg, ERR_RST);
+        } else {
+            pcb->connected(pcb->arg, pcb, ERR_OK);
+        }
+    }
+}
+
+HostBusLog& hostBusLog(uint8_t pin) {
+    static std::map<uint8_t, HostBusLog> buses;
+    buses[pin].pin = pin;
+    return buses[pin];
+}
+
+void randomSeed(unsigned long seed) { randomState = seed ? seed : 1; }
+
+long random(long howBig) {
+    if (howBig <= 0) return 0;
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 1) % howBig;
+}
+
+long random(long howSmall, long howBig) {
+    return howBig > howSmall ? howSmall + random(howBig - howSmall) : howSmall;
+}
+
+void hostAddHost(const char* name, IPAddress ip, uint32_t delayMs) {
+    hostNames[name] = HostName{ip, delayMs, false};
+}
+
+uint32_t hostDnsQueries() { return dnsQueries; }
+
+err_t dns_gethostbyname(const char* name, ip_addr_t* address, dns_found_callback found, void* arg) {
+    dnsQueries++;
+    auto entry = hostNames.find(name);
+    if (entry != hostNames.end() && entry->second.cached) {
+        address->addr = (uint32_t)entry->second.ip;
+        return ERR_OK;
+    }
+    uint32_t delayMs = entry != hostNames.end() ? entry->second.delayMs : 5000;
+    lookups.push_back(HostLookup{name, virtualUs + (uint64_t)delayMs * 1000, found, arg});
+    return ERR_INPROGRESS;
+}
+
+void hostAddPeer(IPAddress ip, uint16_t port, HostPeer peer) {
+    peers.push_back({{(uint32_t)ip, port}, peer});
+}
+
+void hostClearNetwork() {
+    peers.clear();
+    listeners.clear();
+    lookups.clear();
+    hostNames.clear();
+}
+
+void hostSend(const HostDatagram& datagram) {
+    for(WiFiUDP* socket : sockets) {
+        if (socket->accepts(datagram)) socket->receive(datagram);
+    }
+}
+
+WiFiUDP::WiFiUDP() : port(0), bound(false), readPosition(0) {}
+
+WiFiUDP::~WiFiUDP() { stop(); }
+
+uint8_t WiFiUDP::begin(uint16_t localPort) {
+    stop();
+    localIp = WiFi.localIP();
+    port = localPort;
+    bound = true;
+    sockets.push_back(this);
+    return 1;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress local, IPAddress multicast, uint16_t localPort) {
+    begin(localPort);
+    localIp = local;
+    group = multicast;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (!bound) return;
+    for(size_t i = 0; i < sockets.size(); i++) {
+        if (sockets[i] == this) sockets.erase(sockets.begin() + i);
+    }
+    bound = false;
+    queue.clear();
+}
+
+bool WiFiUDP::accepts(const HostDatagram& datagram) const {
+    if (!bound || datagram.destinationPort != port) return false;
+    if (group.isSet() && datagram.destination == group) return datagram.source != localIp;
+    return datagram.destination == localIp;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t remotePort) {
+    outgoing = HostDatagram();
+    outgoing.source = bound ? localIp : WiFi.localIP();
+    outgoing.sourcePort = port;
+    outgoing.destination = ip;
+    outgoing.destinationPort = remotePort;
+    return 1;
+}
+
+int WiFiUDP::beginPacketMulticast(IPAddress multicast, uint16_t remotePort, IPAddress, int) {
+    return beginPacket(multicast, remotePort);
+}
+
+size_t WiFiUDP::write(const uint8_t* data, size_t length) {
+    outgoing.data.insert(outgoing.data.end(), data, data + length);
+    return length;
+}
+
+int WiFiUDP::endPacket() {
+    outgoing.deliverUs = virtualUs;
+    for(auto& peer : peers) {
+        if (peer.first.first == (uint32_t)outgoing.destination && peer.first.second == outgoing.destinationPort) {
+            peer.second(outgoing);
+            return 1;
+        }
+    }
+    hostSend(outgoing);
+    return 1;
+}
+
+int WiFiUDP::parsePacket() {
+    for(size_t i = 0; i < queue.size(); i++) {
+        if (queue[i].deliverUs <= virtualUs) {
+            current = std::move(queue[i]);
+            queue.erase(queue.begin() + i);
+            readPosition = 0;
+            return current.data.size();
+        }
+    }
+    current = HostDatagram();
+    readPosition = 0;
+    return 0;
+}
+
+int WiFiUDP::available() {
+    return current.data.size() - readPosition;
+}
+
+int WiFiUDP::read() {
+    return readPosition < current.data.size() ? current.data[readPosition++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t length) {
+    size_t count = current.data.size() - readPosition;
+    if (length < count) count = length;
+    memcpy(buffer, current.data.data() + readPosition, count);
+    readPosition += count;
+    return count;
+}
+
+void WiFiUDP::flush() {
+    readPosition = current.data.size();
+}
+
+// Файлы в памяти: открытый файл держит ссылку на содержимое, как дескриптор
+LittleFSClass LittleFS;
+static std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> fsFiles;
+static size_t fsCapacity = 0;
+
+struct HostFile {
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t position;
+};
+
+static size_t fsUsed() {
+    size_t used = 0;
+    for(auto& entry : fsFiles) used += entry.second->size();
+    return used;
+}
+
+void hostFsSetCapacity(size_t bytes) { fsCapacity = bytes; }
+void hostFsClear() { fsFiles.clear(); fsCapacity = 0; }
+
+bool LittleFSClass::begin() { return true; }
+
+File LittleFSClass::open(const char* path, const char* mode) {
+    auto found = fsFiles.find(path);
+    if (mode[0] == 'w') {
+        if (found == fsFiles.end()) found = fsFiles.emplace(path, std::make_shared<std::vector<uint8_t>>()).first;
+        found->second->clear();
+    } else if (found == fsFiles.end()) {
+        return File();
+    }
+    return File(std::make_shared<HostFile>(HostFile{found->second, 0}));
+}
+
+bool LittleFSClass::exists(const char* path) { return fsFiles.count(path) != 0; }
+bool LittleFSClass::remove(const char* path) { return fsFiles.erase(path) != 0; }
+
+bool LittleFSClass::rename(const char* from, const char* to) {
+    auto found = fsFiles.find(from);
+    if (found == fsFiles.end()) return false;
+    auto data = found->second;
+    fsFiles.erase(found);
+    fsFiles[to] = data;
+    return true;
+}
+
+size_t File::read(uint8_t* buffer, size_t length) {
+    if (!handle) return 0;
+    size_t left = handle->data->size() - handle->position;
+    if (length > left) length = left;
+    memcpy(buffer, handle->data->data() + handle->position, length);
+    handle->position += length;
+    return length;
+}
+
+int File::read() {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+size_t File::write(const uint8_t* data, size_t length) {
+    if (!handle) return 0;
+    if (fsCapacity != 0) {
+        size_t used = fsUsed();
+        size_t left = used < fsCapacity ? fsCapacity - used : 0;
+        if (length > left) length = left;
+    }
+    std::vector<uint8_t>& content = *handle->data;
+    if (content.size() < handle->position + length) content.resize(handle->position + length);
+    memcpy(content.data() + handle->position, data, length);
+    handle->position += length;
+    return length;
+}
+
+bool File::seek(uint32_t position) {
+    if (!handle || position > handle->data->size()) return false;
+    handle->position = position;
+    return true;
+}
+
+size_t File::position() const { return handle ? handle->position : 0; }
+size_t File::size() const { return handle ? handle->data->size() : 0; }
+int File::available() { return handle ? (int)(handle->data->size() - handle->position) : 0; }
+
+void hostListen(IPAddress ip, uint16_t port, HostAccept accept) {
+    hostStopListening(ip, port);
+    listeners.push_back({{(uint32_t)ip, port}, accept});
+}
+
+void hostStopListening(IPAddress ip, uint16_t port) {
+    for(size_t i = 0; i < listeners.size(); i++) {
+        if (listeners[i].first.first == (uint32_t)ip && listeners[i].first.second == port) {
+            listeners.erase(listeners.begin() + i);
+            return;
+        }
+    }
+}
+
+uint32_t hostConnectAttempts() { return connectAttempts; }
+
+tcp_pcb* tcp_new() { return new tcp_pcb(); }
+void tcp_arg(tcp_pcb* pcb, void* arg) { pcb->arg = arg; }
+void tcp_err(tcp_pcb* pcb, tcp_err_fn err) { pcb->err = err; }
+
+err_t tcp_connect(tcp_pcb* pcb, const ip_addr_t* ip, uint16_t port, tcp_connected_fn connected) {
+    connectAttempts++;
+    pcb->ip = ip->addr;
+    pcb->port = port;
+    pcb->connected = connected;
+    handshakes.push_back(pcb);
+    // Узел без слушателя молчит, как lwIP без RST: блок ждет tcp_abort()
+    for(auto& listener : listeners) {
+        if (listener.first.first == pcb->ip && listener.first.second == port) {
+            pcb->readyUs = virtualUs + HOST_HANDSHAKE_US;
+            break;
+        }
+    }
+    return ERR_OK;
+}
+
+// Как в lwIP: обработчик ошибки получает ERR_ABRT, блок освобождается
+void tcp_abort(tcp_pcb* pcb) {
+    for(size_t i = 0; i < handshakes.size(); i++) {
+        if (handshakes[i] == pcb) {
+            handshakes.erase(handshakes.begin() + i);
+            break;
+        }
+    }
+    tcp_err_fn err = pcb->err;
+    void* arg = pcb->arg;
+    if (pcb->connection != nullptr) pcb->connection->open = false;
+    delete pcb;
+    if (err != nullptr) err(arg, ERR_ABRT);
+}
+
+ClientContext::ClientContext(tcp_pcb* pcb, discard_cb_t, void*) : connection(pcb->connection) {
+    delete pcb;
+}
+
+WiFiClient::WiFiClient(ClientContext* context) : connection(context->connection) {
+    delete context;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (connection == nullptr) return -1;
+    size_t count = 0;
+    while (count < size && !connection->toClient.empty()) {
+        buffer[count++] = connection->toClient.front();
+        connection->toClient.pop_front();
+    }
+    return count;
+}
+
+size_t WiFiClient::write(const uint8_t* data, size_t size) {
+    if (!connected()) return 0;
+    if (size > connection->window) size = connection->window;
+    connection->toServer.insert(connection->toServer.end(), data, data + size);
+    return size;
+}
+
+void WiFiClient::stop() {
+    if (connection != nullptr) connection->open = false;
+    connection.reset();
+}
+
+// Разбор JSON рекурсивным спуском, без ограничения емкости документа
+struct JsonReader {
+    const char* p;
+    const char* end;
+    int depth;
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    }
+
+    DeserializationError::Code parseString(std::string& text) {
+        p++;
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                if (++p >= end) return DeserializationError::IncompleteInput;
+                switch (*p) {
+                    case 'n': text += '\n'; break;
+                    case 't': text += '\t'; break;
+                    case 'r': text += '\r'; break;
+                    case 'b': text += '\b'; break;
+                    case 'f': text += '\f'; break;
+                    case 'u': {
+                        if (end - p < 5) return DeserializationError::IncompleteInput;
+                        unsigned code = strtoul(std::string(p + 1, 4).c_str(), nullptr, 16);
+                        if (code < 0x80) {
+                            text += (char)code;
+                        } else if (code < 0x800) {
+                            text += (char)(0xC0 | (code >> 6));
+                            text += (char)(0x80 | (code & 0x3F));
+                        } else {
+                            text += (char)(0xE0 | (code >> 12));
+                            text += (char)(0x80 | ((code >> 6) & 0x3F));
+                            text += (char)(0x80 | (code & 0x3F));
+                        }
+                        p += 4;
+                        break;
+                    }
+                    default: text += *p; break;
+                }
+                p++;
+            } else {
+                text += *p++;
+            }
+        }
+        if (p >= end) return DeserializationError::IncompleteInput;
+        p++;
+        return DeserializationError::Ok;
+    }
+
+    DeserializationError::Code parse(HostJsonValue& value) {
+        skipSpace();
+        if (p >= end) return DeserializationError::IncompleteInput;
+        if (*p == '{' || *p == '[') {
+            if (++depth > 10) return DeserializationError::TooDeep;
+            bool object = *p == '{';
+            value.type = object ? HostJsonValue::OBJECT : HostJsonValue::ARRAY;
+            char close = object ? '}' : ']';
+            p++;
+            skipSpace();
+            if (p < end && *p == close) {
+                p++;
+                depth--;
+                return DeserializationError::Ok;
+            }
+            while (true) {
+                skipSpace();
+                if (object) {
+                    if (p >= end) return DeserializationError::IncompleteInput;
+                    if (*p != '"') return DeserializationError::InvalidInput;
+                    std::string key;
+                    DeserializationError::Code code = parseString(key);
+                    if (code != DeserializationError::Ok) return code;
+                    skipSpace();
+                    if (p >= end) return DeserializationError::IncompleteInput;
+                    if (*p++ != ':') return DeserializationError::InvalidInput;
+                    value.members.emplace_back(key, HostJsonValue());
+                    code = parse(value.members.back().second);
+                    if (code != DeserializationError::Ok) return code;
+                } else {
+                    value.items.emplace_back();
+                    DeserializationError::Code code = parse(value.items.back());
+                    if (code != DeserializationError::Ok) return code;
+                }
+                skipSpace();
+                if (p >= end) return DeserializationError::IncompleteInput;
+                if (*p == ',') {
+                    p++;
+                    continue;
+                }
+                if (*p++ != close) return DeserializationError::InvalidInput;
+                depth--;
+                return DeserializationError::Ok;
+            }
+        }
+        if (*p == '"') {
+            value.type = HostJsonValue::STRING;
+            return parseString(value.text);
+        }
+        static const struct { const char* word; HostJsonValue::Type type; bool flag; } words[] = {
+            {"true", HostJsonValue::BOOLEAN, true},
+            {"false", HostJsonValue::BOOLEAN, false},
+            {"null", HostJsonValue::NUL, false},
+        };
+        for(auto& word : words) {
+            size_t length = strlen(word.word);
+            if ((size_t)(end - p) >= length && strncmp(p, word.word, length) == 0) {
+                value.type = word.type;
+                value.boolean = word.flag;
+                p += length;
+                return DeserializationError::Ok;
+            }
+        }
+        const char* start = p;
+        bool real = false;
+        if (p < end && *p == '-') p++;
+        while (p < end && (isdigit((unsigned char)*p) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) {
+            if (!isdigit((unsigned char)*p)) real = true;
+            p++;
+        }
+        if (p == start || (p == start + 1 && *start == '-')) return DeserializationError::InvalidInput;
+        std::string number(start, p - start);
+        if (real) {
+            value.type = HostJsonValue::REAL;
+            value.real = strtod(number.c_str(), nullptr);
+        } else {
+            value.type = HostJsonValue::INTEGER;
+            value.integer = strtoll(number.c_str(), nullptr, 10);
+        }
+        return DeserializationError::Ok;
+    }
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t length) {
+    doc.clear();
+    JsonReader reader = {input, input + length, 0};
+    reader.skipSpace();
+    if (reader.p >= reader.end) return DeserializationError::EmptyInput;
+    DeserializationError::Code code = reader.parse(doc.root);
+    if (code != DeserializationError::Ok) doc.clear();
+    return code;
+}
+
+static void writeJson(const HostJsonValue& value, std::string& out) {
+    char number[32];
+    switch (value.type) {
+        case HostJsonValue::NUL: out += "null"; break;
+        case HostJsonValue::BOOLEAN: out += value.boolean ? "true" : "false"; break;
+        case HostJsonValue::INTEGER:
+            snprintf(number, sizeof(number), "%lld", value.integer);
+            out += number;
+            break;
+        case HostJsonValue::REAL:
+            snprintf(number, sizeof(number), "%.9g", value.real);
+            out += number;
+            break;
+        case HostJsonValue::STRING:
+            out += '"';
+            for(char c : value.text) {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c;
+            }
+            out += '"';
+            break;
+        case HostJsonValue::ARRAY:
+            out += '[';
+            for(size_t i = 0; i < value.items.size(); i++) {
+                if (i > 0) out += ',';
+                writeJson(value.items[i], out);
+            }
+            out += ']';
+            break;
+        case HostJsonValue::OBJECT:
+            out += '{';
+            for(size_t i = 0; i < value.members.size(); i++) {
+                if (i > 0) out += ',';
+                HostJsonValue key;
+                key.type = HostJsonValue::STRING;
+                key.text = value.members[i].first;
+                writeJson(key, out);
+                out += ':';
+                writeJson(value.members[i].second, out);
+            }
+            out += '}';
+            break;
+    }
+}
+
+// Как в библиотеке: не поместившийся документ обрезается, возвращается число записанных байт
+size_t serializeJson(const JsonDocument& doc, char* output, size_t size) {
+    std::string text;
+    writeJson(doc.root, text);
+    if (size == 0) return 0;
+    size_t length = text.size() < size - 1 ? text.size() : size - 1;
+    memcpy(output, text.data(), length);
+    output[length] = '\0';
+    return length;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Проверки модулей на хосте с виртуальными часами и сетью внутри процесса.
+#   tools/host/run.sh          - все проверки
+#   tools/host/run.sh sntp     - одна проверка
+set -e
+HOST_DIR=$(cd "$(dirname "$0")" && pwd)
+SRC_DIR="$HOST_DIR/../../src"
+BUILD_DIR="${BUILD_DIR:-$HOST_DIR/build}"
+CXX="${CXX:-g++}"
+CXXFLAGS="-std=gnu++17 -O2 -Wall -Wno-unused-function -I$HOST_DIR/arduino -I$SRC_DIR"
+mkdir -p "$BUILD_DIR"
+
+# Модули прошивки, из которых собирается проверка, и дополнительные файлы из tools/host
+test_sntp="sntp_client.cpp"
+test_http_args="http_args.cpp"
+host_http_args="alloc_count.cpp"
+test_live_control="live_control.cpp scheduler.cpp"
+test_scheduler="scheduler.cpp"
+test_realtime="realtime.cpp effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp"
+test_animation="animation.cpp"
+test_effect_vm="effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp"
+test_phase_sync="phase_sync.cpp"
+test_dither="effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp"
+test_mqtt="mqtt_control.cpp effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp"
+test_schedule="day_schedule.cpp time_zone.cpp presets.cpp content.cpp font7seg.cpp http_args.cpp effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp"
+test_pixel_output="pixel_output.cpp"
+test_alloc="frame_renderer.cpp scheduler.cpp effects.cpp effect_vm.cpp pixel_output.cpp pixel_arena.cpp content.cpp font7seg.cpp day_schedule.cpp time_zone.cpp presets.cpp http_args.cpp realtime.cpp marquee.cpp animation.cpp phase_sync.cpp live_control.cpp"
+host_alloc="alloc_count.cpp"
+
+build() {
+    name=$1
+    sources=$(eval echo "\$test_$name")
+    files="$HOST_DIR/test_$name.cpp $HOST_DIR/host.cpp"
+    for source in $sources; do files="$files $SRC_DIR/$source"; done
+    for source in $(eval echo "\$host_$name"); do files="$files $HOST_DIR/$source"; done
+    $CXX $CXXFLAGS -o "$BUILD_DIR/test_$name" $files
+}
+
+tests=${*:-"sntp http_args live_control scheduler realtime animation effect_vm dither phase_sync mqtt schedule pixel_output alloc"}
+failed=0
+for name in $tests; do
+    build "$name"
+    "$BUILD_DIR/test_$name" || failed=1
+done
+exit $failed
@@ -0,0 +1,221 @@
+// Пути кадра и задач без выделений в куче: кадр прошивки (FrameRenderer) с расписанием,
+// наборами, изменениями из API, анимацией фона, бегущей строкой, общей шкалой фаз и
+// рассылкой состояния, дизеринг, вывод на две цепочки, прием DDP и сам планировщик.
+// Выделения считаются по задачам через те же хуки, что у MemoryMonitor в прошивке.
+// Обработчики HTTP здесь не вызываются: ESP8266WebServer выделяет String на URI, заголовки
+// и каждый аргумент запроса еще до обработчика. Их доля без кучи - разбор аргументов
+// (test_http_args) и запись в ожидающее изменение, которую здесь делает задача input.
+// Пути, собирающие JSON (MQTT, SSE, разбор наборов), не проверяются: замена ArduinoJson
+// на хосте выделяет память, а StaticJsonDocument прошивки - нет
+#include "check.h"
+#include "scheduler.h"
+#include "frame_renderer.h"
+#include <vector>
+
+uint32_t hostAllocations();
+
+const uint16_t PIXELS = 300;
+const uint16_t SPLIT = 150;
+const TimeZone MOSCOW = {3 * 3600, 0, 0, 0, 0};
+const time_t START_EPOCH = 1781201280;        // 21:08 по Москве, правило расписания с 21:10
+const uint16_t ANIM_FRAMES = 8;
+const uint16_t ANIM_INTERVAL_MS = 100;
+
+static PixelArena arena;
+static PixelOutput output;
+static Effects* effects;
+static ContentScheduler content;
+static Marquee marquee;
+static AnimationPlayer animation;
+static PhaseSync phaseSync;
+static LiveControl live;
+static RealtimeReceiver realtime;
+static PresetBank presets;
+static DaySchedule schedule;
+static FrameRenderer frame;
+static ClockSettings settings = {255, 80, 20, 200, STATIC, 128};
+static StateUpdate pendingUpdate = {0, 0, 0, 0, 0, STATIC, TRANSITION_NONE, 0};
+static Scheduler scheduler(micros);
+
+static uint32_t stageStart = 0;
+static uint32_t taskAllocations[SCHEDULER_MAX_TASKS];
+static uint32_t senderAllocations = 0;
+static uint32_t saves = 0;
+static uint32_t inputs = 0;
+
+static time_t epoch() { return START_EPOCH + millis() / 1000; }
+
+static void clockTask() {
+    time_t local = MOSCOW.toLocal(epoch());
+    struct tm date;
+    gmtime_r(&local, &date);
+    content.setTime(date, epoch());
+}
+
+// То, что обработчики /api/state, /color, /brightness и WebSocket пишут между кадрами
+static void inputTask() {
+    inputs++;
+    switch (inputs % 4) {
+    case 0:
+        pendingUpdate.red = inputs;
+        pendingUpdate.green = 255 - inputs;
+        pendingUpdate.blue = 40;
+        pendingUpdate.fields |= UPDATE_COLOR;
+        break;
+    case 1:
+        pendingUpdate.brightness = 100 + inputs % 100;
+        pendingUpdate.fields |= UPDATE_BRIGHTNESS;
+        break;
+    case 2:
+        pendingUpdate.whiteRatio = inputs % 255;
+        pendingUpdate.fields |= UPDATE_WHITE;
+        break;
+    default:
+        pendingUpdate.transition = (Transition)(inputs % TRANSITION_COUNT);
+        pendingUpdate.fields |= UPDATE_TRANSITION;
+        break;
+    }
+}
+
+// Анимация фона из ключевых кадров одного цвета: повторы RLE по 128 байт и остаток
+static void storeAnimation() {
+    std::vector<uint8_t> data = {'L', 'C', 'A', '1', PIXELS & 0xFF, PIXELS >> 8, 3, ANIM_FLAG_LOOP,
+                                 ANIM_INTERVAL_MS & 0xFF, ANIM_INTERVAL_MS >> 8, ANIM_FRAMES, 0, 0, 0, 0, 0};
+    const uint16_t length = PIXELS * 3;
+    for(uint16_t n = 0; n < ANIM_FRAMES; n++) {
+        std::vector<uint8_t> payload;
+        for(uint16_t left = length; left > 0;) {
+            uint16_t run = left < 128 ? left : 128;
+            payload.push_back(0x80 | (run - 1));
+            payload.push_back(n * 30);
+            left -= run;
+        }
+        data.push_back(ANIM_FRAME_KEY);
+        data.push_back(payload.size() & 0xFF);
+        data.push_back(payload.size() >> 8);
+        data.insert(data.end(), payload.begin(), payload.end());
+    }
+    File file = LittleFS.open(ANIM_PATH, "w");
+    file.write(data.data(), data.size());
+    file.close();
+}
+
+// DDP кадр одним пакетом на всю ленту
+static void sendDdpFrame(uint8_t sequence) {
+    HostDatagram datagram;
+    datagram.source = IPAddress(192, 168, 1, 50);
+    datagram.sourcePort = 4048;
+    datagram.destination = WiFi.localIP();
+    datagram.destinationPort = DDP_PORT;
+    datagram.deliverUs = hostMicros();
+    uint16_t length = PIXELS * 3;
+    datagram.data = {0x41, sequence, 0x0B, 0x01, 0, 0, 0, 0, (uint8_t)(length >> 8), (uint8_t)length};
+    datagram.data.resize(datagram.data.size() + length, sequence);
+    hostSend(datagram);
+}
+
+static void run(uint32_t ms, bool stream) {
+    for(uint32_t i = 0; i < ms * 2; i++) {
+        // Отправитель работает вне программы, его выделения не считаются
+        if (stream && i % 33 == 0) {
+            uint32_t before = hostAllocations();
+            sendDdpFrame(i / 33 % 15 + 1);
+            senderAllocations += hostAllocations() - before;
+        }
+        scheduler.run();
+        hostAdvance(500);
+    }
+}
+
+int main() {
+    hostBusLog(OUTPUT_UART_PIN).recording = false;
+    hostBusLog(OUTPUT_DMA_PIN).recording = false;
+    arena.begin((size_t)PIXELS * EFFECTS_BYTES_PER_PIXEL);
+    output.begin(PIXELS);
+    output.configure(PIXELS, SPLIT);
+    effects = new Effects(&output, &arena);
+    effects->setColor(settings.red, settings.green, settings.blue);
+    effects->setBrightness(settings.brightness);
+    effects->setWhiteRatio(settings.whiteRatio);
+
+    // Набор "evening" включает расписание в 21:09, "party" - запрос как у /preset
+    static const char PRESETS[] =
+        "{\"presets\": [{\"name\": \"evening\", \"effect\": \"static\", \"color\": \"#ff2000\","
+        " \"brightness\": 40, \"at\": \"21:09\", \"fade\": 1000},"
+        " {\"name\": \"party\", \"effect\": \"rainbow\", \"color\": \"#00ff40\", \"brightness\": 180,"
+        " \"transition\": 1, \"white\": 0, \"rotation\": \"time:3,date:1\", \"fade\": 500}]}";
+    CHECK(presets.parse(PRESETS, strlen(PRESETS)), "presets rejected: %s", presets.getError());
+    static const char RULES[] = "{\"rules\": [{\"from\": \"21:10\", \"to\": \"07:00\", \"brightness\": 15}]}";
+    schedule.begin(MOSCOW, &presets);
+    CHECK(schedule.parse(RULES, strlen(RULES)), "rules rejected: %s", schedule.getError());
+    CHECK(content.setRotation("time:2,date:2"), "rotation rejected");
+    storeAnimation();
+    animation.begin(PIXELS);
+    CHECK(animation.play(ANIM_PATH), "animation not started");
+    live.begin(&pendingUpdate);
+    realtime.begin(effects);
+
+    FrameSources sources = {effects, &content, &marquee, &animation, &phaseSync, &live, &realtime, &schedule, &presets};
+    frame.begin(sources, &settings, &pendingUpdate, []() { saves++; });
+
+    scheduler.addPeriodic("frame", []() { frame.render(epoch()); }, 50, PRIORITY_FRAME, 5000);
+    scheduler.addPeriodic("dither", []() { effects->refresh(); }, 10, PRIORITY_FRAME, 4000);
+    scheduler.addPeriodic("realtime", []() { realtime.loop(); }, 2, PRIORITY_FRAME, 4000);
+    scheduler.addPeriodic("clock", clockTask, 1000, PRIORITY_HIGH, 500);
+    scheduler.addPeriodic("input", inputTask, 170, PRIORITY_NORMAL, 500);
+    scheduler.setHooks([](uint8_t, uint32_t) {
+        stageStart = hostAllocations();
+    }, [](uint8_t id, uint32_t) {
+        taskAllocations[id] += hostAllocations() - stageStart;
+    });
+
+    // Первые кадры: часы, содержимое и таблица расписания заполняются
+    run(1000, false);
+    memset(taskAllocations, 0, sizeof(taskAllocations));
+    senderAllocations = 0;
+    uint32_t before = hostAllocations();
+
+    // Все встроенные эффекты с плавной сменой через ожидающее изменение,
+    // переходы через точку набора и точку расписания
+    for(uint8_t effect = STATIC; effect < CUSTOM; effect++) {
+        effects->startCrossfade(300);
+        pendingUpdate.effect = (Effect)effect;
+        pendingUpdate.fields |= UPDATE_EFFECT;
+        run(130000 / CUSTOM, false);
+    }
+    bool scheduledPreset = frame.getActivePreset() == presets.find("evening");
+
+    // Набор по запросу и бегущая строка поверх цифр
+    frame.selectPreset(presets.find("party"));
+    CHECK(marquee.enqueue("HELLO 21:10", 1, 10000), "marquee message rejected");
+    run(8000, false);
+
+    // Поток DDP и возврат к эффектам после таймаута
+    run(3000, true);
+    run(REALTIME_TIMEOUT + 1000, false);
+
+    // Вне задач выделяет только отправитель; сумма считается до вывода сообщений
+    uint32_t inTasks = 0;
+    for(uint8_t i = 0; i < scheduler.getTaskCount(); i++) inTasks += taskAllocations[i];
+    uint32_t outside = hostAllocations() - before - senderAllocations - inTasks;
+
+    CHECK(schedule.getStats().transitions >= 2, "schedule point not crossed");
+    CHECK(scheduledPreset, "scheduled preset not applied by the frame");
+    CHECK(frame.getActivePreset() == presets.find("party"), "selected preset not applied by the frame");
+    CHECK(pendingUpdate.fields == 0, "pending update left unapplied");
+    CHECK(saves > 0, "applied changes not handed to the save task");
+    CHECK(animation.getFrameIndex() > 0 && animation.getDecodeErrors() == 0, "background animation not played");
+    CHECK(marquee.getStats().shown >= 1, "marquee message not shown");
+    CHECK(realtime.getStats().frames > 50, "%u DDP frames shown", realtime.getStats().frames);
+    CHECK(!realtime.isActive(), "realtime still active after the timeout");
+    for(uint8_t i = 0; i < scheduler.getTaskCount(); i++) {
+        const Task& task = scheduler.getTask(i);
+        CHECK(taskAllocations[i] == 0, "task %s allocated %u times in %u runs",
+              task.name, taskAllocations[i], task.runs);
+    }
+    CHECK(outside == 0, "scheduler allocated %u times between tasks", outside);
+
+    printf("alloc: frame %u runs, %u inputs, realtime %u DDP frames, schedule %u transitions, %u allocations in tasks\n",
+           scheduler.getTask(0).runs, inputs, realtime.getStats().frames, schedule.getStats().transitions, inTasks);
+    return checkResult("alloc");
+}
@@ -0,0 +1,144 @@
+// Распаковка анимации LCA1 из LittleFS: кадры совпадают с исходными, время распаковки
+// кадра для плавного градиента и для шума (худший случай RLE), порча файла
+#include "check.h"
+#include "animation.h"
+#include <chrono>
+#include <vector>
+
+const uint16_t PIXELS = 300;
+const uint16_t INTERVAL_MS = 20;
+const uint32_t FRAMES = 250;
+
+typedef std::vector<uint8_t> Bytes;
+
+// Тот же RLE, что в tools/anim_encode.py
+static Bytes rleEncode(const Bytes& data) {
+    Bytes out, literal;
+    auto flush = [&]() {
+        if (literal.empty()) return;
+        out.push_back(literal.size() - 1);
+        out.insert(out.end(), literal.begin(), literal.end());
+        literal.clear();
+    };
+    for(size_t i = 0; i < data.size();) {
+        size_t run = 1;
+        while (i + run < data.size() && run < 128 && data[i + run] == data[i]) run++;
+        if (run >= 3) {
+            flush();
+            out.push_back(0x80 | (run - 1));
+            out.push_back(data[i]);
+            i += run;
+        } else {
+            literal.push_back(data[i++]);
+            if (literal.size() == 128) flush();
+        }
+    }
+    flush();
+    return out;
+}
+
+static Bytes encode(const std::vector<Bytes>& frames, bool loop) {
+    Bytes out = {'L', 'C', 'A', '1', PIXELS & 0xFF, PIXELS >> 8, 3, (uint8_t)(loop ? ANIM_FLAG_LOOP : 0),
+                 INTERVAL_MS & 0xFF, INTERVAL_MS >> 8,
+                 (uint8_t)frames.size(), (uint8_t)(frames.size() >> 8), (uint8_t)(frames.size() >> 16), 0, 0, 0};
+    for(size_t n = 0; n < frames.size(); n++) {
+        uint8_t type = ANIM_FRAME_KEY;
+        Bytes payload = rleEncode(frames[n]);
+        if (n > 0) {
+            Bytes diff(frames[n].size());
+            for(size_t i = 0; i < diff.size(); i++) diff[i] = frames[n][i] ^ frames[n - 1][i];
+            Bytes delta = rleEncode(diff);
+            if (delta.size() < payload.size()) {
+                type = ANIM_FRAME_DELTA;
+                payload = delta;
+            }
+        }
+        out.push_back(type);
+        out.push_back(payload.size() & 0xFF);
+        out.push_back(payload.size() >> 8);
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+    return out;
+}
+
+static void store(const char* path, const Bytes& data) {
+    File file = LittleFS.open(path, "w");
+    file.write(data.data(), data.size());
+    file.close();
+}
+
+// Бегущая полоса на темном фоне: длинные повторы и почти пустые разности
+static Bytes bandFrame(uint32_t n) {
+    Bytes frame(PIXELS * 3, 0);
+    for(uint16_t p = 0; p < 40; p++) {
+        uint16_t pixel = (n * 3 + p) % PIXELS;
+        frame[pixel * 3] = 255;
+        frame[pixel * 3 + 1] = p * 6;
+    }
+    return frame;
+}
+
+static Bytes noiseFrame(uint32_t) {
+    Bytes frame(PIXELS * 3);
+    for(uint8_t& value : frame) value = random(256);
+    return frame;
+}
+
+// Проигрывание с проверкой каждого кадра; возвращает среднее время распаковки, нс
+static double playAndMeasure(const char* name, Bytes (*make)(uint32_t)) {
+    std::vector<Bytes> frames;
+    for(uint32_t n = 0; n < FRAMES; n++) frames.push_back(make(n));
+    Bytes file = encode(frames, true);
+    store(ANIM_PATH, file);
+
+    AnimationPlayer player;
+    player.begin(PIXELS);
+    CHECK(player.play(ANIM_PATH), "%s: play failed", name);
+
+    // Три прохода по кругу, один кадр за вызов
+    uint32_t mismatched = 0;
+    double totalNs = 0;
+    uint32_t decoded = 0;
+    for(uint32_t step = 0; step < FRAMES * 3; step++) {
+        uint32_t expected = (step + 1) % FRAMES;
+        hostAdvance(INTERVAL_MS * 1000);
+        auto start = std::chrono::steady_clock::now();
+        player.update(millis());
+        totalNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        decoded++;
+        if (memcmp(player.getFrame(), frames[expected].data(), PIXELS * 3) != 0) mismatched++;
+    }
+    CHECK(player.isPlaying() && player.getDecodeErrors() == 0, "%s: playback stopped", name);
+    CHECK(mismatched == 0, "%s: %u frames differ", name, mismatched);
+    printf("%s: %u frames, %zu -> %zu bytes, %.0f ns per frame\n",
+           name, FRAMES, (size_t)FRAMES * PIXELS * 3, file.size(), totalNs / decoded);
+    return totalNs / decoded;
+}
+
+int main() {
+    playAndMeasure("band", bandFrame);
+    playAndMeasure("noise", noiseFrame);
+
+    // Обрезанный файл: воспроизведение останавливается с ошибкой, а не читает мусор
+    std::vector<Bytes> frames;
+    for(uint32_t n = 0; n < 10; n++) frames.push_back(bandFrame(n));
+    Bytes file = encode(frames, false);
+    file.resize(file.size() - 20);
+    store(ANIM_PATH, file);
+    AnimationPlayer player;
+    player.begin(PIXELS);
+    CHECK(player.play(ANIM_PATH), "truncated file rejected on the first frame");
+    for(uint32_t n = 0; n < 10; n++) {
+        hostAdvance(INTERVAL_MS * 1000);
+        player.update(millis());
+    }
+    CHECK(!player.isPlaying() && player.getDecodeErrors() == 1, "truncated file: errors %u", player.getDecodeErrors());
+
+    // Разностный первый кадр не с чем складывать
+    file = encode(frames, false);
+    file[ANIM_HEADER_SIZE] = ANIM_FRAME_DELTA;
+    store(ANIM_PATH, file);
+    CHECK(!player.play(ANIM_PATH), "delta first frame accepted");
+
+    return checkResult("animation");
+}
@@ -0,0 +1,104 @@
+// Выходной каскад с дизерингом: белый канал при доле 0 и 254, средняя яркость на
+// малых уровнях, время квантования кадра и память под буферы кадра
+#include "check.h"
+#include "effects.h"
+#include <chrono>
+
+const uint16_t PIXELS = 300;              // PixelCountMax в main.cpp
+const uint16_t CLOCK_PIXELS = 90;
+// Единицы: горит мало пикселей, ограничение тока кадр не трогает
+static const uint8_t MASKS[DIGIT_COUNT] = {DIGIT_MASKS[1], DIGIT_MASKS[1], DIGIT_MASKS[1], DIGIT_MASKS[1]};
+const uint16_t LIT_PIXEL = SEG_B * LEDS_PER_SEGMENT;     // первый пиксель сегмента B первой цифры
+
+struct Bench {
+    PixelArena arena;
+    PixelOutput output;
+    Effects* effects;
+
+    Bench(uint16_t pixels) {
+        arena.begin((size_t)PIXELS * EFFECTS_BYTES_PER_PIXEL);
+        output.begin(PIXELS);
+        output.configure(pixels, 0);
+        effects = new Effects(&output, &arena);
+        effects->setEffect(STATIC);
+    }
+    ~Bench() { delete effects; }
+
+    void frame() {
+        effects->showMasks(MASKS, true, false);
+    }
+    const uint8_t* pixel(uint16_t index) { return output.getPixels() + index * StripOrder::SIZE; }
+};
+
+// 8-битный цвет на полной яркости не дает дробной части ни в одном канале
+static void checkWhite() {
+    Bench bench(CLOCK_PIXELS);
+    bench.effects->setColor(200, 100, 50);
+    bench.effects->setBrightness(255);
+    bench.effects->setWhiteRatio(0);
+    for(int i = 0; i < 4; i++) bench.frame();
+    const uint8_t* lit = bench.pixel(LIT_PIXEL);
+    CHECK(!bench.effects->isDithering(), "ratio 0 keeps dithering");
+    CHECK(lit[StripOrder::WHITE] == 0 && lit[StripOrder::RED] == 200 && lit[StripOrder::GREEN] == 100 &&
+          lit[StripOrder::BLUE] == 50, "ratio 0: %u %u %u %u", lit[StripOrder::RED], lit[StripOrder::GREEN],
+          lit[StripOrder::BLUE], lit[StripOrder::WHITE]);
+
+    bench.effects->setWhiteRatio(254);
+    bench.effects->invalidate();
+    for(int i = 0; i < 4; i++) bench.frame();
+    CHECK(!bench.effects->isDithering(), "ratio 254 keeps dithering");
+    CHECK(lit[StripOrder::WHITE] == 50 && lit[StripOrder::RED] == 150 && lit[StripOrder::GREEN] == 50 &&
+          lit[StripOrder::BLUE] == 0, "ratio 254: %u %u %u %u", lit[StripOrder::RED], lit[StripOrder::GREEN],
+          lit[StripOrder::BLUE], lit[StripOrder::WHITE]);
+}
+
+// Ночная яркость: среднее по промежуточным кадрам совпадает с 16-битным значением
+static void checkLowLevels() {
+    Bench bench(CLOCK_PIXELS);
+    bench.effects->setColor(255, 255, 255);
+    bench.effects->setWhiteRatio(0);
+    for(uint8_t brightness = 1; brightness <= 20; brightness++) {
+        bench.effects->setBrightness(brightness);
+        bench.frame();
+        double target = 255.0 * brightness * 0xFF00 / 65025 / 256;
+        uint32_t sum = 0;
+        const uint32_t REFRESHES = 256;
+        for(uint32_t i = 0; i < REFRESHES; i++) {
+            bench.effects->refresh();
+            sum += bench.pixel(LIT_PIXEL)[StripOrder::RED];
+        }
+        double average = (double)sum / REFRESHES;
+        CHECK(fabs(average - target) < 0.01, "brightness %u: average %.3f, expected %.3f", brightness, average, target);
+        CHECK(bench.effects->isDithering() == (fmod(target, 1.0) > 0.001), "brightness %u: dithering flag", brightness);
+    }
+}
+
+// Время одного промежуточного кадра: квантование всей ленты с переносом ошибки
+static void benchmark() {
+    std::vector<uint16_t> frame(PIXELS * 3);
+    for(size_t i = 0; i < frame.size(); i++) frame[i] = (i * 2654435761u) >> 16;
+    std::vector<uint8_t> out(PIXELS * StripOrder::SIZE);
+    std::vector<uint8_t> error(PIXELS * StripOrder::SIZE);
+
+    const uint8_t ratios[] = {0, 128, 254};
+    for(uint8_t ratio : ratios) {
+        const uint32_t FRAMES = 20000;
+        uint32_t active = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t n = 0; n < FRAMES; n++) {
+            active += OutputStage<StripOrder>::convert(frame.data(), out.data(), error.data(), PIXELS, ratio, POWER_SCALE_FULL);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+        CHECK(active == FRAMES, "ratio %u: fractional frame reported as exact", ratio);
+        printf("convert %u pixels, white %3u: %6.0f ns per frame (%.1f ns per pixel)\n", PIXELS, ratio, ns, ns / PIXELS);
+    }
+    printf("memory: %u bytes per pixel in the arena, %u on the wire, %u bytes for %u pixels\n",
+           EFFECTS_BYTES_PER_PIXEL, StripOrder::SIZE, (EFFECTS_BYTES_PER_PIXEL + StripOrder::SIZE) * PIXELS, PIXELS);
+}
+
+int main() {
+    checkWhite();
+    checkLowLevels();
+    benchmark();
+    return checkResult("dither");
+}
@@ -0,0 +1,139 @@
+// Пользовательский эффект против встроенного: время кадра RAINBOW и BREATHING
+// и тех же эффектов программами EffectVM, на ленте только из часов и на длинной ленте.
+// Проверка при загрузке отклоняет программы, которые могли бы выйти за стек или буфер
+#include "check.h"
+#include "effects.h"
+#include <chrono>
+#include <vector>
+
+// tools/effect_compile.py:
+//   let x = t / 50 * 3
+//   r = lit ? pal_r(x) : 0
+//   g = lit ? pal_g(x) : 0
+//   b = lit ? pal_b(x) : 0
+static const uint8_t RAINBOW_PROGRAM[] = {
+    0x4c, 0x43, 0x56, 0x31, 0x2b, 0x00, 0x21, 0x01, 0x32, 0x0b, 0x01, 0x03,
+    0x0a, 0x04, 0x00, 0x20, 0x03, 0x00, 0x1a, 0x01, 0x00, 0x18, 0x04, 0x01,
+    0x20, 0x03, 0x00, 0x1b, 0x01, 0x00, 0x18, 0x04, 0x02, 0x20, 0x03, 0x00,
+    0x1c, 0x01, 0x00, 0x18, 0x04, 0x03, 0x03, 0x01, 0x03, 0x02, 0x03, 0x03,
+    0x00
+};
+
+// tools/effect_compile.py:
+//   let l = sin8(t / 25) * 2 / 5 + 153
+//   r = lit ? red * l >> 8 : 0
+//   g = lit ? green * l >> 8 : 0
+//   b = lit ? blue * l >> 8 : 0
+static const uint8_t BREATHING_PROGRAM[] = {
+    0x4c, 0x43, 0x56, 0x31, 0x3e, 0x00, 0x21, 0x01, 0x19, 0x0b, 0x19, 0x01,
+    0x02, 0x0a, 0x01, 0x05, 0x0b, 0x01, 0x99, 0x08, 0x04, 0x00, 0x20, 0x23,
+    0x03, 0x00, 0x0a, 0x01, 0x08, 0x11, 0x01, 0x00, 0x18, 0x04, 0x01, 0x20,
+    0x24, 0x03, 0x00, 0x0a, 0x01, 0x08, 0x11, 0x01, 0x00, 0x18, 0x04, 0x02,
+    0x20, 0x25, 0x03, 0x00, 0x0a, 0x01, 0x08, 0x11, 0x01, 0x00, 0x18, 0x04,
+    0x03, 0x03, 0x01, 0x03, 0x02, 0x03, 0x03, 0x00
+};
+
+const uint16_t CLOCK_PIXELS = 90;        // PixelCount в main.cpp
+const uint16_t LONG_PIXELS = 300;
+const uint32_t FRAMES = 2000;
+static const uint8_t MASKS[DIGIT_COUNT] = {DIGIT_MASKS[1], DIGIT_MASKS[2], DIGIT_MASKS[3], DIGIT_MASKS[8]};
+
+// Среднее время кадра, нс. Каждый кадр на 50 мс позже, поэтому фаза меняется
+static double frameTime(Effects& effects) {
+    double totalNs = 0;
+    for(uint32_t n = 0; n < FRAMES; n++) {
+        hostAdvance(50000);
+        effects.setPhaseTime(millis());
+        auto start = std::chrono::steady_clock::now();
+        effects.showMasks(MASKS, n % 2 == 0, false);
+        totalNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    return totalNs / FRAMES;
+}
+
+static void compare(uint16_t pixels, Effect native, const uint8_t* program, size_t length, const char* name) {
+    PixelArena arena;
+    arena.begin((size_t)LONG_PIXELS * EFFECTS_BYTES_PER_PIXEL);
+    PixelOutput output;
+    output.begin(LONG_PIXELS);
+    output.configure(pixels, 0);
+    Effects effects(&output, &arena);
+    effects.setColor(255, 120, 40);
+    effects.setBrightness(255);
+
+    EffectVM vm;
+    CHECK(vm.load(program, length) == VM_OK, "%s program rejected", name);
+    effects.setProgram(&vm);
+
+    effects.setEffect(native);
+    double nativeNs = frameTime(effects);
+    effects.setEffect(CUSTOM);
+    double vmNs = frameTime(effects);
+
+    CHECK(vm.getOverruns() == 0, "%s: %u budget overruns", name, vm.getOverruns());
+    CHECK(vm.getLastFrameInstructions() == (uint32_t)vm.getInstructionCount() * pixels,
+          "%s: %u instructions in the last frame", name, vm.getLastFrameInstructions());
+    printf("%-9s %3u pixels: native %6.0f ns, vm %6.0f ns (%4.1fx), %u instructions per pixel\n",
+           name, pixels, nativeNs, vmNs, vmNs / nativeNs, vm.getInstructionCount());
+}
+
+// Код с заголовком "LCV1" и верной длиной
+static VmError loadCode(EffectVM& vm, std::initializer_list<uint8_t> code) {
+    std::vector<uint8_t> data = {'L', 'C', 'V', '1', (uint8_t)code.size(), (uint8_t)(code.size() >> 8)};
+    data.insert(data.end(), code.begin(), code.end());
+    return vm.load(data.data(), data.size());
+}
+
+static void expectError(VmError got, VmError expected, const char* what) {
+    CHECK(got == expected, "%s: %s instead of %s", what, vmErrorName(got), vmErrorName(expected));
+}
+
+static void rejects() {
+    EffectVM vm;
+    CHECK(vm.load(RAINBOW_PROGRAM, sizeof(RAINBOW_PROGRAM)) == VM_OK, "rainbow program rejected");
+    uint16_t instructions = vm.getInstructionCount();
+
+    expectError(loadCode(vm, {VM_PUSH8, 1, VM_ADD, VM_DUP, VM_DUP, VM_END}), VM_ERROR_STACK_UNDERFLOW, "add on one value");
+    expectError(loadCode(vm, {VM_DROP, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END}), VM_ERROR_STACK_UNDERFLOW, "drop on empty stack");
+    std::vector<uint8_t> deep = {'L', 'C', 'V', '1', 0, 0};
+    for(uint8_t i = 0; i <= VM_STACK_SIZE; i++) deep.push_back(VM_PIXEL);
+    deep.push_back(VM_END);
+    deep[4] = deep.size() - VM_HEADER_SIZE;
+    expectError(vm.load(deep.data(), deep.size()), VM_ERROR_STACK_OVERFLOW, "stack deeper than VM_STACK_SIZE");
+    expectError(loadCode(vm, {VM_PIXEL, VM_OPCODE_COUNT, VM_PIXEL, VM_PIXEL, VM_END}), VM_ERROR_OPCODE, "unknown opcode");
+    expectError(loadCode(vm, {0xff}), VM_ERROR_OPCODE, "opcode 0xff");
+    expectError(loadCode(vm, {VM_LOAD, VM_LOCALS, VM_PIXEL, VM_PIXEL, VM_END}), VM_ERROR_LOCAL, "load past the locals");
+    expectError(loadCode(vm, {VM_PIXEL, VM_STORE, 255, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END}), VM_ERROR_LOCAL, "store past the locals");
+    expectError(loadCode(vm, {VM_PIXEL, VM_PIXEL, VM_PUSH16, 0x01}), VM_ERROR_TRUNCATED, "push16 cut after one byte");
+    expectError(loadCode(vm, {VM_PIXEL, VM_PIXEL, VM_PUSH8}), VM_ERROR_TRUNCATED, "push8 without its byte");
+    expectError(loadCode(vm, {VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END}), VM_ERROR_RESULT, "four values at END");
+    expectError(loadCode(vm, {VM_PIXEL, VM_PIXEL, VM_PIXEL}), VM_ERROR_RESULT, "no END");
+    expectError(loadCode(vm, {VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END, VM_PIXEL}), VM_ERROR_RESULT, "code after END");
+
+    const uint8_t wrongMagic[] = {'L', 'C', 'V', '2', 4, 0, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END};
+    expectError(vm.load(wrongMagic, sizeof(wrongMagic)), VM_ERROR_HEADER, "wrong magic");
+    expectError(vm.load(wrongMagic, 5), VM_ERROR_HEADER, "header cut short");
+    const uint8_t longer[] = {'L', 'C', 'V', '1', 5, 0, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END};
+    expectError(vm.load(longer, sizeof(longer)), VM_ERROR_HEADER, "length past the data");
+    const uint8_t shorter[] = {'L', 'C', 'V', '1', 3, 0, VM_PIXEL, VM_PIXEL, VM_PIXEL, VM_END};
+    expectError(vm.load(shorter, sizeof(shorter)), VM_ERROR_HEADER, "length short of the data");
+    const uint8_t empty[] = {'L', 'C', 'V', '1', 0, 0};
+    expectError(vm.load(empty, sizeof(empty)), VM_ERROR_HEADER, "empty program");
+    std::vector<uint8_t> huge(VM_HEADER_SIZE + VM_MAX_CODE + 1, VM_PIXEL);
+    memcpy(huge.data(), "LCV1", 4);
+    huge[4] = (VM_MAX_CODE + 1) & 0xff;
+    huge[5] = (VM_MAX_CODE + 1) >> 8;
+    expectError(vm.load(huge.data(), huge.size()), VM_ERROR_HEADER, "program over VM_MAX_CODE");
+
+    // Отклоненная программа не заменяет загруженную
+    CHECK(vm.isLoaded() && vm.getInstructionCount() == instructions, "rejected program replaced the loaded one");
+}
+
+int main() {
+    rejects();
+    compare(CLOCK_PIXELS, RAINBOW, RAINBOW_PROGRAM, sizeof(RAINBOW_PROGRAM), "rainbow");
+    compare(CLOCK_PIXELS, BREATHING, BREATHING_PROGRAM, sizeof(BREATHING_PROGRAM), "breathing");
+    compare(LONG_PIXELS, RAINBOW, RAINBOW_PROGRAM, sizeof(RAINBOW_PROGRAM), "rainbow");
+    compare(LONG_PIXELS, BREATHING, BREATHING_PROGRAM, sizeof(BREATHING_PROGRAM), "breathing");
+    return checkResult("effect_vm");
+}
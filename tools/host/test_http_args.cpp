@@ -0,0 +1,135 @@
+// Разбор аргументов запроса: сверка со strtol на случайных строках, скорость
+// и выделения памяти за миллион запросов
+#include "check.h"
+#include "http_args.h"
+#include <chrono>
+#include <errno.h>
+#include <limits.h>
+
+uint32_t hostAllocations();
+
+// Эталон: strtol без знака '+', пробелов и ведущих символов
+static bool referenceInt(const char* text, long minValue, long maxValue, long& value) {
+    if (text == nullptr || *text == '\0' || *text == '+' || *text == ' ') return false;
+    if (text[0] == '-' && (text[1] < '0' || text[1] > '9')) return false;
+    if (text[0] != '-' && (text[0] < '0' || text[0] > '9')) return false;
+    errno = 0;
+    char* end;
+    long result = strtol(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || result < minValue || result > maxValue) return false;
+    value = result;
+    return true;
+}
+
+static bool referenceColor(const char* text, uint32_t& rgb) {
+    if (text == nullptr) return false;
+    if (*text == '#') text++;
+    if (strlen(text) != 6) return false;
+    for(int i = 0; i < 6; i++) {
+        if (!isxdigit((unsigned char)text[i])) return false;
+    }
+    rgb = strtoul(text, nullptr, 16);
+    return true;
+}
+
+static void randomText(char* buffer, size_t size) {
+    static const char alphabet[] = "0123456789-+#abcdefABCDEFxyz %";
+    size_t length = random(size);
+    for(size_t i = 0; i < length; i++) {
+        // Чаще цифры: иначе почти все строки отбрасываются на первом символе
+        buffer[i] = random(3) == 0 ? alphabet[random(sizeof(alphabet) - 1)] : '0' + random(10);
+    }
+    buffer[length] = '\0';
+}
+
+static void fuzz() {
+    char text[24];
+    uint32_t accepted = 0;
+    for(uint32_t i = 0; i < 2000000; i++) {
+        randomText(text, i % 4 == 0 ? sizeof(text) : 12);
+        long low = random(3) == 0 ? LONG_MIN : -random(100000);
+        long high = random(3) == 0 ? LONG_MAX : random(100000);
+        long expected = 0, actual = 0;
+        bool expectedOk = referenceInt(text, low, high, expected);
+        bool actualOk = parseBoundedInt(text, low, high, actual);
+        CHECK(expectedOk == actualOk && (!actualOk || expected == actual),
+              "int \"%s\" [%ld, %ld]: %d %ld vs %d %ld", text, low, high, actualOk, actual, expectedOk, expected);
+        accepted += actualOk;
+
+        uint32_t rgb = 0;
+        uint8_t red = 0, green = 0, blue = 0;
+        bool colorOk = referenceColor(text, rgb);
+        CHECK(parseHexColor(text, red, green, blue) == colorOk &&
+              (!colorOk || (uint32_t)((red << 16) | (green << 8) | blue) == rgb), "color \"%s\"", text);
+        if (checkFailures > 10) return;
+    }
+    // Граничные значения
+    long value;
+    CHECK(parseBoundedInt("-9223372036854775808", LONG_MIN, LONG_MAX, value) && value == LONG_MIN, "LONG_MIN");
+    CHECK(!parseBoundedInt("9223372036854775808", LONG_MIN, LONG_MAX, value), "LONG_MAX + 1");
+    CHECK(!parseBoundedInt("-", LONG_MIN, LONG_MAX, value), "lone minus");
+    printf("fuzz: %u of 2000000 integers accepted\n", accepted);
+}
+
+// Аргументы в произвольном порядке, с повторами и отсутствующие
+static void fuzzArgs(ESP8266WebServer& server) {
+    static const char* names[] = {"value", "r", "g", "b", "color", "hours", "v", "valu"};
+    for(uint32_t i = 0; i < 200000; i++) {
+        server.hostClearArgs();
+        int count = random(6);
+        const char* expected[8] = {nullptr};
+        char values[6][8];
+        for(int a = 0; a < count; a++) {
+            int name = random(8);
+            snprintf(values[a], sizeof(values[a]), "%ld", random(-300, 300));
+            server.hostSetArg(names[name], values[a]);
+            // Первый аргумент с таким именем, как у ESP8266WebServer::arg(name)
+            if (expected[name] == nullptr) expected[name] = values[a];
+        }
+        for(int name = 0; name < 8; name++) {
+            const char* found = findArg(server, names[name]);
+            CHECK((found == nullptr) == (expected[name] == nullptr) &&
+                  (found == nullptr || strcmp(found, expected[name]) == 0), "arg %s", names[name]);
+            long value = 0;
+            bool ok = argInt(server, names[name], 0, 255, value);
+            long reference = 0;
+            CHECK(ok == referenceInt(expected[name], 0, 255, reference) && (!ok || value == reference), "argInt %s", names[name]);
+        }
+        if (checkFailures > 10) return;
+    }
+}
+
+// Запрос /color?r=..&g=..&b=.. и /brightness?value=.. так, как их разбирают обработчики
+static void requests(ESP8266WebServer& color, ESP8266WebServer& brightness) {
+    const uint32_t count = 1000000;
+    uint32_t allocationsBefore = hostAllocations();
+    auto start = std::chrono::steady_clock::now();
+    long sum = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        long r, g, b, value;
+        if (argInt(color, "r", 0, 255, r) && argInt(color, "g", 0, 255, g) && argInt(color, "b", 0, 255, b)) {
+            sum += r + g + b;
+        }
+        if (argInt(brightness, "value", 0, 255, value)) sum += value;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t allocations = hostAllocations() - allocationsBefore;
+    // Нет выделений - нечему фрагментировать кучу, сколько бы запросов ни пришло
+    printf("requests: %u in %.3f s (%.0f ns each), heap allocations %u, checksum %ld\n",
+           count, seconds, seconds * 1e9 / count, allocations, sum);
+    CHECK(allocations == 0, "%u allocations in %u requests", allocations, count);
+}
+
+int main() {
+    fuzz();
+    ESP8266WebServer server;
+    fuzzArgs(server);
+
+    ESP8266WebServer color, brightness;
+    color.hostSetArg("r", "255");
+    color.hostSetArg("g", "128");
+    color.hostSetArg("b", "7");
+    brightness.hostSetArg("value", "200");
+    requests(color, brightness);
+    return checkResult("http_args");
+}
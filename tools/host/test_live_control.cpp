@@ -0,0 +1,106 @@
+// Канал живого управления: задержка от команды клиента до кадра и до рассылки
+// другим клиентам, склейка команд и отсутствие эха отправителю
+#include "check.h"
+#include "live_control.h"
+#include "scheduler.h"
+
+const uint32_t FRAME_INTERVAL = 50;       // как в main.cpp
+const uint8_t DRAGGING = 0;               // клиент, который тянет ползунок
+const uint8_t WATCHING = 1;               // вторая вкладка
+
+static LiveControl live;
+static StateUpdate pending;
+static StateUpdate current = {0, 255, 0, 0, 255, STATIC};
+static Scheduler scheduler(micros);
+
+static void frameTask() {
+    if (pending.fields & UPDATE_COLOR) {
+        current.red = pending.red;
+        current.green = pending.green;
+        current.blue = pending.blue;
+    }
+    if (pending.fields & UPDATE_BRIGHTNESS) current.brightness = pending.brightness;
+    if (pending.fields & UPDATE_TRANSITION) current.transition = pending.transition;
+    if (pending.fields & UPDATE_WHITE) current.whiteRatio = pending.whiteRatio;
+    pending.fields = 0;
+    live.frameRendered();
+    live.publishState(current);
+}
+
+int main() {
+    live.begin(&pending);
+    scheduler.addPeriodic("frame", frameTask, FRAME_INTERVAL, PRIORITY_FRAME, 5000);
+    scheduler.addPeriodic("ws", []() { live.loop(); }, 2, PRIORITY_NORMAL, 5000);
+    WebSocketsServer& socket = WebSocketsServer::hostFind(LIVE_CONTROL_PORT);
+    socket.hostConnect(DRAGGING);
+    socket.hostConnect(WATCHING);
+    for(int i = 0; i < 200; i++) {
+        scheduler.run();
+        hostAdvance(500);
+    }
+    CHECK(socket.hostTake(DRAGGING).size() == 1, "initial state not sent to the dragging client");
+    socket.hostTake(WATCHING);
+
+    // Ползунок яркости тянут с частотой событий input браузера, около 60 Гц, две секунды
+    uint64_t sentAt[256];
+    uint32_t worstUs = 0, totalUs = 0, seen = 0;
+    uint64_t nextInputUs = hostMicros();
+    uint8_t value = 0;
+    for(uint32_t step = 0; step < 4000; step++) {
+        if (hostMicros() >= nextInputUs && step < 3900) {
+            // Каждое значение новое, чтобы задержка считалась от его собственной отправки
+            value = value == 255 ? 1 : value + 1;
+            sentAt[value] = hostMicros();
+            socket.hostSend(DRAGGING, {LIVE_OP_BRIGHTNESS, value});
+            nextInputUs += 12000 + random(9334);
+        }
+        scheduler.run();
+        hostAdvance(500);
+
+        for(const HostMessage& message : socket.hostTake(WATCHING)) {
+            uint32_t latency = message.atUs - sentAt[message.data[4]];
+            worstUs = std::max(worstUs, latency);
+            totalUs += latency;
+            seen++;
+        }
+        CHECK(socket.hostTake(DRAGGING).empty(), "state echoed to the dragging client at step %u", step);
+    }
+
+    const LiveControlStats& stats = live.getStats();
+    printf("messages %u, coalesced %u, broadcasts %u, to watcher: average %u us, worst %u us, device max %u us\n",
+           stats.messages, stats.coalesced, stats.broadcasts, seen ? totalUs / seen : 0, worstUs, stats.maxLatencyUs);
+    CHECK(seen > 30, "watcher received %u updates", seen);
+    CHECK(current.brightness == value, "last value %u not applied: %u", value, current.brightness);
+    // Команда ждет не дольше одного кадра и одного опроса сокета
+    CHECK(worstUs <= (FRAME_INTERVAL + 2) * 1000 + 1000, "worst latency %u us", worstUs);
+    CHECK(stats.maxLatencyUs <= (FRAME_INTERVAL + 2) * 1000 + 1000, "device latency %u us", stats.maxLatencyUs);
+    CHECK(stats.coalesced > 0, "60 Hz input into 20 Hz frames must coalesce");
+
+    // Команда другого клиента снова доходит до первого
+    socket.hostSend(WATCHING, {LIVE_OP_BRIGHTNESS, 7});
+    for(int i = 0; i < 200; i++) {
+        scheduler.run();
+        hostAdvance(500);
+    }
+    std::vector<HostMessage> messages = socket.hostTake(DRAGGING);
+    CHECK(messages.size() == 1 && messages[0].data[4] == 7, "update from another client not delivered");
+    CHECK(socket.hostTake(WATCHING).empty(), "state echoed to the sender");
+
+    // Стиль перехода и доля белого идут тем же каналом и входят в рассылку состояния
+    uint32_t invalidBefore = live.getStats().invalid;
+    socket.hostSend(WATCHING, {LIVE_OP_WHITE, 255});
+    socket.hostSend(WATCHING, {LIVE_OP_TRANSITION, TRANSITION_COUNT});
+    socket.hostSend(WATCHING, {LIVE_OP_TRANSITION, TRANSITION_FADE});
+    socket.hostSend(WATCHING, {LIVE_OP_WHITE, 128});
+    for(int i = 0; i < 200; i++) {
+        scheduler.run();
+        hostAdvance(500);
+    }
+    CHECK(live.getStats().invalid == invalidBefore + 2, "out-of-range transition or white accepted");
+    CHECK(current.transition == TRANSITION_FADE && current.whiteRatio == 128, "transition or white not applied");
+    messages = socket.hostTake(DRAGGING);
+    CHECK(messages.size() == 1 && messages[0].data.size() == LIVE_STATE_SIZE &&
+          messages[0].data[6] == TRANSITION_FADE && messages[0].data[7] == 128,
+          "transition and white missing from the state message");
+    return checkResult("live_control");
+}
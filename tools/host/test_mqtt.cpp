@@ -0,0 +1,226 @@
+// MqttControl против брокера-заменителя внутри процесса: имя разрешается один раз,
+// имя и соединение TCP ждутся без блокировки, команды Home Assistant, возврат
+// яркости по "ON", обрыв соединения и недоступный брокер
+#include "check.h"
+#include "mqtt_control.h"
+#include <ArduinoJson.h>
+#include <map>
+#include <string>
+#include <vector>
+
+const IPAddress BROKER_IP(10, 0, 0, 5);
+const uint32_t DNS_DELAY_MS = 80;
+
+// Минимальный брокер MQTT 3.1.1: CONNACK, SUBACK, PINGRESP, хранение retain сообщений
+struct Broker {
+    std::shared_ptr<HostConnection> connection;
+    std::vector<uint8_t> input;
+    std::map<std::string, std::string> retained;
+    std::vector<std::string> subscriptions;
+    uint32_t connects = 0;
+
+    void listen() {
+        hostListen(BROKER_IP, MQTT_PORT, [this](std::shared_ptr<HostConnection> accepted) {
+            connection = accepted;
+            input.clear();
+        });
+    }
+
+    void reply(std::initializer_list<uint8_t> bytes) {
+        connection->toClient.insert(connection->toClient.end(), bytes);
+    }
+
+    void send(const char* topic, const char* payload) {
+        uint16_t topicLength = strlen(topic);
+        uint32_t remaining = 2 + topicLength + strlen(payload);
+        connection->toClient.push_back(0x30);
+        do {
+            uint8_t byte = remaining & 0x7F;
+            remaining >>= 7;
+            connection->toClient.push_back(byte | (remaining ? 0x80 : 0));
+        } while (remaining);
+        connection->toClient.push_back(topicLength >> 8);
+        connection->toClient.push_back(topicLength);
+        connection->toClient.insert(connection->toClient.end(), topic, topic + topicLength);
+        connection->toClient.insert(connection->toClient.end(), payload, payload + strlen(payload));
+    }
+
+    static std::string readString(const uint8_t*& p) {
+        uint16_t length = ((uint16_t)p[0] << 8) | p[1];
+        std::string text((const char*)p + 2, length);
+        p += 2 + length;
+        return text;
+    }
+
+    void handle(uint8_t type, const uint8_t* body, uint32_t length) {
+        switch (type & 0xF0) {
+            case 0x10: {
+                // Переменный заголовок 10 байт, затем идентификатор и завещание
+                const uint8_t* p = body + 10;
+                readString(p);
+                std::string willTopic = readString(p);
+                retained[willTopic + "#will"] = readString(p);
+                connects++;
+                reply({0x20, 0x02, 0x00, 0x00});
+                return;
+            }
+            case 0x30: {
+                const uint8_t* p = body;
+                std::string topic = readString(p);
+                std::string payload((const char*)p, length - (p - body));
+                if (type & 0x01) retained[topic] = payload;
+                return;
+            }
+            case 0x80: {
+                const uint8_t* p = body + 2;
+                subscriptions.push_back(readString(p));
+                reply({0x90, 0x03, body[0], body[1], 0x00});
+                return;
+            }
+            case 0xC0:
+                reply({0xD0, 0x00});
+                return;
+        }
+    }
+
+    void poll() {
+        if (connection == nullptr) return;
+        input.insert(input.end(), connection->toServer.begin(), connection->toServer.end());
+        connection->toServer.clear();
+        while (input.size() >= 2) {
+            uint32_t remaining = 0;
+            size_t header = 1;
+            do {
+                remaining |= (uint32_t)(input[header] & 0x7F) << (7 * (header - 1));
+            } while ((input[header++] & 0x80) && header < input.size());
+            if (input.size() < header + remaining) return;
+            handle(input[0], input.data() + header, remaining);
+            input.erase(input.begin(), input.begin() + header + remaining);
+        }
+    }
+
+    // Обрыв со стороны брокера: завещание публикуется вместо клиента
+    void drop() {
+        connection->open = false;
+        connection.reset();
+        retained["ledclock/test/status"] = "offline";
+    }
+};
+
+static Broker broker;
+static MqttControl mqtt;
+static StateUpdate pending;
+static StateUpdate current = {0, 255, 128, 0, 200, STATIC};
+static uint32_t longestLoopUs = 0;
+
+// Основной цикл прошивки: ожидающее изменение применяется к кадру, состояние публикуется
+static void run(uint32_t ms) {
+    for(uint32_t i = 0; i < ms; i++) {
+        hostAdvance(1000);
+        if (pending.fields & UPDATE_COLOR) {
+            current.red = pending.red;
+            current.green = pending.green;
+            current.blue = pending.blue;
+        }
+        if (pending.fields & UPDATE_BRIGHTNESS) current.brightness = pending.brightness;
+        if (pending.fields & UPDATE_EFFECT) current.effect = pending.effect;
+        pending.fields = 0;
+
+        mqtt.publishState(current);
+        uint64_t start = hostMicros();
+        mqtt.loop();
+        uint32_t spent = hostMicros() - start;
+        if (spent > longestLoopUs) longestLoopUs = spent;
+        broker.poll();
+    }
+}
+
+static int reportedBrightness() {
+    StaticJsonDocument<192> doc;
+    const std::string& state = broker.retained["ledclock/test/state"];
+    if (deserializeJson(doc, state.c_str(), state.size()) != DeserializationError::Ok) return -1;
+    return doc["brightness"] | -1;
+}
+
+int main() {
+    hostAddHost("broker.test", BROKER_IP, DNS_DELAY_MS);
+    broker.listen();
+    pending = current;
+    mqtt.begin("broker.test", MQTT_PORT, "test", &pending);
+
+    // Пока DNS не ответил, соединения нет и loop() не ждет
+    run(DNS_DELAY_MS / 2);
+    CHECK(hostDnsQueries() == 1, "%u DNS queries while resolving", hostDnsQueries());
+    CHECK(hostConnectAttempts() == 0, "connect before the name resolved");
+    CHECK(longestLoopUs == 0, "loop() blocked for %u us while resolving", longestLoopUs);
+
+    run(500);
+    CHECK(mqtt.isConnected(), "not connected after the name resolved");
+    CHECK(broker.connects == 1, "%u CONNECT packets", broker.connects);
+    CHECK(broker.retained["ledclock/test/status"] == "online", "online not published");
+    CHECK(broker.retained["ledclock/test/status#will"] == "offline", "will not set");
+    CHECK(broker.subscriptions.size() == 1 && broker.subscriptions[0] == "ledclock/test/set",
+          "subscription missing");
+    CHECK(broker.retained.count("homeassistant/light/test/config") == 1, "light discovery not published");
+    CHECK(reportedBrightness() == 200, "state brightness %d", reportedBrightness());
+
+    // Команды: цвет и эффект, затем выключение и включение без яркости
+    broker.send("ledclock/test/set", "{\"brightness\":77,\"color\":{\"r\":1,\"g\":2,\"b\":3},\"effect\":\"rainbow\"}");
+    run(20);
+    CHECK(current.brightness == 77 && current.red == 1 && current.blue == 3 && current.effect == RAINBOW,
+          "command not applied: %u %u %u %d", current.brightness, current.red, current.blue, current.effect);
+    broker.send("ledclock/test/set", "{\"state\":\"OFF\"}");
+    run(20);
+    CHECK(current.brightness == 0, "OFF left brightness %u", current.brightness);
+    CHECK(reportedBrightness() == 0, "OFF not reported");
+    broker.send("ledclock/test/set", "{\"state\":\"ON\"}");
+    run(20);
+    CHECK(current.brightness == 77, "ON restored brightness %u instead of 77", current.brightness);
+    CHECK(reportedBrightness() == 77, "ON reported brightness %d", reportedBrightness());
+    broker.send("ledclock/test/set", "{\"state\":\"ON\"}");
+    run(20);
+    CHECK(current.brightness == 77, "repeated ON changed brightness to %u", current.brightness);
+
+    // Неверные команды не применяются частично
+    uint32_t invalid = mqtt.getStats().invalid;
+    broker.send("ledclock/test/set", "{\"brightness\":300,\"effect\":\"sparkle\"}");
+    broker.send("ledclock/test/set", "{\"effect\":\"none\"}");
+    broker.send("ledclock/test/set", "not json");
+    run(20);
+    CHECK(mqtt.getStats().invalid == invalid + 3, "%u invalid commands", mqtt.getStats().invalid - invalid);
+    CHECK(current.effect == RAINBOW && current.brightness == 77, "invalid command applied");
+
+    // Пинг по keepalive без переподключения
+    run(MQTT_KEEPALIVE * 1000);
+    CHECK(mqtt.isConnected() && broker.connects == 1, "keepalive failed");
+
+    // Обрыв: переподключение по уже известному адресу, без нового запроса DNS
+    broker.drop();
+    run(MQTT_RETRY_MIN + 500);
+    CHECK(mqtt.isConnected(), "not reconnected after a drop");
+    CHECK(broker.connects == 2, "%u CONNECT packets after a drop", broker.connects);
+    CHECK(hostDnsQueries() == 1, "reconnect resolved the name again");
+    CHECK(broker.retained["ledclock/test/status"] == "online", "online not restored");
+
+    // Брокер недоступен: соединение ждется в фоне не дольше MQTT_CONNECT_TIMEOUT, имя
+    // разрешается заново, паузы между попытками растут
+    hostStopListening(BROKER_IP, MQTT_PORT);
+    broker.drop();
+    uint32_t attempts = hostConnectAttempts();
+    uint32_t queries = hostDnsQueries();
+    run(MQTT_RETRY_MIN * 8);
+    uint32_t failed = hostConnectAttempts() - attempts;
+    CHECK(failed >= 2 && failed <= 4, "%u attempts to an unreachable broker in %u ms", failed, MQTT_RETRY_MIN * 8);
+    CHECK(hostDnsQueries() - queries >= failed - 1, "name not resolved again after a failed connect");
+    CHECK(longestLoopUs == 0, "loop() blocked for %u us", longestLoopUs);
+
+    // Брокер вернулся
+    broker.listen();
+    run(MQTT_RETRY_MAX + 1000);
+    CHECK(mqtt.isConnected(), "not reconnected after the broker came back");
+    CHECK(longestLoopUs == 0, "loop() blocked for %u us", longestLoopUs);
+
+    printf("mqtt: longest loop %u us, %u connects, %u DNS queries\n",
+           longestLoopUs, mqtt.getStats().connects, hostDnsQueries());
+    return checkResult("mqtt");
+}
@@ -0,0 +1,230 @@
+// Несколько часов в одной группе: у каждого свой кварц со смещением и уходом, пакеты
+// доставляются всем с задержкой и джиттером. Проверяются выборы в порядке номеров,
+// захват роли меньшим номером, отсутствие скачков шкалы и ее расхождение между узлами.
+// Затем часы включают один эффект в разное время, и ведомые подводят его начало к ведущему
+#include "check.h"
+#include "phase_sync.h"
+#include <vector>
+
+const uint8_t NODES = 4;
+// Номера подобраны так, что остаток от деления на разброс идет в обратном порядке
+static const uint32_t IDS[NODES] = {0x100400, 0x2003FF, 0x800002, 0xF00001};
+static const int32_t PPM[NODES] = {-80, 40, 100, -30};
+static const uint32_t START_MS[NODES] = {123456, 5000, 987654, 42};
+
+struct Node {
+    PhaseSync* sync;
+    bool alive;
+    uint32_t lastNow;
+    uint32_t maxBackwardMs;   // шкала не должна идти назад
+    uint32_t maxJumpMs;       // и не должна прыгать вперед после привязки
+    uint8_t effect;
+    uint32_t effectStart;     // начало эффекта по общей шкале, как Effects::phaseStart
+    uint32_t maxShiftMs;      // наибольший сдвиг начала эффекта за шаг
+};
+static Node nodes[NODES];
+
+template<int N>
+unsigned long nodeClock() {
+    int64_t us = hostMicros();
+    return START_MS[N] + (uint32_t)((us + us * PPM[N] / 1000000) / 1000);
+}
+static const SyncClock CLOCKS[NODES] = {nodeClock<0>, nodeClock<1>, nodeClock<2>, nodeClock<3>};
+
+struct InFlight {
+    uint64_t deliverUs;
+    uint8_t from;
+    uint8_t packet[SYNC_PACKET_SIZE];
+};
+static std::vector<InFlight> network;
+
+static void start(uint8_t i) {
+    delete nodes[i].sync;
+    nodes[i].sync = new PhaseSync(CLOCKS[i]);
+    nodes[i].sync->begin(IDS[i], IPAddress(192, 168, 1, 20 + i));
+    nodes[i].alive = true;
+    nodes[i].lastNow = nodes[i].sync->now();
+    nodes[i].effect = 0;
+    nodes[i].effectStart = 0;
+}
+
+// Один шаг 1 мс: доставка, подстройка, рассылка, учет движения шкалы
+static void step() {
+    hostAdvance(1000);
+    for(size_t k = 0; k < network.size();) {
+        if (network[k].deliverUs > hostMicros()) {
+            k++;
+            continue;
+        }
+        for(uint8_t i = 0; i < NODES; i++) {
+            if (nodes[i].alive && i != network[k].from) nodes[i].sync->receive(network[k].packet, SYNC_PACKET_SIZE);
+        }
+        network.erase(network.begin() + k);
+    }
+    for(uint8_t i = 0; i < NODES; i++) {
+        Node& node = nodes[i];
+        if (!node.alive) continue;
+        node.sync->tick();
+        // Как в кадре main.cpp
+        node.sync->setEffect(node.effect);
+        int32_t shift = node.sync->takePhaseShift();
+        if ((uint32_t)abs(shift) > node.maxShiftMs) node.maxShiftMs = abs(shift);
+        node.effectStart += shift;
+        node.sync->setPhaseStart(node.effectStart);
+        if (node.sync->announceDue()) {
+            InFlight flight;
+            flight.deliverUs = hostMicros() + 2000 + random(3000);
+            flight.from = i;
+            node.sync->makeAnnounce(flight.packet);
+            network.push_back(flight);
+        }
+        uint32_t now = node.sync->now();
+        int32_t moved = now - node.lastNow;
+        if (moved < 0 && (uint32_t)-moved > node.maxBackwardMs) node.maxBackwardMs = -moved;
+        if (node.sync->isLocked() && moved > 0 && (uint32_t)moved > node.maxJumpMs) node.maxJumpMs = moved;
+        node.lastNow = now;
+    }
+}
+
+static void run(uint32_t ms) {
+    for(uint32_t i = 0; i < ms; i++) step();
+}
+
+static uint8_t leaders(uint8_t& leader) {
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < NODES; i++) {
+        if (nodes[i].alive && nodes[i].sync->getRole() == SYNC_LEADER) {
+            leader = i;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Наибольшее расхождение шкал живых узлов, мс
+static uint32_t spread() {
+    int32_t reference = 0;
+    bool first = true;
+    uint32_t worst = 0;
+    for(uint8_t i = 0; i < NODES; i++) {
+        if (!nodes[i].alive) continue;
+        int32_t now = nodes[i].sync->now();
+        if (first) {
+            reference = now;
+            first = false;
+        }
+        uint32_t difference = abs(now - reference);
+        if (difference > worst) worst = difference;
+    }
+    return worst;
+}
+
+static void resetMotion() {
+    for(uint8_t i = 0; i < NODES; i++) {
+        nodes[i].maxBackwardMs = 0;
+        nodes[i].maxJumpMs = 0;
+        nodes[i].maxShiftMs = 0;
+    }
+}
+
+// Наибольшее расхождение начала эффекта у узлов 0..count-1, мс
+static uint32_t effectSpread(uint8_t count) {
+    uint32_t worst = 0;
+    for(uint8_t i = 1; i < count; i++) {
+        uint32_t difference = abs((int32_t)(nodes[i].effectStart - nodes[0].effectStart));
+        if (difference > worst) worst = difference;
+    }
+    return worst;
+}
+
+static uint32_t totalSteps() {
+    uint32_t steps = 0;
+    for(uint8_t i = 0; i < NODES; i++) {
+        if (nodes[i].alive) steps += nodes[i].sync->getStats().steps;
+    }
+    return steps;
+}
+
+int main() {
+    for(uint8_t i = 0; i < NODES; i++) start(i);
+
+    // Все стартуют одновременно: ведущим остается меньший номер
+    run(15000);
+    uint8_t leader = 0;
+    CHECK(leaders(leader) == 1 && leader == 0, "%u leaders, leader %u", leaders(leader), leader);
+    for(uint8_t i = 0; i < NODES; i++) {
+        CHECK(nodes[i].sync->getStats().leaderId == IDS[0], "node %u follows %06x", i, nodes[i].sync->getStats().leaderId);
+    }
+
+    // Установившийся режим: расхождение шкал и движение шкалы без скачков
+    resetMotion();
+    uint32_t stepsBefore = totalSteps();
+    uint32_t worstSpread = 0;
+    for(uint32_t second = 0; second < 120; second++) {
+        run(1000);
+        uint32_t current = spread();
+        if (current > worstSpread) worstSpread = current;
+    }
+    printf("steady: worst spread %u ms, jitter", worstSpread);
+    for(uint8_t i = 1; i < NODES; i++) printf(" %u", nodes[i].sync->getStats().jitterMs);
+    printf(" ms\n");
+    CHECK(worstSpread <= 8, "timelines differ by %u ms", worstSpread);
+    CHECK(totalSteps() == stepsBefore, "timeline stepped in steady state");
+    for(uint8_t i = 0; i < NODES; i++) {
+        CHECK(nodes[i].maxBackwardMs == 0 && nodes[i].maxJumpMs <= 2, "node %u moved back %u, jumped %u ms",
+              i, nodes[i].maxBackwardMs, nodes[i].maxJumpMs);
+    }
+
+    // Ведущий пропал: новым становится следующий по номеру, без скачков у ведомых
+    nodes[0].alive = false;
+    resetMotion();
+    stepsBefore = totalSteps();
+    run(SYNC_LEADER_TIMEOUT + SYNC_ELECTION_SPREAD + 3000);
+    CHECK(leaders(leader) == 1 && leader == 1, "after loss: %u leaders, leader %u", leaders(leader), leader);
+    CHECK(totalSteps() == stepsBefore, "timeline stepped on failover");
+    CHECK(spread() <= 8, "after failover timelines differ by %u ms", spread());
+    printf("failover: leader %06x, spread %u ms\n", IDS[leader], spread());
+
+    // Узел с меньшим номером вернулся: перенимает шкалу и забирает роль у живого ведущего
+    start(0);
+    resetMotion();
+    stepsBefore = totalSteps();
+    run(5000);
+    CHECK(leaders(leader) == 1 && leader == 0, "after return: %u leaders, leader %u", leaders(leader), leader);
+    CHECK(nodes[0].sync->getStats().steps == 1, "returning node stepped %u times", nodes[0].sync->getStats().steps);
+    CHECK(totalSteps() == stepsBefore + 1, "other nodes stepped on takeover");
+    for(uint8_t i = 1; i < NODES; i++) {
+        CHECK(nodes[i].maxBackwardMs == 0 && nodes[i].maxJumpMs <= 2, "takeover moved node %u", i);
+    }
+    run(3000);
+    CHECK(spread() <= 8, "after takeover timelines differ by %u ms", spread());
+    printf("takeover: leader %06x, spread %u ms\n", IDS[leader], spread());
+
+    // Один эффект включен на узлах 0-2 с интервалом 700 мс, узел 3 включил другой.
+    // Начало подтягивается к ведущему не быстрее 5% времени, чужой эффект не трогается
+    const uint8_t EFFECT = 2;
+    for(uint8_t i = 0; i < NODES; i++) {
+        nodes[i].effect = i == NODES - 1 ? EFFECT + 1 : EFFECT;
+        nodes[i].effectStart = nodes[i].sync->now();
+        run(700);
+    }
+    uint32_t otherStart = nodes[NODES - 1].effectStart;
+    uint32_t initialSpread = effectSpread(NODES - 1);
+    resetMotion();
+    stepsBefore = totalSteps();
+    run(40000);
+    printf("effect start: spread %u ms -> %u ms, phase error", initialSpread, effectSpread(NODES - 1));
+    for(uint8_t i = 1; i < NODES - 1; i++) printf(" %d", nodes[i].sync->getStats().phaseError);
+    printf(" steps\n");
+    // За время включения ведомые уже подтянулись на 5% от 1400 мс
+    CHECK(initialSpread >= 1300, "effects switched %u ms apart", initialSpread);
+    CHECK(effectSpread(NODES - 1) <= SYNC_PHASE_STEP, "effect starts differ by %u ms", effectSpread(NODES - 1));
+    CHECK(nodes[NODES - 1].effectStart == otherStart, "node with another effect moved its start");
+    CHECK(totalSteps() == stepsBefore, "timeline stepped while effects aligned");
+    for(uint8_t i = 0; i < NODES; i++) {
+        CHECK(nodes[i].maxShiftMs <= 1 && nodes[i].maxBackwardMs == 0 && nodes[i].maxJumpMs <= 2,
+              "node %u: effect start moved %u ms in 1 ms", i, nodes[i].maxShiftMs);
+    }
+
+    return checkResult("phase_sync");
+}
@@ -0,0 +1,89 @@
+// PixelOutput на записывающих шинах: раздача кадра по двум цепочкам, гашение
+// при перенастройке, пересоздание только измененных цепочек и время вывода
+#include "check.h"
+#include "pixel_output.h"
+
+static void fill(PixelOutput& output) {
+    uint8_t* pixels = output.getPixels();
+    for(size_t i = 0; i < output.getPixelsSize(); i++) pixels[i] = (uint8_t)(i * 7 + 1);
+}
+
+// Последний кадр шины совпадает с участком логического кадра
+static bool sentSlice(PixelOutput& output, uint8_t pin, uint16_t first, uint16_t count) {
+    HostBusLog& log = hostBusLog(pin);
+    if (log.frames.empty() || log.frames.back().size() != (size_t)count * StripOrder::SIZE) return false;
+    return memcmp(log.frames.back().data(), output.getPixels() + (size_t)first * StripOrder::SIZE,
+                  (size_t)count * StripOrder::SIZE) == 0;
+}
+
+static bool allZero(const std::vector<uint8_t>& data) {
+    for(uint8_t value : data) if (value != 0) return false;
+    return true;
+}
+
+// Цепочка размещена в самом объекте PixelOutput, а не в куче
+static bool insideObject(const PixelOutput& output, uint8_t index) {
+    const uint8_t* sink = (const uint8_t*)&output.getSink(index);
+    return sink >= (const uint8_t*)&output && sink < (const uint8_t*)(&output + 1);
+}
+
+int main() {
+    HostBusLog& uart = hostBusLog(OUTPUT_UART_PIN);
+    HostBusLog& dma = hostBusLog(OUTPUT_DMA_PIN);
+    PixelOutput output;
+    CHECK(!output.configure(90, 0), "configure before begin accepted");
+    output.begin(600);
+    CHECK(!output.configure(601, 0) && !output.configure(300, 300), "invalid layout accepted");
+
+    // Одна цепочка на UART1
+    CHECK(output.configure(150, 0), "single chain rejected");
+    CHECK(output.getSinkCount() == 1 && insideObject(output, 0), "single chain layout");
+    fill(output);
+    output.show();
+    CHECK(sentSlice(output, OUTPUT_UART_PIN, 0, 150), "uart1 frame differs");
+    CHECK(dma.created == 0, "dma bus created for a single chain");
+
+    // Две цепочки: DMA первой, UART1 передает одновременно с ней
+    uint32_t uartCreated = uart.created;
+    CHECK(output.configure(300, 150), "two chains rejected");
+    CHECK(allZero(uart.frames.back()), "old chain not blanked before the switch");
+    CHECK(uart.created == uartCreated, "unchanged uart1 chain rebuilt");
+    CHECK(output.getSinkCount() == 2 && output.getSink(0).isAsync() && !output.getSink(1).isAsync(),
+          "dma chain must start first");
+    CHECK(insideObject(output, 0) && insideObject(output, 1), "chains allocated outside the object");
+    fill(output);
+    output.show();
+    CHECK(sentSlice(output, OUTPUT_UART_PIN, 0, 150), "uart1 slice differs");
+    CHECK(sentSlice(output, OUTPUT_DMA_PIN, 150, 150), "dma slice differs");
+    uint32_t wireUs = output.getSink(1).getWireUs();
+    CHECK(output.getLastShowUs() == wireUs, "show %u us instead of the uart1 wire time %u us",
+          output.getLastShowUs(), wireUs);
+
+    // Тот же вид - без перестройки и без гашения
+    size_t uartFrames = uart.frames.size();
+    uint32_t dmaCreated = dma.created;
+    CHECK(output.configure(300, 150), "same layout rejected");
+    CHECK(uart.frames.size() == uartFrames && dma.created == dmaCreated, "same layout rebuilt the chains");
+
+    // Длиннее лента - пересоздается только DMA
+    hostAdvance(100000);
+    CHECK(output.configure(450, 150), "longer strip rejected");
+    CHECK(uart.created == uartCreated && dma.created == dmaCreated + 1, "rebuilt %u uart1 and %u dma buses",
+          uart.created - uartCreated, dma.created - dmaCreated);
+    fill(output);
+    output.show();
+    CHECK(sentSlice(output, OUTPUT_DMA_PIN, 150, 300), "longer dma slice differs");
+
+    // Обратно на одну цепочку: DMA гасится и удаляется
+    hostAdvance(100000);
+    CHECK(output.configure(200, 0), "back to one chain rejected");
+    CHECK(allZero(dma.frames.back()), "dma chain not blanked before removal");
+    CHECK(output.getSinkCount() == 1 && !output.getSink(0).isAsync(), "dma chain left after split 0");
+    fill(output);
+    output.show();
+    CHECK(sentSlice(output, OUTPUT_UART_PIN, 0, 200), "uart1 frame after the switch differs");
+
+    printf("pixel_output: %u uart1 and %u dma buses created, sink objects %zu + %zu bytes in place\n",
+           uart.created, dma.created, sizeof(UartSink), sizeof(DmaSink));
+    return checkResult("pixel_output");
+}
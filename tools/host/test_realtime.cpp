@@ -0,0 +1,181 @@
+// Прием DDP от отправителя с частотой 60 кадров в секунду: каждый кадр приходит двумя
+// пакетами с джиттером сети, опрос как у задачи realtime. Затем устаревший номер,
+// два кадра за один опрос и смещение за концом ленты. Яркий поток ограничивается
+// по току и делится на белый канал так же, как кадры часов
+#include "check.h"
+#include "realtime.h"
+
+const uint16_t PIXELS = 300;
+const uint16_t SPLIT = 150;
+const uint32_t FRAME_US = 16667;
+const uint32_t POLL_US = 2000;
+const IPAddress SENDER(192, 168, 1, 50);
+
+static uint8_t sequence = 0;
+
+static void sendPacket(uint32_t offset, const std::vector<uint8_t>& payload, bool push, uint8_t seq, uint32_t delayUs) {
+    HostDatagram datagram;
+    datagram.source = SENDER;
+    datagram.sourcePort = 4048;
+    datagram.destination = WiFi.localIP();
+    datagram.destinationPort = DDP_PORT;
+    datagram.deliverUs = hostMicros() + delayUs;
+    datagram.data = {(uint8_t)(0x40 | (push ? 0x01 : 0)), seq, 0x0B, 0x01,   // RGB, 8 бит
+                     (uint8_t)(offset >> 24), (uint8_t)(offset >> 16), (uint8_t)(offset >> 8), (uint8_t)offset,
+                     (uint8_t)(payload.size() >> 8), (uint8_t)payload.size()};
+    datagram.data.insert(datagram.data.end(), payload.begin(), payload.end());
+    hostSend(datagram);
+}
+
+static uint8_t nextSequence() {
+    sequence = sequence % 15 + 1;
+    return sequence;
+}
+
+// Кадр номер n: пиксель p получает цвет (n, p, n + p) по модулю 16, ток кадра в пределах бюджета
+// Путь один, поэтому пакеты не обгоняют друг друга: второй идет следом за первым
+static void sendFrame(uint32_t n, uint32_t jitterUs) {
+    uint32_t delayUs = random(jitterUs + 1);
+    for(uint16_t half = 0; half < 2; half++) {
+        std::vector<uint8_t> payload;
+        for(uint16_t p = half * SPLIT; p < (half + 1) * SPLIT; p++) {
+            payload.push_back(n % 16);
+            payload.push_back(p % 16);
+            payload.push_back((n + p) % 16);
+        }
+        sendPacket(half * SPLIT * 3, payload, half == 1, nextSequence(), delayUs + half * 50);
+    }
+}
+
+static bool frameMatches(uint32_t n) {
+    const HostBusLog& uart = hostBusLog(OUTPUT_UART_PIN);
+    const HostBusLog& dma = hostBusLog(OUTPUT_DMA_PIN);
+    if (uart.frames.empty() || dma.frames.empty()) return false;
+    for(uint16_t p = 0; p < PIXELS; p++) {
+        const std::vector<uint8_t>& bus = p < SPLIT ? uart.frames.back() : dma.frames.back();
+        const uint8_t* out = bus.data() + (p < SPLIT ? p : p - SPLIT) * StripOrder::SIZE;
+        if (out[StripOrder::RED] != n % 16 || out[StripOrder::GREEN] != p % 16 ||
+            out[StripOrder::BLUE] != (n + p) % 16 || out[StripOrder::WHITE] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void pollFor(RealtimeReceiver& receiver, uint32_t us) {
+    uint64_t end = hostMicros() + us;
+    while (hostMicros() < end) {
+        hostAdvance(POLL_US);
+        receiver.loop();
+    }
+}
+
+int main() {
+    PixelArena arena;
+    arena.begin((size_t)PIXELS * EFFECTS_BYTES_PER_PIXEL);
+    PixelOutput output;
+    output.begin(PIXELS);
+    output.configure(PIXELS, SPLIT);
+    Effects effects(&output, &arena);
+    RealtimeReceiver receiver;
+    receiver.begin(&effects);
+
+    // Десять секунд потока; джиттер меньше интервала кадров
+    const uint32_t FRAMES = 600;
+    uint32_t mismatched = 0;
+    uint64_t maxShowGapUs = 0;
+    uint64_t lastShowUs = 0;
+    uint32_t shown = 0;
+    for(uint32_t n = 0; n < FRAMES; n++) {
+        uint64_t next = hostMicros() + FRAME_US;
+        sendFrame(n, 3000);
+        while (hostMicros() < next) {
+            receiver.loop();
+            if (receiver.getStats().frames != shown) {
+                shown = receiver.getStats().frames;
+                if (!frameMatches(n)) mismatched++;
+                if (lastShowUs != 0 && hostMicros() - lastShowUs > maxShowGapUs) maxShowGapUs = hostMicros() - lastShowUs;
+                lastShowUs = hostMicros();
+            }
+            hostAdvance(POLL_US);
+        }
+    }
+    const RealtimeStats& stats = receiver.getStats();
+    printf("realtime: %u packets, %u frames, %u dropped, %u late, %u invalid, max gap %llu us\n",
+           stats.packets, stats.frames, stats.dropped, stats.late, stats.invalid, (unsigned long long)maxShowGapUs);
+    CHECK(receiver.isActive(), "receiver is not active");
+    CHECK(stats.frames == FRAMES, "%u of %u frames shown", stats.frames, FRAMES);
+    CHECK(stats.dropped == 0 && stats.late == 0 && stats.invalid == 0, "unexpected drops");
+    CHECK(mismatched == 0, "%u frames differ from what was sent", mismatched);
+    CHECK(maxShowGapUs < FRAME_US + 3000 + 2 * POLL_US, "frame gap %llu us", (unsigned long long)maxShowGapUs);
+    CHECK(hostBusLog(OUTPUT_UART_PIN).frames.size() == FRAMES && hostBusLog(OUTPUT_DMA_PIN).frames.size() == FRAMES,
+          "bus frames %zu and %zu", hostBusLog(OUTPUT_UART_PIN).frames.size(), hostBusLog(OUTPUT_DMA_PIN).frames.size());
+
+    // Пакет с уже принятым номером отбрасывается
+    RealtimeStats before = stats;
+    sendPacket(0, std::vector<uint8_t>(SPLIT * 3, 0xAA), true, sequence, 0);
+    pollFor(receiver, POLL_US);
+    CHECK(stats.late == before.late + 1 && stats.frames == before.frames, "stale sequence was shown");
+    CHECK(frameMatches(FRAMES - 1), "stale packet changed the strip");
+
+    // Два кадра за один опрос: выводится только последний
+    before = stats;
+    sendFrame(1000, 0);
+    sendFrame(1001, 0);
+    pollFor(receiver, POLL_US);
+    CHECK(stats.frames == before.frames + 1 && stats.dropped == before.dropped + 1,
+          "frames %u, dropped %u", stats.frames - before.frames, stats.dropped - before.dropped);
+    CHECK(frameMatches(1001), "last frame is not on the strip");
+
+    // Смещение за концом ленты, в том числе больше 65535 пикселей, ничего не пишет,
+    // а флаг вывода в нем по-прежнему выводит кадр
+    before = stats;
+    sendPacket(PIXELS * 3, std::vector<uint8_t>(30, 0xFF), true, nextSequence(), 0);
+    pollFor(receiver, POLL_US);
+    sendPacket(65536 * 3, std::vector<uint8_t>(30, 0xFF), true, nextSequence(), 0);
+    pollFor(receiver, POLL_US);
+    CHECK(stats.frames == before.frames + 2 && stats.invalid == before.invalid, "offset past the strip rejected");
+    CHECK(frameMatches(1001), "offset past the strip wrapped onto the strip");
+
+    // Смещение не кратно размеру пикселя
+    before = stats;
+    sendPacket(4, std::vector<uint8_t>(30, 0xFF), true, nextSequence(), 0);
+    pollFor(receiver, POLL_US);
+    CHECK(stats.invalid == before.invalid + 1 && frameMatches(1001), "misaligned offset accepted");
+
+    // Белый поток на всю ленту просит больше бюджета: кадр затемняется, ток попадает в метрики
+    before = stats;
+    sendPacket(0, std::vector<uint8_t>(PIXELS * 3, 0xFF), true, nextSequence(), 0);
+    pollFor(receiver, POLL_US);
+    CHECK(stats.frames == before.frames + 1, "bright frame not shown");
+    CHECK(effects.getRequestedCurrent() > POWER_BUDGET_MA, "requested %u mA", effects.getRequestedCurrent());
+    CHECK(effects.getPowerScale() < POWER_SCALE_FULL && effects.getOutputCurrent() <= POWER_BUDGET_MA,
+          "stream not limited: scale %u, %u mA", effects.getPowerScale(), effects.getOutputCurrent());
+    uint32_t limitedLoad = 0;
+    for(uint16_t p = 0; p < PIXELS; p++) {
+        const HostBusLog& bus = hostBusLog(p < SPLIT ? OUTPUT_UART_PIN : OUTPUT_DMA_PIN);
+        const uint8_t* out = bus.frames.back().data() + (p < SPLIT ? p : p - SPLIT) * StripOrder::SIZE;
+        limitedLoad += out[StripOrder::RED] + out[StripOrder::GREEN] + out[StripOrder::BLUE] + out[StripOrder::WHITE];
+    }
+    uint32_t limitedMa = POWER_BOARD_MA + POWER_PIXEL_IDLE_MA * PIXELS + limitedLoad * POWER_CHANNEL_MA / 255;
+    printf("realtime: white frame requests %u mA, scale %u/256, on the strip %u mA\n",
+           effects.getRequestedCurrent(), effects.getPowerScale(), limitedMa);
+    CHECK(limitedMa <= POWER_BUDGET_MA + PIXELS * POWER_CHANNEL_MA / 255, "strip draws %u mA", limitedMa);
+
+    // Общую часть цвета берет белый светодиод, если так настроено
+    effects.setWhiteRatio(254);
+    sendPacket(0, std::vector<uint8_t>(30, 40), true, nextSequence(), 0);
+    sendPacket(30, std::vector<uint8_t>((PIXELS - 10) * 3, 0), true, nextSequence(), 0);
+    pollFor(receiver, POLL_US);
+    const uint8_t* gray = hostBusLog(OUTPUT_UART_PIN).frames.back().data();
+    CHECK(gray[StripOrder::WHITE] == 40 && gray[StripOrder::RED] == 0 && gray[StripOrder::GREEN] == 0 &&
+          gray[StripOrder::BLUE] == 0, "gray not moved to white: %u %u %u %u", gray[StripOrder::RED],
+          gray[StripOrder::GREEN], gray[StripOrder::BLUE], gray[StripOrder::WHITE]);
+    CHECK(effects.getPowerScale() == POWER_SCALE_FULL, "dim frame still limited");
+
+    // Без пакетов возвращаемся к часам
+    pollFor(receiver, REALTIME_TIMEOUT * 1000 + POLL_US);
+    CHECK(!receiver.isActive() && stats.timeouts == 1, "no timeout after silence");
+
+    return checkResult("realtime");
+}
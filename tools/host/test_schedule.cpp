@@ -0,0 +1,146 @@
+// DaySchedule: точки смены правил в дни перехода на летнее время и обратно,
+// скачки часов после синхронизации и включение наборов по времени
+#include "check.h"
+#include "day_schedule.h"
+#include <vector>
+
+// Центральная Европа: зимой UTC+1, летом UTC+2, переходы в 01:00 UTC
+const TimeZone EUROPE = {3600, 3600, 3, 10, 1};
+const TimeZone MOSCOW = {3 * 3600, 0, 0, 0, 0};
+
+static const char RULES[] =
+    "{\"rules\": [{\"from\": \"22:00\", \"to\": \"07:00\", \"brightness\": 15, \"effect\": \"static\"},"
+    "            {\"from\": \"02:30\", \"to\": \"03:30\", \"brightness\": 40}]}";
+
+struct Change {
+    time_t at;
+    int8_t rule;
+};
+
+static time_t utc(int year, int month, int day, int hour, int minute) {
+    struct tm date = {};
+    date.tm_year = year - 1900;
+    date.tm_mon = month - 1;
+    date.tm_mday = day;
+    date.tm_hour = hour;
+    date.tm_min = minute;
+    return timegm(&date);
+}
+
+// Ход часов по секундам, как в кадре: запоминаются моменты смены правила
+static std::vector<Change> walk(DaySchedule& schedule, time_t from, time_t to) {
+    std::vector<Change> changes;
+    for(time_t now = from; now < to; now++) {
+        if (schedule.update(now)) changes.push_back({now, schedule.getActiveIndex()});
+    }
+    return changes;
+}
+
+static void expectChanges(const char* name, const std::vector<Change>& got, const std::vector<Change>& expected) {
+    CHECK(got.size() == expected.size(), "%s: %zu changes instead of %zu", name, got.size(), expected.size());
+    for(size_t i = 0; i < got.size() && i < expected.size(); i++) {
+        CHECK(got[i].at == expected[i].at && got[i].rule == expected[i].rule,
+              "%s: change %zu at %+lld s from expected, rule %d instead of %d", name, i,
+              (long long)(got[i].at - expected[i].at), got[i].rule, expected[i].rule);
+    }
+}
+
+static void testTimeZone() {
+    // 29 марта 2026 и 25 октября 2026 - последние воскресенья
+    CHECK(EUROPE.offsetAt(utc(2026, 3, 29, 0, 59)) == 3600, "winter offset before the spring switch");
+    CHECK(EUROPE.offsetAt(utc(2026, 3, 29, 1, 0)) == 7200, "summer offset after the spring switch");
+    CHECK(EUROPE.offsetAt(utc(2026, 10, 25, 0, 59)) == 7200, "summer offset before the autumn switch");
+    CHECK(EUROPE.offsetAt(utc(2026, 10, 25, 1, 0)) == 3600, "winter offset after the autumn switch");
+    // Пропущенное местное 02:30 - момент перехода, повторяющееся 02:30 - второй раз
+    CHECK(EUROPE.toUtc(utc(2026, 3, 29, 2, 30)) == utc(2026, 3, 29, 1, 0), "skipped local time");
+    CHECK(EUROPE.toUtc(utc(2026, 10, 25, 2, 30)) == utc(2026, 10, 25, 1, 30), "repeated local time");
+    CHECK(MOSCOW.toUtc(MOSCOW.toLocal(1760000000)) == 1760000000, "fixed offset round trip");
+}
+
+static void testSpringForward() {
+    DaySchedule schedule;
+    schedule.begin(EUROPE, nullptr);
+    CHECK(schedule.parse(RULES, strlen(RULES)), "rules rejected: %s", schedule.getError());
+
+    std::vector<Change> changes = walk(schedule, utc(2026, 3, 28, 12, 0), utc(2026, 3, 29, 12, 0));
+    expectChanges("spring", changes, {
+        {utc(2026, 3, 28, 12, 0), -1},
+        {utc(2026, 3, 28, 21, 0), 0},       // 22:00 CET
+        {utc(2026, 3, 29, 1, 0), 1},        // 02:30 не наступает, правило начинается в 03:00 CEST
+        {utc(2026, 3, 29, 1, 30), 0},       // 03:30 CEST
+        {utc(2026, 3, 29, 5, 0), -1},       // 07:00 CEST
+    });
+    CHECK(schedule.getStats().jumps == 0, "the DST switch counted as %u clock jumps", schedule.getStats().jumps);
+    CHECK(schedule.getStats().compiles == 2, "%u compiles over two local days", schedule.getStats().compiles);
+}
+
+static void testFallBack() {
+    DaySchedule schedule;
+    schedule.begin(EUROPE, nullptr);
+    schedule.parse(RULES, strlen(RULES));
+
+    std::vector<Change> changes = walk(schedule, utc(2026, 10, 24, 12, 0), utc(2026, 10, 26, 0, 0));
+    expectChanges("autumn", changes, {
+        {utc(2026, 10, 24, 12, 0), -1},
+        {utc(2026, 10, 24, 20, 0), 0},      // 22:00 CEST
+        {utc(2026, 10, 25, 1, 30), 1},      // 02:30 второй раз, уже CET
+        {utc(2026, 10, 25, 2, 30), 0},      // 03:30 CET
+        {utc(2026, 10, 25, 6, 0), -1},      // 07:00 CET
+        {utc(2026, 10, 25, 21, 0), 0},      // 22:00 CET
+    });
+    CHECK(schedule.getStats().jumps == 0, "the DST switch counted as %u clock jumps", schedule.getStats().jumps);
+    // Сутки 25 октября длятся 25 часов
+    schedule.update(utc(2026, 10, 25, 12, 0));
+    CHECK(schedule.getNextTransition() == utc(2026, 10, 25, 21, 0), "next transition %lld",
+          (long long)schedule.getNextTransition());
+}
+
+static void testClockJumps() {
+    PresetBank presets;
+    static const char PRESETS[] =
+        "{\"presets\": [{\"name\": \"evening\", \"effect\": \"static\", \"color\": \"#ff2000\","
+        "               \"brightness\": 60, \"at\": \"20:00\"}]}";
+    CHECK(presets.parse(PRESETS, strlen(PRESETS)), "presets rejected: %s", presets.getError());
+
+    DaySchedule schedule;
+    schedule.begin(MOSCOW, &presets);
+    schedule.parse(RULES, strlen(RULES));
+
+    // 12:00 по Москве, затем обычный ход до 20:00: набор включается один раз
+    time_t noon = utc(2026, 6, 10, 9, 0);
+    walk(schedule, noon, noon + 8 * 3600 + 5);
+    CHECK(schedule.takePreset() == 0, "preset not fired at 20:00");
+    CHECK(schedule.takePreset() == SCHEDULE_NO_PRESET, "preset fired twice");
+
+    // Синхронизация переставила часы вперед через 22:00: правило найдено сразу, набор не повторяется
+    time_t late = utc(2026, 6, 10, 20, 15);
+    CHECK(schedule.update(late), "jump into the night rule not reported");
+    CHECK(schedule.getActiveIndex() == 0, "rule %d after a forward jump", schedule.getActiveIndex());
+    CHECK(schedule.getStats().jumps == 1, "%u jumps", schedule.getStats().jumps);
+    CHECK(schedule.takePreset() == SCHEDULE_NO_PRESET, "preset fired after a jump");
+
+    // Назад через полночь - в предыдущие сутки, таблица собирается заново
+    uint32_t compiles = schedule.getStats().compiles;
+    time_t yesterday = utc(2026, 6, 9, 15, 0);
+    CHECK(schedule.update(yesterday), "jump back to the day not reported");
+    CHECK(schedule.getActiveIndex() == -1, "rule %d after a backward jump", schedule.getActiveIndex());
+    CHECK(schedule.getStats().compiles == compiles + 1, "table not rebuilt after a backward jump");
+    CHECK(schedule.getStats().jumps == 2, "%u jumps", schedule.getStats().jumps);
+    CHECK(schedule.takePreset() == SCHEDULE_NO_PRESET, "preset fired after a backward jump");
+
+    // Шаг вперед до следующей точки - только сравнение, шаг через точку меньше
+    // SCHEDULE_MAX_STEP - обычный ход, набор включается
+    time_t beforeEvening = utc(2026, 6, 9, 16, 59);
+    CHECK(!schedule.update(beforeEvening), "step before the next point reported");
+    schedule.update(beforeEvening + 90);
+    CHECK(schedule.takePreset() == 0, "preset not fired after a small step over 20:00");
+    CHECK(schedule.getStats().jumps == 2, "%u jumps", schedule.getStats().jumps);
+}
+
+int main() {
+    testTimeZone();
+    testSpringForward();
+    testFallBack();
+    testClockJumps();
+    return checkResult("schedule");
+}
@@ -0,0 +1,69 @@
+// Планировщик с набором задач из main.cpp на виртуальных часах: кадр держит срок,
+// а задачи PRIORITY_NORMAL выполняются со своим периодом рядом с частыми опросами
+#include "check.h"
+#include "scheduler.h"
+
+// Время работы задачи: обычное и изредка долгое, мкс
+struct Load {
+    uint32_t usual;
+    uint32_t spike;
+    uint32_t spikeEvery;         // каждый N-й запуск долгий, 0 - никогда
+    uint32_t calls;
+};
+
+static Load loads[SCHEDULER_MAX_TASKS];
+static Scheduler scheduler(micros);
+
+static void work() {
+    Load& load = loads[scheduler.getCurrentTask()];
+    load.calls++;
+    bool spike = load.spikeEvery != 0 && load.calls % load.spikeEvery == 0;
+    hostAdvance(spike ? load.spike : load.usual);
+}
+
+static void add(const char* name, uint32_t periodMs, uint8_t priority, uint32_t budgetUs, Load load) {
+    int8_t id = scheduler.addPeriodic(name, work, periodMs, priority, budgetUs);
+    loads[id] = load;
+}
+
+int main() {
+    // Периоды, приоритеты и бюджеты как в setup()
+    add("frame", 50, PRIORITY_FRAME, 5000, {3000, 4500, 20, 0});
+    add("dither", 10, PRIORITY_FRAME, 4000, {800, 0, 0, 0});
+    add("realtime", 2, PRIORITY_FRAME, 4000, {30, 0, 0, 0});
+    add("clock", 1000, PRIORITY_HIGH, 500, {100, 0, 0, 0});
+    add("sync", 10, PRIORITY_HIGH, 1000, {60, 300, 100, 0});
+    add("wifi", 100, PRIORITY_NORMAL, 2000, {100, 0, 0, 0});
+    add("http", 2, PRIORITY_NORMAL, 10000, {40, 6000, 250, 0});
+    add("ws", 2, PRIORITY_NORMAL, 5000, {60, 400, 50, 0});
+    add("mqtt", 10, PRIORITY_NORMAL, 5000, {150, 2000, 100, 0});
+    add("events", 100, PRIORITY_NORMAL, 3000, {200, 0, 0, 0});
+    add("ota", 10, PRIORITY_NORMAL, 2000, {20, 0, 0, 0});
+    add("sntp", 20, PRIORITY_LOW, 2000, {30, 0, 0, 0});
+
+    const uint64_t durationUs = 10000000;
+    uint64_t end = hostMicros() + durationUs;
+    while (hostMicros() < end) {
+        scheduler.run();
+        hostAdvance(20);
+    }
+
+    for(uint8_t i = 0; i < scheduler.getTaskCount(); i++) {
+        const Task& task = scheduler.getTask(i);
+        uint32_t nominal = durationUs / task.periodUs;
+        printf("%-9s runs %5u of %5u, deferrals %5u, overruns %3u, max late %6u us\n",
+               task.name, task.runs, nominal, task.deferrals, task.overruns, task.maxLateUs);
+        if (task.priority == PRIORITY_NORMAL) {
+            // Срыв до SCHEDULER_MAX_DEFER дал бы около 10 запусков в секунду. Ожидание
+            // кадра и подсветки законно и стоит не больше половины запусков
+            CHECK(task.runs >= nominal / 2, "%s ran %u of %u times", task.name, task.runs, nominal);
+            CHECK(task.maxLateUs < SCHEDULER_MAX_DEFER / 4, "%s late by %u us", task.name, task.maxLateUs);
+        }
+        if (strcmp(task.name, "frame") == 0) {
+            CHECK(task.runs >= nominal - 1, "frame ran %u of %u times", task.runs, nominal);
+            // Кадр ждет не дольше самой долгой из уже начатых задач
+            CHECK(task.maxLateUs <= 6500, "frame late by %u us", task.maxLateUs);
+        }
+    }
+    return checkResult("scheduler");
+}
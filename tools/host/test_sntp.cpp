@@ -0,0 +1,95 @@
+// SntpClient против локального сервера-заменителя: задержка, джиттер, уход кварца,
+// сервер с большой задержкой и имя, которое не разрешается
+#include "check.h"
+#include "sntp_client.h"
+
+const uint32_t NTP_UNIX_OFFSET = 2208988800UL;
+const int64_t TRUE_EPOCH_US = 1760000000LL * 1000000LL;
+const int64_t CRYSTAL_PPM = 150;           // локальные часы спешат
+
+// Истинное время в зависимости от показаний локального кварца
+static int64_t trueTimeUs(uint64_t localUs) {
+    return TRUE_EPOCH_US + (int64_t)localUs - (int64_t)localUs * CRYSTAL_PPM / 1000000;
+}
+
+static void writeStamp(uint8_t* p, int64_t unixUs) {
+    uint32_t seconds = unixUs / 1000000 + NTP_UNIX_OFFSET;
+    uint32_t fraction = ((uint64_t)(unixUs % 1000000) << 32) / 1000000;
+    for(int i = 0; i < 4; i++) {
+        p[i] = seconds >> (24 - i * 8);
+        p[4 + i] = fraction >> (24 - i * 8);
+    }
+}
+
+struct StandIn {
+    uint32_t baseDelayUs;    // в одну сторону
+    uint32_t jitterUs;
+    uint32_t requests;
+};
+
+static void addServer(const char* name, IPAddress ip, StandIn* server) {
+    hostAddHost(name, ip, 40);
+    hostAddPeer(ip, 123, [server](const HostDatagram& request) {
+        server->requests++;
+        uint32_t out = server->baseDelayUs + random(server->jitterUs + 1);
+        uint32_t back = server->baseDelayUs + random(server->jitterUs + 1);
+        HostDatagram reply = request;
+        std::swap(reply.source, reply.destination);
+        std::swap(reply.sourcePort, reply.destinationPort);
+        reply.data.assign(48, 0);
+        reply.data[0] = 0x24;    // версия 4, режим 4 (сервер)
+        reply.data[1] = 2;
+        memcpy(&reply.data[24], &request.data[40], 8);
+        writeStamp(&reply.data[32], trueTimeUs(request.deliverUs + out));
+        writeStamp(&reply.data[40], trueTimeUs(request.deliverUs + out + 50));
+        reply.deliverUs = request.deliverUs + out + 50 + back;
+        hostSend(reply);
+    });
+}
+
+int main() {
+    StandIn nearServer = {3000, 4000, 0};
+    StandIn farServer = {400000, 0, 0};      // задержка больше SNTP_MAX_DELAY
+    addServer("near.test", IPAddress(10, 0, 0, 1), &nearServer);
+    addServer("far.test", IPAddress(10, 0, 0, 2), &farServer);
+
+    const char* servers[] = {"far.test", "missing.test", "near.test"};
+    SntpClient sntp;
+    sntp.begin(servers, 3);
+
+    uint64_t lastMs = 0;
+    int64_t worstErrorUs = 0;
+    uint64_t longestLoopUs = 0;
+    // Шесть часов виртуального времени шагами по миллисекунде
+    for(uint64_t step = 0; step < 6ULL * 3600 * 1000; step++) {
+        uint64_t before = hostMicros();
+        sntp.loop();
+        longestLoopUs = std::max(longestLoopUs, hostMicros() - before);
+        hostAdvance(1000);
+
+        if (!sntp.isSynced() || step % 100 != 0) continue;
+        uint64_t nowMs = sntp.nowMs();
+        CHECK(nowMs >= lastMs, "clock went back at %llu ms: %llu < %llu",
+              (unsigned long long)step, (unsigned long long)nowMs, (unsigned long long)lastMs);
+        lastMs = nowMs;
+        // Оценка ухода сходится за несколько опросов, каждый уменьшает ошибку вдвое
+        if (step > 3ULL * 3600 * 1000) {
+            int64_t error = (int64_t)nowMs * 1000 - trueTimeUs(hostMicros());
+            worstErrorUs = std::max(worstErrorUs, error < 0 ? -error : error);
+        }
+    }
+
+    const SntpStats& stats = sntp.getStats();
+    printf("syncs %u, fails %u, drift %.1f ppm, last offset %d ms, worst error %lld us, dns queries %u\n",
+           stats.syncCount, stats.failCount, stats.driftPpm, stats.offsetMs,
+           (long long)worstErrorUs, hostDnsQueries());
+    CHECK(longestLoopUs == 0, "loop() waited %llu us", (unsigned long long)longestLoopUs);
+    CHECK(stats.syncCount >= 20, "only %u syncs", stats.syncCount);
+    CHECK(stats.lastServer == 2, "best sample from server %u", stats.lastServer);
+    CHECK(fabsf(stats.driftPpm + CRYSTAL_PPM) < 20, "drift estimate %.1f ppm", stats.driftPpm);
+    CHECK(worstErrorUs < 10000, "clock error %lld us", (long long)worstErrorUs);
+    CHECK(farServer.requests > 0 && nearServer.requests > 0, "servers were not polled");
+    // Имена кэшируются: повторный запрос DNS только для неразрешенного сервера
+    CHECK(hostDnsQueries() <= 3 + stats.syncCount + stats.failCount, "%u dns queries", hostDnsQueries());
+    return checkResult("sntp");
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Проверка и замер образа для обновления по сети (см. tools/ota_pack.py, src/ota_verify.h).
+
+Образ упаковывается как ota_pack.py и подается порциями, как его принимают часы:
+хеш считается по мере записи и сверяется с хвостом так же, как OtaVerifier,
+затем gzip распаковывается потоком и сравнивается с исходной прошивкой.
+Печатает скорость распаковки и проверки и время передачи .bin и .bin.gz по каналу.
+Пример:
+    python3 tools/ota_bench.py .pio/build/esp8266/firmware.bin --link 1000
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import time
+import zlib
+
+from ota_pack import HASH_SIZE, pack
+
+UPLOAD_CHUNK = 2048    # HTTP_UPLOAD_BUFLEN в ESP8266WebServer
+
+
+def verify(image, chunk):
+    """Хеш всего до хвоста против записанного в хвосте, как Updater с OtaVerifier."""
+    trailer = image[-4:]
+    if struct.unpack("<I", trailer)[0] != HASH_SIZE:
+        return False
+    body = image[:-HASH_SIZE - 4]
+    digest = hashlib.sha256()
+    for start in range(0, len(body), chunk):
+        digest.update(body[start:start + chunk])
+    return digest.digest() == image[-HASH_SIZE - 4:-4]
+
+
+def inflate(compressed, chunk):
+    """Потоковая распаковка gzip с окном 32 КБ, как у загрузчика eboot."""
+    stream = zlib.decompressobj(16 + 15)
+    out = bytearray()
+    for start in range(0, len(compressed), chunk):
+        out += stream.decompress(compressed[start:start + chunk])
+    out += stream.flush()
+    return bytes(out)
+
+
+def measure(function, repeat):
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = function()
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None or elapsed < best else best
+    return result, best
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Проверка и замер образа для обновления LED часов")
+    parser.add_argument("input", help="firmware.bin после сборки")
+    parser.add_argument("--chunk", type=int, default=UPLOAD_CHUNK, help="размер порции, байт")
+    parser.add_argument("--link", type=float, default=1000, help="полезная скорость канала, кбит/с")
+    parser.add_argument("--repeat", type=int, default=5, help="повторов замера, берется лучший")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        firmware = f.read()
+    image = pack(firmware)
+    compressed = image[:-HASH_SIZE - 4]
+
+    ok, verify_s = measure(lambda: verify(image, args.chunk), args.repeat)
+    if not ok:
+        sys.exit("хеш образа не совпал")
+    broken = bytearray(image)
+    broken[len(compressed) // 2] ^= 0x01
+    if verify(bytes(broken), args.chunk):
+        sys.exit("испорченный образ прошел проверку")
+
+    restored, inflate_s = measure(lambda: inflate(compressed, args.chunk), args.repeat)
+    if restored != firmware:
+        sys.exit("распакованный образ отличается от исходного")
+
+    mb = len(firmware) / 1e6
+    plain_s = len(firmware) * 8 / (args.link * 1000)
+    packed_s = len(image) * 8 / (args.link * 1000)
+    print("образ: %d -> %d байт (%.1f%%), порции по %d байт" %
+          (len(firmware), len(image), 100.0 * len(image) / len(firmware), args.chunk))
+    print("проверка sha256: %.1f МБ/с, распаковка: %.1f МБ/с (на этой машине)" %
+          (len(compressed) / 1e6 / verify_s, mb / inflate_s))
+    print("передача при %.0f кбит/с: .bin %.1f с, .bin.gz %.1f с" % (args.link, plain_s, packed_s))
+
+
+if __name__ == "__main__":
+    main()
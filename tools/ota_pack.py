@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Подготовка прошивки LED часов к обновлению по сети (см. src/ota_verify.h).
+
+Образ сжимается gzip (распаковывает загрузчик eboot при перезагрузке),
+в конец дописываются SHA-256 сжатого образа и длина хеша. Хеш нужен сборке
+env:esp8266-signed; для обычной сборки достаточно --no-hash.
+Пример:
+    python3 tools/ota_pack.py .pio/build/esp8266-signed/firmware.bin firmware.bin.gz
+Загрузка на часы:
+    curl -F "update=@firmware.bin.gz" http://<ip>/update
+    python3 espota.py -i <ip> -f firmware.bin.gz
+"""
+
+import argparse
+import gzip
+import hashlib
+import struct
+import sys
+
+HASH_SIZE = 32
+
+
+def pack(firmware, with_hash=True):
+    # Образ ESP8266 начинается с 0xE9, сжатый - с 0x1F
+    if firmware[:1] != b"\xe9":
+        sys.exit("это не образ прошивки ESP8266, нужен исходный firmware.bin")
+    # mtime=0: одинаковый вход дает одинаковый выход
+    compressed = gzip.compress(firmware, compresslevel=9, mtime=0)
+    if not with_hash:
+        return compressed
+    digest = hashlib.sha256(compressed).digest()
+    return compressed + digest + struct.pack("<I", HASH_SIZE)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Сжатие и подпись хешем прошивки LED часов")
+    parser.add_argument("input", help="firmware.bin после сборки")
+    parser.add_argument("output", help="файл .bin.gz для загрузки на часы")
+    parser.add_argument("--no-hash", action="store_true", help="только сжатие, для сборки без OTA_REQUIRE_HASH")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        firmware = f.read()
+    data = pack(firmware, not args.no_hash)
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    print("%d -> %d байт (%.1f%%)" % (len(firmware), len(data), 100.0 * len(data) / len(firmware)))
+    if not args.no_hash:
+        print("sha256 %s" % data[-HASH_SIZE - 4:-4].hex())
+
+
+if __name__ == "__main__":
+    main()